@@ -0,0 +1,166 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <system_error>
+
+#include "../support/error.hpp"
+#include "../support/asset_archive.hpp"
+
+#include "../jobs/job_system.hpp"
+
+/* Asset archive packer
+ *
+ * Packs all files below the given directories into one archive (see
+ * support/asset_archive.hpp), compressing them in parallel. Paths are
+ * stored relative to --root, which must be the directory that the program
+ * is run from (paths like "assets/default.vert" then resolve the same way
+ * from the archive as from loose files).
+ *
+ * Build files (Makefile, *.vcxproj*), Wavefront OBJ files and virtual
+ * texture tiles (*.vtex) are skipped; OBJ files are read by rapidobj
+ * directly from disk, and tiles are read one at a time as needed rather
+ * than unpacked as a whole.
+ *
+ * Exit code: 0 on success, 1 on errors, 2 on usage errors.
+ */
+
+namespace
+{
+	struct Options_
+	{
+		char const* root = ".";
+		std::size_t threads = 0;
+		std::vector<char const*> inputs;
+		char const* output = nullptr;
+	};
+
+	void print_help_( char const* aProgram )
+	{
+		std::printf( "Usage: %s [options] DIR... ARCHIVE\n", aProgram );
+		std::printf( "Options:\n" );
+		std::printf( "  --root=DIR          Store paths relative to DIR (default: .)\n" );
+		std::printf( "  --threads=N         Compress on N worker threads (default: all cores)\n" );
+	}
+
+	char const* match_value_( char const* aArg, char const* aName )
+	{
+		std::size_t const len = std::strlen( aName );
+		if( 0 != std::strncmp( aArg, aName, len ) || '=' != aArg[len] )
+			return nullptr;
+
+		return aArg + len + 1;
+	}
+
+	bool skipped_( std::filesystem::path const& aPath )
+	{
+		auto const name = aPath.filename().string();
+		auto const ext = aPath.extension().string();
+
+		return "Makefile" == name
+			|| std::string::npos != name.find( ".vcxproj" )
+			|| ".obj" == ext || ".OBJ" == ext
+			|| ".vtex" == ext
+		;
+	}
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+	Options_ options;
+	std::vector<char const*> positional;
+	for( int i = 1; i < aArgc; ++i )
+	{
+		char const* arg = aArgv[i];
+
+		if( 0 == std::strcmp( arg, "--help" ) )
+		{
+			print_help_( aArgv[0] );
+			return 0;
+		}
+		else if( char const* value = match_value_( arg, "--root" ) )
+		{
+			options.root = value;
+		}
+		else if( char const* value = match_value_( arg, "--threads" ) )
+		{
+			options.threads = std::size_t(std::max( 0, std::atoi( value ) ));
+		}
+		else if( '-' == arg[0] && '-' == arg[1] )
+		{
+			std::fprintf( stderr, "asset-packer: unknown option '%s' (try --help)\n", arg );
+			return 2;
+		}
+		else
+		{
+			positional.emplace_back( arg );
+		}
+	}
+
+	if( positional.size() < 2 )
+	{
+		print_help_( aArgv[0] );
+		return 2;
+	}
+
+	options.output = positional.back();
+	options.inputs.assign( positional.begin(), positional.end()-1 );
+
+	// Collect files, relative to the root
+	namespace fs = std::filesystem;
+	fs::path const root = fs::absolute( options.root ).lexically_normal();
+
+	std::vector<std::string> files;
+	for( auto const input : options.inputs )
+	{
+		std::error_code ec;
+		for( fs::recursive_directory_iterator it( input, ec ), end; !ec && it != end; it.increment( ec ) )
+		{
+			if( !it->is_regular_file() || skipped_( it->path() ) )
+				continue;
+
+			auto const relative = fs::absolute( it->path() ).lexically_normal().lexically_relative( root );
+			if( relative.empty() || *relative.begin() == ".." )
+				throw Error( "'%s' is outside of the root '%s'", it->path().string().c_str(), root.string().c_str() );
+
+			files.emplace_back( relative.generic_string() );
+		}
+
+		if( ec )
+			throw Error( "Unable to list '%s': %s", input, ec.message().c_str() );
+	}
+
+	// Files are read relative to the root too.
+	auto const cwd = fs::current_path();
+	auto const output = fs::absolute( options.output );
+	fs::current_path( root );
+
+	auto const start = std::chrono::steady_clock::now();
+
+	JobSystem jobs( options.threads );
+	auto const stats = write_asset_archive( output.string().c_str(), files, jobs );
+
+	auto const ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+	fs::current_path( cwd );
+
+	std::printf( "asset-packer: %zu files (%zu compressed), %.1f KiB -> %.1f KiB in '%s' (%.1f ms, %zu threads)\n",
+		stats.entries, stats.compressed,
+		stats.originalBytes / 1024.0,
+		stats.fileBytes / 1024.0,
+		options.output,
+		ms, jobs.thread_count()
+	);
+
+	return 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "asset-packer: %s\n", eErr.what() );
+	return 1;
+}
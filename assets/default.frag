@@ -1,5 +1,221 @@
 #version 430
 
+// Must match MaterialGpu_ in main/material.cpp
+struct Material
+{
+	vec4 diffuse;   // rgb: Kd
+	vec4 specular;  // rgb: Ks, a: Ns
+	vec4 emissive;  // rgb: Ke
+	ivec4 texture;  // x: array (-1 = none, -2 = virtual), y: layer
+};
+
+layout( std430, binding = 0 ) readonly buffer Materials
+{
+	Material uMaterials[];
+};
+
+layout( binding = 0 ) uniform sampler2DArray uMaterialTextures[4];
+
+// Virtual texture, see main/virtual_texture.hpp. Bindings and the page table
+// layout must match main/virtual_texture.cpp.
+const int kVirtualTexture = -2;
+
+layout( std430, binding = 5 ) readonly buffer PageTable
+{
+	vec4 uVtSize;        // xy: level 0 size (texels), z: tile size, w: border
+	vec4 uVtCache;       // xy: 1 / cache size (texels), z: page size, w: level count
+	uvec4 uVtLevels[16]; // x: first entry, yz: tiles
+	uint uVtEntries[];   // page x | page y << 12 | level << 24
+};
+
+layout( binding = 5 ) uniform sampler2D uVtPages;
+
+layout( location = 2 ) uniform vec3 uLightDir; // towards the light, world space
+
+// Cascaded shadow maps, see main/shadow_map.hpp. Binding and locations must
+// match main/shadow_map.cpp.
+layout( binding = 4 ) uniform sampler2DArrayShadow uShadowMap;
+
+layout( location = 4 ) uniform mat4 uShadowMatrices[4]; // world -> [0,1]^3
+layout( location = 8 ) uniform vec4 uCascadeEnds;       // view distance
+layout( location = 9 ) uniform vec3 uCameraPosition;
+layout( location = 10 ) uniform vec3 uCameraForward;
+layout( location = 11 ) uniform int uShadowCascades;    // 0: no shadows
+layout( location = 12 ) uniform vec4 uShadowTexelSizes; // world units
+
+// Clustered point and spot lights, see main/clustered_lights.hpp. Bindings,
+// locations and the grid size must match main/clustered_lights.cpp.
+const uvec3 kClusterGrid = uvec3( 16, 9, 24 );
+
+// Must match LightGpu_ in main/clustered_lights.hpp
+struct Light
+{
+	vec4 positionRange;      // xyz: world space, w: range
+	vec4 colorSpotOuter;     // rgb: color, a: cos of the outer cone angle (-1 = point light)
+	vec4 directionSpotInner; // xyz: cone axis, w: cos of the inner cone angle
+};
+
+layout( std430, binding = 1 ) readonly buffer Lights
+{
+	Light uLights[];
+};
+
+layout( std430, binding = 2 ) readonly buffer Clusters
+{
+	uvec2 uClusters[]; // x: offset into uLightIndices, y: count
+};
+
+layout( std430, binding = 3 ) readonly buffer LightIndices
+{
+	uint uLightIndices[];
+};
+
+layout( location = 13 ) uniform vec4 uClusterParams; // xy: tiles per pixel, z: slice scale, w: slice bias
+layout( location = 14 ) uniform int uLightMode;      // 0: no lights, 1: clustered, 2: all lights (naive)
+layout( location = 15 ) uniform int uLightCount;
+
+in vec3 v2fWorldPosition;
+in vec3 v2fNormal;
+in vec2 v2fTexCoord;
+flat in uint v2fMaterial;
+
+layout( location = 0 ) out vec3 oColor;
+
+// Level of the virtual texture whose texels are about a pixel in size
+// (nearest level). Must match assets/vt_feedback.frag.
+uint vt_level( vec2 aDx, vec2 aDy, float aBias )
+{
+	vec2 dx = aDx * uVtSize.xy;
+	vec2 dy = aDy * uVtSize.xy;
+	float lod = 0.5 * log2( max( dot( dx, dx ), dot( dy, dy ) ) ) + aBias;
+	return uint( clamp( floor( lod + 0.5 ), 0.0, uVtCache.w - 1.0 ) );
+}
+
+// Tile of a level containing aTexCoord (in [0,1)). Must match
+// assets/vt_feedback.frag.
+uvec2 vt_tile( vec2 aTexCoord, uint aLevel )
+{
+	vec2 texel = aTexCoord * uVtSize.xy / exp2( float(aLevel) );
+	return min( uvec2( texel / uVtSize.z ), uVtLevels[aLevel].yz - 1u );
+}
+
+// The page table entry of the wanted tile names the page of the finest
+// resident level covering it, which may be coarser.
+vec4 sample_virtual( vec2 aTexCoord, vec2 aDx, vec2 aDy )
+{
+	vec2 uv = fract( aTexCoord );
+	uint level = vt_level( aDx, aDy, 0.0 );
+	uvec2 tile = vt_tile( uv, level );
+
+	uint entry = uVtEntries[uVtLevels[level].x + tile.y * uVtLevels[level].y + tile.x];
+	uvec2 page = uvec2( entry & 0xfffu, (entry >> 12) & 0xfffu );
+	uint resident = entry >> 24;
+
+	// Position within the resident tile, which covers the wanted one
+	vec2 texel = uv * uVtSize.xy / exp2( float(resident) );
+	vec2 offset = clamp( texel - vec2( tile >> (resident - level) ) * uVtSize.z, vec2( 0.0 ), vec2( uVtSize.z ) );
+
+	vec2 coord = (vec2( page ) * uVtCache.z + uVtSize.w + offset) * uVtCache.xy;
+	return textureLod( uVtPages, coord, 0.0 );
+}
+
+// The array index varies per fragment, so the samplers cannot be indexed
+// directly. Derivatives are computed outside of the branch.
+vec4 sample_material( ivec4 aTexture, vec2 aTexCoord, vec2 aDx, vec2 aDy )
+{
+	vec3 uvw = vec3( aTexCoord, float(aTexture.y) );
+	switch( aTexture.x )
+	{
+		case 0: return textureGrad( uMaterialTextures[0], uvw, aDx, aDy );
+		case 1: return textureGrad( uMaterialTextures[1], uvw, aDx, aDy );
+		case 2: return textureGrad( uMaterialTextures[2], uvw, aDx, aDy );
+		case 3: return textureGrad( uMaterialTextures[3], uvw, aDx, aDy );
+		case kVirtualTexture: return sample_virtual( aTexCoord, aDx, aDy );
+	}
+	return vec4( 1.0 );
+}
+
+// 1 = lit, 0 = in shadow
+float shadow( vec3 aPosition, vec3 aNormal )
+{
+	float depth = dot( aPosition - uCameraPosition, uCameraForward );
+
+	int cascade = 0;
+	while( cascade < uShadowCascades && depth > uCascadeEnds[cascade] )
+		++cascade;
+
+	if( cascade >= uShadowCascades )
+		return 1.0;
+
+	// Normal offset (about a texel) against self-shadowing on slopes
+	vec3 position = aPosition + aNormal * (1.5 * uShadowTexelSizes[cascade]);
+	vec4 coord = uShadowMatrices[cascade] * vec4( position, 1.0 );
+
+	return texture( uShadowMap, vec4( coord.xy, float(cascade), coord.z ) );
+}
+
+// Diffuse light from one point or spot light. Falls off with the inverse
+// square of the distance, windowed to reach zero at the light's range.
+vec3 local_light( Light aLight, vec3 aPosition, vec3 aNormal )
+{
+	vec3 toLight = aLight.positionRange.xyz - aPosition;
+	float dist2 = dot( toLight, toLight );
+	float range = aLight.positionRange.w;
+
+	float r2 = dist2 / (range * range);
+	if( r2 >= 1.0 )
+		return vec3( 0.0 );
+
+	vec3 l = toLight * inversesqrt( max( dist2, 1e-8 ) );
+	float window = (1.0 - r2*r2) * (1.0 - r2*r2);
+	float intensity = window / (1.0 + dist2) * max( 0.0, dot( aNormal, l ) );
+
+	float cosOuter = aLight.colorSpotOuter.a;
+	if( cosOuter > -1.0 )
+		intensity *= smoothstep( cosOuter, aLight.directionSpotInner.w, dot( -l, aLight.directionSpotInner.xyz ) );
+
+	return aLight.colorSpotOuter.rgb * intensity;
+}
+
+vec3 local_lights( vec3 aPosition, vec3 aNormal )
+{
+	vec3 ret = vec3( 0.0 );
+
+	if( 1 == uLightMode )
+	{
+		float depth = dot( aPosition - uCameraPosition, uCameraForward );
+
+		uvec2 tile = min( uvec2( gl_FragCoord.xy * uClusterParams.xy ), kClusterGrid.xy - 1u );
+		int slice = int( log( max( depth, 1e-4 ) ) * uClusterParams.z + uClusterParams.w );
+		uint z = uint( clamp( slice, 0, int(kClusterGrid.z) - 1 ) );
+
+		uvec2 cluster = uClusters[(z * kClusterGrid.y + tile.y) * kClusterGrid.x + tile.x];
+		for( uint i = 0; i < cluster.y; ++i )
+			ret += local_light( uLights[uLightIndices[cluster.x + i]], aPosition, aNormal );
+	}
+	else if( 2 == uLightMode )
+	{
+		for( int i = 0; i < uLightCount; ++i )
+			ret += local_light( uLights[i], aPosition, aNormal );
+	}
+
+	return ret;
+}
+
 void main()
-{}
+{
+	vec2 dx = dFdx( v2fTexCoord );
+	vec2 dy = dFdy( v2fTexCoord );
+
+	Material mat = uMaterials[v2fMaterial];
+	vec3 albedo = mat.diffuse.rgb * sample_material( mat.texture, v2fTexCoord, dx, dy ).rgb;
+
+	vec3 normal = normalize( v2fNormal );
+	float nDotL = max( 0.0, dot( normal, uLightDir ) );
+
+	float lit = nDotL > 0.0 ? shadow( v2fWorldPosition, normal ) : 0.0;
+
+	vec3 local = local_lights( v2fWorldPosition, normal );
 
+	oColor = albedo * (0.05 + nDotL * lit + local) + mat.emissive.rgb;
+}
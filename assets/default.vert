@@ -1,4 +1,28 @@
 #version 430
 
+layout( location = 0 ) in vec3 iPosition;
+layout( location = 1 ) in vec3 iNormal;
+layout( location = 2 ) in vec2 iTexCoord;
+layout( location = 3 ) in uint iMaterial;
+
+layout( location = 0 ) uniform mat4 uProjCameraWorld;
+layout( location = 1 ) uniform mat3 uNormalMatrix;
+layout( location = 3 ) uniform mat4 uWorld;
+
+out vec3 v2fWorldPosition;
+out vec3 v2fNormal;
+out vec2 v2fTexCoord;
+flat out uint v2fMaterial;
+
+// Must match assets/depth.vert (depth pre-pass, GL_EQUAL)
+invariant gl_Position;
+
 void main()
-{}
+{
+	v2fWorldPosition = (uWorld * vec4( iPosition, 1.0 )).xyz;
+	v2fNormal = normalize( uNormalMatrix * iNormal );
+	v2fTexCoord = iTexCoord;
+	v2fMaterial = iMaterial;
+
+	gl_Position = uProjCameraWorld * vec4( iPosition, 1.0 );
+}
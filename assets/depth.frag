@@ -0,0 +1,7 @@
+#version 430
+
+// Depth pre-pass: depth only, color writes are masked.
+
+void main()
+{
+}
@@ -0,0 +1,17 @@
+#version 430
+
+// Depth pre-pass (see main/renderer.cpp). The shading pass draws with
+// GL_EQUAL, so gl_Position must come out bit for bit the same as in
+// default.vert: same input, same uniform, same expression, and invariant in
+// both.
+
+layout( location = 0 ) in vec3 iPosition;
+
+layout( location = 0 ) uniform mat4 uProjCameraWorld;
+
+invariant gl_Position;
+
+void main()
+{
+	gl_Position = uProjCameraWorld * vec4( iPosition, 1.0 );
+}
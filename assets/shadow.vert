@@ -0,0 +1,12 @@
+#version 430
+
+// Depth only: no fragment shader.
+
+layout( location = 0 ) in vec3 iPosition;
+
+layout( location = 0 ) uniform mat4 uLightProjWorld;
+
+void main()
+{
+	gl_Position = uLightProjWorld * vec4( iPosition, 1.0 );
+}
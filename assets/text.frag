@@ -0,0 +1,13 @@
+#version 430
+
+layout( binding = 0 ) uniform sampler2D uAtlas; // glyph coverage in .r
+
+in vec2 v2fTexCoord;
+in vec4 v2fColor;
+
+layout( location = 0 ) out vec4 oColor;
+
+void main()
+{
+	oColor = vec4( v2fColor.rgb, v2fColor.a * texture( uAtlas, v2fTexCoord ).r );
+}
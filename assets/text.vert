@@ -0,0 +1,22 @@
+#version 430
+
+layout( location = 0 ) in vec2 iPosition; // pixels, origin top left
+layout( location = 1 ) in vec2 iTexCoord;
+layout( location = 2 ) in vec4 iColor;
+
+layout( location = 0 ) uniform vec2 uPixelToClip; // 2/width, 2/height
+
+out vec2 v2fTexCoord;
+out vec4 v2fColor;
+
+void main()
+{
+	v2fTexCoord = iTexCoord;
+	v2fColor = iColor;
+
+	gl_Position = vec4(
+		iPosition.x * uPixelToClip.x - 1.0,
+		1.0 - iPosition.y * uPixelToClip.y,
+		0.0, 1.0
+	);
+}
@@ -0,0 +1,69 @@
+#version 430
+
+// Virtual texture feedback, see main/virtual_texture.hpp: writes the tile
+// that assets/default.frag samples. Drawn with assets/default.vert.
+
+// Must match MaterialGpu_ in main/material.cpp
+struct Material
+{
+	vec4 diffuse;
+	vec4 specular;
+	vec4 emissive;
+	ivec4 texture;  // x: array (-1 = none, -2 = virtual), y: layer
+};
+
+layout( std430, binding = 0 ) readonly buffer Materials
+{
+	Material uMaterials[];
+};
+
+// Must match assets/default.frag
+const int kVirtualTexture = -2;
+
+layout( std430, binding = 5 ) readonly buffer PageTable
+{
+	vec4 uVtSize;        // xy: level 0 size (texels), z: tile size, w: border
+	vec4 uVtCache;       // xy: 1 / cache size (texels), z: page size, w: level count
+	uvec4 uVtLevels[16]; // x: first entry, yz: tiles
+	uint uVtEntries[];
+};
+
+layout( location = 16 ) uniform float uLodBias; // -log2 of the feedback downscale
+
+in vec2 v2fTexCoord;
+flat in uint v2fMaterial;
+
+layout( location = 0 ) out uint oRequest; // tile x | y << 12 | level << 24 (~0u: none)
+
+// Must match assets/default.frag
+uint vt_level( vec2 aDx, vec2 aDy, float aBias )
+{
+	vec2 dx = aDx * uVtSize.xy;
+	vec2 dy = aDy * uVtSize.xy;
+	float lod = 0.5 * log2( max( dot( dx, dx ), dot( dy, dy ) ) ) + aBias;
+	return uint( clamp( floor( lod + 0.5 ), 0.0, uVtCache.w - 1.0 ) );
+}
+
+// Must match assets/default.frag
+uvec2 vt_tile( vec2 aTexCoord, uint aLevel )
+{
+	vec2 texel = aTexCoord * uVtSize.xy / exp2( float(aLevel) );
+	return min( uvec2( texel / uVtSize.z ), uVtLevels[aLevel].yz - 1u );
+}
+
+void main()
+{
+	vec2 dx = dFdx( v2fTexCoord );
+	vec2 dy = dFdy( v2fTexCoord );
+
+	// Other surfaces still occlude virtually textured ones.
+	if( kVirtualTexture != uMaterials[v2fMaterial].texture.x )
+	{
+		oRequest = 0xffffffffu;
+		return;
+	}
+
+	uint level = vt_level( dx, dy, uLodBias );
+	uvec2 tile = vt_tile( fract( v2fTexCoord ), level );
+	oRequest = tile.x | (tile.y << 12) | (level << 24);
+}
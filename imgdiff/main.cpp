@@ -0,0 +1,186 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include <vector>
+#include <algorithm>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+/* Image comparison for capture regression tests
+ *
+ * Compares a golden image against a test image (both loaded as 8-bit RGB)
+ * and reports the maximum and mean absolute error, RMSE and PSNR, and how
+ * many pixels differ by more than --threshold in any channel. Optionally
+ * writes a difference image, amplified so that small errors are visible.
+ *
+ * Exit code: 0 if PSNR >= --min-psnr, 1 if it is lower (or the sizes
+ * differ), 2 on usage or I/O errors.
+ */
+
+namespace
+{
+	struct Options_
+	{
+		double minPsnr = 40.0;
+		int threshold = 0;
+		char const* diffPath = nullptr;
+		char const* golden = nullptr;
+		char const* test = nullptr;
+	};
+
+	struct Image_
+	{
+		int width = 0, height = 0;
+		stbi_uc* data = nullptr;
+
+		~Image_() { stbi_image_free( data ); }
+	};
+
+	void print_help_( char const* aProgram )
+	{
+		std::printf( "Usage: %s [options] GOLDEN TEST\n", aProgram );
+		std::printf( "Options:\n" );
+		std::printf( "  --min-psnr=DB       Fail if the PSNR is below this (default: 40)\n" );
+		std::printf( "  --threshold=N       Count pixels that differ by more than N in any channel (default: 0)\n" );
+		std::printf( "  --diff=PATH         Write an amplified difference image (PNG)\n" );
+	}
+
+	char const* match_value_( char const* aArg, char const* aName )
+	{
+		std::size_t const len = std::strlen( aName );
+		if( 0 != std::strncmp( aArg, aName, len ) || '=' != aArg[len] )
+			return nullptr;
+
+		return aArg + len + 1;
+	}
+
+	bool load_( char const* aPath, Image_& aImage )
+	{
+		int channels = 0;
+		aImage.data = stbi_load( aPath, &aImage.width, &aImage.height, &channels, 3 );
+		if( !aImage.data )
+		{
+			std::fprintf( stderr, "imgdiff: unable to load '%s': %s\n", aPath, stbi_failure_reason() );
+			return false;
+		}
+		return true;
+	}
+}
+
+int main( int aArgc, char* aArgv[] )
+{
+	Options_ options;
+	for( int i = 1; i < aArgc; ++i )
+	{
+		char const* arg = aArgv[i];
+
+		if( 0 == std::strcmp( arg, "--help" ) )
+		{
+			print_help_( aArgv[0] );
+			return 0;
+		}
+		else if( char const* value = match_value_( arg, "--min-psnr" ) )
+		{
+			options.minPsnr = std::atof( value );
+		}
+		else if( char const* value = match_value_( arg, "--threshold" ) )
+		{
+			options.threshold = std::atoi( value );
+		}
+		else if( char const* value = match_value_( arg, "--diff" ) )
+		{
+			options.diffPath = value;
+		}
+		else if( '-' == arg[0] && '-' == arg[1] )
+		{
+			std::fprintf( stderr, "imgdiff: unknown option '%s' (try --help)\n", arg );
+			return 2;
+		}
+		else if( !options.golden )
+		{
+			options.golden = arg;
+		}
+		else if( !options.test )
+		{
+			options.test = arg;
+		}
+		else
+		{
+			std::fprintf( stderr, "imgdiff: too many arguments (try --help)\n" );
+			return 2;
+		}
+	}
+
+	if( !options.golden || !options.test )
+	{
+		print_help_( aArgv[0] );
+		return 2;
+	}
+
+	Image_ golden, test;
+	if( !load_( options.golden, golden ) || !load_( options.test, test ) )
+		return 2;
+
+	if( golden.width != test.width || golden.height != test.height )
+	{
+		std::printf( "FAIL: size mismatch (%dx%d vs %dx%d)\n", golden.width, golden.height, test.width, test.height );
+		return 1;
+	}
+
+	auto const pixels = std::size_t(golden.width) * std::size_t(golden.height);
+
+	std::vector<std::uint8_t> diff;
+	if( options.diffPath )
+		diff.resize( pixels * 3 );
+
+	int maxError = 0;
+	std::uint64_t sumAbs = 0, sumSq = 0;
+	std::size_t differing = 0;
+
+	for( std::size_t i = 0; i < pixels; ++i )
+	{
+		int pixelMax = 0;
+		for( std::size_t c = 0; c < 3; ++c )
+		{
+			int const d = std::abs( int(golden.data[3*i+c]) - int(test.data[3*i+c]) );
+			pixelMax = std::max( pixelMax, d );
+			sumAbs += std::uint64_t(d);
+			sumSq += std::uint64_t(d*d);
+
+			if( options.diffPath )
+				diff[3*i+c] = std::uint8_t(std::min( 255, d * 16 ));
+		}
+
+		maxError = std::max( maxError, pixelMax );
+		if( pixelMax > options.threshold )
+			++differing;
+	}
+
+	double const samples = double(pixels) * 3.0;
+	double const mse = samples > 0.0 ? double(sumSq) / samples : 0.0;
+	double const psnr = mse > 0.0 ? 10.0 * std::log10( 255.0 * 255.0 / mse ) : INFINITY;
+
+	if( options.diffPath && !stbi_write_png( options.diffPath, golden.width, golden.height, 3, diff.data(), golden.width * 3 ) )
+	{
+		std::fprintf( stderr, "imgdiff: unable to write '%s'\n", options.diffPath );
+		return 2;
+	}
+
+	bool const pass = psnr >= options.minPsnr;
+	std::printf( "%s: %dx%d, max error %d, mean abs error %.4f, RMSE %.4f, PSNR %.2f dB, %zu pixels (%.3f%%) differ by more than %d\n",
+		pass ? "PASS" : "FAIL",
+		golden.width, golden.height,
+		maxError,
+		samples > 0.0 ? double(sumAbs) / samples : 0.0,
+		std::sqrt( mse ),
+		psnr,
+		differing, pixels ? 100.0 * double(differing) / double(pixels) : 0.0,
+		options.threshold
+	);
+
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,342 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+namespace
+{
+	// Which JobSystem thread (if any) the current thread is.
+	thread_local JobSystem const* tlSystem_ = nullptr;
+	thread_local std::size_t tlIndex_ = 0;
+
+	// Idle workers spin (yielding) for this many attempts before going to
+	// sleep until the next push.
+	constexpr std::size_t kSpinCount_ = 64;
+}
+
+JobSystem::JobSystem( std::size_t aWorkers )
+	: mRunning( true )
+	, mSleeping( 0 )
+	, mPushes( 0 )
+	, mParked( nullptr )
+	, mParkedCount( 0 )
+{
+	if( 0 == aWorkers )
+	{
+		std::size_t const hw = std::thread::hardware_concurrency();
+		aWorkers = hw > 1 ? hw-1 : 1;
+	}
+
+	for( std::size_t i = 0; i < aWorkers+1; ++i )
+	{
+		auto thread = std::make_unique<Thread_>();
+		thread->jobs = std::make_unique<Job_[]>( kJobsPerThread );
+		mThreads.emplace_back( std::move(thread) );
+	}
+
+	assert( !tlSystem_ );
+	tlSystem_ = this;
+	tlIndex_ = 0;
+
+	for( std::size_t i = 0; i < aWorkers; ++i )
+		mWorkers.emplace_back( [this,i] { worker_( i+1 ); } );
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock( mSleepMutex );
+		mRunning.store( false );
+	}
+	mSleepCondition.notify_all();
+
+	for( auto& worker : mWorkers )
+		worker.join();
+
+	if( this == tlSystem_ )
+		tlSystem_ = nullptr;
+}
+
+std::size_t JobSystem::thread_count() const noexcept
+{
+	return mThreads.size();
+}
+
+void JobSystem::run( JobFunction aFunction, void* aData, std::size_t aBegin, std::size_t aEnd, std::size_t aGrain, JobCounter& aCounter, JobCounter const* aDependency )
+{
+	assert( aBegin <= aEnd );
+
+	Thread_& self = current_();
+
+	Job_* job = allocate_( self );
+	job->function = aFunction;
+	job->data = aData;
+	job->begin = aBegin;
+	job->end = aEnd;
+	job->grain = std::max( aGrain, std::size_t(1) );
+	job->counter = &aCounter;
+	job->dependency = aDependency;
+
+	aCounter.mPending.fetch_add( 1, std::memory_order_relaxed );
+
+	if( aDependency && !aDependency->done() )
+		park_( job );
+	else
+		push_( self, job );
+}
+
+void JobSystem::wait( JobCounter const& aCounter )
+{
+	std::size_t const index = current_index_();
+	while( !aCounter.done() )
+	{
+		if( !try_execute_( index ) )
+			std::this_thread::yield();
+	}
+}
+
+JobSystem::Stats JobSystem::stats() const noexcept
+{
+	Stats ret{};
+	for( auto const& thread : mThreads )
+	{
+		ret.executed += thread->executed.load( std::memory_order_relaxed );
+		ret.stolen += thread->stolen.load( std::memory_order_relaxed );
+	}
+	return ret;
+}
+
+JobSystem::Job_* JobSystem::allocate_( Thread_& aThread )
+{
+	while( true )
+	{
+		// Take the next free slot of the ring. Slots can still be in use when
+		// the ring wraps around (queued jobs, or jobs further up this
+		// thread's call stack), so skip those rather than waiting for them.
+		for( std::size_t i = 0; i < kJobsPerThread; ++i )
+		{
+			Job_* job = &aThread.jobs[aThread.nextJob++ % kJobsPerThread];
+			if( !job->active.load( std::memory_order_acquire ) )
+			{
+				job->active.store( true, std::memory_order_relaxed );
+				return job;
+			}
+		}
+
+		// Every slot is in flight. Help out until one frees up.
+		if( !try_execute_( current_index_() ) )
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::push_( Thread_& aThread, Job_* aJob )
+{
+	// Released parked jobs from other threads' rings land here as well, so
+	// the deque can fill up. Help out until the job fits: this thread's own
+	// pops make room.
+	while( !aThread.deque.push( aJob ) )
+	{
+		if( !try_execute_( current_index_() ) )
+			std::this_thread::yield();
+	}
+
+	// Sequentially consistent, pairs with worker_(): either this sees the
+	// sleeper, or the sleeper sees the new push count and stays awake.
+	// Notifying under the mutex means that a worker that has registered
+	// is already waiting.
+	mPushes.fetch_add( 1, std::memory_order_seq_cst );
+	if( mSleeping.load( std::memory_order_seq_cst ) > 0 )
+	{
+		std::lock_guard<std::mutex> lock( mSleepMutex );
+		mSleepCondition.notify_one();
+	}
+}
+
+void JobSystem::park_( Job_* aJob )
+{
+	assert( aJob->dependency );
+
+	{
+		std::lock_guard<std::mutex> lock( mParkMutex );
+		aJob->nextParked = mParked;
+		mParked = aJob;
+		mParkedCount.fetch_add( 1, std::memory_order_seq_cst );
+
+		// The dependency may have finished before the job was on the list,
+		// and release_() may have missed it. (Sequentially consistent: either
+		// the last job of the dependency sees the count, or this sees the
+		// dependency done.)
+		if( 0 != aJob->dependency->mPending.load( std::memory_order_seq_cst ) )
+			return;
+
+		mParked = aJob->nextParked;
+		mParkedCount.fetch_sub( 1, std::memory_order_relaxed );
+	}
+
+	push_( current_(), aJob );
+}
+
+void JobSystem::release_( Thread_& aThread )
+{
+	if( 0 == mParkedCount.load( std::memory_order_seq_cst ) )
+		return;
+
+	// Unlink the jobs whose dependency is done, then push them outside of
+	// the lock (push_() may execute jobs).
+	Job_* released = nullptr;
+	{
+		std::lock_guard<std::mutex> lock( mParkMutex );
+
+		Job_** link = &mParked;
+		while( Job_* job = *link )
+		{
+			if( job->dependency->done() )
+			{
+				*link = job->nextParked;
+				job->nextParked = released;
+				released = job;
+				mParkedCount.fetch_sub( 1, std::memory_order_relaxed );
+			}
+			else
+			{
+				link = &job->nextParked;
+			}
+		}
+	}
+
+	while( released )
+	{
+		Job_* job = released;
+		released = job->nextParked;
+		job->nextParked = nullptr;
+		push_( aThread, job );
+	}
+}
+
+JobSystem::Job_* JobSystem::find_job_( std::size_t aThread )
+{
+	Thread_& self = *mThreads[aThread];
+	if( Job_* job = self.deque.pop() )
+		return job;
+
+	// Try to steal, starting with the next thread over so that not everybody
+	// hammers the same deque.
+	std::size_t const count = mThreads.size();
+	for( std::size_t i = 1; i < count; ++i )
+	{
+		if( Job_* job = mThreads[(aThread+i) % count]->deque.steal() )
+		{
+			self.stolen.fetch_add( 1, std::memory_order_relaxed );
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+bool JobSystem::try_execute_( std::size_t aThread )
+{
+	Job_* job = find_job_( aThread );
+	if( !job )
+		return false;
+
+	// Dependency not yet satisfied (the job was pushed before it became
+	// unmet again, i.e., the counter was reused); park it.
+	if( job->dependency && !job->dependency->done() )
+	{
+		park_( job );
+		return false;
+	}
+
+	execute_( aThread, job );
+	return true;
+}
+
+void JobSystem::execute_( std::size_t aThread, Job_* aJob )
+{
+	Thread_& self = *mThreads[aThread];
+
+	// Split off the upper half until the remaining range is at most one
+	// grain. The split-off jobs are pushed onto this thread's deque, where
+	// idle threads can steal them.
+	while( aJob->end - aJob->begin > aJob->grain )
+	{
+		std::size_t const mid = aJob->begin + (aJob->end - aJob->begin) / 2;
+
+		Job_* half = allocate_( self );
+		half->function = aJob->function;
+		half->data = aJob->data;
+		half->begin = mid;
+		half->end = aJob->end;
+		half->grain = aJob->grain;
+		half->counter = aJob->counter;
+		half->dependency = nullptr; // Already satisfied
+
+		aJob->counter->mPending.fetch_add( 1, std::memory_order_relaxed );
+		push_( self, half );
+
+		aJob->end = mid;
+	}
+
+	aJob->function( aJob->data, aJob->begin, aJob->end );
+
+	JobCounter* counter = aJob->counter;
+	aJob->active.store( false, std::memory_order_release );
+
+	// The counter may be gone as soon as it reaches zero; do not touch it
+	// afterwards. Parked jobs keep their dependency alive, though.
+	bool const last = 1 == counter->mPending.fetch_sub( 1, std::memory_order_seq_cst );
+	self.executed.fetch_add( 1, std::memory_order_relaxed );
+
+	if( last )
+		release_( self );
+}
+
+void JobSystem::worker_( std::size_t aThread )
+{
+	tlSystem_ = this;
+	tlIndex_ = aThread;
+
+	std::size_t idle = 0;
+	while( mRunning.load( std::memory_order_relaxed ) )
+	{
+		// Read before looking for jobs. Any push that the search below
+		// misses changes the count, so the worker does not sleep on it.
+		std::uint64_t const pushes = mPushes.load( std::memory_order_seq_cst );
+
+		if( try_execute_( aThread ) )
+		{
+			idle = 0;
+			continue;
+		}
+
+		if( ++idle < kSpinCount_ )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( mSleepMutex );
+
+		mSleeping.fetch_add( 1, std::memory_order_seq_cst );
+		mSleepCondition.wait( lock, [&] {
+			return !mRunning.load( std::memory_order_relaxed ) || pushes != mPushes.load( std::memory_order_seq_cst );
+		} );
+		mSleeping.fetch_sub( 1, std::memory_order_relaxed );
+		idle = 0;
+	}
+}
+
+JobSystem::Thread_& JobSystem::current_()
+{
+	return *mThreads[current_index_()];
+}
+
+std::size_t JobSystem::current_index_() const
+{
+	// Jobs may only be started/waited for from the owning thread or from a
+	// worker of this JobSystem.
+	assert( this == tlSystem_ );
+	return tlIndex_;
+}
@@ -0,0 +1,178 @@
+#ifndef JOB_SYSTEM_HPP_427F5BFC_9992_4247_92FA_29F2EBE87966
+#define JOB_SYSTEM_HPP_427F5BFC_9992_4247_92FA_29F2EBE87966
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+
+#include "work_deque.hpp"
+
+// Job entry point. Processes the index range [aBegin, aEnd).
+using JobFunction = void (*)( void* aData, std::size_t aBegin, std::size_t aEnd );
+
+/* Completion counter
+ *
+ * Incremented for each job that is started with the counter and decremented
+ * when the job finishes. A counter reaching zero means that all jobs
+ * associated with it are done. Counters are also used as dependencies: a job
+ * that depends on a counter does not start until the counter is zero.
+ *
+ * Counters are plain objects, typically on the stack of the thread that
+ * waits for them. They must outlive the jobs that reference them.
+ */
+class JobCounter final
+{
+	public:
+		JobCounter() = default;
+
+		JobCounter( JobCounter const& ) = delete;
+		JobCounter& operator= (JobCounter const&) = delete;
+
+	public:
+		bool done() const noexcept
+		{
+			return 0 == mPending.load( std::memory_order_acquire );
+		}
+
+	private:
+		friend class JobSystem;
+		std::atomic<std::size_t> mPending{ 0 };
+};
+
+/* Work-stealing job system
+ *
+ * One worker thread per additional core; the thread that creates the
+ * JobSystem participates as well (thread index 0) whenever it waits for
+ * jobs. Each thread has
+ *  - a Chase-Lev deque (see work_deque.hpp) that it pushes new jobs onto,
+ *    and that idle threads steal from, and
+ *  - a preallocated ring of Job objects.
+ * Starting a job therefore never allocates. If all Job slots of a thread are
+ * still in flight, the thread helps executing jobs until one frees up.
+ *
+ * Jobs whose dependency is not done yet are parked on a wait list instead
+ * of a deque, and pushed again by the thread that finishes the last job of
+ * the dependency's counter, so waiting threads do not spin on them.
+ *
+ * parallel_for() splits ranges lazily: a job covering more than aGrain
+ * elements pushes its upper half as a new job and continues with the lower
+ * half. Idle threads thus steal large chunks first.
+ *
+ * Jobs may only be started from the thread that created the JobSystem or
+ * from within jobs.
+ */
+class JobSystem final
+{
+	public:
+		static constexpr std::size_t kJobsPerThread = 4096;
+
+		struct Stats
+		{
+			std::size_t executed;
+			std::size_t stolen;
+		};
+
+	public:
+		// aWorkers = 0 picks one worker per hardware thread, minus one.
+		explicit JobSystem( std::size_t aWorkers = 0 );
+		~JobSystem();
+
+		JobSystem( JobSystem const& ) = delete;
+		JobSystem& operator= (JobSystem const&) = delete;
+
+	public:
+		// Number of threads executing jobs, including the owning thread.
+		std::size_t thread_count() const noexcept;
+
+		// Start a job that processes [aBegin, aEnd) in pieces of at most
+		// aGrain elements. The job does not start before aDependency (if
+		// given) is done. aCounter is done once all pieces have finished.
+		void run( JobFunction, void* aData, std::size_t aBegin, std::size_t aEnd, std::size_t aGrain, JobCounter& aCounter, JobCounter const* aDependency = nullptr );
+
+		// Execute jobs on this thread until aCounter is done.
+		void wait( JobCounter const& aCounter );
+
+		// Call aFunc( begin, end ) for subranges of [0, aCount), in parallel.
+		// The asynchronous version returns immediately; aFunc must stay alive
+		// until aCounter is done.
+		template< typename tFunc >
+		void parallel_for( std::size_t aCount, std::size_t aGrain, tFunc& aFunc, JobCounter& aCounter, JobCounter const* aDependency = nullptr );
+
+		template< typename tFunc >
+		void parallel_for( std::size_t aCount, std::size_t aGrain, tFunc&& aFunc );
+
+		// Totals since construction (approximate while jobs are running).
+		Stats stats() const noexcept;
+
+	private:
+		struct Job_
+		{
+			JobFunction function;
+			void* data;
+			std::size_t begin, end;
+			std::size_t grain;
+
+			JobCounter* counter;
+			JobCounter const* dependency;
+			Job_* nextParked = nullptr; // wait list (mParkMutex)
+
+			std::atomic<bool> active{ false };
+		};
+
+		struct alignas(64) Thread_
+		{
+			// Leave room for parked jobs from other threads, which are
+			// pushed here when released (see push_()).
+			WorkDeque<Job_, 2*kJobsPerThread> deque;
+
+			std::unique_ptr<Job_[]> jobs;
+			std::size_t nextJob = 0;
+
+			std::atomic<std::size_t> executed{ 0 };
+			std::atomic<std::size_t> stolen{ 0 };
+		};
+
+		Job_* allocate_( Thread_& );
+		void push_( Thread_&, Job_* );
+
+		void park_( Job_* );
+		void release_( Thread_& );
+
+		Job_* find_job_( std::size_t aThread );
+		bool try_execute_( std::size_t aThread );
+		void execute_( std::size_t aThread, Job_* );
+
+		void worker_( std::size_t aThread );
+
+		Thread_& current_();
+		std::size_t current_index_() const;
+
+		template< typename tFunc >
+		static void invoke_( void*, std::size_t, std::size_t );
+
+	private:
+		std::vector<std::unique_ptr<Thread_>> mThreads; // [0] is the owner
+		std::vector<std::thread> mWorkers;
+
+		std::atomic<bool> mRunning;
+
+		// Idle workers sleep here until mPushes changes (see push_() and
+		// worker_()). mRunning is only cleared under the mutex.
+		std::mutex mSleepMutex;
+		std::condition_variable mSleepCondition;
+		std::atomic<std::size_t> mSleeping;
+		std::atomic<std::uint64_t> mPushes;
+
+		// Jobs waiting for their dependency (linked by Job_::nextParked)
+		std::mutex mParkMutex;
+		Job_* mParked;
+		std::atomic<std::size_t> mParkedCount;
+};
+
+#include "job_system.inl"
+#endif // JOB_SYSTEM_HPP_427F5BFC_9992_4247_92FA_29F2EBE87966
@@ -0,0 +1,22 @@
+template< typename tFunc > inline
+void JobSystem::parallel_for( std::size_t aCount, std::size_t aGrain, tFunc& aFunc, JobCounter& aCounter, JobCounter const* aDependency )
+{
+	if( 0 == aCount )
+		return;
+
+	run( &JobSystem::invoke_<tFunc>, const_cast<void*>(static_cast<void const*>(&aFunc)), 0, aCount, aGrain, aCounter, aDependency );
+}
+
+template< typename tFunc > inline
+void JobSystem::parallel_for( std::size_t aCount, std::size_t aGrain, tFunc&& aFunc )
+{
+	JobCounter counter;
+	parallel_for( aCount, aGrain, aFunc, counter );
+	wait( counter );
+}
+
+template< typename tFunc > inline
+void JobSystem::invoke_( void* aData, std::size_t aBegin, std::size_t aEnd )
+{
+	(*static_cast<tFunc*>(aData))( aBegin, aEnd );
+}
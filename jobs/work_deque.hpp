@@ -0,0 +1,104 @@
+#ifndef WORK_DEQUE_HPP_BF201331_D665_41D1_89D8_CD83C9204C97
+#define WORK_DEQUE_HPP_BF201331_D665_41D1_89D8_CD83C9204C97
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/* Fixed-capacity Chase-Lev work-stealing deque
+ *
+ * The owning thread pushes and pops at the bottom (LIFO, good locality);
+ * other threads steal from the top (FIFO, i.e., the oldest and typically
+ * largest pieces of work). Follows "Correct and Efficient Work-Stealing for
+ * Weak Memory Models" (Le et al., PPoPP 2013), without the resizing: push()
+ * fails when the deque is full.
+ *
+ * tCapacity must be a power of two.
+ */
+template< typename tItem, std::size_t tCapacity >
+class WorkDeque final
+{
+	static_assert( tCapacity > 0 && 0 == (tCapacity & (tCapacity-1)), "WorkDeque: capacity must be a power of two" );
+
+	public:
+		WorkDeque() = default;
+
+		WorkDeque( WorkDeque const& ) = delete;
+		WorkDeque& operator= (WorkDeque const&) = delete;
+
+	public:
+		// Owner only
+		bool push( tItem* aItem ) noexcept
+		{
+			std::int64_t const b = mBottom.load( std::memory_order_relaxed );
+			std::int64_t const t = mTop.load( std::memory_order_acquire );
+			if( b - t >= std::int64_t(tCapacity) )
+				return false;
+
+			mItems[b & kMask].store( aItem, std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_release );
+			mBottom.store( b+1, std::memory_order_relaxed );
+			return true;
+		}
+
+		// Owner only
+		tItem* pop() noexcept
+		{
+			std::int64_t const b = mBottom.load( std::memory_order_relaxed ) - 1;
+			mBottom.store( b, std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			std::int64_t t = mTop.load( std::memory_order_relaxed );
+
+			if( t > b )
+			{
+				// Empty
+				mBottom.store( b+1, std::memory_order_relaxed );
+				return nullptr;
+			}
+
+			tItem* item = mItems[b & kMask].load( std::memory_order_relaxed );
+			if( t == b )
+			{
+				// Last item; race against thieves for it.
+				if( !mTop.compare_exchange_strong( t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+					item = nullptr;
+
+				mBottom.store( b+1, std::memory_order_relaxed );
+			}
+
+			return item;
+		}
+
+		// Any thread
+		tItem* steal() noexcept
+		{
+			std::int64_t t = mTop.load( std::memory_order_acquire );
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			std::int64_t const b = mBottom.load( std::memory_order_acquire );
+
+			if( t >= b )
+				return nullptr;
+
+			tItem* item = mItems[t & kMask].load( std::memory_order_relaxed );
+			if( !mTop.compare_exchange_strong( t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+				return nullptr; // Lost the race
+
+			return item;
+		}
+
+		// Approximate
+		bool empty() const noexcept
+		{
+			return mBottom.load( std::memory_order_relaxed ) <= mTop.load( std::memory_order_relaxed );
+		}
+
+	private:
+		static constexpr std::int64_t kMask = std::int64_t(tCapacity) - 1;
+
+		alignas(64) std::atomic<std::int64_t> mTop{ 0 };
+		alignas(64) std::atomic<std::int64_t> mBottom{ 0 };
+
+		std::atomic<tItem*> mItems[tCapacity];
+};
+
+#endif // WORK_DEQUE_HPP_BF201331_D665_41D1_89D8_CD83C9204C97
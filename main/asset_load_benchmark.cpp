@@ -0,0 +1,178 @@
+#include "asset_load_benchmark.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+#include <cstdio>
+#include <cstdint>
+
+#if !defined(_WIN32)
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#include "../support/error.hpp"
+#include "../support/file_mapping.hpp"
+
+namespace
+{
+	using Clock_ = std::chrono::steady_clock;
+
+	constexpr std::size_t kColdRuns_ = 3;
+	constexpr std::size_t kWarmRuns_ = 5;
+
+	// Page size for touching mapped files. 4 KiB is the smallest in use;
+	// touching more often than needed is harmless.
+	constexpr std::size_t kPage_ = 4096;
+
+	struct Times_
+	{
+		double readMs, mapMs;
+	};
+
+	// Drop the file's pages from the page cache. Returns false if that is
+	// not supported.
+	bool evict_( char const* aPath );
+
+	// Returns a checksum, so that the reads are not optimized away.
+	std::uint64_t load_read_( char const* aPath );
+	std::uint64_t load_map_( char const* aPath );
+
+	template< typename tFunc >
+	double time_ms_( tFunc&& aFunc, std::uint64_t& aChecksum )
+	{
+		auto const start = Clock_::now();
+		aChecksum += aFunc();
+		auto const end = Clock_::now();
+		return std::chrono::duration<double, std::milli>( end - start ).count();
+	}
+}
+
+void run_asset_load_benchmark( char const* aDirectory )
+{
+	std::vector<std::filesystem::path> files;
+	for( auto const& entry : std::filesystem::recursive_directory_iterator( aDirectory ) )
+	{
+		if( entry.is_regular_file() )
+			files.emplace_back( entry.path() );
+	}
+
+	if( files.empty() )
+		throw Error( "--load-benchmark: no files in '%s'", aDirectory );
+
+	std::sort( files.begin(), files.end() );
+
+	bool const canEvict = evict_( files.front().string().c_str() );
+	if( !canEvict )
+		std::printf( "Note: cannot evict files from the page cache here; cold times are not available\n" );
+
+	std::printf( "Asset loading, '%s' (%zu files; cold: best of %zu, warm: best of %zu; ms):\n", aDirectory, files.size(), kColdRuns_, kWarmRuns_ );
+	std::printf( "  %-36s %10s %9s %9s %9s %9s\n", "file", "bytes", "cold read", "cold map", "warm read", "warm map" );
+
+	std::uint64_t checksum = 0, totalBytes = 0;
+	Times_ cold{ 0.0, 0.0 }, warm{ 0.0, 0.0 };
+
+	for( auto const& file : files )
+	{
+		auto const path = file.string();
+		auto const bytes = std::filesystem::file_size( file );
+		totalBytes += bytes;
+
+		auto const best = [&] (std::size_t aRuns, bool aEvict, auto&& aLoad) {
+			double ret = 1e30;
+			for( std::size_t i = 0; i < aRuns; ++i )
+			{
+				if( aEvict )
+					evict_( path.c_str() );
+				ret = std::min( ret, time_ms_( [&] { return aLoad( path.c_str() ); }, checksum ) );
+			}
+			return ret;
+		};
+
+		Times_ fileCold{ 0.0, 0.0 };
+		if( canEvict )
+		{
+			fileCold.readMs = best( kColdRuns_, true, load_read_ );
+			fileCold.mapMs = best( kColdRuns_, true, load_map_ );
+		}
+
+		// The cold runs leave the file cached.
+		Times_ const fileWarm{
+			best( kWarmRuns_, false, load_read_ ),
+			best( kWarmRuns_, false, load_map_ )
+		};
+
+		auto const name = std::filesystem::relative( file, aDirectory ).generic_string();
+		if( canEvict )
+			std::printf( "  %-36s %10llu %9.3f %9.3f %9.3f %9.3f\n", name.c_str(), (unsigned long long)bytes, fileCold.readMs, fileCold.mapMs, fileWarm.readMs, fileWarm.mapMs );
+		else
+			std::printf( "  %-36s %10llu %9s %9s %9.3f %9.3f\n", name.c_str(), (unsigned long long)bytes, "n/a", "n/a", fileWarm.readMs, fileWarm.mapMs );
+
+		cold.readMs += fileCold.readMs;
+		cold.mapMs += fileCold.mapMs;
+		warm.readMs += fileWarm.readMs;
+		warm.mapMs += fileWarm.mapMs;
+	}
+
+	if( canEvict )
+		std::printf( "  %-36s %10llu %9.3f %9.3f %9.3f %9.3f\n", "total", (unsigned long long)totalBytes, cold.readMs, cold.mapMs, warm.readMs, warm.mapMs );
+	else
+		std::printf( "  %-36s %10llu %9s %9s %9.3f %9.3f\n", "total", (unsigned long long)totalBytes, "n/a", "n/a", warm.readMs, warm.mapMs );
+
+	std::printf( "  (checksum %llx)\n", (unsigned long long)checksum );
+}
+
+namespace
+{
+	bool evict_( char const* aPath )
+	{
+#		if defined(_WIN32)
+		(void)aPath;
+		return false;
+#		else
+		int const fd = open( aPath, O_RDONLY );
+		if( -1 == fd )
+			return false;
+
+		bool const ok = 0 == posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+		close( fd );
+		return ok;
+#		endif
+	}
+
+	std::uint64_t load_read_( char const* aPath )
+	{
+		std::FILE* fin = std::fopen( aPath, "rb" );
+		if( !fin )
+			throw Error( "--load-benchmark: unable to open '%s'", aPath );
+
+		std::fseek( fin, 0, SEEK_END );
+		auto const length = std::size_t(std::ftell( fin ));
+		std::fseek( fin, 0, SEEK_SET );
+
+		std::vector<std::uint8_t> data( length );
+		auto const read = std::fread( data.data(), 1, length, fin );
+		std::fclose( fin );
+
+		if( read != length )
+			throw Error( "--load-benchmark: error while reading '%s'", aPath );
+
+		std::uint64_t sum = 0;
+		for( std::size_t i = 0; i < length; i += kPage_ )
+			sum += data[i];
+		return sum;
+	}
+
+	std::uint64_t load_map_( char const* aPath )
+	{
+		FileMapping const file( aPath );
+
+		std::uint64_t sum = 0;
+		for( std::size_t i = 0; i < file.size(); i += kPage_ )
+			sum += file.data()[i];
+		return sum;
+	}
+}
@@ -0,0 +1,18 @@
+#ifndef ASSET_LOAD_BENCHMARK_HPP_DB9A8F5B_B9C2_408A_A8FB_5737B1E6B12F
+#define ASSET_LOAD_BENCHMARK_HPP_DB9A8F5B_B9C2_408A_A8FB_5737B1E6B12F
+
+/* Asset loading: read vs. map (see --load-benchmark)
+ *
+ * For every file below aDirectory, compares
+ *  - read: fopen()/fread() into a freshly allocated buffer (what the loaders
+ *    did before FileMapping), and
+ *  - map: FileMapping, touching every page (as a parser or glTexImage*()
+ *    reading the mapped bytes would),
+ * with a cold page cache (the file's pages are evicted first with
+ * posix_fadvise(POSIX_FADV_DONTNEED)) and a warm one. Results go to stdout.
+ *
+ * Eviction is not available on Windows; only warm times are measured there.
+ */
+void run_asset_load_benchmark( char const* aDirectory );
+
+#endif // ASSET_LOAD_BENCHMARK_HPP_DB9A8F5B_B9C2_408A_A8FB_5737B1E6B12F
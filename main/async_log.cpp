@@ -0,0 +1,95 @@
+#include "async_log.hpp"
+
+#include <cstdio>
+#include <cstdarg>
+
+namespace
+{
+	// Sleep between polls of an empty queue. Diagnostics are not latency
+	// critical, so there is no need to wake the thread for every message.
+	constexpr auto kIdleSleep = std::chrono::milliseconds( 5 );
+}
+
+AsyncLog::~AsyncLog()
+{
+	stop();
+}
+
+void AsyncLog::start()
+{
+	if( mRunning.load() )
+		return;
+
+	mStart = Clock::now();
+	mRunning.store( true );
+	mThread = std::thread( [this] { run_(); } );
+}
+
+void AsyncLog::stop()
+{
+	if( !mRunning.exchange( false ) )
+		return;
+
+	if( mThread.joinable() )
+		mThread.join();
+
+	if( auto const dropped = mDropped.load() )
+		std::fprintf( stderr, "AsyncLog: %zu messages dropped\n", dropped );
+}
+
+bool AsyncLog::running() const noexcept
+{
+	return mRunning.load( std::memory_order_relaxed );
+}
+
+void AsyncLog::log( char const* aFmt, ... ) noexcept
+{
+	if( !running() )
+		return;
+
+	Message_ msg;
+	msg.time = Clock::now();
+
+	va_list args;
+	va_start( args, aFmt );
+	std::vsnprintf( msg.text, sizeof(msg.text), aFmt, args );
+	va_end( args );
+
+	if( !mQueue.try_push( msg ) )
+		mDropped.fetch_add( 1, std::memory_order_relaxed );
+}
+
+std::size_t AsyncLog::dropped() const noexcept
+{
+	return mDropped.load( std::memory_order_relaxed );
+}
+
+void AsyncLog::run_()
+{
+	while( mRunning.load( std::memory_order_relaxed ) )
+	{
+		if( 0 == write_pending_() )
+			std::this_thread::sleep_for( kIdleSleep );
+		else
+			std::fflush( stdout );
+	}
+
+	// Drain whatever was queued before stop()
+	write_pending_();
+	std::fflush( stdout );
+}
+
+std::size_t AsyncLog::write_pending_()
+{
+	std::size_t count = 0;
+
+	Message_ msg;
+	while( mQueue.try_pop( msg ) )
+	{
+		float const t = std::chrono::duration_cast<Secondsf>(msg.time - mStart).count();
+		std::printf( "[%9.4f] %s\n", t, msg.text );
+		++count;
+	}
+
+	return count;
+}
@@ -0,0 +1,67 @@
+#ifndef ASYNC_LOG_HPP_99A3D970_068C_4F8B_944A_1F085BBF8AF9
+#define ASYNC_LOG_HPP_99A3D970_068C_4F8B_944A_1F085BBF8AF9
+
+#include <atomic>
+#include <thread>
+#include <cstddef>
+
+#include "defaults.hpp"
+#include "spsc_ring.hpp"
+
+/* Asynchronous diagnostics logger
+ *
+ * log() formats the message into a fixed-size slot and pushes it into a
+ * lock-free ring; a background thread writes queued messages to stdout. The
+ * calling thread therefore never blocks on console I/O. Messages are dropped
+ * (and counted) if the ring is full.
+ *
+ * log() must only be called from a single thread (the main thread). When the
+ * logger is not running, log() is a no-op.
+ */
+class AsyncLog final
+{
+	public:
+		static constexpr std::size_t kCapacity = 256;
+		static constexpr std::size_t kMessageLength = 120;
+
+	public:
+		AsyncLog() = default;
+		~AsyncLog();
+
+		AsyncLog( AsyncLog const& ) = delete;
+		AsyncLog& operator= (AsyncLog const&) = delete;
+
+	public:
+		void start();
+		void stop(); // Flushes remaining messages
+
+		bool running() const noexcept;
+
+#		if defined(__GNUC__)
+		__attribute__((format(printf,2,3)))
+#		endif
+		void log( char const* aFmt, ... ) noexcept;
+
+		std::size_t dropped() const noexcept;
+
+	private:
+		struct Message_
+		{
+			Clock::time_point time;
+			char text[kMessageLength];
+		};
+
+		void run_();
+		std::size_t write_pending_();
+
+	private:
+		SpscRing<Message_, kCapacity> mQueue;
+
+		std::thread mThread;
+		std::atomic<bool> mRunning{ false };
+		std::atomic<std::size_t> mDropped{ 0 };
+
+		Clock::time_point mStart;
+};
+
+#endif // ASYNC_LOG_HPP_99A3D970_068C_4F8B_944A_1F085BBF8AF9
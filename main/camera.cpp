@@ -0,0 +1,111 @@
+#include "camera.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+
+namespace
+{
+	constexpr float kMaxPitch_ = 1.55f; // just under 90 degrees
+
+	constexpr float kTwoPi_ = 6.2831853f;
+
+	constexpr float kOrbitPeriod_ = 40.f; // seconds per lap
+	constexpr float kOrbitRadius_ = 45.f;
+	constexpr float kOrbitHeight_ = 12.f;
+}
+
+Mat44f camera_world_to_view( Camera const& aCamera ) noexcept
+{
+	return make_rotation_x( aCamera.pitch )
+		* make_rotation_y( aCamera.yaw )
+		* make_translation( -aCamera.position );
+}
+
+Vec3f camera_forward( Camera const& aCamera ) noexcept
+{
+	float const cp = std::cos( aCamera.pitch ), sp = std::sin( aCamera.pitch );
+	float const cy = std::cos( aCamera.yaw ), sy = std::sin( aCamera.yaw );
+	return Vec3f{ sy*cp, -sp, -cy*cp };
+}
+
+Vec3f camera_right( Camera const& aCamera ) noexcept
+{
+	return Vec3f{ std::cos( aCamera.yaw ), 0.f, std::sin( aCamera.yaw ) };
+}
+
+Camera camera_orbit( float aTime ) noexcept
+{
+	float const angle = kTwoPi_ * aTime / kOrbitPeriod_;
+	float const height = kOrbitHeight_ + 6.f * std::sin( 3.f * angle );
+
+	// Forward is (sin(yaw), ., -cos(yaw)); looking from (r sin(a), ., r cos(a))
+	// towards the origin gives yaw = -a.
+	Camera ret;
+	ret.position = Vec3f{ kOrbitRadius_ * std::sin( angle ), height, kOrbitRadius_ * std::cos( angle ) };
+	ret.yaw = -angle;
+	ret.pitch = std::atan2( height, kOrbitRadius_ );
+	return ret;
+}
+
+Camera interpolate( Camera const& aPrev, Camera const& aCurr, float aAlpha ) noexcept
+{
+	Camera ret;
+	ret.position = aPrev.position + (aCurr.position - aPrev.position) * aAlpha;
+	ret.yaw = aPrev.yaw + (aCurr.yaw - aPrev.yaw) * aAlpha;
+	ret.pitch = aPrev.pitch + (aCurr.pitch - aPrev.pitch) * aAlpha;
+	return ret;
+}
+
+void CameraController::handle_event( Camera& aCamera, InputEvent const& aEvent ) noexcept
+{
+	if( InputEventType::cursor != aEvent.type )
+		return;
+
+	if( !mouseEnabled )
+		return;
+
+	if( !mHaveLast )
+	{
+		mLastX = aEvent.x;
+		mLastY = aEvent.y;
+		mHaveLast = true;
+		return;
+	}
+
+	float const dx = float(aEvent.x - mLastX);
+	float const dy = float(aEvent.y - mLastY);
+	mLastX = aEvent.x;
+	mLastY = aEvent.y;
+
+	aCamera.yaw += dx * sensitivity;
+	aCamera.pitch = std::clamp( aCamera.pitch + dy * sensitivity, -kMaxPitch_, kMaxPitch_ );
+}
+
+void CameraController::update( Camera& aCamera, KeySet const& aKeys, float aDt ) const noexcept
+{
+	float modifier = 1.f;
+	if( aKeys.test( GLFW_KEY_LEFT_SHIFT ) || aKeys.test( GLFW_KEY_RIGHT_SHIFT ) )
+		modifier = 2.f;
+	if( aKeys.test( GLFW_KEY_LEFT_CONTROL ) || aKeys.test( GLFW_KEY_RIGHT_CONTROL ) )
+		modifier = 0.5f;
+
+	Vec3f const forward = camera_forward( aCamera );
+	Vec3f const right = camera_right( aCamera );
+	Vec3f const up{ 0.f, 1.f, 0.f };
+
+	Vec3f move{ 0.f, 0.f, 0.f };
+	if( aKeys.test( GLFW_KEY_W ) ) move += forward;
+	if( aKeys.test( GLFW_KEY_S ) ) move -= forward;
+	if( aKeys.test( GLFW_KEY_D ) ) move += right;
+	if( aKeys.test( GLFW_KEY_A ) ) move -= right;
+	if( aKeys.test( GLFW_KEY_E ) ) move += up;
+	if( aKeys.test( GLFW_KEY_Q ) ) move -= up;
+
+	aCamera.position += move * (speed * modifier * aDt);
+}
+
+void CameraController::reset_mouse() noexcept
+{
+	mHaveLast = false;
+}
@@ -0,0 +1,59 @@
+#ifndef CAMERA_HPP_C8E03FD6_7AB8_4AB3_B087_8B6DF2DBBCE5
+#define CAMERA_HPP_C8E03FD6_7AB8_4AB3_B087_8B6DF2DBBCE5
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "input.hpp"
+
+// First-person camera. The camera looks down -Z when yaw and pitch are
+// zero. Positive yaw turns right, positive pitch looks down.
+struct Camera
+{
+	Vec3f position{ 0.f, 5.f, 10.f };
+	float yaw = 0.f;
+	float pitch = 0.3f;
+};
+
+Mat44f camera_world_to_view( Camera const& ) noexcept;
+
+Vec3f camera_forward( Camera const& ) noexcept;
+Vec3f camera_right( Camera const& ) noexcept;
+
+// Scripted camera for benchmarks: circles the scene once every 40 seconds,
+// looking at the centre, while slowly rising and falling. Depends only on
+// aTime, so runs are reproducible.
+Camera camera_orbit( float aTime ) noexcept;
+
+// Blend between two simulation states; aAlpha = 0 returns aPrev, 1 aCurr.
+Camera interpolate( Camera const& aPrev, Camera const& aCurr, float aAlpha ) noexcept;
+
+/* Fly-through controls
+ *
+ * W/S: forward/backward, A/D: left/right, E/Q: up/down. Holding shift
+ * doubles the speed, control halves it. When mouse control is enabled, the
+ * mouse turns the camera.
+ *
+ * handle_event() is called for each queued input event, update() once per
+ * simulation step with the key snapshot from the InputQueue.
+ */
+struct CameraController
+{
+	float speed = 10.f;         // units per second
+	float sensitivity = 0.002f; // radians per pixel
+
+	bool mouseEnabled = true;
+
+	void handle_event( Camera&, InputEvent const& ) noexcept;
+	void update( Camera&, KeySet const&, float aDt ) const noexcept;
+
+	// Call when mouse control is toggled, so that the jump in cursor
+	// position is not applied as a rotation.
+	void reset_mouse() noexcept;
+
+	private:
+		bool mHaveLast = false;
+		double mLastX = 0.0, mLastY = 0.0;
+};
+
+#endif // CAMERA_HPP_C8E03FD6_7AB8_4AB3_B087_8B6DF2DBBCE5
@@ -0,0 +1,172 @@
+#include "camera_path.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kPathMagic = 0x48545043; // "CPTH"
+	constexpr std::uint32_t kPathVersion = 1;
+
+	struct PathHeader_
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		float step;
+		std::uint32_t poseCount;
+		std::uint32_t eventCount;
+	};
+
+	struct PathPose_
+	{
+		float x, y, z;
+		float yaw, pitch;
+	};
+
+	struct PathEvent_
+	{
+		std::uint32_t step;
+		std::uint32_t type;
+		std::int32_t key, action, mods;
+		float x, y;
+	};
+}
+
+CameraPath::CameraPath( float aStep )
+	: mStep( aStep )
+{
+	if( !(aStep > 0.f) )
+		throw Error( "CameraPath: step must be positive (got %f)", double(aStep) );
+}
+
+void CameraPath::add_pose( Camera const& aCamera )
+{
+	mPoses.emplace_back( aCamera );
+}
+
+void CameraPath::add_event( InputEvent const& aEvent )
+{
+	mEvents.emplace_back( CameraPathEvent{
+		std::uint32_t(mPoses.size()),
+		aEvent.type,
+		aEvent.key, aEvent.action, aEvent.mods,
+		float(aEvent.x), float(aEvent.y)
+	} );
+}
+
+float CameraPath::step() const noexcept
+{
+	return mStep;
+}
+
+float CameraPath::duration() const noexcept
+{
+	return mPoses.empty() ? 0.f : float(mPoses.size()-1) * mStep;
+}
+
+std::size_t CameraPath::pose_count() const noexcept
+{
+	return mPoses.size();
+}
+
+std::vector<CameraPathEvent> const& CameraPath::events() const noexcept
+{
+	return mEvents;
+}
+
+Camera CameraPath::sample( float aTime ) const noexcept
+{
+	float const pos = std::clamp( aTime / mStep, 0.f, float(mPoses.size()-1) );
+	auto const index = std::min( std::size_t(pos), mPoses.size()-1 );
+	auto const next = std::min( index+1, mPoses.size()-1 );
+
+	return interpolate( mPoses[index], mPoses[next], pos - std::floor( pos ) );
+}
+
+void save_camera_path( char const* aPath, CameraPath const& aCameraPath )
+{
+	PathHeader_ header{};
+	header.magic = kPathMagic;
+	header.version = kPathVersion;
+	header.step = aCameraPath.mStep;
+	header.poseCount = std::uint32_t(aCameraPath.mPoses.size());
+	header.eventCount = std::uint32_t(aCameraPath.mEvents.size());
+
+	std::vector<PathPose_> poses;
+	poses.reserve( aCameraPath.mPoses.size() );
+	for( auto const& pose : aCameraPath.mPoses )
+		poses.emplace_back( PathPose_{ pose.position.x, pose.position.y, pose.position.z, pose.yaw, pose.pitch } );
+
+	std::vector<PathEvent_> events;
+	events.reserve( aCameraPath.mEvents.size() );
+	for( auto const& event : aCameraPath.mEvents )
+		events.emplace_back( PathEvent_{ event.step, std::uint32_t(event.type), event.key, event.action, event.mods, event.x, event.y } );
+
+	std::FILE* fof = std::fopen( aPath, "wb" );
+	if( !fof )
+		throw Error( "save_camera_path(): unable to open '%s' for writing", aPath );
+
+	bool ok = 1 == std::fwrite( &header, sizeof(header), 1, fof );
+	ok = ok && poses.size() == std::fwrite( poses.data(), sizeof(PathPose_), poses.size(), fof );
+	ok = ok && events.size() == std::fwrite( events.data(), sizeof(PathEvent_), events.size(), fof );
+	ok = (0 == std::fclose( fof )) && ok;
+
+	if( !ok )
+	{
+		std::remove( aPath );
+		throw Error( "save_camera_path(): error while writing '%s'", aPath );
+	}
+}
+
+CameraPath load_camera_path( char const* aPath )
+{
+	std::FILE* fin = std::fopen( aPath, "rb" );
+	if( !fin )
+		throw Error( "load_camera_path(): unable to open '%s'", aPath );
+
+	PathHeader_ header{};
+	std::vector<PathPose_> poses;
+	std::vector<PathEvent_> events;
+
+	bool ok = 1 == std::fread( &header, sizeof(header), 1, fin )
+		&& kPathMagic == header.magic
+		&& kPathVersion == header.version
+		&& header.step > 0.f
+		&& header.poseCount > 0
+	;
+
+	if( ok )
+	{
+		poses.resize( header.poseCount );
+		events.resize( header.eventCount );
+
+		ok = poses.size() == std::fread( poses.data(), sizeof(PathPose_), poses.size(), fin );
+		ok = ok && events.size() == std::fread( events.data(), sizeof(PathEvent_), events.size(), fin );
+	}
+
+	std::fclose( fin );
+
+	if( !ok )
+		throw Error( "'%s' is not a camera path (wrong version, empty or truncated)", aPath );
+
+	CameraPath ret( header.step );
+	ret.mPoses.reserve( poses.size() );
+	for( auto const& pose : poses )
+	{
+		Camera camera;
+		camera.position = Vec3f{ pose.x, pose.y, pose.z };
+		camera.yaw = pose.yaw;
+		camera.pitch = pose.pitch;
+		ret.mPoses.emplace_back( camera );
+	}
+
+	ret.mEvents.reserve( events.size() );
+	for( auto const& event : events )
+		ret.mEvents.emplace_back( CameraPathEvent{ event.step, InputEventType(event.type), event.key, event.action, event.mods, event.x, event.y } );
+
+	return ret;
+}
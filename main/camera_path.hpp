@@ -0,0 +1,65 @@
+#ifndef CAMERA_PATH_HPP_888DAD83_9CF3_4E14_A5FA_77F3D0579CA9
+#define CAMERA_PATH_HPP_888DAD83_9CF3_4E14_A5FA_77F3D0579CA9
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "input.hpp"
+#include "camera.hpp"
+
+// Input event recorded with a camera path. `step` is the number of poses
+// recorded before the event, i.e., the event happened during step `step`.
+struct CameraPathEvent
+{
+	std::uint32_t step;
+	InputEventType type;
+	std::int32_t key, action, mods;
+	float x, y;
+};
+
+/* Recorded camera path
+ *
+ * One camera pose per simulation step (at a fixed step length), plus the
+ * input events that produced them. Replaying samples the poses by time, so
+ * a path can be replayed at a different simulation rate than it was
+ * recorded at. The events are informational (the poses already include
+ * their effect).
+ *
+ * File format (native byte order, as the texture cache): a header with
+ * magic, version, step length and counts, followed by the poses (five
+ * floats each: position, yaw, pitch) and the events.
+ */
+class CameraPath final
+{
+	public:
+		explicit CameraPath( float aStep );
+
+	public:
+		void add_pose( Camera const& );
+		void add_event( InputEvent const& );
+
+		float step() const noexcept;
+		float duration() const noexcept;
+
+		std::size_t pose_count() const noexcept;
+		std::vector<CameraPathEvent> const& events() const noexcept;
+
+		// Pose at aTime seconds from the start, interpolated between steps
+		// and clamped to the path. Requires at least one pose.
+		Camera sample( float aTime ) const noexcept;
+
+	private:
+		friend void save_camera_path( char const*, CameraPath const& );
+		friend CameraPath load_camera_path( char const* );
+
+		float mStep;
+		std::vector<Camera> mPoses;
+		std::vector<CameraPathEvent> mEvents;
+};
+
+// Both throw Error on I/O errors or invalid files.
+void save_camera_path( char const* aPath, CameraPath const& );
+CameraPath load_camera_path( char const* aPath );
+
+#endif // CAMERA_PATH_HPP_888DAD83_9CF3_4E14_A5FA_77F3D0579CA9
@@ -0,0 +1,174 @@
+#include "clustered_lights.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include "../support/checkpoint.hpp"
+#include "../support/gpu_profiler.hpp"
+
+#include "cpu_profiler.hpp"
+
+namespace
+{
+	// Must match the local size in assets/cluster_lights.comp
+	constexpr std::size_t kWorkGroupSize_ = 64;
+
+	// Uniform locations in assets/cluster_lights.comp
+	constexpr GLint kWorldToCameraLocation_ = 0;
+	constexpr GLint kTanHalfFovLocation_ = 1;
+	constexpr GLint kLightCountLocation_ = 2;
+	constexpr GLint kDepthRangeLocation_ = 3;
+
+	// Uniform locations in the mesh program (default.frag)
+	constexpr GLint kClusterParamsLocation_ = 13;
+	constexpr GLint kLightModeLocation_ = 14;
+	constexpr GLint kMeshLightCountLocation_ = 15;
+
+	// uLightMode in default.frag
+	constexpr GLint kLightModeNone_ = 0;
+	constexpr GLint kLightModeClustered_ = 1;
+	constexpr GLint kLightModeNaive_ = 2;
+
+	GLuint create_buffer_( std::size_t aBytes, GLenum aUsage )
+	{
+		GLuint buffer = 0;
+		glGenBuffers( 1, &buffer );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffer );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, GLsizeiptr(aBytes), nullptr, aUsage );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+		return buffer;
+	}
+
+	// View distances spanned by the depth slices (see ClusteredLights)
+	struct DepthRange_
+	{
+		float start, end;
+	};
+
+	DepthRange_ depth_range_( FramePacket const& aPacket ) noexcept
+	{
+		assert( aPacket.nearPlane > 0.f && aPacket.farPlane > aPacket.nearPlane );
+		float const start = aPacket.nearPlane;
+		return DepthRange_{ start, std::min( aPacket.farPlane, start * ClusteredLights::kMaxDepthRatio ) };
+	}
+}
+
+ClusteredLights::ClusteredLights()
+	: mLights( 0 )
+	, mClusters( 0 )
+	, mIndices( 0 )
+	, mCounter( 0 )
+	, mProgram( {
+		{ GL_COMPUTE_SHADER, "assets/cluster_lights.comp" }
+	} )
+	, mLightCount( 0 )
+{
+	static_assert( sizeof(LightGpu_) == 48, "Must match Light in assets/default.frag (std430)" );
+
+	mLights = create_buffer_( kMaxLights * sizeof(LightGpu_), GL_STREAM_DRAW );
+	mClusters = create_buffer_( kClusterCount * 2 * sizeof(GLuint), GL_DYNAMIC_COPY );
+	mIndices = create_buffer_( kIndexCapacity * sizeof(GLuint), GL_DYNAMIC_COPY );
+	mCounter = create_buffer_( sizeof(GLuint), GL_DYNAMIC_COPY );
+
+	mUpload.reserve( kMaxLights );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+ClusteredLights::~ClusteredLights()
+{
+	glDeleteBuffers( 1, &mCounter );
+	glDeleteBuffers( 1, &mIndices );
+	glDeleteBuffers( 1, &mClusters );
+	glDeleteBuffers( 1, &mLights );
+}
+
+void ClusteredLights::update( FramePacket const& aPacket, GpuProfiler& aProfiler )
+{
+	assert( aPacket.lights.size() <= kMaxLights );
+	mLightCount = std::min( aPacket.lights.size(), kMaxLights );
+
+	if( 0 == mLightCount )
+		return;
+
+	mUpload.clear();
+	for( std::size_t i = 0; i < mLightCount; ++i )
+	{
+		auto const& light = aPacket.lights[i];
+		mUpload.emplace_back( LightGpu_{
+			{ light.position.x, light.position.y, light.position.z, light.range },
+			{ light.color.x, light.color.y, light.color.z, light.spotCosOuter },
+			{ light.direction.x, light.direction.y, light.direction.z, light.spotCosInner }
+		} );
+	}
+
+	// Orphan the previous frame's lights; the GPU may still be reading them.
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mLights );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, GLsizeiptr(kMaxLights * sizeof(LightGpu_)), nullptr, GL_STREAM_DRAW );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(mUpload.size() * sizeof(LightGpu_)), mUpload.data() );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	if( LightCulling::clustered != aPacket.lightCulling )
+		return;
+
+	GpuProfileScope cullScope( aProfiler, "light culling" );
+	PROFILE_SCOPE( "light culling" );
+
+	GLuint const zero = 0;
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mCounter );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	glUseProgram( mProgram.programId() );
+
+	glUniformMatrix4fv( kWorldToCameraLocation_, 1, GL_TRUE, aPacket.worldToCamera.v );
+	glUniform2f( kTanHalfFovLocation_, 1.f / aPacket.projection(0,0), 1.f / aPacket.projection(1,1) );
+	glUniform1ui( kLightCountLocation_, GLuint(mLightCount) );
+	DepthRange_ const range = depth_range_( aPacket );
+	glUniform2f( kDepthRangeLocation_, range.start, range.end );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kLightBufferBinding, mLights );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kClusterBufferBinding, mClusters );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kIndexBufferBinding, mIndices );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kCounterBufferBinding, mCounter );
+
+	glDispatchCompute( GLuint((kClusterCount + kWorkGroupSize_-1) / kWorkGroupSize_), 1, 1 );
+
+	// The cluster lists are read by the fragment shaders of the scene pass.
+	glMemoryBarrier( GL_SHADER_STORAGE_BARRIER_BIT );
+
+	glUseProgram( 0 );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+void ClusteredLights::bind( FramePacket const& aPacket, int aWidth, int aHeight ) const
+{
+	if( 0 == mLightCount )
+	{
+		glUniform1i( kLightModeLocation_, kLightModeNone_ );
+		return;
+	}
+
+	bool const clustered = LightCulling::clustered == aPacket.lightCulling;
+
+	// Cluster of a fragment: tile = gl_FragCoord.xy * params.xy, slice =
+	// log(distance) * params.z + params.w. The slices follow
+	// start * (end/start)^(slice/kGridZ).
+	DepthRange_ const range = depth_range_( aPacket );
+	float const sliceScale = float(kGridZ) / std::log( range.end / range.start );
+	glUniform4f( kClusterParamsLocation_,
+		float(kGridX) / float(aWidth),
+		float(kGridY) / float(aHeight),
+		sliceScale,
+		-std::log( range.start ) * sliceScale
+	);
+	glUniform1i( kLightModeLocation_, clustered ? kLightModeClustered_ : kLightModeNaive_ );
+	glUniform1i( kMeshLightCountLocation_, GLint(mLightCount) );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kLightBufferBinding, mLights );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kClusterBufferBinding, mClusters );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kIndexBufferBinding, mIndices );
+}
@@ -0,0 +1,106 @@
+#ifndef CLUSTERED_LIGHTS_HPP_6A0F3C52_8E1B_4D7A_9C43_2B5E7D19F0A6
+#define CLUSTERED_LIGHTS_HPP_6A0F3C52_8E1B_4D7A_9C43_2B5E7D19F0A6
+
+#include <glad.h>
+
+#include <vector>
+#include <cstddef>
+
+#include "../support/program.hpp"
+
+#include "frame_packet.hpp"
+
+class GpuProfiler;
+
+// Most lights per frame (FramePacket::lights beyond this are ignored).
+constexpr std::size_t kMaxLights = 4096;
+
+/* Clustered forward lighting for point and spot lights
+ *
+ * The view frustum is divided into a grid of kGridX x kGridY screen tiles
+ * and kGridZ depth slices ("froxels"). Slices are spaced exponentially in
+ * view distance from the packet's near plane to its far plane, or to
+ * kMaxDepthRatio times the near plane if that is closer (the far plane may
+ * be infinite); the last slice extends to infinity.
+ * Each frame, a compute pass (assets/cluster_lights.comp) tests every light's
+ * bounding sphere against every cluster's view space bounding box, built
+ * from the packet's projection (the field of view of any projection in
+ * mat44.hpp), and writes
+ *
+ *  - a list of light indices, all clusters packed back to back (space is
+ *    reserved with one atomic add per cluster), and
+ *  - per cluster, the offset and length of its part of the list.
+ *
+ * Fragments find their cluster from gl_FragCoord and their view distance,
+ * and only loop over its lights. The compute pass tests each light twice:
+ * once to count a cluster's lights (to reserve their space in the list),
+ * and once to write their indices. This avoids a per-cluster limit; only
+ * the list as a whole is limited to kIndexCapacity indices, and lights
+ * past that are dropped.
+ *
+ * With LightCulling::naive, the compute pass is skipped and fragments loop
+ * over all lights (for comparison).
+ *
+ * The culling pass has its own GpuProfiler scope ("light culling").
+ *
+ * Mesh programs read the lights via the buffers and uniforms set by bind();
+ * see assets/default.frag.
+ */
+class ClusteredLights final
+{
+	public:
+		// Grid and limits. Must match assets/cluster_lights.comp and
+		// assets/default.frag.
+		static constexpr std::size_t kGridX = 16;
+		static constexpr std::size_t kGridY = 9;
+		static constexpr std::size_t kGridZ = 24;
+		static constexpr std::size_t kClusterCount = kGridX * kGridY * kGridZ;
+
+		static constexpr std::size_t kIndexCapacity = kClusterCount * 128;
+
+		// Largest ratio of the slices' far end to the near plane
+		static constexpr float kMaxDepthRatio = 3000.f;
+
+		// Shader storage buffer bindings (after the materials)
+		static constexpr GLuint kLightBufferBinding = 1;
+		static constexpr GLuint kClusterBufferBinding = 2;
+		static constexpr GLuint kIndexBufferBinding = 3;
+		static constexpr GLuint kCounterBufferBinding = 4;
+
+	public:
+		ClusteredLights();
+		~ClusteredLights();
+
+		ClusteredLights( ClusteredLights const& ) = delete;
+		ClusteredLights& operator= (ClusteredLights const&) = delete;
+
+	public:
+		// Upload the packet's lights and, with LightCulling::clustered,
+		// assign them to clusters. Leaves no program bound.
+		void update( FramePacket const&, GpuProfiler& );
+
+		// Bind the light buffers and set the light uniforms, for a scene
+		// viewport of aWidth x aHeight pixels (at the origin). The mesh
+		// program must be current.
+		void bind( FramePacket const&, int aWidth, int aHeight ) const;
+
+	private:
+		GLuint mLights;
+		GLuint mClusters;
+		GLuint mIndices;
+		GLuint mCounter;
+
+		ShaderProgram mProgram;
+
+		std::size_t mLightCount;
+
+		struct LightGpu_
+		{
+			float positionRange[4];
+			float colorSpotOuter[4];
+			float directionSpotInner[4];
+		};
+		std::vector<LightGpu_> mUpload;
+};
+
+#endif // CLUSTERED_LIGHTS_HPP_6A0F3C52_8E1B_4D7A_9C43_2B5E7D19F0A6
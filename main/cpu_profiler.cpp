@@ -0,0 +1,366 @@
+#include "cpu_profiler.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include <cstdio>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#	include <intrin.h>
+#	define PROFILER_TSC_ 1
+#elif defined(__x86_64__) || defined(__i386__)
+#	include <x86intrin.h>
+#	define PROFILER_TSC_ 1
+#else
+#	define PROFILER_TSC_ 0
+#endif
+
+#include "../support/error.hpp"
+
+#include "defaults.hpp"
+
+namespace
+{
+	constexpr std::size_t kEventsPerThread_ = std::size_t(1) << 18;
+
+	// CPU events store raw ticks: the TSC on x86, which is about twice as
+	// cheap to read as Clock::now(), and profiler_now_ns() elsewhere. Ticks
+	// are converted to nanoseconds when the trace is written, using the
+	// (ticks, ns) pairs taken at the start and end of the capture.
+	struct Event_
+	{
+		char const* name;
+		std::int64_t begin, end;
+	};
+
+	struct Calibration_
+	{
+		std::int64_t ticks0, ns0;
+		std::int64_t ticks1, ns1;
+	};
+
+	struct ThreadBuffer_
+	{
+		std::unique_ptr<Event_[]> events;
+
+		// Written by the owning thread only. `epoch` identifies the capture
+		// that the events belong to.
+		std::atomic<std::size_t> count{ 0 };
+		std::atomic<std::uint64_t> epoch{ 0 };
+		std::atomic<std::size_t> dropped{ 0 };
+
+		std::uint32_t tid = 0;
+		char const* name = nullptr; // Protected by Registry_::mutex
+	};
+
+	struct Registry_
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadBuffer_>> threads;
+
+		// GPU events arrive in bulk, once per frame; a mutex is fine here.
+		std::mutex gpuMutex;
+		std::vector<Event_> gpu;
+	};
+
+	Registry_& registry_()
+	{
+		static Registry_ registry;
+		return registry;
+	}
+
+	Clock::time_point const kOrigin_ = Clock::now();
+
+	std::atomic<bool> gCapturing_{ false };
+	std::atomic<std::uint64_t> gEpoch_{ 0 };
+
+	Calibration_ gCalibration_{}; // Written by begin/end_capture() only
+
+	thread_local ThreadBuffer_* tlBuffer_ = nullptr;
+
+	ThreadBuffer_& thread_buffer_()
+	{
+		if( !tlBuffer_ )
+		{
+			auto buffer = std::make_unique<ThreadBuffer_>();
+			buffer->events = std::make_unique<Event_[]>( kEventsPerThread_ );
+
+			auto& reg = registry_();
+			std::lock_guard<std::mutex> lock( reg.mutex );
+			buffer->tid = std::uint32_t(reg.threads.size() + 1); // 0 is the GPU
+			tlBuffer_ = buffer.get();
+			reg.threads.emplace_back( std::move(buffer) );
+		}
+
+		return *tlBuffer_;
+	}
+
+	inline std::int64_t ticks_() noexcept
+	{
+#		if PROFILER_TSC_
+		return std::int64_t(__rdtsc());
+#		else
+		return profiler_now_ns();
+#		endif
+	}
+
+	void calibrate_( std::int64_t& aTicks, std::int64_t& aNs ) noexcept
+	{
+		aTicks = ticks_();
+		aNs = profiler_now_ns();
+	}
+
+	Event_ to_ns_( Event_ const& aEvent, Calibration_ const& aCal ) noexcept
+	{
+		double const scale = aCal.ticks1 > aCal.ticks0
+			? double(aCal.ns1 - aCal.ns0) / double(aCal.ticks1 - aCal.ticks0)
+			: 1.0
+		;
+
+		auto const convert = [&] (std::int64_t aTicks) {
+			return aCal.ns0 + std::int64_t(double(aTicks - aCal.ticks0) * scale);
+		};
+
+		return Event_{ aEvent.name, convert( aEvent.begin ), convert( aEvent.end ) };
+	}
+
+	void record_( char const* aName, std::int64_t aBegin, std::int64_t aEnd ) noexcept
+	{
+		auto& buffer = thread_buffer_();
+
+		// First event of a new capture on this thread: start over.
+		std::uint64_t const epoch = gEpoch_.load( std::memory_order_relaxed );
+		if( buffer.epoch.load( std::memory_order_relaxed ) != epoch )
+		{
+			buffer.count.store( 0, std::memory_order_relaxed );
+			buffer.dropped.store( 0, std::memory_order_relaxed );
+			buffer.epoch.store( epoch, std::memory_order_release );
+		}
+
+		std::size_t const index = buffer.count.load( std::memory_order_relaxed );
+		if( index >= kEventsPerThread_ )
+		{
+			buffer.dropped.fetch_add( 1, std::memory_order_relaxed );
+			return;
+		}
+
+		buffer.events[index] = Event_{ aName, aBegin, aEnd };
+		buffer.count.store( index+1, std::memory_order_release );
+	}
+
+	void write_string_( std::FILE* aOut, char const* aString )
+	{
+		std::fputc( '"', aOut );
+		for( char const* c = aString; *c; ++c )
+		{
+			if( '"' == *c || '\\' == *c )
+				std::fputc( '\\', aOut );
+			if( static_cast<unsigned char>(*c) >= 0x20 )
+				std::fputc( *c, aOut );
+		}
+		std::fputc( '"', aOut );
+	}
+
+	void write_event_( std::FILE* aOut, Event_ const& aEvent, std::uint32_t aTid, char const* aCategory, bool& aFirst )
+	{
+		std::fputs( aFirst ? "\n" : ",\n", aOut );
+		aFirst = false;
+
+		std::fputs( "{\"name\":", aOut );
+		write_string_( aOut, aEvent.name );
+		std::fprintf( aOut, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+			aCategory,
+			double(aEvent.begin) * 1e-3,
+			double(aEvent.end - aEvent.begin) * 1e-3,
+			unsigned(aTid)
+		);
+	}
+
+	void write_thread_name_( std::FILE* aOut, std::uint32_t aTid, char const* aName, bool& aFirst )
+	{
+		std::fputs( aFirst ? "\n" : ",\n", aOut );
+		aFirst = false;
+
+		std::fprintf( aOut, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", unsigned(aTid) );
+		write_string_( aOut, aName );
+		std::fputs( "}}", aOut );
+
+		std::fprintf( aOut, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}", unsigned(aTid), unsigned(aTid) );
+	}
+}
+
+std::int64_t profiler_now_ns() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - kOrigin_).count();
+}
+
+void profiler_set_thread_name( char const* aName )
+{
+	auto& buffer = thread_buffer_();
+
+	std::lock_guard<std::mutex> lock( registry_().mutex );
+	buffer.name = aName;
+}
+
+void profiler_begin_capture()
+{
+	{
+		auto& reg = registry_();
+		std::lock_guard<std::mutex> lock( reg.gpuMutex );
+		reg.gpu.clear();
+	}
+
+	calibrate_( gCalibration_.ticks0, gCalibration_.ns0 );
+	gCalibration_.ticks1 = gCalibration_.ticks0;
+	gCalibration_.ns1 = gCalibration_.ns0;
+
+	gEpoch_.fetch_add( 1, std::memory_order_relaxed );
+	gCapturing_.store( true, std::memory_order_release );
+}
+
+void profiler_end_capture()
+{
+	gCapturing_.store( false, std::memory_order_release );
+	calibrate_( gCalibration_.ticks1, gCalibration_.ns1 );
+}
+
+bool profiler_capturing() noexcept
+{
+	return gCapturing_.load( std::memory_order_relaxed );
+}
+
+void profiler_add_gpu_event( char const* aName, std::int64_t aBeginNs, std::int64_t aEndNs )
+{
+	if( !profiler_capturing() )
+		return;
+
+	auto& reg = registry_();
+	std::lock_guard<std::mutex> lock( reg.gpuMutex );
+	reg.gpu.emplace_back( Event_{ aName, aBeginNs, aEndNs } );
+}
+
+void profiler_write_chrome_trace( char const* aPath )
+{
+	std::FILE* out = std::fopen( aPath, "wb" );
+	if( !out )
+		throw Error( "Unable to open '%s' for writing", aPath );
+
+	auto& reg = registry_();
+	std::uint64_t const epoch = gEpoch_.load( std::memory_order_relaxed );
+
+	Calibration_ cal = gCalibration_;
+	if( profiler_capturing() )
+		calibrate_( cal.ticks1, cal.ns1 );
+
+	std::fputs( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out );
+	bool first = true;
+
+	{
+		std::lock_guard<std::mutex> lock( reg.mutex );
+		for( auto const& thread : reg.threads )
+		{
+			if( thread->epoch.load( std::memory_order_acquire ) != epoch )
+				continue;
+
+			char fallback[32];
+			std::snprintf( fallback, sizeof(fallback), "thread %u", unsigned(thread->tid) );
+			write_thread_name_( out, thread->tid, thread->name ? thread->name : fallback, first );
+
+			std::size_t const count = thread->count.load( std::memory_order_acquire );
+			for( std::size_t i = 0; i < count; ++i )
+				write_event_( out, to_ns_( thread->events[i], cal ), thread->tid, "cpu", first );
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( reg.gpuMutex );
+		if( !reg.gpu.empty() )
+		{
+			write_thread_name_( out, 0, "GPU", first );
+			for( auto const& event : reg.gpu )
+				write_event_( out, event, 0, "gpu", first );
+		}
+	}
+
+	std::fputs( "\n]}\n", out );
+
+	bool const ok = !std::ferror( out );
+	std::fclose( out );
+
+	if( !ok )
+		throw Error( "Error while writing '%s'", aPath );
+}
+
+std::size_t profiler_dropped_events() noexcept
+{
+	auto& reg = registry_();
+	std::uint64_t const epoch = gEpoch_.load( std::memory_order_relaxed );
+
+	std::size_t ret = 0;
+	std::lock_guard<std::mutex> lock( reg.mutex );
+	for( auto const& thread : reg.threads )
+	{
+		if( thread->epoch.load( std::memory_order_acquire ) == epoch )
+			ret += thread->dropped.load( std::memory_order_relaxed );
+	}
+	return ret;
+}
+
+void profiler_run_overhead_benchmark()
+{
+	// Stays below the per-thread buffer size, so nothing is dropped.
+	constexpr std::size_t kScopes = 100000;
+	constexpr std::size_t kRuns = 10;
+
+	auto const run = [] {
+		auto const start = Clock::now();
+		for( std::size_t i = 0; i < kScopes; ++i )
+		{
+			ProfileScope scope( "benchmark" );
+		}
+		auto const end = Clock::now();
+		return std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(end - start).count() / double(kScopes);
+	};
+
+	// Baseline: loop and clock overhead only
+	double empty = 1e9;
+	for( std::size_t r = 0; r < kRuns; ++r )
+	{
+		auto const start = Clock::now();
+		for( std::size_t i = 0; i < kScopes; ++i )
+			std::atomic_signal_fence( std::memory_order_seq_cst ); // keep the loop
+		auto const end = Clock::now();
+		empty = std::min( empty, std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(end - start).count() / double(kScopes) );
+	}
+
+	double idle = 1e9;
+	for( std::size_t r = 0; r < kRuns; ++r )
+		idle = std::min( idle, run() );
+
+	double capturing = 1e9;
+	for( std::size_t r = 0; r < kRuns; ++r )
+	{
+		profiler_begin_capture();
+		capturing = std::min( capturing, run() );
+		profiler_end_capture();
+	}
+
+	std::printf( "CPU profiler overhead per scope (best of %zu runs of %zu scopes):\n", kRuns, kScopes );
+	std::printf( "  not capturing: %6.1f ns\n", idle - empty );
+	std::printf( "  capturing:     %6.1f ns\n", capturing - empty );
+	std::printf( "  (dropped events: %zu)\n", profiler_dropped_events() );
+}
+
+ProfileScope::ProfileScope( char const* aName ) noexcept
+	: mName( aName )
+	, mBegin( profiler_capturing() ? ticks_() : -1 )
+{}
+
+ProfileScope::~ProfileScope()
+{
+	if( mBegin >= 0 )
+		record_( mName, mBegin, ticks_() );
+}
@@ -0,0 +1,85 @@
+#ifndef CPU_PROFILER_HPP_BFFE99CF_1749_4FA6_B8DB_71CC1F12CBA2
+#define CPU_PROFILER_HPP_BFFE99CF_1749_4FA6_B8DB_71CC1F12CBA2
+
+#include <cstddef>
+#include <cstdint>
+
+/* CPU scope profiler
+ *
+ * PROFILE_SCOPE( "name" ) records the begin and end time of the enclosing
+ * scope (TSC ticks on x86, mapped onto Clock time when the trace is
+ * written). Events go into a buffer owned by the recording thread, so
+ * recording takes no locks and never allocates (the buffer is allocated
+ * when a thread records its first event). When a thread's buffer is full,
+ * further events are dropped and counted.
+ *
+ * Events are only recorded during a capture (profiler_begin_capture() to
+ * profiler_end_capture()). Outside of a capture, a scope costs one relaxed
+ * atomic load. profiler_write_chrome_trace() writes the last capture as
+ * Chrome trace JSON, which chrome://tracing and https://ui.perfetto.dev
+ * open. GPU timings (see GpuProfiler) can be added on the same timeline
+ * with profiler_add_gpu_event().
+ *
+ * The PROFILE_* macros expand to nothing in release builds, unless
+ * CPU_PROFILER_ENABLED is defined to 1 (e.g., by generating the project
+ * files with "premake5 --cpu-profiler ...").
+ */
+#if !defined(CPU_PROFILER_ENABLED)
+#	if defined(NDEBUG)
+#		define CPU_PROFILER_ENABLED 0
+#	else
+#		define CPU_PROFILER_ENABLED 1
+#	endif
+#endif // ~ CPU_PROFILER_ENABLED
+
+#define PROFILE_CONCAT_IMPL_( a, b ) a##b
+#define PROFILE_CONCAT_( a, b ) PROFILE_CONCAT_IMPL_( a, b )
+
+#if CPU_PROFILER_ENABLED
+#	define PROFILE_SCOPE( name ) ::ProfileScope PROFILE_CONCAT_( profileScope_, __LINE__ )( name )
+#	define PROFILE_THREAD_NAME( name ) ::profiler_set_thread_name( name )
+#else
+#	define PROFILE_SCOPE( name ) do {} while(0)
+#	define PROFILE_THREAD_NAME( name ) do {} while(0)
+#endif // ~ CPU_PROFILER_ENABLED
+
+// Nanoseconds since the profiler's time origin (program start).
+std::int64_t profiler_now_ns() noexcept;
+
+// Name the calling thread in the trace. aName must be a string literal (or
+// otherwise outlive the profiler).
+void profiler_set_thread_name( char const* aName );
+
+void profiler_begin_capture();
+void profiler_end_capture();
+bool profiler_capturing() noexcept;
+
+// Add a GPU event (in profiler_now_ns() time) to the current capture. Shown
+// on a separate "GPU" track. Thread safe.
+void profiler_add_gpu_event( char const* aName, std::int64_t aBeginNs, std::int64_t aEndNs );
+
+// Throws Error if the file cannot be written.
+void profiler_write_chrome_trace( char const* aPath );
+
+// Events dropped in the last capture because a thread's buffer was full.
+std::size_t profiler_dropped_events() noexcept;
+
+// Measure the cost of a PROFILE_SCOPE, with and without an active capture,
+// and print the results.
+void profiler_run_overhead_benchmark();
+
+class ProfileScope final
+{
+	public:
+		explicit ProfileScope( char const* aName ) noexcept;
+		~ProfileScope();
+
+		ProfileScope( ProfileScope const& ) = delete;
+		ProfileScope& operator= (ProfileScope const&) = delete;
+
+	private:
+		char const* mName;
+		std::int64_t mBegin;
+};
+
+#endif // CPU_PROFILER_HPP_BFFE99CF_1749_4FA6_B8DB_71CC1F12CBA2
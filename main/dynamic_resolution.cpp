@@ -0,0 +1,103 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+DynamicResolution::DynamicResolution( float aMinScale, float aMaxScale, float aBudgetMs ) noexcept
+	: mMinScale( aMinScale )
+	, mMaxScale( aMaxScale )
+	, mBudgetMs( aBudgetMs )
+	, mScale( aMaxScale )
+	, mChanged( true )
+	, mFirstFrame( 0 )
+	, mSampleSum( 0.f )
+	, mSamples( 0 )
+	, mChanges( 0 )
+	, mScaleSum( 0.0 )
+	, mFrames( 0 )
+{
+	assert( aMinScale > 0.f && aMinScale <= aMaxScale );
+	assert( aBudgetMs > 0.f );
+}
+
+float DynamicResolution::begin_frame( std::size_t aFrame ) noexcept
+{
+	if( mChanged )
+	{
+		mFirstFrame = aFrame;
+		mChanged = false;
+	}
+
+	mScaleSum += mScale;
+	++mFrames;
+
+	return mScale;
+}
+
+void DynamicResolution::add_sample( std::size_t aFrame, float aGpuMs ) noexcept
+{
+	// Drawn at an earlier scale
+	if( mChanged || aFrame < mFirstFrame || aGpuMs < 0.f )
+		return;
+
+	mSampleSum += aGpuMs;
+	if( ++mSamples < kWindow )
+		return;
+
+	float const meanMs = mSampleSum / float(mSamples);
+	mSampleSum = 0.f;
+	mSamples = 0;
+
+	bool const lower = meanMs > mBudgetMs;
+	bool const raise = meanMs < kRaiseBelow * mBudgetMs;
+	if( !lower && !raise )
+		return;
+
+	// Pixels scale with the square of the scale.
+	float const ratio = std::sqrt( kAim * mBudgetMs / std::max( meanMs, 1e-3f ) );
+	float target = mScale * std::min( ratio, kMaxRaise );
+
+	// Round down (with some slack for rounding errors, so that multiples of
+	// kStep stay put), then clamp.
+	target = std::floor( target / kStep + 1e-3f ) * kStep;
+	target = std::clamp( target, mMinScale, mMaxScale );
+
+	if( (lower && target >= mScale) || (raise && target <= mScale) )
+		return;
+
+	mScale = target;
+	mChanged = true;
+	++mChanges;
+}
+
+float DynamicResolution::scale() const noexcept
+{
+	return mScale;
+}
+
+float DynamicResolution::min_scale() const noexcept
+{
+	return mMinScale;
+}
+
+float DynamicResolution::max_scale() const noexcept
+{
+	return mMaxScale;
+}
+
+float DynamicResolution::budget_ms() const noexcept
+{
+	return mBudgetMs;
+}
+
+std::size_t DynamicResolution::changes() const noexcept
+{
+	return mChanges;
+}
+
+float DynamicResolution::mean_scale() const noexcept
+{
+	return mFrames ? float(mScaleSum / double(mFrames)) : mScale;
+}
@@ -0,0 +1,79 @@
+#ifndef DYNAMIC_RESOLUTION_HPP_D8C90256_9831_451E_A484_18AC7D2A4E7A
+#define DYNAMIC_RESOLUTION_HPP_D8C90256_9831_451E_A484_18AC7D2A4E7A
+
+#include <cstddef>
+
+/* Dynamic resolution controller
+ *
+ * Picks the scale (per axis, relative to the framebuffer) at which the scene
+ * is drawn, from the GPU time of past frames. The renderer reports each
+ * frame's GPU time once its timer queries have been read back (a few frames
+ * late) with add_sample(), and asks for the scale of each new frame with
+ * begin_frame().
+ *
+ * Samples of frames drawn before the last change of scale are ignored. Once
+ * kWindow samples at the current scale are in, their mean is compared to
+ * the budget:
+ *
+ *  - above the budget, the scale is lowered;
+ *  - below kRaiseBelow times the budget, it is raised;
+ *  - otherwise, it is kept.
+ *
+ * A new scale is chosen such that the frame would take kAim times the
+ * budget, assuming GPU time proportional to the number of pixels. kAim lies
+ * between the two thresholds, so the scale settles instead of oscillating.
+ * (Time that does not depend on the resolution, such as shadow maps, makes
+ * the estimate err towards smaller steps, so the scale approaches the
+ * target from either side rather than overshooting it.) Raises are limited
+ * to a factor of kMaxRaise, so that a briefly cheap view does not jump
+ * straight to the maximum. Scales are rounded down to multiples of kStep
+ * and kept within [min, max].
+ */
+class DynamicResolution final
+{
+	public:
+		static constexpr std::size_t kWindow = 8;
+
+		static constexpr float kRaiseBelow = 0.75f;
+		static constexpr float kAim = 0.9f;
+		static constexpr float kMaxRaise = 1.25f;
+		static constexpr float kStep = 0.05f;
+
+	public:
+		// Starts at the maximum scale.
+		DynamicResolution( float aMinScale, float aMaxScale, float aBudgetMs ) noexcept;
+
+	public:
+		// Frame aFrame is about to be drawn. Returns its scale.
+		float begin_frame( std::size_t aFrame ) noexcept;
+
+		// GPU time of frame aFrame. Negative times (not available) are
+		// ignored.
+		void add_sample( std::size_t aFrame, float aGpuMs ) noexcept;
+
+		float scale() const noexcept;
+		float min_scale() const noexcept;
+		float max_scale() const noexcept;
+		float budget_ms() const noexcept;
+
+		// Number of times the scale changed, and its mean over all frames
+		std::size_t changes() const noexcept;
+		float mean_scale() const noexcept;
+
+	private:
+		float mMinScale, mMaxScale;
+		float mBudgetMs;
+
+		float mScale;
+		bool mChanged;           // mScale not yet used by begin_frame()
+		std::size_t mFirstFrame; // first frame drawn at mScale
+
+		float mSampleSum;
+		std::size_t mSamples;
+
+		std::size_t mChanges;
+		double mScaleSum;
+		std::size_t mFrames;
+};
+
+#endif // DYNAMIC_RESOLUTION_HPP_D8C90256_9831_451E_A484_18AC7D2A4E7A
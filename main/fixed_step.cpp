@@ -0,0 +1,52 @@
+#include "fixed_step.hpp"
+
+#include <cmath>
+#include <cassert>
+
+FixedStep::FixedStep( Secondsf aStep, std::size_t aMaxSteps ) noexcept
+	: mStep( aStep )
+	, mMaxSteps( aMaxSteps )
+	, mAccumulator( 0.f )
+	, mDropped( 0.f )
+{
+	assert( aStep.count() > 0.f );
+	assert( aMaxSteps > 0 );
+}
+
+std::size_t FixedStep::advance( Secondsf aElapsed ) noexcept
+{
+	mAccumulator += aElapsed;
+
+	std::size_t steps = 0;
+	while( mAccumulator >= mStep && steps < mMaxSteps )
+	{
+		mAccumulator -= mStep;
+		++steps;
+	}
+
+	// Hit the guard. Keep the fractional part so that interpolation stays
+	// smooth, and drop the rest.
+	if( mAccumulator >= mStep )
+	{
+		auto const whole = std::floor( mAccumulator / mStep );
+		mDropped += whole * mStep;
+		mAccumulator -= whole * mStep;
+	}
+
+	return steps;
+}
+
+Secondsf FixedStep::step() const noexcept
+{
+	return mStep;
+}
+
+float FixedStep::alpha() const noexcept
+{
+	return mAccumulator / mStep;
+}
+
+Secondsf FixedStep::dropped() const noexcept
+{
+	return mDropped;
+}
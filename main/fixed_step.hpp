@@ -0,0 +1,42 @@
+#ifndef FIXED_STEP_HPP_AF5B028A_7655_4ADD_AC02_B415D6DFEE60
+#define FIXED_STEP_HPP_AF5B028A_7655_4ADD_AC02_B415D6DFEE60
+
+#include <cstddef>
+
+#include "defaults.hpp"
+
+/* Fixed-timestep accumulator
+ *
+ * Each frame, advance() adds the elapsed real time to an accumulator and
+ * returns how many simulation steps of length step() to run. The remainder
+ * is carried over to the next frame; alpha() is the fraction of a step that
+ * is left over, which the renderer uses to interpolate between the previous
+ * and the current simulation state.
+ *
+ * If a frame takes too long, at most `aMaxSteps` steps are run and the rest
+ * of the accumulated time is discarded. Otherwise a slow frame causes more
+ * steps next frame, which make the frame slower still ("spiral of death").
+ */
+class FixedStep final
+{
+	public:
+		FixedStep( Secondsf aStep, std::size_t aMaxSteps ) noexcept;
+
+	public:
+		std::size_t advance( Secondsf aElapsed ) noexcept;
+
+		Secondsf step() const noexcept;
+		float alpha() const noexcept;
+
+		// Total simulation time discarded by the max-steps guard
+		Secondsf dropped() const noexcept;
+
+	private:
+		Secondsf mStep;
+		std::size_t mMaxSteps;
+
+		Secondsf mAccumulator;
+		Secondsf mDropped;
+};
+
+#endif // FIXED_STEP_HPP_AF5B028A_7655_4ADD_AC02_B415D6DFEE60
@@ -0,0 +1,216 @@
+#include "frame_capture.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include <stb_image_write.h>
+
+#include "../support/checkpoint.hpp"
+
+FrameCapture::FrameCapture()
+{
+	for( auto& slot : mSlots )
+		glGenBuffers( 1, &slot.pbo );
+
+	OGL_CHECKPOINT_ALWAYS();
+
+	mWriter = std::thread( [this] { writer_(); } );
+}
+
+FrameCapture::~FrameCapture()
+{
+	finish();
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStop = true;
+	}
+	mCondition.notify_all();
+	mWriter.join();
+
+	for( auto& slot : mSlots )
+		glDeleteBuffers( 1, &slot.pbo );
+}
+
+void FrameCapture::capture( int aWidth, int aHeight, std::string aPath )
+{
+	// Pick a free slot, or wait for the oldest capture.
+	Slot_* slot = nullptr;
+	for( auto& s : mSlots )
+	{
+		if( !s.fence )
+		{
+			slot = &s;
+			break;
+		}
+
+		if( !slot || s.sequence < slot->sequence )
+			slot = &s;
+	}
+
+	if( slot->fence )
+	{
+		++mStalls;
+		complete_( *slot );
+	}
+
+	auto const bytes = std::size_t(aWidth) * std::size_t(aHeight) * 4;
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, slot->pbo );
+	glBufferData( GL_PIXEL_PACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_READ );
+
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	glReadPixels( 0, 0, aWidth, aHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	slot->fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	slot->sequence = mSequence++;
+	slot->width = aWidth;
+	slot->height = aHeight;
+	slot->path = std::move(aPath);
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+void FrameCapture::poll()
+{
+	for( auto& slot : mSlots )
+	{
+		if( !slot.fence )
+			continue;
+
+		GLint status = GL_UNSIGNALED;
+		glGetSynciv( slot.fence, GL_SYNC_STATUS, 1, nullptr, &status );
+
+		if( GL_SIGNALED == status )
+			complete_( slot );
+	}
+}
+
+void FrameCapture::finish()
+{
+	// Complete in order, so that files are written in the order captured.
+	while( true )
+	{
+		Slot_* oldest = nullptr;
+		for( auto& slot : mSlots )
+		{
+			if( slot.fence && (!oldest || slot.sequence < oldest->sequence) )
+				oldest = &slot;
+		}
+
+		if( !oldest )
+			break;
+
+		complete_( *oldest );
+	}
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	mCondition.wait( lock, [this] { return mQueue.empty() && 0 == mWriting; } );
+}
+
+std::size_t FrameCapture::written() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mWritten;
+}
+
+std::size_t FrameCapture::failed() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mFailed;
+}
+
+std::size_t FrameCapture::stalls() const noexcept
+{
+	return mStalls;
+}
+
+void FrameCapture::complete_( Slot_& aSlot )
+{
+	// Blocks only if the fence has not been signaled yet (finish() or all
+	// slots busy).
+	glClientWaitSync( aSlot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(~0ull) );
+	glDeleteSync( aSlot.fence );
+	aSlot.fence = nullptr;
+
+	Image_ image;
+	image.width = aSlot.width;
+	image.height = aSlot.height;
+	image.path = std::move(aSlot.path);
+	image.rgba.resize( std::size_t(aSlot.width) * std::size_t(aSlot.height) * 4 );
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, aSlot.pbo );
+	if( void const* data = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(image.rgba.size()), GL_MAP_READ_BIT ) )
+	{
+		std::memcpy( image.rgba.data(), data, image.rgba.size() );
+		glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+	}
+	else
+	{
+		image.rgba.clear();
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	if( image.rgba.empty() )
+	{
+		std::fprintf( stderr, "FrameCapture: unable to map pixel buffer for '%s'\n", image.path.c_str() );
+
+		std::lock_guard<std::mutex> lock( mMutex );
+		++mFailed;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mQueue.emplace_back( std::move(image) );
+	}
+	mCondition.notify_all();
+}
+
+void FrameCapture::writer_()
+{
+	std::vector<std::uint8_t> rgb;
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	while( true )
+	{
+		mCondition.wait( lock, [this] { return !mQueue.empty() || mStop; } );
+		if( mQueue.empty() )
+			break;
+
+		Image_ image = std::move(mQueue.front());
+		mQueue.pop_front();
+		++mWriting;
+		lock.unlock();
+
+		// Flip and drop alpha. The clear color's alpha is zero, which would
+		// make the PNG transparent.
+		auto const w = std::size_t(image.width), h = std::size_t(image.height);
+		rgb.resize( w * h * 3 );
+		for( std::size_t y = 0; y < h; ++y )
+		{
+			std::uint8_t const* src = image.rgba.data() + (h-1-y) * w * 4;
+			std::uint8_t* dst = rgb.data() + y * w * 3;
+			for( std::size_t x = 0; x < w; ++x )
+			{
+				dst[3*x+0] = src[4*x+0];
+				dst[3*x+1] = src[4*x+1];
+				dst[3*x+2] = src[4*x+2];
+			}
+		}
+
+		bool const ok = 0 != stbi_write_png( image.path.c_str(), image.width, image.height, 3, rgb.data(), image.width * 3 );
+		if( !ok )
+			std::fprintf( stderr, "FrameCapture: unable to write '%s'\n", image.path.c_str() );
+
+		lock.lock();
+		--mWriting;
+		if( ok )
+			++mWritten;
+		else
+			++mFailed;
+
+		mCondition.notify_all();
+	}
+}
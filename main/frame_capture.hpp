@@ -0,0 +1,90 @@
+#ifndef FRAME_CAPTURE_HPP_98E39B6C_AFDD_407A_BDFA_937835D48A47
+#define FRAME_CAPTURE_HPP_98E39B6C_AFDD_407A_BDFA_937835D48A47
+
+#include <glad.h>
+
+#include <mutex>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+
+/* Asynchronous framebuffer capture
+ *
+ * capture() starts a glReadPixels() of the current read framebuffer into a
+ * pixel buffer object and inserts a fence; it returns immediately, without
+ * waiting for the GPU. poll(), called once per frame, checks the fences of
+ * outstanding captures without blocking. Completed captures are copied out
+ * of their PBO and handed to a writer thread, which flips them (GL's origin
+ * is the bottom left) and writes them as RGB PNGs with stb_image_write.
+ *
+ * Up to kSlots captures can be in flight. If all slots are busy, capture()
+ * waits for the oldest one (and counts a stall).
+ *
+ * Must be created, used and destroyed on the thread that owns the GL
+ * context. The destructor waits for all outstanding captures to be written.
+ * Errors are reported on stderr and counted in failed().
+ */
+class FrameCapture final
+{
+	public:
+		static constexpr std::size_t kSlots = 3;
+
+	public:
+		FrameCapture();
+		~FrameCapture();
+
+		FrameCapture( FrameCapture const& ) = delete;
+		FrameCapture& operator= (FrameCapture const&) = delete;
+
+	public:
+		void capture( int aWidth, int aHeight, std::string aPath );
+		void poll();
+
+		// Wait until all captures so far have been written.
+		void finish();
+
+		std::size_t written() const;
+		std::size_t failed() const;
+		std::size_t stalls() const noexcept;
+
+	private:
+		struct Slot_
+		{
+			GLuint pbo = 0;
+			GLsync fence = nullptr;
+			std::size_t sequence = 0;
+
+			int width = 0, height = 0;
+			std::string path;
+		};
+
+		struct Image_
+		{
+			int width, height;
+			std::string path;
+			std::vector<std::uint8_t> rgba;
+		};
+
+		void complete_( Slot_& );
+		void writer_();
+
+	private:
+		Slot_ mSlots[kSlots];
+		std::size_t mSequence = 0;
+		std::size_t mStalls = 0;
+
+		mutable std::mutex mMutex;
+		std::condition_variable mCondition;
+		std::deque<Image_> mQueue;
+		std::size_t mWriting = 0;
+		std::size_t mWritten = 0, mFailed = 0;
+		bool mStop = false;
+
+		std::thread mWriter;
+};
+
+#endif // FRAME_CAPTURE_HPP_98E39B6C_AFDD_407A_BDFA_937835D48A47
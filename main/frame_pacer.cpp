@@ -0,0 +1,131 @@
+#include "frame_pacer.hpp"
+
+#include <thread>
+#include <algorithm>
+
+#include <cassert>
+
+namespace
+{
+	float to_ms_( Clock::duration aDuration )
+	{
+		return std::chrono::duration_cast<Secondsf>(aDuration).count() * 1000.f;
+	}
+}
+
+FramePacer::FramePacer( std::size_t aMaxInFlight ) noexcept
+	: mMaxInFlight( aMaxInFlight )
+	, mFirst( 0 )
+	, mCount( 0 )
+	, mLatency{}
+	, mLatencySum( 0.0 )
+{
+	assert( aMaxInFlight >= 1 && aMaxInFlight <= kMaxInFlight );
+}
+
+FramePacer::~FramePacer()
+{
+	for( auto& slot : mSlots )
+	{
+		if( slot.fence )
+			glDeleteSync( slot.fence );
+	}
+}
+
+float FramePacer::begin_frame()
+{
+	auto const start = Clock::now();
+
+	// Frames finish in order; retire the ones that are done.
+	while( mCount > 0 )
+	{
+		auto& slot = mSlots[mFirst];
+
+		GLint status = GL_UNSIGNALED;
+		glGetSynciv( slot.fence, GL_SYNC_STATUS, 1, nullptr, &status );
+		if( GL_SIGNALED != status )
+			break;
+
+		complete_( slot, start );
+	}
+
+	if( mCount < mMaxInFlight )
+		return 0.f;
+
+	// Too far ahead of the GPU
+	while( mCount >= mMaxInFlight )
+	{
+		auto& slot = mSlots[mFirst];
+		glClientWaitSync( slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(~0ull) );
+		complete_( slot, Clock::now() );
+	}
+
+	return to_ms_( Clock::now() - start );
+}
+
+void FramePacer::end_frame( Clock::time_point aInputTime )
+{
+	assert( mCount < kMaxInFlight );
+
+	auto& slot = mSlots[(mFirst + mCount) % kMaxInFlight];
+	slot.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	slot.inputTime = aInputTime;
+	++mCount;
+}
+
+FramePacer::LatencyStats const& FramePacer::latency() const noexcept
+{
+	return mLatency;
+}
+
+void FramePacer::complete_( Slot_& aSlot, Clock::time_point aNow )
+{
+	assert( mCount > 0 && &aSlot == &mSlots[mFirst] );
+
+	glDeleteSync( aSlot.fence );
+	aSlot.fence = nullptr;
+
+	mFirst = (mFirst+1) % kMaxInFlight;
+	--mCount;
+
+	float const ms = to_ms_( aNow - aSlot.inputTime );
+
+	mLatency.lastMs = ms;
+	mLatency.maxMs = std::max( mLatency.maxMs, ms );
+	mLatencySum += ms;
+	++mLatency.frames;
+	mLatency.meanMs = float(mLatencySum / double(mLatency.frames));
+}
+
+InputPacer::InputPacer( bool aEnabled ) noexcept
+	: mEnabled( aEnabled )
+	, mSleepMs( 0.f )
+{}
+
+void InputPacer::sleep_before_input() const
+{
+	if( mEnabled && mSleepMs > 0.f )
+		std::this_thread::sleep_for( std::chrono::duration<float, std::milli>( mSleepMs ) );
+}
+
+void InputPacer::record( float aAcquireWaitMs, float aRenderWaitMs ) noexcept
+{
+	if( !mEnabled )
+		return;
+
+	// Time blocked in acquire() could have been spent before sampling
+	// input. Beyond that, aim for the render thread to wait kSlackMs for
+	// the packet: any less, and the packet was queued behind another one.
+	mSleepMs += aAcquireWaitMs + kGain * (kSlackMs - aRenderWaitMs);
+	mSleepMs = std::clamp( mSleepMs, 0.f, kMaxSleepMs );
+}
+
+bool InputPacer::enabled() const noexcept
+{
+	return mEnabled;
+}
+
+float InputPacer::sleep_ms() const noexcept
+{
+	return mSleepMs;
+}
@@ -0,0 +1,115 @@
+#ifndef FRAME_PACER_HPP_B6DBF738_6F14_4B26_B9CF_E1DFD9B5B349
+#define FRAME_PACER_HPP_B6DBF738_6F14_4B26_B9CF_E1DFD9B5B349
+
+#include <glad.h>
+
+#include <cstddef>
+
+#include "defaults.hpp"
+
+/* Frame pacing on the render thread
+ *
+ * glfwSwapBuffers() usually returns long before the GPU has finished the
+ * frame, so without a limit the driver may queue several frames, each adding
+ * a frame of latency. After each swap, end_frame() inserts a fence; before
+ * each frame, begin_frame() waits until at most aMaxInFlight-1 earlier
+ * frames are unfinished, i.e., the render thread never runs more than
+ * aMaxInFlight frames ahead of the GPU (at most kMaxInFlight).
+ *
+ * The fences also give a latency estimate: the time from when a frame's
+ * input was sampled (FramePacket::inputTime) to when its fence was seen
+ * signalled. Fences are checked without blocking at the start of each
+ * frame (and when waiting), so the estimate can be up to a frame late; it
+ * also does not include the wait for the display's vertical blank.
+ *
+ * Must be used on the thread that owns the GL context.
+ */
+class FramePacer final
+{
+	public:
+		static constexpr std::size_t kMaxInFlight = 4;
+
+		struct LatencyStats
+		{
+			float lastMs;
+			float meanMs, maxMs;
+			std::size_t frames;
+		};
+
+	public:
+		// 1 <= aMaxInFlight <= kMaxInFlight
+		explicit FramePacer( std::size_t aMaxInFlight ) noexcept;
+		~FramePacer();
+
+		FramePacer( FramePacer const& ) = delete;
+		FramePacer& operator= (FramePacer const&) = delete;
+
+	public:
+		// Before drawing a frame. Returns the time spent waiting (ms).
+		float begin_frame();
+
+		// After swapping a frame whose input was sampled at aInputTime.
+		void end_frame( Clock::time_point aInputTime );
+
+		LatencyStats const& latency() const noexcept;
+
+	private:
+		struct Slot_
+		{
+			GLsync fence = nullptr;
+			Clock::time_point inputTime;
+		};
+
+		void complete_( Slot_&, Clock::time_point aNow );
+
+	private:
+		std::size_t mMaxInFlight;
+
+		// Ring of frames in flight, oldest at mFirst
+		Slot_ mSlots[kMaxInFlight];
+		std::size_t mFirst, mCount;
+
+		LatencyStats mLatency;
+		double mLatencySum;
+};
+
+/* Just-in-time input on the main thread
+ *
+ * The main thread samples input, simulates, and then blocks in
+ * Renderer::acquire() until the render thread frees a packet. Time blocked
+ * there is added to the latency of the input that was just sampled. With
+ * just-in-time input, the main thread instead sleeps before sampling input,
+ * for about as long as it would otherwise block:
+ *
+ *   pacer.sleep_before_input();
+ *   ... poll events, simulate, acquire() ...
+ *   pacer.record( acquire wait, render thread wait for the packet );
+ *
+ * The sleep grows by kGain times the wait in acquire() beyond kSlackMs, and
+ * shrinks by the render thread's wait for a packet (the packet was late).
+ * The OS may oversleep by a fraction of a millisecond (more on some
+ * platforms); the slack absorbs that.
+ */
+class InputPacer final
+{
+	public:
+		static constexpr float kSlackMs = 1.f;
+		static constexpr float kGain = 0.5f;
+		static constexpr float kMaxSleepMs = 100.f;
+
+	public:
+		explicit InputPacer( bool aEnabled ) noexcept;
+
+	public:
+		void sleep_before_input() const;
+		void record( float aAcquireWaitMs, float aRenderWaitMs ) noexcept;
+
+		bool enabled() const noexcept;
+		float sleep_ms() const noexcept;
+
+	private:
+		bool mEnabled;
+		float mSleepMs;
+};
+
+#endif // FRAME_PACER_HPP_B6DBF738_6F14_4B26_B9CF_E1DFD9B5B349
@@ -0,0 +1,125 @@
+#ifndef FRAME_PACKET_HPP_AFE2EF21_F69A_4139_9A6E_D17B620FA248
+#define FRAME_PACKET_HPP_AFE2EF21_F69A_4139_9A6E_D17B620FA248
+
+#include <vector>
+#include <memory_resource>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "../support/frame_arena.hpp"
+
+#include "defaults.hpp"
+
+// One mesh instance. `mesh` indexes the models passed to the Renderer.
+//
+// Static instances do not move; cached shadow cascades (see shadow_map.hpp)
+// are only re-rendered for them when the camera or the sun moves.
+struct DrawItem
+{
+	std::uint32_t mesh;
+	Mat44f world;
+	bool dynamic = false;
+};
+
+// A point light, or a spot light if spotCosOuter > -1. The light falls off
+// to zero at `range` (see assets/default.frag).
+struct LightItem
+{
+	Vec3f position;
+	float range;
+	Vec3f color;
+
+	// Spot lights only: cone axis (pointing away from the light) and cosines
+	// of the angles where the falloff starts and ends.
+	Vec3f direction;
+	float spotCosInner;
+	float spotCosOuter;
+};
+
+// How fragments find their lights (see clustered_lights.hpp)
+enum class LightCulling
+{
+	clustered, // loop over the lights of the fragment's cluster
+	naive      // loop over all lights
+};
+
+// One line of overlay text, in pixels from the top left corner.
+struct TextItem
+{
+	float x, y;
+	float size;
+	std::uint32_t color;
+	char text[128];
+};
+
+/* Everything the render thread needs to draw one frame
+ *
+ * The main thread fills in a packet and submits it; from then on the packet
+ * is owned by the render thread and is treated as immutable until it is
+ * handed back.
+ *
+ * Each packet has a FrameArena, which is reset when the packet is acquired.
+ * `draws` is allocated from it, and the render thread takes its scratch
+ * memory for the frame (draw order, text vertices) from it as well. Only
+ * the thread that currently owns the packet uses the arena. The other
+ * vectors are recycled with the packet, so they reach a steady-state
+ * capacity and stop allocating after the first few frames.
+ */
+struct FramePacket
+{
+	explicit FramePacket( FrameArena& aArena )
+		: arena( &aArena )
+		, frame( 0 )
+		, inputTime{}
+		, framebufferWidth( 0 ), framebufferHeight( 0 )
+		, projection{}, worldToCamera{}
+		, nearPlane( 0.f ), farPlane( 0.f )
+		, cameraPosition{}, cameraForward{}
+		, lightDir{}
+		, draws( &aArena )
+		, lightCulling( LightCulling::clustered )
+		, textBenchmark( false )
+		, capture( false )
+	{}
+
+	FrameArena* arena;
+
+	std::size_t frame;
+
+	// When the main thread sampled the input for this frame (see
+	// FramePacer)
+	Clock::time_point inputTime;
+
+	int framebufferWidth;
+	int framebufferHeight;
+
+	// Camera
+	Mat44f projection;
+	Mat44f worldToCamera;
+	// View distances of the projection's near and far planes. farPlane is
+	// infinite for an infinite projection.
+	float nearPlane;
+	float farPlane;
+	Vec3f cameraPosition;
+	Vec3f cameraForward;
+
+	// Uniforms
+	Vec3f lightDir;
+
+	std::pmr::vector<DrawItem> draws;
+	std::vector<LightItem> lights;
+	LightCulling lightCulling;
+	std::vector<TextItem> text;
+
+	bool textBenchmark;
+
+	// Read back the finished frame and write it to a PNG (see
+	// Renderer::Config::captureDirectory).
+	bool capture;
+};
+
+#endif // FRAME_PACKET_HPP_AFE2EF21_F69A_4139_9A6E_D17B620FA248
@@ -0,0 +1,149 @@
+#include "frame_stats.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	float percentile_( std::vector<float> const& aSorted, float aPercent ) noexcept
+	{
+		// Nearest rank: the smallest sample such that at least aPercent of
+		// the samples are less than or equal to it.
+		auto const rank = std::size_t(std::ceil( aPercent / 100.f * float(aSorted.size()) ));
+		return aSorted[std::clamp<std::size_t>( rank, 1, aSorted.size() ) - 1];
+	}
+
+	void write_summary_( std::FILE* aOut, char const* aName, TimingSummary const& aSummary, bool aLast )
+	{
+		std::fprintf( aOut, "  \"%s\": { \"count\": %zu, \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+			aName,
+			aSummary.count,
+			aSummary.mean, aSummary.min,
+			aSummary.p50, aSummary.p95, aSummary.p99,
+			aSummary.max,
+			aLast ? "" : ","
+		);
+	}
+
+	void write_string_( std::FILE* aOut, std::string const& aString )
+	{
+		std::fputc( '"', aOut );
+		for( char const c : aString )
+		{
+			if( '"' == c || '\\' == c )
+				std::fputc( '\\', aOut );
+			if( static_cast<unsigned char>(c) >= 0x20 )
+				std::fputc( c, aOut );
+		}
+		std::fputc( '"', aOut );
+	}
+}
+
+TimingSummary summarize_timings( std::vector<float> aSamples )
+{
+	TimingSummary ret{};
+	if( aSamples.empty() )
+		return ret;
+
+	std::sort( aSamples.begin(), aSamples.end() );
+
+	double sum = 0.0;
+	for( auto const sample : aSamples )
+		sum += sample;
+
+	ret.count = aSamples.size();
+	ret.mean = float(sum / double(aSamples.size()));
+	ret.min = aSamples.front();
+	ret.max = aSamples.back();
+	ret.p50 = percentile_( aSamples, 50.f );
+	ret.p95 = percentile_( aSamples, 95.f );
+	ret.p99 = percentile_( aSamples, 99.f );
+	return ret;
+}
+
+void write_benchmark_json( char const* aPath, BenchmarkReport const& aReport )
+{
+	std::FILE* out = std::fopen( aPath, "wb" );
+	if( !out )
+		throw Error( "Unable to open '%s' for writing", aPath );
+
+	std::fputs( "{\n  \"renderer\": ", out );
+	write_string_( out, aReport.renderer );
+	std::fprintf( out, ",\n  \"width\": %d,\n  \"height\": %d,\n", aReport.width, aReport.height );
+	std::fprintf( out, "  \"frames\": %zu,\n  \"warmup_frames\": %zu,\n", aReport.frameMs.size(), aReport.warmupFrames );
+
+	write_summary_( out, "frame_ms", summarize_timings( aReport.frameMs ), false );
+	write_summary_( out, "main_ms", summarize_timings( aReport.mainMs ), false );
+	write_summary_( out, "render_ms", summarize_timings( aReport.renderMs ), false );
+	write_summary_( out, "latency_ms", summarize_timings( aReport.latencyMs ), true );
+
+	std::fputs( "}\n", out );
+
+	bool const ok = !std::ferror( out );
+	std::fclose( out );
+
+	if( !ok )
+		throw Error( "Error while writing '%s'", aPath );
+}
+
+void write_replay_csv( char const* aPath, std::vector<ReplayFrame> const& aFrames )
+{
+	std::FILE* out = std::fopen( aPath, "wb" );
+	if( !out )
+		throw Error( "Unable to open '%s' for writing", aPath );
+
+	std::fputs( "frame,path_time,x,y,z,yaw,pitch,frame_ms,main_ms,render_ms,gpu_ms\n", out );
+	for( auto const& f : aFrames )
+	{
+		std::fprintf( out, "%zu,%.4f,%.4f,%.4f,%.4f,%.5f,%.5f,%.4f,%.4f,%.4f,",
+			f.frame, f.pathTime,
+			f.camera.position.x, f.camera.position.y, f.camera.position.z,
+			f.camera.yaw, f.camera.pitch,
+			f.frameMs, f.mainMs, f.renderMs
+		);
+
+		if( f.gpuMs >= 0.f )
+			std::fprintf( out, "%.4f", f.gpuMs );
+		std::fputc( '\n', out );
+	}
+
+	bool const ok = !std::ferror( out );
+	std::fclose( out );
+
+	if( !ok )
+		throw Error( "Error while writing '%s'", aPath );
+}
+
+void print_slowest_frames( std::FILE* aOut, std::vector<ReplayFrame> const& aFrames, std::size_t aCount )
+{
+	std::vector<ReplayFrame const*> order;
+	order.reserve( aFrames.size() );
+	for( auto const& f : aFrames )
+		order.emplace_back( &f );
+
+	aCount = std::min( aCount, order.size() );
+	std::partial_sort( order.begin(), order.begin() + std::ptrdiff_t(aCount), order.end(), [] (ReplayFrame const* aA, ReplayFrame const* aB) {
+		return aA->frameMs > aB->frameMs;
+	} );
+
+	std::fprintf( aOut, "Slowest frames:\n" );
+	std::fprintf( aOut, "  %6s %8s %26s %8s %8s %8s\n", "frame", "t (s)", "position", "frame", "render", "gpu" );
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		auto const& f = *order[i];
+
+		char gpu[16] = "-";
+		if( f.gpuMs >= 0.f )
+			std::snprintf( gpu, sizeof(gpu), "%.3f", f.gpuMs );
+
+		std::fprintf( aOut, "  %6zu %8.3f (%7.2f, %7.2f, %7.2f) %8.3f %8.3f %8s\n",
+			f.frame, f.pathTime,
+			f.camera.position.x, f.camera.position.y, f.camera.position.z,
+			f.frameMs, f.renderMs, gpu
+		);
+	}
+}
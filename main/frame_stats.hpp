@@ -0,0 +1,69 @@
+#ifndef FRAME_STATS_HPP_8043736B_C549_4B1F_A8C5_D41F0A11FF3A
+#define FRAME_STATS_HPP_8043736B_C549_4B1F_A8C5_D41F0A11FF3A
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+
+#include "camera.hpp"
+
+// Summary of a series of timings (milliseconds). Percentiles use the
+// nearest-rank method.
+struct TimingSummary
+{
+	std::size_t count;
+	float mean, min, max;
+	float p50, p95, p99;
+};
+
+// Takes the samples by value, since they are sorted. All zero for an empty
+// series.
+TimingSummary summarize_timings( std::vector<float> aSamples );
+
+/* Results of a headless benchmark run (see --headless)
+ *
+ * Written as a single JSON object:
+ *   { "renderer": ..., "width": ..., "height": ..., "frames": ...,
+ *     "warmup_frames": ..., "frame_ms": { "mean": ..., "p50": ..., ... },
+ *     "main_ms": { ... }, "render_ms": { ... }, "latency_ms": { ... } }
+ */
+struct BenchmarkReport
+{
+	std::string renderer; // GL_RENDERER
+	int width, height;
+	std::size_t warmupFrames;
+
+	std::vector<float> frameMs;   // frame to frame, main thread
+	std::vector<float> mainMs;    // main thread CPU time, excluding waits
+	std::vector<float> renderMs;  // render thread CPU time, excluding waits
+	std::vector<float> latencyMs; // input to GPU done, latest estimate (Renderer::Timings)
+};
+
+// Throws Error if the file cannot be written.
+void write_benchmark_json( char const* aPath, BenchmarkReport const& );
+
+/* Per frame results of a camera path replay (see --replay)
+ *
+ * Written as CSV with a header line:
+ *   frame,path_time,x,y,z,yaw,pitch,frame_ms,main_ms,render_ms,gpu_ms
+ * gpu_ms is empty if no GPU time was collected for the frame.
+ */
+struct ReplayFrame
+{
+	std::size_t frame;
+	float pathTime; // seconds from the start of the path
+	Camera camera;
+
+	float frameMs, mainMs, renderMs;
+	float gpuMs; // < 0: not available
+};
+
+// Throws Error if the file cannot be written.
+void write_replay_csv( char const* aPath, std::vector<ReplayFrame> const& );
+
+// Print the aCount frames with the longest frame time (with their position
+// on the path), slowest first.
+void print_slowest_frames( std::FILE*, std::vector<ReplayFrame> const&, std::size_t aCount );
+
+#endif // FRAME_STATS_HPP_8043736B_C549_4B1F_A8C5_D41F0A11FF3A
@@ -0,0 +1,61 @@
+#include "input.hpp"
+
+void InputQueue::push_key( int aKey, int aAction, int aMods ) noexcept
+{
+	InputEvent event{};
+	event.time = Clock::now();
+	event.type = InputEventType::key;
+	event.key = aKey;
+	event.action = aAction;
+	event.mods = aMods;
+	push_( event );
+}
+
+void InputQueue::push_cursor( double aX, double aY ) noexcept
+{
+	InputEvent event{};
+	event.time = Clock::now();
+	event.type = InputEventType::cursor;
+	event.x = aX;
+	event.y = aY;
+	push_( event );
+}
+
+KeySet const& InputQueue::keys() const noexcept
+{
+	return mKeys;
+}
+
+bool InputQueue::key( int aKey ) const noexcept
+{
+	if( aKey < 0 || std::size_t(aKey) >= mKeys.size() )
+		return false;
+
+	return mKeys.test( std::size_t(aKey) );
+}
+
+std::size_t InputQueue::dropped() const noexcept
+{
+	return mDropped.load( std::memory_order_relaxed );
+}
+
+void InputQueue::push_( InputEvent const& aEvent ) noexcept
+{
+	if( !mQueue.try_push( aEvent ) )
+		mDropped.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void InputQueue::update_keys_( InputEvent const& aEvent ) noexcept
+{
+	if( InputEventType::key != aEvent.type )
+		return;
+
+	// GLFW_KEY_UNKNOWN is -1
+	if( aEvent.key < 0 || std::size_t(aEvent.key) >= mKeys.size() )
+		return;
+
+	if( GLFW_PRESS == aEvent.action )
+		mKeys.set( std::size_t(aEvent.key) );
+	else if( GLFW_RELEASE == aEvent.action )
+		mKeys.reset( std::size_t(aEvent.key) );
+}
@@ -0,0 +1,84 @@
+#ifndef INPUT_HPP_16768CA9_6EC3_4061_AB30_DF46896E66D3
+#define INPUT_HPP_16768CA9_6EC3_4061_AB30_DF46896E66D3
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+#include "defaults.hpp"
+#include "spsc_ring.hpp"
+
+enum class InputEventType : std::uint8_t
+{
+	key,
+	cursor
+};
+
+struct InputEvent
+{
+	Clock::time_point time;
+	InputEventType type;
+
+	// InputEventType::key
+	int key, action, mods;
+
+	// InputEventType::cursor
+	double x, y;
+};
+
+using KeySet = std::bitset<GLFW_KEY_LAST+1>;
+
+/* Input event queue
+ *
+ * The GLFW callbacks only timestamp the event and push it into a lock-free
+ * ring; no I/O or other work happens on the event path. The main loop calls
+ * consume() once per frame, which drains the queue, updates the key state
+ * snapshot and hands each event to a handler (e.g. the camera controller).
+ *
+ * Key state is read from the snapshot via keys(), instead of calling
+ * glfwGetKey() for each event.
+ *
+ * If the queue overflows (the frame loop stalls for a long time), new events
+ * are dropped and counted.
+ */
+class InputQueue final
+{
+	public:
+		static constexpr std::size_t kCapacity = 1024;
+
+	public:
+		InputQueue() = default;
+
+		InputQueue( InputQueue const& ) = delete;
+		InputQueue& operator= (InputQueue const&) = delete;
+
+	public:
+		// Producer side (GLFW callbacks)
+		void push_key( int aKey, int aAction, int aMods ) noexcept;
+		void push_cursor( double aX, double aY ) noexcept;
+
+		// Consumer side (main loop). Returns the number of events processed.
+		template< typename tHandler >
+		std::size_t consume( tHandler&& aHandler );
+
+		KeySet const& keys() const noexcept;
+		bool key( int aKey ) const noexcept;
+
+		std::size_t dropped() const noexcept;
+
+	private:
+		void push_( InputEvent const& ) noexcept;
+		void update_keys_( InputEvent const& ) noexcept;
+
+	private:
+		SpscRing<InputEvent, kCapacity> mQueue;
+		KeySet mKeys;
+
+		std::atomic<std::size_t> mDropped{ 0 };
+};
+
+#include "input.inl"
+#endif // INPUT_HPP_16768CA9_6EC3_4061_AB30_DF46896E66D3
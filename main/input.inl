@@ -0,0 +1,15 @@
+template< typename tHandler > inline
+std::size_t InputQueue::consume( tHandler&& aHandler )
+{
+	std::size_t count = 0;
+
+	InputEvent event;
+	while( mQueue.try_pop( event ) )
+	{
+		update_keys_( event );
+		aHandler( static_cast<InputEvent const&>(event) );
+		++count;
+	}
+
+	return count;
+}
@@ -0,0 +1,162 @@
+#include "loadobj.hpp"
+
+#include <filesystem>
+#include <string_view>
+
+#include <rapidobj/rapidobj.hpp>
+
+#include "../support/error.hpp"
+#include "../support/asset_store.hpp"
+
+namespace
+{
+	// File name from the first "mtllib" statement before the first face, or
+	// empty if there is none.
+	std::string_view find_mtllib_( std::string_view aObj );
+}
+
+ObjModel load_wavefront_obj( char const* aPath )
+{
+	auto const basePath = std::filesystem::path( aPath ).parent_path();
+
+	// rapidobj reads the OBJ itself (block-wise, in parallel for large
+	// files). The material library is handed to it as text straight from a
+	// mapping, rather than read into a buffer by rapidobj. Only the head of
+	// the OBJ is touched to find the library's name. If that fails, rapidobj
+	// looks for the library as before. The library may come from the asset
+	// archive; the OBJ is always a loose file, as rapidobj opens it by path.
+	FileMapping const obj( aPath, FileMapping::Access::random );
+	auto const mtllib = find_mtllib_( obj.text() );
+
+	AssetData mtl;
+	if( auto const mtlPath = (basePath / mtllib).string(); !mtllib.empty() && (asset_in_archive( mtlPath ) || std::filesystem::is_regular_file( mtlPath )) )
+		mtl = open_asset( mtlPath.c_str() );
+
+	// Ask rapidobj to load the requested file
+	auto result = mtl.empty()
+		? rapidobj::ParseFile( aPath )
+		: rapidobj::ParseFile( aPath, rapidobj::MaterialLibrary::String( mtl.text() ) )
+	;
+	if( result.error )
+		throw Error( "Unable to load OBJ file '%s': %s", aPath, result.error.code.message().c_str() );
+
+	// OBJ files can define faces that are not triangles. However, OpenGL will
+	// only render triangles (and lines and points), so we must triangulate any
+	// faces that are not already triangles. Fortunately, rapidobj can do this
+	// for us.
+	rapidobj::Triangulate( result );
+
+	ObjModel ret;
+
+	// Materials. Texture paths in the .mtl are relative to the OBJ file.
+	for( auto const& mat : result.materials )
+	{
+		MaterialDesc desc;
+		desc.name = mat.name;
+		desc.diffuse = Vec3f{ mat.diffuse[0], mat.diffuse[1], mat.diffuse[2] };
+		desc.specular = Vec3f{ mat.specular[0], mat.specular[1], mat.specular[2] };
+		desc.emissive = Vec3f{ mat.emission[0], mat.emission[1], mat.emission[2] };
+		desc.shininess = mat.shininess;
+
+		if( !mat.diffuse_texname.empty() )
+			desc.diffuseTexture = (basePath / mat.diffuse_texname).generic_string();
+
+		ret.materials.emplace_back( std::move(desc) );
+	}
+
+	// Convert the OBJ data into a SimpleMeshData structure. For now, we simply
+	// turn the object into a triangle soup, ignoring the indexing information
+	// that the OBJ file contains.
+	auto& mesh = ret.mesh;
+	for( auto const& shape : result.shapes )
+	{
+		for( std::size_t i = 0; i < shape.mesh.indices.size(); ++i )
+		{
+			auto const& idx = shape.mesh.indices[i];
+
+			mesh.positions.emplace_back( Vec3f{
+				result.attributes.positions[idx.position_index*3+0],
+				result.attributes.positions[idx.position_index*3+1],
+				result.attributes.positions[idx.position_index*3+2]
+			} );
+
+			if( idx.normal_index >= 0 )
+			{
+				mesh.normals.emplace_back( Vec3f{
+					result.attributes.normals[idx.normal_index*3+0],
+					result.attributes.normals[idx.normal_index*3+1],
+					result.attributes.normals[idx.normal_index*3+2]
+				} );
+			}
+			else
+			{
+				mesh.normals.emplace_back( Vec3f{ 0.f, 1.f, 0.f } );
+			}
+
+			if( idx.texcoord_index >= 0 )
+			{
+				mesh.texcoords.emplace_back( Vec2f{
+					result.attributes.texcoords[idx.texcoord_index*2+0],
+					result.attributes.texcoords[idx.texcoord_index*2+1]
+				} );
+			}
+			else
+			{
+				mesh.texcoords.emplace_back( Vec2f{ 0.f, 0.f } );
+			}
+
+			// Always triangles, so we can find the face index by dividing the
+			// vertex index by three
+			std::int32_t material = 0;
+			if( !shape.mesh.material_ids.empty() )
+				material = shape.mesh.material_ids[i/3];
+
+			mesh.materials.emplace_back( std::uint32_t(material < 0 ? 0 : material) );
+		}
+	}
+
+	return ret;
+}
+
+void offset_material_ids( SimpleMeshData& aMesh, std::uint32_t aOffset )
+{
+	for( auto& mat : aMesh.materials )
+		mat += aOffset;
+}
+
+namespace
+{
+	std::string_view find_mtllib_( std::string_view aObj )
+	{
+		constexpr std::string_view kMtllib = "mtllib";
+		constexpr std::string_view kSpace = " \t";
+
+		while( !aObj.empty() )
+		{
+			auto const eol = aObj.find_first_of( "\r\n" );
+			auto line = aObj.substr( 0, eol );
+			aObj.remove_prefix( std::string_view::npos == eol ? aObj.size() : eol+1 );
+
+			auto const first = line.find_first_not_of( kSpace );
+			if( std::string_view::npos == first )
+				continue;
+			line.remove_prefix( first );
+
+			if( 'f' == line[0] && line.size() > 1 && kSpace.find( line[1] ) != std::string_view::npos )
+				break;
+
+			if( line.substr( 0, kMtllib.size() ) != kMtllib || line.size() == kMtllib.size() || kSpace.find( line[kMtllib.size()] ) == std::string_view::npos )
+				continue;
+
+			line.remove_prefix( kMtllib.size() );
+			auto const begin = line.find_first_not_of( kSpace );
+			if( std::string_view::npos == begin )
+				continue;
+
+			line.remove_prefix( begin );
+			return line.substr( 0, line.find_last_not_of( kSpace ) + 1 );
+		}
+
+		return {};
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef LOADOBJ_HPP_DEDDBC3D_EF95_4A1D_9DAE_79F71BD67C7A
+#define LOADOBJ_HPP_DEDDBC3D_EF95_4A1D_9DAE_79F71BD67C7A
+
+#include <vector>
+
+#include "material.hpp"
+#include "simple_mesh.hpp"
+
+struct ObjModel
+{
+	SimpleMeshData mesh;                 // material IDs index into materials
+	std::vector<MaterialDesc> materials; // from the referenced .mtl file
+};
+
+// Load a Wavefront OBJ file (and its materials). Faces are triangulated.
+// Texture paths in the materials are made relative to the working directory.
+ObjModel load_wavefront_obj( char const* aPath );
+
+// Shift the model's material IDs, e.g., by the value returned from
+// MaterialSystem::add_materials().
+void offset_material_ids( SimpleMeshData&, std::uint32_t aOffset );
+
+#endif // LOADOBJ_HPP_DEDDBC3D_EF95_4A1D_9DAE_79F71BD67C7A
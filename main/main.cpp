@@ -1,21 +1,48 @@
 #include <glad.h>
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+#include <memory>
+#include <iterator>
+#include <limits>
+#include <optional>
 #include <typeinfo>
+#include <algorithm>
+#include <filesystem>
 #include <stdexcept>
 
+#include <cmath>
 #include <cstdio>
+#include <cstdint>
 #include <cstdlib>
 
 #include "../support/error.hpp"
-#include "../support/program.hpp"
-#include "../support/checkpoint.hpp"
-#include "../support/debug_output.hpp"
+#include "../support/asset_store.hpp"
+#include "../support/alloc_counter.hpp"
+
+#include "../jobs/job_system.hpp"
 
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/mat44.hpp"
 
+#include "input.hpp"
+#include "camera.hpp"
 #include "defaults.hpp"
+#include "loadobj.hpp"
+#include "options.hpp"
+#include "simple_mesh.hpp"
+#include "mesh_residency.hpp"
+#include "terrain_normals.hpp"
+#include "fixed_step.hpp"
+#include "frame_pacer.hpp"
+#include "camera_path.hpp"
+#include "frame_stats.hpp"
+#include "renderer.hpp"
+#include "clustered_lights.hpp"
+#include "async_log.hpp"
+#include "cpu_profiler.hpp"
+#include "asset_load_benchmark.hpp"
+#include "text_renderer.hpp"
 
 #include "rapidobj/rapidobj.hpp"
 
@@ -25,12 +52,60 @@
 namespace
 {
 	constexpr char const* kWindowTitle = "COMP3811 - CW2";
+
+	constexpr float kPi_ = 3.1415926f;
+
+	constexpr float kNearPlane_ = 0.1f;
+	constexpr float kFarPlane_ = 100.f; // without reverse-Z
 	
 	void glfw_callback_error_( int, char const* );
 
 	void glfw_callback_key_( GLFWwindow*, int, int, int, int );
 
-	void glfw_callback_cursor_(GLFWwindow*, double, double);
+	void glfw_callback_cursor_( GLFWwindow*, double, double );
+
+
+	// With --trace, skip this many frames (startup) before capturing
+	constexpr std::size_t kTraceStartFrame_ = 60;
+
+	// With --headless or --replay: frames rendered (at the start of the
+	// camera path) before measuring, and the simulated time per frame (the
+	// camera path does not depend on the frame rate).
+	constexpr std::size_t kWarmupFrames_ = 60;
+	constexpr float kFixedFrameTime_ = 1.f / 60.f;
+
+	// With --replay: frames rendered (at the end of the path) after the
+	// last measured frame, so that its GPU times are collected. GPU results
+	// lag up to GpuProfiler::kFrameLatency frames behind, plus the frames
+	// queued in the renderer's pipeline.
+	constexpr std::size_t kReplayTailFrames_ = 8;
+
+	// With --light-benchmark: light counts, each measured with clustered
+	// and naive lighting (in that order). Each configuration is drawn for
+	// kLightBenchmarkSettleFrames_ frames before measuring
+	// kLightBenchmarkFrames_ frames. The benchmark ends with
+	// kReplayTailFrames_ frames, for the same reason as --replay.
+	constexpr std::size_t kLightBenchmarkCounts_[] = { 16, 64, 256, 1024, 4096 };
+	constexpr std::size_t kLightBenchmarkSteps_ = 2 * std::size(kLightBenchmarkCounts_);
+	constexpr std::size_t kLightBenchmarkSettleFrames_ = 10;
+	constexpr std::size_t kLightBenchmarkFrames_ = 60;
+
+	static_assert( kLightBenchmarkCounts_[std::size(kLightBenchmarkCounts_)-1] <= kMaxLights );
+
+	// Grid points per side of the terrain heightfield, at most
+	constexpr std::uint32_t kTerrainHeightfieldMaxSize_ = 2048;
+
+	// Configuration drawn in aFrame (index into the benchmark steps)
+	std::size_t light_benchmark_step_( std::size_t aFrame ) noexcept;
+
+	// Fill aLights with aCount lights circling the landing pads at aTime.
+	// The lights only depend on their index and the time.
+	void animate_lights_( std::vector<LightItem>& aLights, std::size_t aCount, Vec3f const* aPads, std::size_t aPadCount, float aTime );
+
+	float to_ms_( Clock::duration aDuration )
+	{
+		return std::chrono::duration_cast<Secondsf>(aDuration).count() * 1000.f;
+	}
 
 	struct GLFWCleanupHelper
 	{
@@ -43,14 +118,85 @@ namespace
 	};
 }
 
-int main() try
+int main( int aArgc, char* aArgv[] ) try
 {
+	Options options;
+	if( !parse_options( aArgc, aArgv, options ) )
+		return 0;
+
+	if( options.profilerBenchmark )
+	{
+		profiler_run_overhead_benchmark();
+		return 0;
+	}
+
+	if( options.loadBenchmark )
+	{
+		run_asset_load_benchmark( "assets" );
+		return 0;
+	}
+
+	// Mount the asset archive before anything is loaded. Compressed entries
+	// are unpacked up front on a temporary job system; its threads are done
+	// once the archive is mounted.
+	if( auto const& archive = options.assetArchive; !archive.empty() )
+	{
+		if( std::filesystem::is_regular_file( archive ) )
+		{
+			JobSystem jobs;
+			auto const stats = mount_asset_archive( archive.c_str(), jobs );
+
+			std::printf( "Asset archive '%s': %zu entries (%zu compressed), %.1f KiB, unpacked %.1f KiB in %.1f ms on %zu threads\n",
+				archive.c_str(),
+				stats.entries, stats.unpacked,
+				stats.archiveBytes / 1024.0,
+				stats.unpackedBytes / 1024.0,
+				stats.unpackMs,
+				stats.threads
+			);
+		}
+		else if( archive != kDefaultAssetArchive )
+		{
+			throw Error( "Asset archive '%s' does not exist", archive.c_str() );
+		}
+	}
+
+	PROFILE_THREAD_NAME( "main" );
+
+	if( options.lightBenchmark && !options.replayPath.empty() )
+		throw Error( "--light-benchmark and --replay cannot be combined" );
+
+	// Load the camera path first, so that a bad file is reported before
+	// opening a window.
+	std::optional<CameraPath> replay;
+	if( !options.replayPath.empty() )
+	{
+		replay.emplace( load_camera_path( options.replayPath.c_str() ) );
+		std::printf( "Replaying '%s': %.2f s (%zu poses, %zu input events)\n", options.replayPath.c_str(), replay->duration(), replay->pose_count(), replay->events().size() );
+	}
+
 	// Initialize GLFW
+	bool nullPlatform = false;
 	if( GLFW_TRUE != glfwInit() )
 	{
 		char const* msg = nullptr;
 		int ecode = glfwGetError( &msg );
-		throw Error( "glfwInit() failed with '%s' (%d)", msg, ecode );
+
+		if( !options.headless )
+			throw Error( "glfwInit() failed with '%s' (%d)", msg, ecode );
+
+		// No display. Headless runs fall back to GLFW's null platform, with
+		// an OSMesa (software) context.
+		std::fprintf( stderr, "glfwInit() failed with '%s' (%d); trying the null platform\n", msg, ecode );
+
+		glfwInitHint( GLFW_PLATFORM, GLFW_PLATFORM_NULL );
+		if( GLFW_TRUE != glfwInit() )
+		{
+			ecode = glfwGetError( &msg );
+			throw Error( "glfwInit() (null platform) failed with '%s' (%d)", msg, ecode );
+		}
+
+		nullPlatform = true;
 	}
 
 	// Ensure that we call glfwTerminate() at the end of the program.
@@ -69,18 +215,33 @@ int main() try
 	glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE );
 	glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
 
-	glfwWindowHint( GLFW_DEPTH_BITS, 24 );
+	// With a float depth buffer, the renderer draws into its own framebuffer
+	// object; the window does not need a depth buffer then.
+	glfwWindowHint( GLFW_DEPTH_BITS, (options.floatDepth || options.headless) ? 0 : 24 );
 
-#	if !defined(NDEBUG)
-	// When building in debug mode, request an OpenGL debug context. This
-	// enables additional debugging features. However, this can carry extra
-	// overheads. We therefore do not do this for release builds.
-	glfwWindowHint( GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE );
-#	endif // ~ !NDEBUG
+	// With GL validation enabled (the default in debug builds), request an
+	// OpenGL debug context. This enables additional debugging features.
+	// However, this can carry extra overheads, so it is off by default in
+	// release builds.
+	if( GlValidation::off != options.glValidation )
+		glfwWindowHint( GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE );
+
+	// Headless: the window only provides the context; rendering goes to an
+	// offscreen framebuffer.
+	if( options.headless )
+		glfwWindowHint( GLFW_VISIBLE, GLFW_FALSE );
+
+	// OSMesa does not support forward-compatible contexts (only required on
+	// macOS anyway).
+	if( nullPlatform )
+	{
+		glfwWindowHint( GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API );
+		glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GLFW_FALSE );
+	}
 
 	GLFWwindow* window = glfwCreateWindow(
-		1280,
-		720,
+		options.headless ? options.width : 1280,
+		options.headless ? options.height : 720,
 		kWindowTitle,
 		nullptr, nullptr
 	);
@@ -95,97 +256,659 @@ int main() try
 	GLFWWindowDeleter windowDeleter{ window };
 
 	// Set up event handling
-	// TODO1: Additional event handling setup :done!
+	// The callbacks only push timestamped events into the input queue. The
+	// queue is drained once per frame in the main loop.
+	InputQueue input;
+	glfwSetWindowUserPointer( window, &input );
+
 	glfwSetKeyCallback( window, &glfw_callback_key_ );
-	glfwSetCursorPosCallback(window, &glfw_callback_cursor_);
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);  
-	// Set up drawing stuff
-	glfwMakeContextCurrent( window );
-	glfwSwapInterval( 1 ); // V-Sync is on.
+	glfwSetCursorPosCallback( window, &glfw_callback_cursor_ );
 
-	// Initialize GLAD
-	// This will load the OpenGL API. We mustn't make any OpenGL calls before this!
-	if( !gladLoadGLLoader( (GLADloadproc)&glfwGetProcAddress ) )
-		throw Error( "gladLoaDGLLoader() failed - cannot load GL API!" );
+	if( !options.headless )
+		glfwSetInputMode( window, GLFW_CURSOR, GLFW_CURSOR_DISABLED );
 
-	std::printf( "RENDERER %s\n", glGetString( GL_RENDERER ) );
-	std::printf( "VENDOR %s\n", glGetString( GL_VENDOR ) );
-	std::printf( "VERSION %s\n", glGetString( GL_VERSION ) );
-	std::printf( "SHADING_LANGUAGE_VERSION %s\n", glGetString( GL_SHADING_LANGUAGE_VERSION ) );
+	AsyncLog log;
+	if( options.logInput )
+		log.start();
 
-	// Ddebug output
-#	if !defined(NDEBUG)
-	setup_gl_debug_output();
-#	endif // ~ !NDEBUG
+	// Load models. This only touches the CPU; the render thread creates the
+	// GL resources.
+	auto terrain = load_wavefront_obj( "assets/parlahti.obj" );
+	auto landingPad = load_wavefront_obj( "assets/landingpad.obj" );
 
-	// Global GL state
-	OGL_CHECKPOINT_ALWAYS();
+	// One material table for all models
+	std::vector<MaterialDesc> materials;
+	for( auto* model : { &terrain, &landingPad } )
+	{
+		offset_material_ids( model->mesh, std::uint32_t(materials.size()) );
+		materials.insert( materials.end(), model->materials.begin(), model->materials.end() );
+	}
 
-	// TODO2: global GL setup goes here 
+	// With GPU normals, the terrain is drawn without the OBJ's normals; the
+	// render thread fills them from the heightfield when it uploads the
+	// terrain (or one of its tiles).
+	std::shared_ptr<Heightfield const> terrainHeightfield;
+	if( options.terrainGpuNormals )
+	{
+		auto const start = Clock::now();
+		terrainHeightfield = std::make_shared<Heightfield const>( make_heightfield( terrain.mesh.positions, kTerrainHeightfieldMaxSize_ ) );
+		std::printf( "Terrain heightfield: %ux%u grid points (spacing %g x %g) in %.1f ms; normals generated on the GPU\n",
+			terrainHeightfield->columns, terrainHeightfield->rows,
+			double(terrainHeightfield->spacingX), double(terrainHeightfield->spacingZ),
+			double(to_ms_( Clock::now() - start ))
+		);
 
-	OGL_CHECKPOINT_ALWAYS();
+		terrain.mesh.normals.clear();
+		terrain.mesh.normals.shrink_to_fit();
+	}
 
-	// Get actual framebuffer size.
-	// This can be different from the window size, as standard window
-	// decorations (title bar, borders, ...) may be included in the window size
-	// but not be part of the drawable surface area.
-	int iwidth, iheight;
-	glfwGetFramebufferSize( window, &iwidth, &iheight );
+	// Meshes are uploaded when first drawn, and may be evicted again (see
+	// MeshResidency); their loaders copy from the CPU data kept here. The
+	// terrain is optionally split into tiles, which are only drawn within
+	// the stream distance. The last mesh is the landing pad.
+	auto const terrainTiles = std::make_shared<std::vector<SimpleMeshData> const>( options.terrainTileSize > 0.f
+		? split_mesh_tiles( terrain.mesh, options.terrainTileSize )
+		: std::vector<SimpleMeshData>{ std::move(terrain.mesh) }
+	);
+	auto const landingPadMesh = std::make_shared<SimpleMeshData const>( std::move(landingPad.mesh) );
 
-	glViewport( 0, 0, iwidth, iheight );
+	std::vector<MeshAsset> meshes;
+	for( std::size_t i = 0; i < terrainTiles->size(); ++i )
+	{
+		auto const& tile = (*terrainTiles)[i];
+		meshes.emplace_back( MeshAsset{ mesh_bounds( tile ), vertex_bytes( tile ), [terrainTiles, i] { return (*terrainTiles)[i]; } } );
+	}
 
-	// Other initialization & loading
-	OGL_CHECKPOINT_ALWAYS();
-	
-	// TODO3: global GL setup goes here
+	auto const landingPadId = std::uint32_t(meshes.size());
+	meshes.emplace_back( MeshAsset{ mesh_bounds( *landingPadMesh ), vertex_bytes( *landingPadMesh ), [landingPadMesh] { return *landingPadMesh; } } );
+
+	std::vector<BoundingSphere> tileBounds;
+	for( std::size_t i = 0; i < terrainTiles->size(); ++i )
+		tileBounds.emplace_back( meshes[i].bounds );
+
+	if( terrainTiles->size() > 1 )
+		std::printf( "Terrain: %zu tiles of %g units%s\n", terrainTiles->size(), double(options.terrainTileSize), options.streamDistance > 0.f ? "" : " (no stream distance; all are drawn)" );
+
+	Vec3f const landingPads[] = {
+		{ -20.f, -0.97f, 15.f },
+		{ 10.f, -0.97f, -40.f }
+	};
+	Mat44f const landingPadWorld[] = {
+		make_translation( landingPads[0] ),
+		make_translation( landingPads[1] )
+	};
+
+	// Headless benchmark length (without --replay)
+	std::size_t const headlessEnd = options.lightBenchmark
+		? kWarmupFrames_ + kLightBenchmarkSteps_ * (kLightBenchmarkSettleFrames_ + kLightBenchmarkFrames_) + kReplayTailFrames_
+		: kWarmupFrames_ + options.benchmarkFrames
+	;
+
+	// Start the render thread. It takes over the GL context; from here on,
+	// this thread only handles events and simulation.
+	Renderer::Config renderConfig;
+	renderConfig.pipelineDepth = options.pipelineDepth;
+	renderConfig.maxFramesInFlight = options.framesInFlight;
+	renderConfig.swapInterval = (options.textBenchmark || options.headless) ? 0 : options.swapInterval; // V-Sync is on by default (except when benchmarking).
+	renderConfig.gpuProfile = options.gpuProfile;
+	renderConfig.validation = options.glValidation;
+	renderConfig.captureDirectory = options.captureDirectory;
+	renderConfig.recordFrameTimes = replay || options.lightBenchmark;
+	renderConfig.expectedFrames = (options.headless && !replay) ? headlessEnd : 0;
+	renderConfig.reverseZ = options.reverseZ;
+	renderConfig.floatDepth = options.floatDepth;
+	renderConfig.shadows = options.shadows;
+	renderConfig.shadowResolution = options.shadowResolution;
+	renderConfig.shadowDistance = options.shadowDistance;
+	renderConfig.depthPrepass = options.depthPrepass;
+	renderConfig.sortFrontToBack = options.sortDraws;
+	renderConfig.dynamicResolution = options.dynamicResolution;
+	renderConfig.minResolutionScale = options.minResolutionScale;
+	renderConfig.maxResolutionScale = options.maxResolutionScale;
+	renderConfig.gpuBudgetMs = options.gpuBudgetMs;
+	renderConfig.meshBudgetBytes = std::uint64_t(options.vramBudgetMiB) * 1024*1024;
+	renderConfig.virtualTextureMinSize = options.virtualTextureMinSize;
+	renderConfig.virtualTextureCachePages = options.virtualTextureCachePages;
+	renderConfig.terrainHeightfield = std::move(terrainHeightfield);
+
+	if( !options.captureFrames.empty() )
+		std::filesystem::create_directories( options.captureDirectory );
+
+	if( options.headless )
+	{
+		renderConfig.offscreenWidth = options.width;
+		renderConfig.offscreenHeight = options.height;
+	}
+
+	Renderer renderer( window, std::move(materials), std::move(meshes), renderConfig );
+
+	// Simulation state. The simulation runs at a fixed rate; rendering
+	// interpolates between the previous and the current state.
+	Camera camera, prevCamera;
+	CameraController cameraControl;
 
-	OGL_CHECKPOINT_ALWAYS();
+	FixedStep stepper( Secondsf( 1.f / options.simulationRate ), options.maxSimulationSteps );
+
+	// Scripted camera (headless benchmark or replay): fixed time per frame,
+	// no camera controls. The path holds its first pose during the warm-up.
+	bool const scripted = options.headless || replay;
+	float pathTime = 0.f;
+
+	if( scripted )
+		camera = prevCamera = replay ? replay->sample( 0.f ) : camera_orbit( 0.f );
+
+	std::optional<CameraPath> recording;
+	if( !options.recordPath.empty() )
+	{
+		recording.emplace( stepper.step().count() );
+		recording->add_pose( camera );
+	}
+
+	InputPacer inputPacer( options.jitInput );
 
 	// Main loop
+	auto last = Clock::now();
+	std::size_t frame = 0;
+
+	float mainMs = 0.f, mainWaitMs = 0.f;
+
+	// Drives the light animation
+	float simulationTime = 0.f;
+
+	BenchmarkReport report;
+	report.renderer = renderer.gl_renderer();
+	report.width = options.width;
+	report.height = options.height;
+	report.warmupFrames = kWarmupFrames_;
+
+	// Reserved up front, so that the measured frames do not allocate.
+	// (The light benchmark measures more than benchmarkFrames.)
+	std::size_t const measuredFrames = headlessEnd - kWarmupFrames_;
+	report.frameMs.reserve( measuredFrames );
+	report.mainMs.reserve( measuredFrames );
+	report.renderMs.reserve( measuredFrames );
+	report.latencyMs.reserve( measuredFrames );
+
+	// Heap allocations on this thread after the warm-up (headless, without
+	// --replay). The loop should not allocate once all buffers have grown.
+	std::uint64_t steadyAllocations = 0;
+	std::size_t allocatingFrames = 0, firstAllocatingFrame = 0;
+
+	// Render thread count (Renderer::Timings) at the end of the warm-up
+	std::uint64_t renderWarmAllocations = 0;
+
+	// Replay state. replayEnd is the frame that reached the end of the path.
+	std::vector<ReplayFrame> replayFrames;
+	std::optional<std::size_t> replayEnd;
+
 	while( !glfwWindowShouldClose( window ) )
 	{
+		if( replay && replayEnd && frame > *replayEnd + kReplayTailFrames_ )
+			break;
+		if( options.headless && !replay && frame >= headlessEnd )
+			break;
+
+		if( !options.tracePath.empty() )
+		{
+			if( kTraceStartFrame_ == frame )
+				profiler_begin_capture();
+
+			if( kTraceStartFrame_ + options.traceFrames == frame )
+			{
+				profiler_end_capture();
+				profiler_write_chrome_trace( options.tracePath.c_str() );
+				std::printf( "Wrote %zu frames of trace to '%s' (%zu events dropped)\n", options.traceFrames, options.tracePath.c_str(), profiler_dropped_events() );
+			}
+		}
+
+		PROFILE_SCOPE( "frame" );
+
+		auto const frameAllocations = thread_heap_allocations();
+
+		// Just-in-time input: sleep here rather than in acquire() below.
+		{
+			PROFILE_SCOPE( "input pacing" );
+			inputPacer.sleep_before_input();
+		}
+
+		auto const frameStart = Clock::now();
+
 		// Let GLFW process events
-		glfwPollEvents();
+		{
+			PROFILE_SCOPE( "poll events" );
+			glfwPollEvents();
+		}
+
+		auto const inputTime = Clock::now();
 		
 		// Check if window was resized.
-		float fbwidth, fbheight;
+		int nwidth, nheight;
+		glfwGetFramebufferSize( window, &nwidth, &nheight );
+
+		if( options.headless )
+		{
+			nwidth = options.width;
+			nheight = options.height;
+		}
+		else if( 0 == nwidth || 0 == nheight )
 		{
-			int nwidth, nheight;
-			glfwGetFramebufferSize( window, &nwidth, &nheight );
+			// Window minimized? Pause until it is unminimized.
+			// This is a bit of a hack.
+			do
+			{
+				glfwWaitEvents();
+				glfwGetFramebufferSize( window, &nwidth, &nheight );
+			} while( 0 == nwidth || 0 == nheight );
+		}
 
-			fbwidth = float(nwidth);
-			fbheight = float(nheight);
+		float const fbwidth = float(nwidth);
+		float const fbheight = float(nheight);
 
-			if( 0 == nwidth || 0 == nheight )
-			{
-				// Window minimized? Pause until it is unminimized.
-				// This is a bit of a hack.
-				do
+		// Update state
+		//TODO4: update state
+		auto const now = Clock::now();
+		float const dt = std::chrono::duration_cast<Secondsf>(now-last).count();
+		last = now;
+
+		{
+			PROFILE_SCOPE( "input" );
+
+			input.consume( [&] (InputEvent const& aEvent) {
+				if( InputEventType::key == aEvent.type && GLFW_PRESS == aEvent.action )
+				{
+					// Space toggles mouse control
+					if( GLFW_KEY_SPACE == aEvent.key )
+					{
+						cameraControl.mouseEnabled = !cameraControl.mouseEnabled;
+						cameraControl.reset_mouse();
+						glfwSetInputMode( window, GLFW_CURSOR, cameraControl.mouseEnabled ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL );
+						log.log( "Mouse control %s", cameraControl.mouseEnabled ? "enabled" : "disabled" );
+					}
+					else
+					{
+						log.log( "Key %d pressed (mods %#x)", aEvent.key, unsigned(aEvent.mods) );
+					}
+				}
+				else if( InputEventType::key == aEvent.type && GLFW_RELEASE == aEvent.action )
 				{
-					glfwWaitEvents();
-					glfwGetFramebufferSize( window, &nwidth, &nheight );
-				} while( 0 == nwidth || 0 == nheight );
+					log.log( "Key %d released", aEvent.key );
+				}
+
+				if( recording )
+					recording->add_event( aEvent );
+
+				if( !scripted )
+					cameraControl.handle_event( camera, aEvent );
+			} );
+		}
+
+		// Mouse look is applied immediately rather than at the simulation
+		// rate, so that it isn't delayed by interpolation.
+		prevCamera.yaw = camera.yaw;
+		prevCamera.pitch = camera.pitch;
+
+		std::size_t const steps = stepper.advance( Secondsf( scripted ? kFixedFrameTime_ : dt ) );
+		for( std::size_t i = 0; i < steps; ++i )
+		{
+			PROFILE_SCOPE( "simulation step" );
+
+			prevCamera = camera;
+			simulationTime += stepper.step().count();
+
+			if( scripted )
+			{
+				// The light benchmark keeps the camera still, so that all
+				// configurations see the same view.
+				if( frame >= kWarmupFrames_ && !options.lightBenchmark )
+					pathTime += stepper.step().count();
+
+				camera = replay ? replay->sample( pathTime ) : camera_orbit( pathTime );
+			}
+			else
+			{
+				cameraControl.update( camera, input.keys(), stepper.step().count() );
 			}
 
-			glViewport( 0, 0, nwidth, nheight );
+			if( recording )
+				recording->add_pose( camera );
 		}
 
-		// Update state
-		//TODO4: update state
+		// Accumulated step lengths are not exact; allow for half a step.
+		if( replay && !replayEnd && pathTime >= replay->duration() - 0.5f * stepper.step().count() )
+			replayEnd = frame;
+
+		Camera const view = interpolate( prevCamera, camera, stepper.alpha() );
 
-		// Draw scene
-		OGL_CHECKPOINT_DEBUG();
+		// Reverse-Z with a float depth buffer has enough precision for an
+		// infinite far plane.
+		Mat44f const projection = renderer.reverse_z()
+			? make_infinite_reverse_z_projection( 60.f * kPi_ / 180.f, fbwidth / fbheight, kNearPlane_ )
+			: make_perspective_projection( 60.f * kPi_ / 180.f, fbwidth / fbheight, kNearPlane_, kFarPlane_ )
+		;
 
-		//TODO5: draw frame
+		// Build the frame packet. This blocks if the render thread is more
+		// than the pipeline depth behind.
+		auto const waitStart = Clock::now();
+		FramePacket& packet = renderer.acquire();
+		auto const waitEnd = Clock::now();
+
+		packet.frame = frame;
+		packet.inputTime = inputTime;
+		packet.framebufferWidth = nwidth;
+		packet.framebufferHeight = nheight;
+
+		packet.projection = projection;
+		packet.nearPlane = kNearPlane_;
+		packet.farPlane = renderer.reverse_z() ? std::numeric_limits<float>::infinity() : kFarPlane_;
+		packet.worldToCamera = camera_world_to_view( view );
+		packet.cameraPosition = view.position;
+		packet.cameraForward = camera_forward( view );
+
+		packet.lightDir = normalize( Vec3f{ 0.f, 1.f, -1.f } );
+
+		// Terrain tiles within the stream distance (nearest point of their
+		// bounds). Room for all of them up front: the list is allocated
+		// from the packet's arena, where growing would waste the old
+		// storage.
+		packet.draws.reserve( tileBounds.size() + std::size(landingPadWorld) );
+
+		for( std::size_t i = 0; i < tileBounds.size(); ++i )
+		{
+			if( options.streamDistance > 0.f && length( tileBounds[i].center - view.position ) - tileBounds[i].radius > options.streamDistance )
+				continue;
+
+			packet.draws.emplace_back( DrawItem{ std::uint32_t(i), kIdentity44f } );
+		}
 
-		OGL_CHECKPOINT_DEBUG();
+		for( auto const& world : landingPadWorld )
+			packet.draws.emplace_back( DrawItem{ landingPadId, world } );
 
-		// Display results
-		glfwSwapBuffers( window );
+		std::size_t lightCount = options.lights;
+		packet.lightCulling = options.clusteredLights ? LightCulling::clustered : LightCulling::naive;
+
+		if( options.lightBenchmark )
+		{
+			std::size_t const step = light_benchmark_step_( frame );
+			lightCount = kLightBenchmarkCounts_[step / 2];
+			packet.lightCulling = 0 == step % 2 ? LightCulling::clustered : LightCulling::naive;
+		}
+
+		// Room for the most lights this run uses, so that the packets do not
+		// grow (and allocate) when --light-benchmark raises the count.
+		packet.lights.reserve( options.lightBenchmark ? kLightBenchmarkCounts_[std::size(kLightBenchmarkCounts_)-1] : options.lights );
+
+		animate_lights_( packet.lights, lightCount, landingPads, std::size(landingPads), simulationTime );
+
+		packet.capture = std::binary_search( options.captureFrames.begin(), options.captureFrames.end(), frame );
+
+		// Overlay. Left out of captured frames (below), since it shows timings.
+		auto const renderTimings = renderer.timings();
+
+		inputPacer.record( to_ms_( waitEnd - waitStart ), renderTimings.waitMs );
+
+		packet.text.clear();
+
+		TextItem& hud = packet.text.emplace_back();
+		hud = TextItem{ 10.f, 10.f, 20.f, text_rgba( 255, 255, 0 ), {} };
+		std::snprintf( hud.text, sizeof(hud.text), "%.2f ms (%.0f FPS), %zu sim steps", dt * 1000.f, dt > 0.f ? 1.f / dt : 0.f, steps );
+
+		TextItem& threads = packet.text.emplace_back();
+		threads = TextItem{ 10.f, 32.f, 16.f, text_rgba( 255, 255, 0 ), {} };
+		std::snprintf( threads.text, sizeof(threads.text), "main %.2f ms (+%.2f wait), render %.2f ms (+%.2f swap, %.2f wait)",
+			mainMs, mainWaitMs,
+			renderTimings.renderMs, renderTimings.swapMs, renderTimings.waitMs
+		);
+
+		TextItem& pacing = packet.text.emplace_back();
+		pacing = TextItem{ 10.f, 50.f, 16.f, text_rgba( 255, 255, 0 ), {} };
+		std::snprintf( pacing.text, sizeof(pacing.text), "latency %.2f ms (input to GPU done), GPU wait %.2f ms, input sleep %.2f ms",
+			renderTimings.latencyMs, renderTimings.fenceMs, inputPacer.sleep_ms()
+		);
+
+		float hudY = 68.f;
+
+		if( GlValidation::off != options.glValidation )
+		{
+			TextItem& gl = packet.text.emplace_back();
+			gl = TextItem{ 10.f, hudY, 16.f, text_rgba( 255, 255, 0 ), {} };
+			hudY += 18.f;
+			std::snprintf( gl.text, sizeof(gl.text), "GL validation %s: %zu messages (%zu perf, %zu suppressed)",
+				gl_validation_name( options.glValidation ),
+				renderTimings.gl.messages, renderTimings.gl.performance, renderTimings.gl.suppressed
+			);
+		}
+
+		if( options.shadows )
+		{
+			static_assert( 4 == kShadowCascades && 2 == ShadowCascades::kFirstCachedCascade, "Update the HUD" );
+			auto const& sh = renderTimings.shadows;
+
+			TextItem& shadows = packet.text.emplace_back();
+			shadows = TextItem{ 10.f, hudY, 16.f, text_rgba( 255, 255, 0 ), {} };
+			std::snprintf( shadows.text, sizeof(shadows.text), "shadows: casters %zu/%zu/%zu/%zu, rendered %c%c%c%c, cached re-renders %zu/%zu",
+				sh.casters[0], sh.casters[1], sh.casters[2], sh.casters[3],
+				sh.rendered[0] ? '+' : '-', sh.rendered[1] ? '+' : '-', sh.rendered[2] ? '+' : '-', sh.rendered[3] ? '+' : '-',
+				sh.renders[2], sh.renders[3]
+			);
+			hudY += 18.f;
+		}
+
+		if( options.dynamicResolution )
+		{
+			TextItem& resolution = packet.text.emplace_back();
+			resolution = TextItem{ 10.f, hudY, 16.f, text_rgba( 255, 255, 0 ), {} };
+			std::snprintf( resolution.text, sizeof(resolution.text), "resolution: %.2f (%dx%d of %dx%d), GPU budget %.1f ms",
+				renderTimings.resolutionScale,
+				renderTimings.sceneWidth, renderTimings.sceneHeight,
+				nwidth, nheight,
+				options.gpuBudgetMs
+			);
+			hudY += 18.f;
+		}
+
+		if( renderTimings.shadingFragments > 0 && renderTimings.sceneWidth > 0 )
+		{
+			float const pixels = float(renderTimings.sceneWidth) * float(renderTimings.sceneHeight);
+
+			TextItem& fragments = packet.text.emplace_back();
+			fragments = TextItem{ 10.f, hudY, 16.f, text_rgba( 255, 255, 0 ), {} };
+			std::snprintf( fragments.text, sizeof(fragments.text), "fragments: %s%.2f/px shaded (%.2f/px pre-pass)",
+				options.depthPrepass ? "pre-pass, " : "",
+				float(renderTimings.shadingFragments) / pixels,
+				float(renderTimings.prepassFragments) / pixels
+			);
+			hudY += 18.f;
+		}
+
+		if( auto const& res = renderTimings.residency; res.meshes > 1 || 0 != res.budgetBytes )
+		{
+			TextItem& residency = packet.text.emplace_back();
+			residency = TextItem{ 10.f, hudY, 16.f, text_rgba( 255, 255, 0 ), {} };
+			std::snprintf( residency.text, sizeof(residency.text), "meshes: %zu/%zu resident, %.1f MiB GPU (+%.1f textures, budget %.0f), %zu loading, +%zu -%zu",
+				res.resident, res.meshes,
+				res.gpuBytes / (1024.0*1024.0),
+				res.pinnedBytes / (1024.0*1024.0),
+				res.budgetBytes / (1024.0*1024.0),
+				res.loading,
+				res.totalLoads, res.totalEvictions
+			);
+			hudY += 18.f;
+		}
+
+		if( auto const& vt = renderTimings.virtualTexture; vt.pages > 0 )
+		{
+			TextItem& virtualTexture = packet.text.emplace_back();
+			virtualTexture = TextItem{ 10.f, hudY, 16.f, text_rgba( 255, 255, 0 ), {} };
+			std::snprintf( virtualTexture.text, sizeof(virtualTexture.text), "virtual texture: %zu/%zu pages, %zu tiles requested (%zu missing), %zu loading, +%zu -%zu",
+				vt.residentPages, vt.pages,
+				vt.requested, vt.missing,
+				vt.loading,
+				vt.totalUploads, vt.totalEvictions
+			);
+			hudY += 18.f;
+		}
+
+		if( !packet.lights.empty() )
+		{
+			TextItem& lights = packet.text.emplace_back();
+			lights = TextItem{ 10.f, hudY, 16.f, text_rgba( 255, 255, 0 ), {} };
+			std::snprintf( lights.text, sizeof(lights.text), "lights: %zu (%s)",
+				packet.lights.size(),
+				LightCulling::clustered == packet.lightCulling ? "clustered" : "naive"
+			);
+			hudY += 18.f;
+		}
+
+		packet.textBenchmark = options.textBenchmark;
+
+		if( packet.capture )
+		{
+			packet.text.clear();
+			packet.textBenchmark = false;
+		}
+
+		renderer.submit();
+
+		// CPU time of this thread, excluding time blocked on the renderer
+		auto const frameEnd = Clock::now();
+		mainWaitMs = to_ms_( waitEnd - waitStart );
+		mainMs = to_ms_( frameEnd - frameStart ) - mainWaitMs;
+
+		if( replay && frame >= kWarmupFrames_ && (!replayEnd || frame <= *replayEnd) )
+		{
+			// Render times are filled in from Renderer::frame_times() at the end
+			replayFrames.emplace_back( ReplayFrame{ frame, pathTime, view, dt * 1000.f, mainMs, -1.f, -1.f } );
+		}
+		else if( options.headless && !replay && frame >= kWarmupFrames_ )
+		{
+			report.frameMs.push_back( dt * 1000.f );
+			report.mainMs.push_back( mainMs );
+			report.renderMs.push_back( renderTimings.renderMs );
+			report.latencyMs.push_back( renderTimings.latencyMs );
+		}
+
+		if( options.headless && !replay && frame >= kWarmupFrames_ )
+		{
+			if( kWarmupFrames_ == frame )
+				renderWarmAllocations = renderTimings.heapAllocations;
+
+			if( auto const count = thread_heap_allocations() - frameAllocations )
+			{
+				if( 0 == steadyAllocations )
+					firstAllocatingFrame = frame;
+
+				steadyAllocations += count;
+				++allocatingFrames;
+			}
+		}
+
+		++frame;
+	}
+
+	if( recording )
+	{
+		save_camera_path( options.recordPath.c_str(), *recording );
+		std::printf( "Recorded %.2f s of camera path (%zu poses, %zu input events) to '%s'\n", recording->duration(), recording->pose_count(), recording->events().size(), options.recordPath.c_str() );
+	}
+
+	if( replay )
+	{
+		// Both are ordered by frame.
+		auto const times = renderer.frame_times();
+		auto it = times.begin();
+		for( auto& row : replayFrames )
+		{
+			while( times.end() != it && it->frame < row.frame )
+				++it;
+
+			if( times.end() != it && it->frame == row.frame )
+			{
+				row.renderMs = it->renderMs;
+				row.gpuMs = it->gpuMs;
+			}
+		}
+
+		write_replay_csv( options.replayReportPath.c_str(), replayFrames );
+
+		std::vector<float> frameMs;
+		for( auto const& row : replayFrames )
+			frameMs.push_back( row.frameMs );
+
+		auto const summary = summarize_timings( frameMs );
+		std::printf( "Replay: %zu frames, frame time mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f (written to '%s')\n",
+			summary.count,
+			summary.mean, summary.p50, summary.p95, summary.p99,
+			options.replayReportPath.c_str()
+		);
+		print_slowest_frames( stdout, replayFrames, 5 );
+	}
+	else if( options.lightBenchmark )
+	{
+		// GPU time of the whole frame (shadows, light culling, scene and
+		// overlay), averaged over the measured frames of each step.
+		double gpuMs[kLightBenchmarkSteps_] = {};
+		std::size_t gpuFrames[kLightBenchmarkSteps_] = {};
+
+		for( auto const& times : renderer.frame_times() )
+		{
+			if( times.frame < kWarmupFrames_ || times.gpuMs < 0.f )
+				continue;
+
+			std::size_t const step = light_benchmark_step_( times.frame );
+			std::size_t const offset = (times.frame - kWarmupFrames_) % (kLightBenchmarkSettleFrames_ + kLightBenchmarkFrames_);
+			if( times.frame >= headlessEnd - kReplayTailFrames_ || offset < kLightBenchmarkSettleFrames_ )
+				continue;
+
+			gpuMs[step] += times.gpuMs;
+			++gpuFrames[step];
+		}
+
+		std::printf( "Light benchmark: %dx%d, GPU ms per frame (mean of %zu frames)\n", options.width, options.height, kLightBenchmarkFrames_ );
+		std::printf( "  %6s %10s %10s %8s\n", "lights", "clustered", "naive", "speedup" );
+		for( std::size_t i = 0; i < std::size(kLightBenchmarkCounts_); ++i )
+		{
+			auto const mean = [&] (std::size_t aStep) {
+				return gpuFrames[aStep] ? gpuMs[aStep] / double(gpuFrames[aStep]) : -1.0;
+			};
+
+			double const clustered = mean( 2*i ), naive = mean( 2*i+1 );
+			if( clustered > 0.0 && naive > 0.0 )
+				std::printf( "  %6zu %10.3f %10.3f %7.2fx\n", kLightBenchmarkCounts_[i], clustered, naive, naive / clustered );
+			else
+				std::printf( "  %6zu %10s %10s %8s\n", kLightBenchmarkCounts_[i], "n/a", "n/a", "" );
+		}
+	}
+	else if( options.headless )
+	{
+		write_benchmark_json( options.statsPath.c_str(), report );
+
+		auto const summary = summarize_timings( report.frameMs );
+		std::printf( "Headless: %zu frames at %dx%d, frame time mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f (written to '%s')\n",
+			summary.count, options.width, options.height,
+			summary.mean, summary.p50, summary.p95, summary.p99,
+			options.statsPath.c_str()
+		);
+	}
+
+	if( options.headless && !replay )
+	{
+		// The render thread count lags by the pipeline depth; close enough.
+		auto const renderAllocations = renderer.timings().heapAllocations - renderWarmAllocations;
+
+		std::printf( "Main loop heap allocations after warm-up: %llu in %zu frames (render thread: %llu)\n", (unsigned long long)steadyAllocations, allocatingFrames, (unsigned long long)renderAllocations );
+
+		if( options.checkAllocations && steadyAllocations )
+			throw Error( "--check-allocations: the main loop allocated %llu times after the warm-up (first in frame %zu)", (unsigned long long)steadyAllocations, firstAllocatingFrame );
+		if( options.checkAllocations && renderAllocations )
+			throw Error( "--check-allocations: the render thread allocated %llu times after the warm-up", (unsigned long long)renderAllocations );
 	}
 
 	// Cleanup.
 	//TODO6: additional cleanup
+	glfwSetWindowUserPointer( window, nullptr );
+
+	if( auto const dropped = input.dropped() )
+		std::fprintf( stderr, "Input queue overflowed: %zu events dropped\n", dropped );
 	
 	return 0;
 }
@@ -200,103 +923,99 @@ catch( std::exception const& eErr )
 
 namespace
 {
-	// add params
-	float lastX = 640.0f;  // (1280/2)
-	float lastY = 360.0f;  // (720/2)
-	bool firstMouse = true;
-	bool mouseEnabled = false;  // enable indicator
-
 	void glfw_callback_error_( int aErrNum, char const* aErrDesc )
 	{
 		std::fprintf( stderr, "GLFW error: %s (%d)\n", aErrDesc, aErrNum );
 	}
 
-	void glfw_callback_key_(GLFWwindow* aWindow, int aKey, int, int aAction, int)
+	void glfw_callback_key_( GLFWwindow* aWindow, int aKey, int, int aAction, int aMods )
 	{
-		if (GLFW_KEY_ESCAPE == aKey && GLFW_PRESS == aAction)
+		if( GLFW_KEY_ESCAPE == aKey && GLFW_PRESS == aAction )
 		{
-			glfwSetWindowShouldClose(aWindow, GLFW_TRUE);
+			glfwSetWindowShouldClose( aWindow, GLFW_TRUE );
 			return;
 		}
 
-		// ոлģʽ
-		if (GLFW_KEY_SPACE == aKey && GLFW_PRESS == aAction)
-		{
-			mouseEnabled = !mouseEnabled;
-			if (mouseEnabled)
-			{
-				glfwSetInputMode(aWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-				std::printf("Mouse control enabled\n");
-			}
-			else
-			{
-				glfwSetInputMode(aWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-				std::printf("Mouse control disabled\n");
-			}
-			firstMouse = true;  // ״̬
-			return;
-		}
-		// speed
-		float speedModifier = 1.0f;
-		if (glfwGetKey(aWindow, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-		{
-			speedModifier = 2.0f;  // 2x
-			std::printf("Speed up (x2)\n");
-		}
-		if (glfwGetKey(aWindow, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
-		{
-			speedModifier = 0.5f;  // 0.5x
-			std::printf("Speed down (x0.5)\n");
-		}
+		if( auto* input = static_cast<InputQueue*>(glfwGetWindowUserPointer( aWindow )) )
+			input->push_key( aKey, aAction, aMods );
+	}
 
-		// WSADQE control
-		if (aAction == GLFW_PRESS || aAction == GLFW_REPEAT)
-		{
-			switch (aKey)
-			{
-			case GLFW_KEY_W:
-				std::printf("Moving forward\n");
-				break;
-			case GLFW_KEY_S:
-				std::printf("Moving backward\n");
-				break;
-			case GLFW_KEY_A:
-				std::printf("Moving left\n");
-				break;
-			case GLFW_KEY_D:
-				std::printf("Moving right\n");
-				break;
-			case GLFW_KEY_E:
-				std::printf("Moving up\n");
-				break;
-			case GLFW_KEY_Q:
-				std::printf("Moving down\n");
-				break;
-			}
-		}
+	void glfw_callback_cursor_( GLFWwindow* aWindow, double aX, double aY )
+	{
+		if( auto* input = static_cast<InputQueue*>(glfwGetWindowUserPointer( aWindow )) )
+			input->push_cursor( aX, aY );
 	}
-	
-	// callback func
-	void glfw_callback_cursor_(GLFWwindow* window, double xpos, double ypos)
+}
+
+namespace
+{
+	std::size_t light_benchmark_step_( std::size_t aFrame ) noexcept
 	{
-		if (!mouseEnabled) return;  // δ򲻴
-		if (firstMouse)
-		{
-			lastX = xpos;
-			lastY = ypos;
-			firstMouse = false;
-			return;
-		}
+		if( aFrame < kWarmupFrames_ )
+			return 0;
 
-		float xoffset = xpos - lastX;
-		float yoffset = lastY - ypos;
-		lastX = xpos;
-		lastY = ypos;
+		std::size_t const step = (aFrame - kWarmupFrames_) / (kLightBenchmarkSettleFrames_ + kLightBenchmarkFrames_);
+		return std::min( step, kLightBenchmarkSteps_-1 );
+	}
 
-		std::printf("Mouse moved - X offset: %.1f, Y offset: %.1f\n", xoffset, yoffset);
+	// Uniform in [0,1), from a light index and a per-property channel
+	float light_random_( std::uint32_t aIndex, std::uint32_t aChannel ) noexcept
+	{
+		std::uint32_t h = aIndex * 0x9e3779b9u + aChannel * 0x85ebca6bu;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return float(h >> 8) * (1.f / 16777216.f);
 	}
 
+	void animate_lights_( std::vector<LightItem>& aLights, std::size_t aCount, Vec3f const* aPads, std::size_t aPadCount, float aTime )
+	{
+		aLights.clear();
+
+		for( std::size_t i = 0; i < aCount; ++i )
+		{
+			auto const index = std::uint32_t(i);
+			Vec3f const pad = aPads[i % aPadCount];
+
+			// Orbits around the pad, denser close to it
+			float const radius = 2.f + 38.f * light_random_( index, 0 ) * light_random_( index, 1 );
+			float const speed = 0.8f * (light_random_( index, 2 ) - 0.5f); // radians per second
+			float const angle = 2.f * kPi_ * light_random_( index, 3 ) + speed * aTime;
+			float const height = 0.5f + 3.5f * light_random_( index, 4 );
+
+			// Fully saturated hue
+			float const hue = 6.f * light_random_( index, 5 );
+			Vec3f const color{
+				std::clamp( std::abs( hue - 3.f ) - 1.f, 0.f, 1.f ),
+				std::clamp( 2.f - std::abs( hue - 2.f ), 0.f, 1.f ),
+				std::clamp( 2.f - std::abs( hue - 4.f ), 0.f, 1.f )
+			};
 
+			LightItem& light = aLights.emplace_back();
+			light.position = pad + Vec3f{ radius * std::cos( angle ), height, radius * std::sin( angle ) };
+			light.color = 2.f * color;
+
+			// Every fourth light is a spot light, pointing down and towards
+			// the pad.
+			if( 3 == i % 4 )
+			{
+				Vec3f const towardsPad = normalize( Vec3f{ pad.x - light.position.x, 0.f, pad.z - light.position.z } );
+				light.range = 6.f + 6.f * light_random_( index, 6 );
+				light.direction = normalize( Vec3f{ 0.f, -1.f, 0.f } + 0.5f * towardsPad );
+				light.spotCosInner = 0.9f;
+				light.spotCosOuter = 0.75f;
+			}
+			else
+			{
+				light.range = 3.f + 5.f * light_random_( index, 6 );
+				light.direction = Vec3f{ 0.f, -1.f, 0.f };
+				light.spotCosInner = -1.f;
+				light.spotCosOuter = -1.f;
+			}
+		}
+	}
 }
 
 namespace
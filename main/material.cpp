@@ -0,0 +1,342 @@
+#include "material.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <system_error>
+
+#include <cstdio>
+#include <cassert>
+
+#include <stb_image.h>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+#include "../support/asset_store.hpp"
+
+#include "texture_cache.hpp"
+#include "virtual_texture.hpp"
+
+namespace
+{
+	// std430 layout; must match "struct Material" in the shaders
+	struct MaterialGpu_
+	{
+		float diffuse[4];       // rgb: Kd
+		float specular[4];      // rgb: Ks, a: Ns
+		float emissive[4];      // rgb: Ke
+		std::int32_t texture[4]; // x: array (-1 = none, -2 = virtual), y: layer
+	};
+
+	static_assert( sizeof(MaterialGpu_) == 64, "Unexpected padding in MaterialGpu_" );
+
+	constexpr std::int32_t kVirtualArray_ = -2;
+
+	struct ArrayKey_
+	{
+		GLenum internalFormat;
+		std::uint32_t width, height, levels;
+
+		bool operator== (ArrayKey_ const& aOther) const noexcept
+		{
+			return internalFormat == aOther.internalFormat
+				&& width == aOther.width
+				&& height == aOther.height
+				&& levels == aOther.levels
+			;
+		}
+	};
+
+	struct TextureArray_
+	{
+		ArrayKey_ key;
+		std::vector<std::string> sources; // one per layer
+		std::vector<std::string> caches;  // empty if uncompressed
+	};
+
+	std::uint32_t mip_count_( std::uint32_t aWidth, std::uint32_t aHeight ) noexcept
+	{
+		std::uint32_t levels = 1;
+		while( aWidth > 1 || aHeight > 1 )
+		{
+			aWidth = std::max( 1u, aWidth/2 );
+			aHeight = std::max( 1u, aHeight/2 );
+			++levels;
+		}
+		return levels;
+	}
+
+	void upload_rgba_layer_( char const* aSourcePath, ArrayKey_ const& aKey, GLint aLayer )
+	{
+		stbi_set_flip_vertically_on_load( true );
+
+		auto const file = open_asset( aSourcePath );
+
+		int w, h, channels;
+		stbi_uc* ptr = stbi_load_from_memory( file.data(), int(file.size()), &w, &h, &channels, 4 );
+		if( !ptr )
+			throw Error( "Unable to load image '%s'", aSourcePath );
+
+		glTexSubImage3D( GL_TEXTURE_2D_ARRAY, 0, 0, 0, aLayer, GLsizei(aKey.width), GLsizei(aKey.height), 1, GL_RGBA, GL_UNSIGNED_BYTE, ptr );
+
+		stbi_image_free( ptr );
+	}
+
+	bool asset_exists_( std::string const& aPath )
+	{
+		std::error_code ec;
+		return asset_in_archive( aPath ) || std::filesystem::exists( aPath, ec );
+	}
+
+	bool is_virtual_( std::string const& aSourcePath, MaterialSystem::VirtualConfig const& aConfig )
+	{
+		if( 0 == aConfig.minSize )
+			return false;
+
+		// Only the tiles may be shipped.
+		if( !asset_exists_( aSourcePath ) )
+			return asset_exists_( virtual_texture_path( aSourcePath.c_str() ) );
+
+		// Only the header is read.
+		auto const file = open_asset( aSourcePath.c_str(), FileMapping::Access::random );
+
+		int w, h, channels;
+		if( !stbi_info_from_memory( file.data(), int(file.size()), &w, &h, &channels ) )
+			throw Error( "Unable to load image '%s'", aSourcePath.c_str() );
+
+		return std::uint32_t(std::max( w, h )) >= aConfig.minSize;
+	}
+}
+
+MaterialSystem::MaterialSystem()
+	: mBuffer( 0 )
+	, mStats{}
+{}
+
+MaterialSystem::~MaterialSystem()
+{
+	if( !mTextureArrays.empty() )
+		glDeleteTextures( GLsizei(mTextureArrays.size()), mTextureArrays.data() );
+	if( 0 != mBuffer )
+		glDeleteBuffers( 1, &mBuffer );
+}
+
+std::uint32_t MaterialSystem::add_materials( std::vector<MaterialDesc> const& aMaterials )
+{
+	assert( 0 == mBuffer ); // must be called before finalize()
+
+	auto const first = std::uint32_t(mMaterials.size());
+	mMaterials.insert( mMaterials.end(), aMaterials.begin(), aMaterials.end() );
+	return first;
+}
+
+void MaterialSystem::finalize( VirtualConfig const& aVirtual, JobSystem& aLoaders )
+{
+	assert( 0 == mBuffer );
+
+	bool const compressed = texture_cache_supported();
+
+	// Group distinct textures by size and format. Each group becomes one
+	// texture array.
+	std::vector<TextureArray_> arrays;
+	std::unordered_map<std::string, std::pair<std::int32_t,std::int32_t>> layers;
+
+	std::string virtualSource;
+
+	for( auto const& mat : mMaterials )
+	{
+		if( mat.diffuseTexture.empty() || layers.count( mat.diffuseTexture ) )
+			continue;
+
+		if( is_virtual_( mat.diffuseTexture, aVirtual ) )
+		{
+			if( !virtualSource.empty() )
+				throw Error( "MaterialSystem: more than one virtual texture ('%s', '%s')", virtualSource.c_str(), mat.diffuseTexture.c_str() );
+
+			virtualSource = mat.diffuseTexture;
+			layers[mat.diffuseTexture] = { kVirtualArray_, 0 };
+			continue;
+		}
+
+		ArrayKey_ key{};
+		std::string cache;
+		if( compressed )
+		{
+			cache = ensure_texture_cache( mat.diffuseTexture.c_str() );
+
+			auto const info = query_texture_cache( cache.c_str() );
+			key = ArrayKey_{ info.internalFormat, info.width, info.height, info.levels };
+		}
+		else
+		{
+			// Only the header is read.
+			auto const file = open_asset( mat.diffuseTexture.c_str(), FileMapping::Access::random );
+
+			int w, h, channels;
+			if( !stbi_info_from_memory( file.data(), int(file.size()), &w, &h, &channels ) )
+				throw Error( "Unable to load image '%s'", mat.diffuseTexture.c_str() );
+
+			key = ArrayKey_{ GL_SRGB8_ALPHA8, std::uint32_t(w), std::uint32_t(h), mip_count_( w, h ) };
+		}
+
+		auto it = std::find_if( arrays.begin(), arrays.end(), [&key] (TextureArray_ const& aArr) {
+			return aArr.key == key;
+		} );
+
+		if( arrays.end() == it )
+		{
+			if( arrays.size() == kMaxTextureArrays )
+				throw Error( "MaterialSystem: more than %zu distinct texture sizes/formats", kMaxTextureArrays );
+
+			arrays.emplace_back( TextureArray_{ key, {}, {} } );
+			it = arrays.end()-1;
+		}
+
+		layers[mat.diffuseTexture] = { std::int32_t(it - arrays.begin()), std::int32_t(it->sources.size()) };
+		it->sources.emplace_back( mat.diffuseTexture );
+		it->caches.emplace_back( std::move(cache) );
+	}
+
+	// Create arrays and upload layers
+	mTextureArrays.resize( arrays.size() );
+	if( !arrays.empty() )
+		glGenTextures( GLsizei(mTextureArrays.size()), mTextureArrays.data() );
+
+	std::uint64_t textureBytes = 0;
+	for( std::size_t i = 0; i < arrays.size(); ++i )
+	{
+		auto const& arr = arrays[i];
+
+		glBindTexture( GL_TEXTURE_2D_ARRAY, mTextureArrays[i] );
+		glTexStorage3D( GL_TEXTURE_2D_ARRAY, GLsizei(arr.key.levels), arr.key.internalFormat, GLsizei(arr.key.width), GLsizei(arr.key.height), GLsizei(arr.sources.size()) );
+
+		for( std::size_t layer = 0; layer < arr.sources.size(); ++layer )
+		{
+			if( compressed )
+				upload_texture_cache_layer( arr.caches[layer].c_str(), GLint(layer) );
+			else
+				upload_rgba_layer_( arr.sources[layer].c_str(), arr.key, GLint(layer) );
+		}
+
+		if( !compressed )
+			glGenerateMipmap( GL_TEXTURE_2D_ARRAY );
+
+		// GPU memory, for residency budgets
+		for( std::uint32_t level = 0; level < arr.key.levels; ++level )
+		{
+			if( compressed )
+			{
+				GLint bytes = 0;
+				glGetTexLevelParameteriv( GL_TEXTURE_2D_ARRAY, GLint(level), GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes );
+				textureBytes += std::uint64_t(bytes);
+			}
+			else
+			{
+				auto const w = std::max( 1u, arr.key.width >> level ), h = std::max( 1u, arr.key.height >> level );
+				textureBytes += std::uint64_t(w) * h * 4 * arr.sources.size();
+			}
+		}
+
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	}
+
+	glBindTexture( GL_TEXTURE_2D_ARRAY, 0 );
+
+	if( !virtualSource.empty() )
+	{
+		auto const tiles = ensure_virtual_texture( virtualSource.c_str(), aLoaders );
+		mVirtual = std::make_unique<VirtualTexture>( tiles.c_str(), aVirtual.cachePages, aLoaders );
+
+		auto const& file = mVirtual->file();
+		auto const& stats = mVirtual->stats();
+		std::printf( "Virtual texture '%s': %ux%u, %u levels, %zu tiles of %u texels; cache %zux%zu pages (%.1f MiB)\n",
+			tiles.c_str(),
+			file.width(), file.height(), file.level_count(),
+			stats.tiles, file.tile_size(),
+			mVirtual->cache_pages(), mVirtual->cache_pages(),
+			stats.cacheBytes / (1024.0*1024.0)
+		);
+
+		textureBytes += stats.cacheBytes;
+	}
+
+	// Material table
+	std::vector<MaterialGpu_> table;
+	table.reserve( mMaterials.size() );
+
+	std::size_t textured = 0;
+	for( auto const& mat : mMaterials )
+	{
+		MaterialGpu_ gpu{
+			{ mat.diffuse.x, mat.diffuse.y, mat.diffuse.z, 1.f },
+			{ mat.specular.x, mat.specular.y, mat.specular.z, mat.shininess },
+			{ mat.emissive.x, mat.emissive.y, mat.emissive.z, 0.f },
+			{ -1, 0, 0, 0 }
+		};
+
+		if( !mat.diffuseTexture.empty() )
+		{
+			auto const& slot = layers[mat.diffuseTexture];
+			gpu.texture[0] = slot.first;
+			gpu.texture[1] = slot.second;
+			++textured;
+		}
+
+		table.emplace_back( gpu );
+	}
+
+	// An empty SSBO can't be bound; keep a dummy entry in that case.
+	if( table.empty() )
+		table.emplace_back( MaterialGpu_{ { 1.f, 1.f, 1.f, 1.f }, {}, {}, { -1, 0, 0, 0 } } );
+
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mBuffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, table.size() * sizeof(MaterialGpu_), table.data(), GL_STATIC_DRAW );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	OGL_CHECKPOINT_DEBUG();
+
+	mStats.materials = mMaterials.size();
+	mStats.texturedMaterials = textured;
+	mStats.textures = layers.size();
+	mStats.textureArrays = arrays.size();
+	mStats.textureBytes = textureBytes;
+	mStats.bindsPerFramePerMaterial = textured;
+	mStats.bindsPerFrame = arrays.size() + (mVirtual ? 1 : 0);
+
+	std::printf( "Materials: %zu (%zu textured), %zu textures in %zu array(s); texture binds per frame: %zu -> %zu (%zu eliminated)\n",
+		mStats.materials, mStats.texturedMaterials,
+		mStats.textures, mStats.textureArrays,
+		mStats.bindsPerFramePerMaterial, mStats.bindsPerFrame,
+		mStats.bindsPerFramePerMaterial - std::min( mStats.bindsPerFramePerMaterial, mStats.bindsPerFrame )
+	);
+}
+
+void MaterialSystem::bind() const
+{
+	assert( 0 != mBuffer );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kMaterialBufferBinding, mBuffer );
+
+	for( std::size_t i = 0; i < mTextureArrays.size(); ++i )
+	{
+		glActiveTexture( GLenum(GL_TEXTURE0 + kMaterialTextureUnit + i) );
+		glBindTexture( GL_TEXTURE_2D_ARRAY, mTextureArrays[i] );
+	}
+
+	if( mVirtual )
+		mVirtual->bind();
+}
+
+MaterialSystem::Stats const& MaterialSystem::stats() const noexcept
+{
+	return mStats;
+}
+
+VirtualTexture* MaterialSystem::virtual_texture() const noexcept
+{
+	return mVirtual.get();
+}
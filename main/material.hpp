@@ -0,0 +1,108 @@
+#ifndef MATERIAL_HPP_AE16BF18_032E_4D26_ACEB_312D3D8B4B58
+#define MATERIAL_HPP_AE16BF18_032E_4D26_ACEB_312D3D8B4B58
+
+#include <glad.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "../vmlib/vec3.hpp"
+
+class JobSystem;
+class VirtualTexture;
+
+// Material parameters, as parsed from a .mtl file
+struct MaterialDesc
+{
+	std::string name;
+
+	Vec3f diffuse{ 1.f, 1.f, 1.f };  // Kd
+	Vec3f specular{ 0.f, 0.f, 0.f }; // Ks
+	Vec3f emissive{ 0.f, 0.f, 0.f }; // Ke
+	float shininess = 1.f;           // Ns
+
+	std::string diffuseTexture;      // map_Kd (path relative to working dir)
+};
+
+/* Material system
+ *
+ * All materials live in a single table in a shader storage buffer, and all
+ * diffuse textures are packed into GL_TEXTURE_2D_ARRAY layers (one array per
+ * distinct size/format). Shaders index the table by a per-vertex material ID
+ * and pick the texture layer from the material. The arrays and the buffer are
+ * bound once per frame, independently of how many materials are in use.
+ *
+ * Shader interface (see assets/default.frag):
+ *   layout( std430, binding = kMaterialBufferBinding ) buffer Materials
+ *   layout( binding = kMaterialTextureUnit+i ) uniform sampler2DArray ...
+ *
+ * A texture at least VirtualConfig::minSize texels wide or high does not
+ * go into an array; it is tiled (ensure_virtual_texture()) and drawn from a
+ * VirtualTexture instead, which bind() binds as well. So is a texture whose
+ * source is missing but whose tiles exist. At most one texture per scene can
+ * be virtual.
+ *
+ * Usage: add materials (add_materials() returns the ID of the first one,
+ * which is the offset to apply to the mesh's local material indices), then
+ * call finalize() once with a current GL context.
+ */
+class MaterialSystem final
+{
+	public:
+		static constexpr GLuint kMaterialBufferBinding = 0;
+		static constexpr GLuint kMaterialTextureUnit = 0;
+		static constexpr std::size_t kMaxTextureArrays = 4;
+
+		struct Stats
+		{
+			std::size_t materials;
+			std::size_t texturedMaterials;
+			std::size_t textures;
+			std::size_t textureArrays;
+			std::uint64_t textureBytes; // all arrays, all levels
+
+			// Texture binds per frame with one bind per textured material vs.
+			// binding the arrays once.
+			std::size_t bindsPerFramePerMaterial;
+			std::size_t bindsPerFrame;
+		};
+
+		struct VirtualConfig
+		{
+			std::uint32_t minSize;  // 0: no virtual textures
+			std::size_t cachePages; // per side, see VirtualTexture
+		};
+
+	public:
+		MaterialSystem();
+		~MaterialSystem();
+
+		MaterialSystem( MaterialSystem const& ) = delete;
+		MaterialSystem& operator= (MaterialSystem const&) = delete;
+
+	public:
+		std::uint32_t add_materials( std::vector<MaterialDesc> const& );
+
+		// The virtual texture (if any) is tiled and read on aLoaders.
+		void finalize( VirtualConfig const&, JobSystem& aLoaders );
+
+		void bind() const;
+
+		Stats const& stats() const noexcept;
+
+		// Null if no texture is virtual
+		VirtualTexture* virtual_texture() const noexcept;
+
+	private:
+		std::vector<MaterialDesc> mMaterials;
+
+		GLuint mBuffer;
+		std::vector<GLuint> mTextureArrays;
+		std::unique_ptr<VirtualTexture> mVirtual;
+
+		Stats mStats;
+};
+
+#endif // MATERIAL_HPP_AE16BF18_032E_4D26_ACEB_312D3D8B4B58
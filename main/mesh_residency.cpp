@@ -0,0 +1,246 @@
+#include "mesh_residency.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "cpu_profiler.hpp"
+
+MeshResidency::MeshResidency( std::vector<MeshAsset> aAssets, std::uint64_t aBudgetBytes, std::uint64_t aMaxUploadBytes, JobSystem& aLoaders )
+	: mJobs( aLoaders )
+	, mBudgetBytes( aBudgetBytes )
+	, mMaxUploadBytes( aMaxUploadBytes )
+	, mSourceBytes( 0 )
+	, mFrame( 0 )
+	, mStats{}
+{
+	for( auto& asset : aAssets )
+	{
+		assert( asset.load );
+
+		GpuMesh mesh;
+		mesh.boundsCenter = asset.bounds.center;
+		mesh.boundsRadius = asset.bounds.radius;
+		mMeshes.emplace_back( mesh );
+
+		mSourceBytes += asset.sourceBytes;
+
+		auto& slot = mSlots.emplace_back();
+		slot.asset = std::move(asset);
+		slot.job = LoadJob_{ &slot };
+	}
+
+	// Sized for the worst case, so that frames do not allocate.
+	mPending.reserve( mSlots.size() );
+	mCandidates.reserve( mSlots.size() );
+	mUploaded.reserve( mSlots.size() );
+
+	mStats.budgetBytes = mBudgetBytes;
+	mStats.meshes = mSlots.size();
+	mStats.cpuBytes = mSourceBytes;
+}
+
+MeshResidency::~MeshResidency()
+{
+	for( std::size_t i = 0; i < mSlots.size(); ++i )
+	{
+		auto& slot = mSlots[i];
+		mJobs.wait( slot.done );
+
+		if( State_::resident == slot.state )
+			destroy_gpu_mesh( mMeshes[i] );
+	}
+}
+
+void MeshResidency::begin_frame( std::size_t aFrame )
+{
+	PROFILE_SCOPE( "residency upload" );
+
+	mFrame = aFrame;
+
+	mStats.requested = 0;
+	mStats.missing = 0;
+	mStats.uploaded = 0;
+	mStats.uploadedBytes = 0;
+	mUploaded.clear();
+
+	// Finished loaders, in request order. Later ones wait for the next
+	// frame once the upload limit is reached.
+	std::size_t kept = 0;
+	for( std::size_t i = 0; i < mPending.size(); ++i )
+	{
+		auto const index = mPending[i];
+		auto& slot = mSlots[index];
+
+		if( State_::loading == slot.state && slot.done.done() )
+		{
+			if( slot.error )
+				std::rethrow_exception( slot.error );
+
+			slot.state = State_::loaded;
+			slot.loadedBytes = vertex_bytes( slot.data );
+		}
+
+		bool const mayUpload = 0 == mStats.uploaded || mStats.uploadedBytes + slot.loadedBytes <= mMaxUploadBytes;
+		if( State_::loaded == slot.state && mayUpload )
+		{
+			upload_( slot, index );
+			continue;
+		}
+
+		mPending[kept++] = index;
+	}
+	mPending.resize( kept );
+
+	// Loaded but not yet uploaded meshes hold CPU memory.
+	mStats.cpuBytes = mSourceBytes;
+	mStats.loading = mPending.size();
+	for( auto const index : mPending )
+		mStats.cpuBytes += mSlots[index].loadedBytes;
+}
+
+bool MeshResidency::request( std::uint32_t aMesh )
+{
+	assert( aMesh < mSlots.size() );
+	auto& slot = mSlots[aMesh];
+
+	bool const first = slot.lastUsed != mFrame || State_::unloaded == slot.state;
+	slot.lastUsed = mFrame;
+
+	if( State_::unloaded == slot.state )
+	{
+		slot.state = State_::loading;
+		slot.error = nullptr;
+		mJobs.parallel_for( 1, 1, slot.job, slot.done );
+		mPending.emplace_back( aMesh );
+		++mStats.loading;
+	}
+
+	bool const resident = State_::resident == slot.state;
+	if( first )
+	{
+		++mStats.requested;
+		mStats.missing += resident ? 0 : 1;
+	}
+
+	return resident;
+}
+
+void MeshResidency::end_frame()
+{
+	PROFILE_SCOPE( "residency evict" );
+
+	mStats.evicted = 0;
+	mStats.evictedBytes = 0;
+
+	if( 0 != mBudgetBytes && mStats.gpuBytes + mStats.pinnedBytes > mBudgetBytes )
+	{
+		// Least recently requested first; never what this frame used.
+		mCandidates.clear();
+		for( std::size_t i = 0; i < mSlots.size(); ++i )
+		{
+			auto const& slot = mSlots[i];
+			if( State_::resident == slot.state && slot.lastUsed != mFrame )
+				mCandidates.emplace_back( std::uint32_t(i) );
+		}
+
+		std::sort( mCandidates.begin(), mCandidates.end(), [this] (std::uint32_t aA, std::uint32_t aB) {
+			return mSlots[aA].lastUsed < mSlots[aB].lastUsed || (mSlots[aA].lastUsed == mSlots[aB].lastUsed && aA < aB);
+		} );
+
+		for( auto const index : mCandidates )
+		{
+			if( mStats.gpuBytes + mStats.pinnedBytes <= mBudgetBytes )
+				break;
+
+			evict_( mSlots[index], index );
+		}
+	}
+}
+
+void MeshResidency::set_pinned_bytes( std::uint64_t aBytes ) noexcept
+{
+	mStats.pinnedBytes = aBytes;
+}
+
+std::vector<GpuMesh> const& MeshResidency::meshes() const noexcept
+{
+	return mMeshes;
+}
+
+bool MeshResidency::uploaded_this_frame() const noexcept
+{
+	return 0 != mStats.uploaded;
+}
+
+std::vector<std::uint32_t> const& MeshResidency::uploaded() const noexcept
+{
+	return mUploaded;
+}
+
+bool MeshResidency::over_budget() const noexcept
+{
+	return 0 != mBudgetBytes && mStats.gpuBytes + mStats.pinnedBytes > mBudgetBytes;
+}
+
+ResidencyStats const& MeshResidency::stats() const noexcept
+{
+	return mStats;
+}
+
+void MeshResidency::upload_( Slot_& aSlot, std::size_t aIndex )
+{
+	assert( State_::loaded == aSlot.state );
+
+	auto& mesh = mMeshes[aIndex];
+	mesh = create_gpu_mesh( aSlot.data );
+
+	// The registered bounds are authoritative (they were used for culling
+	// and sorting before the mesh was loaded).
+	mesh.boundsCenter = aSlot.asset.bounds.center;
+	mesh.boundsRadius = aSlot.asset.bounds.radius;
+
+	// Normals generated on the GPU are not part of the loaded data.
+	aSlot.gpuBytes = vertex_bytes( mesh );
+	aSlot.loadedBytes = 0;
+	aSlot.data = SimpleMeshData{};
+	aSlot.state = State_::resident;
+
+	mStats.gpuBytes += aSlot.gpuBytes;
+	mStats.uploadedBytes += aSlot.gpuBytes;
+	mUploaded.emplace_back( std::uint32_t(aIndex) );
+	++mStats.uploaded;
+	++mStats.resident;
+	++mStats.totalLoads;
+}
+
+void MeshResidency::evict_( Slot_& aSlot, std::size_t aIndex )
+{
+	assert( State_::resident == aSlot.state );
+
+	auto& mesh = mMeshes[aIndex];
+	destroy_gpu_mesh( mesh );
+	mesh.boundsCenter = aSlot.asset.bounds.center;
+	mesh.boundsRadius = aSlot.asset.bounds.radius;
+
+	mStats.gpuBytes -= aSlot.gpuBytes;
+	mStats.evictedBytes += aSlot.gpuBytes;
+	++mStats.evicted;
+	--mStats.resident;
+	++mStats.totalEvictions;
+
+	aSlot.gpuBytes = 0;
+	aSlot.state = State_::unloaded;
+}
+
+void MeshResidency::LoadJob_::operator() ( std::size_t, std::size_t )
+{
+	try
+	{
+		slot->data = slot->asset.load();
+	}
+	catch( ... )
+	{
+		slot->error = std::current_exception();
+	}
+}
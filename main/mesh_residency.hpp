@@ -0,0 +1,156 @@
+#ifndef MESH_RESIDENCY_HPP_61C98522_F0E7_459C_987F_94F17C1DBB1F
+#define MESH_RESIDENCY_HPP_61C98522_F0E7_459C_987F_94F17C1DBB1F
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+
+#include "../jobs/job_system.hpp"
+
+#include "simple_mesh.hpp"
+
+// A mesh that is loaded on demand. `load` runs on a job thread and may be
+// called again after the mesh was evicted; material IDs in its result must
+// already index the global material table.
+struct MeshAsset
+{
+	BoundingSphere bounds;     // model space, known before loading
+	std::uint64_t sourceBytes; // CPU memory held by `load` (0 if it reads from disk)
+	std::function<SimpleMeshData()> load;
+};
+
+struct ResidencyStats
+{
+	std::uint64_t budgetBytes;   // 0: unlimited
+	std::uint64_t gpuBytes;      // resident meshes
+	std::uint64_t pinnedBytes;   // other GPU memory counted against the budget (textures)
+	std::uint64_t cpuBytes;      // MeshAsset::sourceBytes, plus loaded meshes awaiting upload
+
+	std::size_t meshes;
+	std::size_t resident;
+	std::size_t loading;         // loading or awaiting upload
+
+	// Most recent frame
+	std::size_t requested;       // distinct meshes
+	std::size_t missing;         // requested, but not resident (not drawn)
+	std::size_t uploaded;
+	std::uint64_t uploadedBytes;
+	std::size_t evicted;
+	std::uint64_t evictedBytes;
+
+	// Since the start
+	std::size_t totalLoads;
+	std::size_t totalEvictions;
+};
+
+/* On-demand mesh residency with a GPU memory budget
+ *
+ * Meshes are registered as MeshAssets; nothing is loaded up front. Each
+ * frame, the render thread
+ *  - calls begin_frame(), which uploads meshes whose loaders have finished
+ *    (at most aMaxUploadBytes per frame, but always at least one),
+ *  - calls request() for each mesh it wants to draw. The first request
+ *    starts the mesh's loader as a job; until the mesh is uploaded,
+ *    request() returns false and the draw is skipped, and
+ *  - calls end_frame(), which evicts the least recently requested meshes
+ *    while the resident meshes plus the pinned bytes exceed the budget.
+ *    Meshes requested in the current frame are never evicted, so a frame
+ *    that needs more than the budget goes over it (see over_budget()).
+ *
+ * GPU sizes are the sizes of the vertex buffers. meshes() has an entry for
+ * each asset; entries of non-resident meshes only hold the bounds (and a
+ * vertexCount of zero).
+ *
+ * Render thread only (GL context, and the owner of aLoaders, which may be
+ * shared with other loaders).
+ */
+class MeshResidency final
+{
+	public:
+		MeshResidency( std::vector<MeshAsset>, std::uint64_t aBudgetBytes, std::uint64_t aMaxUploadBytes, JobSystem& aLoaders );
+		~MeshResidency(); // Waits for running loaders
+
+		MeshResidency( MeshResidency const& ) = delete;
+		MeshResidency& operator= (MeshResidency const&) = delete;
+
+	public:
+		// Rethrows errors from loaders.
+		void begin_frame( std::size_t aFrame );
+		bool request( std::uint32_t aMesh );
+		void end_frame();
+
+		// GPU memory that is not managed here but counts against the budget
+		void set_pinned_bytes( std::uint64_t ) noexcept;
+
+		std::vector<GpuMesh> const& meshes() const noexcept;
+
+		// Whether meshes were uploaded in the current frame (i.e., the set
+		// of drawable meshes grew)
+		bool uploaded_this_frame() const noexcept;
+
+		// The meshes uploaded in the current frame
+		std::vector<std::uint32_t> const& uploaded() const noexcept;
+
+		bool over_budget() const noexcept;
+
+		ResidencyStats const& stats() const noexcept;
+
+	private:
+		enum class State_
+		{
+			unloaded,
+			loading,  // loader job running
+			loaded,   // data ready for upload
+			resident
+		};
+
+		struct Slot_;
+
+		// Job functor (see JobSystem::parallel_for()); lives in its slot
+		struct LoadJob_
+		{
+			Slot_* slot;
+			void operator() ( std::size_t, std::size_t );
+		};
+
+		struct Slot_
+		{
+			MeshAsset asset;
+			State_ state = State_::unloaded;
+
+			std::size_t lastUsed = 0;    // frame of the last request
+			std::uint64_t gpuBytes = 0;  // while resident
+			std::uint64_t loadedBytes = 0; // while loaded
+
+			SimpleMeshData data; // while loaded
+			std::exception_ptr error;
+
+			LoadJob_ job;
+			JobCounter done;
+		};
+
+		void upload_( Slot_&, std::size_t aIndex );
+		void evict_( Slot_&, std::size_t aIndex );
+
+	private:
+		JobSystem& mJobs;
+
+		std::deque<Slot_> mSlots; // stable addresses (LoadJob_, JobCounter)
+		std::vector<GpuMesh> mMeshes;
+
+		std::vector<std::uint32_t> mPending;    // loading or loaded, in request order
+		std::vector<std::uint32_t> mCandidates; // scratch for end_frame()
+		std::vector<std::uint32_t> mUploaded;   // current frame
+
+		std::uint64_t mBudgetBytes;
+		std::uint64_t mMaxUploadBytes;
+		std::uint64_t mSourceBytes;
+
+		std::size_t mFrame;
+		ResidencyStats mStats;
+};
+
+#endif // MESH_RESIDENCY_HPP_61C98522_F0E7_459C_987F_94F17C1DBB1F
@@ -0,0 +1,387 @@
+#include "options.hpp"
+
+#include <algorithm>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../support/error.hpp"
+
+#include "frame_pacer.hpp"
+#include "clustered_lights.hpp"
+#include "virtual_texture.hpp"
+
+namespace
+{
+	void print_help_( char const* aProgram )
+	{
+		std::printf( "Usage: %s [options]\n", aProgram );
+		std::printf( "Options:\n" );
+		std::printf( "  --help              Show this message\n" );
+		std::printf( "  --text-benchmark    Draw ~10k dynamic glyphs per frame and report timings\n" );
+		std::printf( "  --log-input         Log input events (asynchronously, on a background thread)\n" );
+		std::printf( "  --sim-rate=HZ       Fixed simulation rate (default: 120)\n" );
+		std::printf( "  --max-sim-steps=N   Max. simulation steps per frame (default: 8)\n" );
+		std::printf( "  --vsync=0|1|adaptive  Enable/disable V-Sync; adaptive tears late frames if supported (default: 1)\n" );
+		std::printf( "  --frames-in-flight=N  Frames the renderer may run ahead of the GPU (1-%zu, default: 2)\n", FramePacer::kMaxInFlight );
+		std::printf( "  --jit-input=0|1     Sleep before sampling input instead of waiting after it (default: 0)\n" );
+		std::printf( "  --reverse-z=0|1     Reverse-Z depth with an infinite far plane (default: 1)\n" );
+		std::printf( "  --float-depth=0|1   32-bit float depth buffer (default: 1)\n" );
+		std::printf( "  --shadows=0|1       Cascaded shadow maps (default: 1)\n" );
+		std::printf( "  --shadow-resolution=N  Shadow map size per cascade (default: 2048)\n" );
+		std::printf( "  --shadow-distance=D  View distance covered by shadows (default: 150)\n" );
+		std::printf( "  --depth-prepass=0|1  Depth-only pre-pass, then shading with GL_EQUAL (default: 0)\n" );
+		std::printf( "  --sort-draws=0|1    Draw meshes front to back (default: 1)\n" );
+		std::printf( "  --dynamic-resolution=0|1  Scale the scene resolution to keep within the GPU budget (default: 0)\n" );
+		std::printf( "  --resolution-scale=MIN,MAX  Bounds of the dynamic resolution scale (default: 0.5,1)\n" );
+		std::printf( "  --gpu-budget=MS     GPU time budget per frame for dynamic resolution (default: 14)\n" );
+		std::printf( "  --vram-budget=MIB   GPU memory for meshes and textures; evicts least recently used meshes (default: 0, unlimited)\n" );
+		std::printf( "  --terrain-tile=SIZE  Split the terrain into tiles of SIZE world units, loaded on demand (default: 0, one mesh)\n" );
+		std::printf( "  --stream-distance=D  Draw (and load) terrain tiles within D of the camera (default: 0, all)\n" );
+		std::printf( "  --terrain-normals=obj|gpu  Terrain normals from the OBJ, or generated from a heightfield on the GPU (default: obj)\n" );
+		std::printf( "  --vt-min-size=N     Draw textures at least N texels wide or high as a virtual texture (default: 8192, 0: off)\n" );
+		std::printf( "  --vt-cache=N        Virtual texture cache size, N x N pages of 128x128 texels (2-%zu, default: 16)\n", VirtualTexture::kMaxCachePages );
+		std::printf( "  --lights=N          Animated point/spot lights around the landing pads (0-%zu, default: 0)\n", kMaxLights );
+		std::printf( "  --clustered-lights=0|1  Clustered light culling; 0 loops over all lights (default: 1)\n" );
+		std::printf( "  --light-benchmark   Headless: GPU time of clustered vs. naive lighting for 16-4096 lights\n" );
+		std::printf( "  --pipeline-depth=N  Frames the main thread may run ahead of the render thread (1-3, default: 1)\n" );
+		std::printf( "  --gpu-profile       Show per-pass GPU timings (overlay and console)\n" );
+		std::printf( "  --trace=PATH        Write a CPU/GPU trace (chrome://tracing, Perfetto) to PATH\n" );
+		std::printf( "  --trace-frames=N    Number of frames to trace (default: 300)\n" );
+		std::printf( "  --profiler-benchmark  Measure the CPU profiler's overhead per scope and exit\n" );
+		std::printf( "  --load-benchmark    Time reading vs. mapping the files in assets/ (cold and warm cache) and exit\n" );
+		std::printf( "  --asset-archive=PATH  Packed asset archive; empty: loose files only (default: '%s', if it exists)\n", kDefaultAssetArchive );
+		std::printf( "  --headless          Render offscreen along a scripted camera path and write frame statistics\n" );
+		std::printf( "  --resolution=WxH    Offscreen resolution with --headless (default: 1280x720)\n" );
+		std::printf( "  --frames=N          Frames to measure with --headless (default: 600)\n" );
+		std::printf( "  --stats=PATH        Where --headless writes its statistics (JSON, default: frame_stats.json)\n" );
+		std::printf( "  --check-allocations  Headless: fail if the frame loop (main or render thread) allocates after the warm-up\n" );
+		std::printf( "  --capture=N[,N...]  Write these frames as PNGs (without the text overlay)\n" );
+		std::printf( "  --capture-dir=DIR   Where --capture writes to (default: captures)\n" );
+		std::printf( "  --record=PATH       Record the camera path and input events to PATH\n" );
+		std::printf( "  --replay=PATH       Replay a recorded camera path (fixed time step) and report per-frame times\n" );
+		std::printf( "  --replay-report=PATH  Where --replay writes its report (CSV, default: replay_report.csv)\n" );
+		std::printf( "  --gl-validation=off|async|sync  GL debug output and error checks (default: %s)\n", gl_validation_name( default_gl_validation() ) );
+	}
+
+	// Match "--name=value". Returns the value, or nullptr if aArg is a
+	// different option.
+	char const* match_value_( char const* aArg, char const* aName )
+	{
+		std::size_t const len = std::strlen( aName );
+		if( 0 != std::strncmp( aArg, aName, len ) || '=' != aArg[len] )
+			return nullptr;
+
+		return aArg + len + 1;
+	}
+
+	float parse_float_( char const* aName, char const* aValue )
+	{
+		char* end = nullptr;
+		float const ret = std::strtof( aValue, &end );
+		if( end == aValue || '\0' != *end )
+			throw Error( "Option %s: expected a number, got '%s'", aName, aValue );
+		return ret;
+	}
+
+	long parse_int_( char const* aName, char const* aValue )
+	{
+		char* end = nullptr;
+		long const ret = std::strtol( aValue, &end, 10 );
+		if( end == aValue || '\0' != *end )
+			throw Error( "Option %s: expected an integer, got '%s'", aName, aValue );
+		return ret;
+	}
+}
+
+bool parse_options( int aArgc, char* aArgv[], Options& aOptions )
+{
+	for( int i = 1; i < aArgc; ++i )
+	{
+		char const* arg = aArgv[i];
+
+		if( 0 == std::strcmp( arg, "--help" ) )
+		{
+			print_help_( aArgv[0] );
+			return false;
+		}
+		else if( 0 == std::strcmp( arg, "--text-benchmark" ) )
+		{
+			aOptions.textBenchmark = true;
+		}
+		else if( 0 == std::strcmp( arg, "--log-input" ) )
+		{
+			aOptions.logInput = true;
+		}
+		else if( 0 == std::strcmp( arg, "--gpu-profile" ) )
+		{
+			aOptions.gpuProfile = true;
+		}
+		else if( 0 == std::strcmp( arg, "--profiler-benchmark" ) )
+		{
+			aOptions.profilerBenchmark = true;
+		}
+		else if( 0 == std::strcmp( arg, "--load-benchmark" ) )
+		{
+			aOptions.loadBenchmark = true;
+		}
+		else if( char const* value = match_value_( arg, "--asset-archive" ) )
+		{
+			aOptions.assetArchive = value;
+		}
+		else if( char const* value = match_value_( arg, "--trace" ) )
+		{
+			if( '\0' == *value )
+				throw Error( "Option --trace: expected a path" );
+			aOptions.tracePath = value;
+		}
+		else if( char const* value = match_value_( arg, "--trace-frames" ) )
+		{
+			long const frames = parse_int_( "--trace-frames", value );
+			if( frames < 1 )
+				throw Error( "Option --trace-frames: must be at least 1" );
+			aOptions.traceFrames = std::size_t(frames);
+		}
+		else if( char const* value = match_value_( arg, "--sim-rate" ) )
+		{
+			aOptions.simulationRate = parse_float_( "--sim-rate", value );
+			if( !(aOptions.simulationRate > 0.f) )
+				throw Error( "Option --sim-rate: must be positive" );
+		}
+		else if( char const* value = match_value_( arg, "--max-sim-steps" ) )
+		{
+			long const steps = parse_int_( "--max-sim-steps", value );
+			if( steps < 1 )
+				throw Error( "Option --max-sim-steps: must be at least 1" );
+			aOptions.maxSimulationSteps = unsigned(steps);
+		}
+		else if( char const* value = match_value_( arg, "--vsync" ) )
+		{
+			if( 0 == std::strcmp( value, "adaptive" ) )
+				aOptions.swapInterval = -1;
+			else
+				aOptions.swapInterval = parse_int_( "--vsync", value ) ? 1 : 0;
+		}
+		else if( char const* value = match_value_( arg, "--frames-in-flight" ) )
+		{
+			long const frames = parse_int_( "--frames-in-flight", value );
+			if( frames < 1 || std::size_t(frames) > FramePacer::kMaxInFlight )
+				throw Error( "Option --frames-in-flight: must be between 1 and %zu", FramePacer::kMaxInFlight );
+			aOptions.framesInFlight = std::size_t(frames);
+		}
+		else if( char const* value = match_value_( arg, "--jit-input" ) )
+		{
+			aOptions.jitInput = 0 != parse_int_( "--jit-input", value );
+		}
+		else if( char const* value = match_value_( arg, "--reverse-z" ) )
+		{
+			aOptions.reverseZ = 0 != parse_int_( "--reverse-z", value );
+		}
+		else if( char const* value = match_value_( arg, "--float-depth" ) )
+		{
+			aOptions.floatDepth = 0 != parse_int_( "--float-depth", value );
+		}
+		else if( char const* value = match_value_( arg, "--shadows" ) )
+		{
+			aOptions.shadows = 0 != parse_int_( "--shadows", value );
+		}
+		else if( char const* value = match_value_( arg, "--shadow-resolution" ) )
+		{
+			long const res = parse_int_( "--shadow-resolution", value );
+			if( res < 16 || res > 16384 )
+				throw Error( "Option --shadow-resolution: must be between 16 and 16384" );
+			aOptions.shadowResolution = int(res);
+		}
+		else if( char const* value = match_value_( arg, "--shadow-distance" ) )
+		{
+			float const dist = parse_float_( "--shadow-distance", value );
+			if( !(dist > 1.f) )
+				throw Error( "Option --shadow-distance: must be greater than 1" );
+			aOptions.shadowDistance = dist;
+		}
+		else if( char const* value = match_value_( arg, "--pipeline-depth" ) )
+		{
+			long const depth = parse_int_( "--pipeline-depth", value );
+			if( depth < 1 || depth > 3 )
+				throw Error( "Option --pipeline-depth: must be between 1 and 3" );
+			aOptions.pipelineDepth = unsigned(depth);
+		}
+		else if( char const* value = match_value_( arg, "--depth-prepass" ) )
+		{
+			aOptions.depthPrepass = 0 != parse_int_( "--depth-prepass", value );
+		}
+		else if( char const* value = match_value_( arg, "--sort-draws" ) )
+		{
+			aOptions.sortDraws = 0 != parse_int_( "--sort-draws", value );
+		}
+		else if( char const* value = match_value_( arg, "--dynamic-resolution" ) )
+		{
+			aOptions.dynamicResolution = 0 != parse_int_( "--dynamic-resolution", value );
+		}
+		else if( char const* value = match_value_( arg, "--resolution-scale" ) )
+		{
+			float lo = 0.f, hi = 0.f;
+			char tail = 0;
+			if( 2 != std::sscanf( value, "%f,%f%c", &lo, &hi, &tail ) || !(lo > 0.f) || lo > hi || hi > 2.f )
+				throw Error( "Option --resolution-scale: expected MIN,MAX with 0 < MIN <= MAX <= 2 (got '%s')", value );
+			aOptions.minResolutionScale = lo;
+			aOptions.maxResolutionScale = hi;
+		}
+		else if( char const* value = match_value_( arg, "--gpu-budget" ) )
+		{
+			aOptions.gpuBudgetMs = parse_float_( "--gpu-budget", value );
+			if( !(aOptions.gpuBudgetMs > 0.f) )
+				throw Error( "Option --gpu-budget: must be positive" );
+		}
+		else if( char const* value = match_value_( arg, "--vram-budget" ) )
+		{
+			long const budget = parse_int_( "--vram-budget", value );
+			if( budget < 0 )
+				throw Error( "Option --vram-budget: must not be negative" );
+			aOptions.vramBudgetMiB = std::size_t(budget);
+		}
+		else if( char const* value = match_value_( arg, "--terrain-tile" ) )
+		{
+			aOptions.terrainTileSize = parse_float_( "--terrain-tile", value );
+			if( !(aOptions.terrainTileSize >= 0.f) )
+				throw Error( "Option --terrain-tile: must not be negative" );
+		}
+		else if( char const* value = match_value_( arg, "--terrain-normals" ) )
+		{
+			if( 0 == std::strcmp( value, "obj" ) )
+				aOptions.terrainGpuNormals = false;
+			else if( 0 == std::strcmp( value, "gpu" ) )
+				aOptions.terrainGpuNormals = true;
+			else
+				throw Error( "Option --terrain-normals: expected 'obj' or 'gpu' (got '%s')", value );
+		}
+		else if( char const* value = match_value_( arg, "--vt-min-size" ) )
+		{
+			long const size = parse_int_( "--vt-min-size", value );
+			if( size < 0 )
+				throw Error( "Option --vt-min-size: must not be negative" );
+			aOptions.virtualTextureMinSize = std::uint32_t(size);
+		}
+		else if( char const* value = match_value_( arg, "--vt-cache" ) )
+		{
+			long const pages = parse_int_( "--vt-cache", value );
+			if( pages < 2 || std::size_t(pages) > VirtualTexture::kMaxCachePages )
+				throw Error( "Option --vt-cache: must be between 2 and %zu", VirtualTexture::kMaxCachePages );
+			aOptions.virtualTextureCachePages = std::size_t(pages);
+		}
+		else if( char const* value = match_value_( arg, "--stream-distance" ) )
+		{
+			aOptions.streamDistance = parse_float_( "--stream-distance", value );
+			if( !(aOptions.streamDistance >= 0.f) )
+				throw Error( "Option --stream-distance: must not be negative" );
+		}
+		else if( char const* value = match_value_( arg, "--lights" ) )
+		{
+			long const lights = parse_int_( "--lights", value );
+			if( lights < 0 || std::size_t(lights) > kMaxLights )
+				throw Error( "Option --lights: must be between 0 and %zu", kMaxLights );
+			aOptions.lights = std::size_t(lights);
+		}
+		else if( char const* value = match_value_( arg, "--clustered-lights" ) )
+		{
+			aOptions.clusteredLights = 0 != parse_int_( "--clustered-lights", value );
+		}
+		else if( 0 == std::strcmp( arg, "--light-benchmark" ) )
+		{
+			aOptions.lightBenchmark = true;
+			aOptions.headless = true;
+		}
+		else if( 0 == std::strcmp( arg, "--headless" ) )
+		{
+			aOptions.headless = true;
+		}
+		else if( 0 == std::strcmp( arg, "--check-allocations" ) )
+		{
+			aOptions.checkAllocations = true;
+			aOptions.headless = true;
+		}
+		else if( char const* value = match_value_( arg, "--resolution" ) )
+		{
+			int w = 0, h = 0;
+			char tail = 0;
+			if( 2 != std::sscanf( value, "%dx%d%c", &w, &h, &tail ) || w < 1 || h < 1 )
+				throw Error( "Option --resolution: expected WIDTHxHEIGHT (got '%s')", value );
+			aOptions.width = w;
+			aOptions.height = h;
+		}
+		else if( char const* value = match_value_( arg, "--frames" ) )
+		{
+			long const frames = parse_int_( "--frames", value );
+			if( frames < 1 )
+				throw Error( "Option --frames: must be at least 1" );
+			aOptions.benchmarkFrames = std::size_t(frames);
+		}
+		else if( char const* value = match_value_( arg, "--stats" ) )
+		{
+			if( '\0' == *value )
+				throw Error( "Option --stats: expected a path" );
+			aOptions.statsPath = value;
+		}
+		else if( char const* value = match_value_( arg, "--capture" ) )
+		{
+			aOptions.captureFrames.clear();
+			for( char const* item = value; ; )
+			{
+				char* end = nullptr;
+				long const frame = std::strtol( item, &end, 10 );
+				if( end == item || frame < 0 || (',' != *end && '\0' != *end) )
+					throw Error( "Option --capture: expected a comma separated list of frame numbers (got '%s')", value );
+
+				aOptions.captureFrames.push_back( std::size_t(frame) );
+
+				if( '\0' == *end )
+					break;
+				item = end+1;
+			}
+
+			std::sort( aOptions.captureFrames.begin(), aOptions.captureFrames.end() );
+		}
+		else if( char const* value = match_value_( arg, "--capture-dir" ) )
+		{
+			if( '\0' == *value )
+				throw Error( "Option --capture-dir: expected a path" );
+			aOptions.captureDirectory = value;
+		}
+		else if( char const* value = match_value_( arg, "--record" ) )
+		{
+			if( '\0' == *value )
+				throw Error( "Option --record: expected a path" );
+			aOptions.recordPath = value;
+		}
+		else if( char const* value = match_value_( arg, "--replay" ) )
+		{
+			if( '\0' == *value )
+				throw Error( "Option --replay: expected a path" );
+			aOptions.replayPath = value;
+		}
+		else if( char const* value = match_value_( arg, "--replay-report" ) )
+		{
+			if( '\0' == *value )
+				throw Error( "Option --replay-report: expected a path" );
+			aOptions.replayReportPath = value;
+		}
+		else if( char const* value = match_value_( arg, "--gl-validation" ) )
+		{
+			if( 0 == std::strcmp( value, "off" ) )
+				aOptions.glValidation = GlValidation::off;
+			else if( 0 == std::strcmp( value, "async" ) )
+				aOptions.glValidation = GlValidation::async;
+			else if( 0 == std::strcmp( value, "sync" ) )
+				aOptions.glValidation = GlValidation::sync;
+			else
+				throw Error( "Option --gl-validation: expected off, async or sync (got '%s')", value );
+		}
+		else
+		{
+			throw Error( "Unknown option '%s' (try --help)", arg );
+		}
+	}
+
+	return true;
+}
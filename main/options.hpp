@@ -0,0 +1,162 @@
+#ifndef OPTIONS_HPP_F28868D4_C6FE_4FEC_880F_5DBD294E29EA
+#define OPTIONS_HPP_F28868D4_C6FE_4FEC_880F_5DBD294E29EA
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "../support/debug_output.hpp"
+
+#if defined(NDEBUG)
+inline constexpr char kDefaultAssetArchive[] = "assets.pak";
+#else
+inline constexpr char kDefaultAssetArchive[] = "";
+#endif
+
+// Command line options
+//
+// All options are of the form "--name" or "--name=value". Run with --help for
+// a list.
+struct Options
+{
+	// Stress test for the text renderer: draw ~10k changing glyphs per frame
+	// and report timings.
+	bool textBenchmark = false;
+
+	// Print input events. Messages are written by a background thread, so
+	// this does not stall the event path.
+	bool logInput = false;
+
+	// Fixed simulation rate (Hz) and the maximum number of simulation steps
+	// per rendered frame. Rendering interpolates between simulation states.
+	float simulationRate = 120.f;
+	unsigned maxSimulationSteps = 8;
+
+	// Swap interval: 1 = V-Sync, 0 = render as fast as possible, -1 =
+	// adaptive V-Sync (see Renderer::Config).
+	int swapInterval = 1;
+
+	// Frame pacing (see frame_pacer.hpp): frames the render thread may run
+	// ahead of the GPU, and just-in-time input sampling.
+	std::size_t framesInFlight = 2;
+	bool jitInput = false;
+
+	// Depth buffer setup (see Renderer::Config). Reverse-Z uses a projection
+	// without a far plane.
+	bool reverseZ = true;
+	bool floatDepth = true;
+
+	// Cascaded shadow maps (see shadow_map.hpp)
+	bool shadows = true;
+	int shadowResolution = 2048;
+	float shadowDistance = 150.f;
+
+	// Scene pass: depth pre-pass, or a single pass (see Renderer::Config),
+	// and front to back sorting of the meshes.
+	bool depthPrepass = false;
+	bool sortDraws = true;
+
+	// Dynamic resolution (see Renderer::Config): scale bounds of the scene
+	// resolution and the GPU time budget per frame (ms).
+	bool dynamicResolution = false;
+	float minResolutionScale = 0.5f;
+	float maxResolutionScale = 1.f;
+	float gpuBudgetMs = 14.f;
+
+	// Mesh residency (see MeshResidency): GPU memory budget in MiB (0:
+	// unlimited), terrain tile size in world units (0: one mesh), and the
+	// distance from the camera within which terrain tiles are drawn (and
+	// thus requested; 0: all).
+	std::size_t vramBudgetMiB = 0;
+	float terrainTileSize = 0.f;
+	float streamDistance = 0.f;
+
+	// Terrain normals generated from a heightfield on the GPU (see
+	// TerrainNormals) instead of the OBJ's.
+	bool terrainGpuNormals = false;
+
+	// Virtual texturing (see VirtualTexture): minimum texture size (width
+	// or height, in texels; 0: off) and cache size in pages per side.
+	std::uint32_t virtualTextureMinSize = 8192;
+	std::size_t virtualTextureCachePages = 16;
+
+	// Point and spot lights around the landing pads (see
+	// clustered_lights.hpp), and whether fragments use the light clusters
+	// or loop over all lights.
+	std::size_t lights = 0;
+	bool clusteredLights = true;
+
+	// Headless benchmark of the light loop: clustered vs. naive, from 16 to
+	// 4096 lights, fixed camera. Prints GPU frame times per configuration.
+	// Implies `headless`.
+	bool lightBenchmark = false;
+
+	// Number of frames the main thread may run ahead of the render thread
+	// (1 = double buffered frame packets, 2 = triple buffered, ...).
+	unsigned pipelineDepth = 1;
+
+	// GPU timings (timer queries) per render pass, in the overlay and on the
+	// console.
+	bool gpuProfile = false;
+
+	// Capture a CPU/GPU trace of `traceFrames` frames and write it to
+	// `tracePath` (Chrome trace JSON). Empty: no trace.
+	std::string tracePath;
+	std::size_t traceFrames = 300;
+
+	// Measure the overhead of PROFILE_SCOPE and exit.
+	bool profilerBenchmark = false;
+
+	// Measure asset load times (read vs. mapped, cold and warm page cache)
+	// and exit. See asset_load_benchmark.hpp.
+	bool loadBenchmark = false;
+
+	// Packed asset archive (see asset_store.hpp). Assets that are not in it
+	// are loaded from loose files. Release builds mount kDefaultAssetArchive
+	// if it exists; debug builds load loose files only, unless an archive is
+	// given explicitly. Empty: no archive.
+	std::string assetArchive = kDefaultAssetArchive;
+
+	// Headless benchmark: hidden window (or GLFW's null platform with an
+	// OSMesa context if there is no display), offscreen framebuffer of
+	// `width` x `height`, V-Sync off, scripted camera. Runs for
+	// `benchmarkFrames` frames after a short warm-up and writes frame time
+	// statistics to `statsPath` (JSON).
+	bool headless = false;
+	int width = 1280, height = 720;
+	std::size_t benchmarkFrames = 600;
+	std::string statsPath = "frame_stats.json";
+
+	// Fail (exit with an error) if the headless main loop or the render
+	// thread allocates from the heap after the warm-up (see
+	// alloc_counter.hpp).
+	bool checkAllocations = false;
+
+	// Write these frames (sorted) as PNGs into `captureDirectory`, which is
+	// created if needed. Captured frames are drawn without the text overlay,
+	// so that they only depend on the scene (compare with imgdiff).
+	std::vector<std::size_t> captureFrames;
+	std::string captureDirectory = "captures";
+
+	// Record the camera (one pose per simulation step) and the input events
+	// to `recordPath` (see camera_path.hpp). Empty: don't record.
+	std::string recordPath;
+
+	// Replay a recorded camera path, with a fixed frame time, instead of the
+	// interactive camera (or, with --headless, the scripted one). Ends with
+	// the path. Writes per frame CPU and GPU times, keyed to the position
+	// on the path, to `replayReportPath` (CSV).
+	std::string replayPath;
+	std::string replayReportPath = "replay_report.csv";
+
+	// GL debug output and checkpoints (see debug_output.hpp). Anything but
+	// "off" requests a debug context.
+	GlValidation glValidation = default_gl_validation();
+};
+
+// Parse command line. Throws Error on unknown or malformed options. Returns
+// false if the program should exit (e.g., after printing --help).
+bool parse_options( int aArgc, char* aArgv[], Options& aOptions );
+
+#endif // OPTIONS_HPP_F28868D4_C6FE_4FEC_880F_5DBD294E29EA
@@ -0,0 +1,1114 @@
+#include "renderer.hpp"
+
+#include <glad.h>
+#include <GLFW/glfw3.h>
+
+#include <memory>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/program.hpp"
+#include "../support/checkpoint.hpp"
+#include "../support/gpu_profiler.hpp"
+#include "../support/pipeline_stats.hpp"
+#include "../support/debug_output.hpp"
+#include "../support/alloc_counter.hpp"
+
+#include "../vmlib/mat33.hpp"
+
+#include "../jobs/job_system.hpp"
+
+#include "material.hpp"
+#include "simple_mesh.hpp"
+#include "dynamic_resolution.hpp"
+#include "frame_pacer.hpp"
+#include "clustered_lights.hpp"
+#include "frame_capture.hpp"
+#include "cpu_profiler.hpp"
+#include "text_renderer.hpp"
+
+namespace
+{
+	// Print the GPU profile every this many frames (with --gpu-profile)
+	constexpr std::size_t kGpuSummaryInterval_ = 600;
+
+	// Worker threads loading meshes and virtual texture tiles
+	constexpr std::size_t kLoaderThreads_ = 2;
+
+	// PipelineStats passes
+	constexpr std::size_t kPrepassStats_ = 0;
+	constexpr std::size_t kShadingStats_ = 1;
+
+	// Size of each packet's FrameArena: the draw list, the draw order and
+	// the text vertices. --text-benchmark peaks at about 4 MiB (in the frame
+	// where the vertices first outgrow their reserve). More spills to the
+	// heap (see FrameArena::overflows()).
+	constexpr std::size_t kFrameArenaBytes_ = 8*1024*1024;
+
+	float to_ms_( Clock::duration aDuration )
+	{
+		return std::chrono::duration_cast<Secondsf>(aDuration).count() * 1000.f;
+	}
+
+	// GL resources. Only ever touched by the render thread.
+	struct Resources_
+	{
+		Resources_( std::vector<MaterialDesc> const&, std::vector<MeshAsset>, Renderer::Config const& );
+		~Resources_();
+
+		Resources_( Resources_ const& ) = delete;
+		Resources_& operator= (Resources_ const&) = delete;
+
+		// Shared by the loaders below, so it is destroyed last. There can
+		// only be one JobSystem per thread.
+		JobSystem loaders;
+
+		ShaderProgram program;
+		ShaderProgram depthProgram;
+		MaterialSystem materials;
+		TextRenderer text;
+
+		GpuProfiler gpuProfiler;
+		std::int64_t gpuToCpuNs = 0; // GL_TIMESTAMP -> profiler_now_ns()
+
+		PipelineStats pipelineStats;
+
+		std::unique_ptr<ShadowCascades> shadows; // null: no shadows
+		ClusteredLights lights;
+
+		// Null without dynamic resolution. Fed from forward_gpu_scope_().
+		std::unique_ptr<DynamicResolution> resolution;
+
+		MeshResidency meshes;
+
+		// Null without Renderer::Config::terrainHeightfield
+		std::unique_ptr<TerrainNormals> terrainNormals;
+
+		// Scene pass setup (Renderer::Config)
+		bool depthPrepass = false;
+		bool sortFrontToBack = true;
+		GLenum depthFunc = GL_LESS;
+
+		struct TextBenchmarkTimes
+		{
+			float draw = 0.f, flush = 0.f, frame = 0.f;
+			std::size_t frames = 0;
+		} textBench;
+	};
+
+	struct Offscreen_;
+
+	// Where the scene is drawn. With dynamic resolution, that is a separate
+	// target (sized for the maximum scale), from which the scene is upscaled
+	// to the output; the overlay is then drawn into the output. Otherwise,
+	// everything is drawn into the output directly.
+	struct SceneTarget_
+	{
+		Offscreen_ const* scaled; // null: draw into the output
+		int width, height;        // scene viewport
+		GLuint output;            // framebuffer object of the output, 0 for the window
+	};
+
+	void render_( Resources_&, FramePacket const&, SceneTarget_ const&, float aFrameMs, bool aShowProfile );
+	void render_scopes_( Resources_&, FramePacket const&, SceneTarget_ const&, float aFrameMs, bool aShowProfile );
+	void generate_normals_( Resources_& );
+	void draw_gpu_profile_( TextRenderer&, GpuProfiler const&, float aY );
+	void forward_gpu_scope_( void*, std::uint64_t, char const*, std::size_t, GLuint64, GLuint64 );
+
+	void draw_mesh_( GpuMesh const&, Mat44f const& aProjCameraWorld, Mat44f const& aWorld );
+	// Indices into aPacket.draws in drawing order, allocated from its arena
+	std::pmr::vector<std::uint32_t> order_draws_( Resources_&, FramePacket const& aPacket );
+	void draw_text_benchmark_( TextRenderer&, std::size_t aFrame );
+
+	// User data for forward_gpu_scope_()
+	struct GpuScopeSink_
+	{
+		Resources_* resources;
+
+		// Null unless Config::recordFrameTimes
+		std::mutex* mutex;
+		std::vector<Renderer::FrameTimes>* frameTimes;
+	};
+
+	struct ContextReleaser_
+	{
+		~ContextReleaser_() { glfwMakeContextCurrent( nullptr ); }
+	};
+
+	// Offscreen render target (sRGB color, 24 bit or 32 bit float depth)
+	struct Offscreen_
+	{
+		Offscreen_( int aWidth, int aHeight, GLenum aDepthFormat );
+		~Offscreen_();
+
+		Offscreen_( Offscreen_ const& ) = delete;
+		Offscreen_& operator= (Offscreen_ const&) = delete;
+
+		GLuint fbo = 0;
+		GLuint color = 0;
+		GLuint depth = 0;
+
+		int width, height;
+	};
+
+	// Copy aWidth x aHeight pixels of aSource's color to aTarget (a
+	// framebuffer object, or 0 for the window), stretched to aTargetWidth x
+	// aTargetHeight. Leaves aTarget bound for drawing and aSource for
+	// reading.
+	void blit_color_( Offscreen_ const& aSource, int aWidth, int aHeight, GLuint aTarget, int aTargetWidth, int aTargetHeight );
+}
+
+Renderer::Renderer( GLFWwindow* aWindow, std::vector<MaterialDesc> aMaterials, std::vector<MeshAsset> aMeshes, Config const& aConfig )
+	: mWindow( aWindow )
+	, mConfig( aConfig )
+	, mWriteIndex( 0 ), mReadIndex( 0 )
+	, mReady( 0 )
+	, mAcquired( false )
+	, mStarted( false )
+	, mStop( false )
+	, mTimings{}
+	, mReverseZ( false )
+{
+	if( mConfig.pipelineDepth < 1 || mConfig.pipelineDepth > kMaxPipelineDepth )
+		throw Error( "Renderer: pipeline depth must be between 1 and %zu (got %zu)", kMaxPipelineDepth, mConfig.pipelineDepth );
+	if( mConfig.maxFramesInFlight < 1 || mConfig.maxFramesInFlight > FramePacer::kMaxInFlight )
+		throw Error( "Renderer: frames in flight must be between 1 and %zu (got %zu)", FramePacer::kMaxInFlight, mConfig.maxFramesInFlight );
+	if( mConfig.dynamicResolution && !(mConfig.minResolutionScale > 0.f && mConfig.minResolutionScale <= mConfig.maxResolutionScale && mConfig.gpuBudgetMs > 0.f) )
+		throw Error( "Renderer: invalid dynamic resolution setup (scale %g to %g, budget %g ms)", double(mConfig.minResolutionScale), double(mConfig.maxResolutionScale), double(mConfig.gpuBudgetMs) );
+
+	mArenas.reserve( mConfig.pipelineDepth + 1 );
+	mPackets.reserve( mConfig.pipelineDepth + 1 );
+	for( std::size_t i = 0; i <= mConfig.pipelineDepth; ++i )
+	{
+		mArenas.emplace_back( std::make_unique<FrameArena>( kFrameArenaBytes_ ) );
+		mPackets.emplace_back( *mArenas.back() );
+	}
+
+	mThread = std::thread( [this, materials = std::move(aMaterials), meshes = std::move(aMeshes)] () mutable {
+		run_( std::move(materials), std::move(meshes) );
+	} );
+
+	// Wait for initialization to finish, so that errors (missing assets,
+	// shader compilation, ...) are reported from here.
+	std::unique_lock<std::mutex> lock( mMutex );
+	mCondition.wait( lock, [this] { return mStarted || mError; } );
+
+	if( mError )
+	{
+		lock.unlock();
+		mThread.join();
+		std::rethrow_exception( mError );
+	}
+}
+
+Renderer::~Renderer()
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStop = true;
+	}
+	mCondition.notify_all();
+
+	if( mThread.joinable() )
+		mThread.join();
+}
+
+FramePacket& Renderer::acquire()
+{
+	PROFILE_SCOPE( "wait for renderer" );
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	assert( !mAcquired );
+
+	mCondition.wait( lock, [this] { return mReady < mPackets.size() || mError; } );
+
+	if( mError )
+		std::rethrow_exception( mError );
+
+	mAcquired = true;
+
+	// Start the frame with an empty arena. The draw list from the packet's
+	// last use must let go of its storage first.
+	FramePacket& packet = mPackets[mWriteIndex];
+	std::pmr::vector<DrawItem>( packet.arena ).swap( packet.draws );
+	packet.arena->reset();
+
+	return packet;
+}
+
+void Renderer::submit()
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		assert( mAcquired );
+
+		mAcquired = false;
+		mWriteIndex = (mWriteIndex+1) % mPackets.size();
+		++mReady;
+	}
+	mCondition.notify_all();
+}
+
+Renderer::Timings Renderer::timings() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mTimings;
+}
+
+std::vector<Renderer::FrameTimes> Renderer::frame_times() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mFrameTimes;
+}
+
+std::string const& Renderer::gl_renderer() const noexcept
+{
+	return mGlRenderer;
+}
+
+bool Renderer::reverse_z() const noexcept
+{
+	return mReverseZ;
+}
+
+void Renderer::run_( std::vector<MaterialDesc> aMaterials, std::vector<MeshAsset> aMeshes )
+{
+	PROFILE_THREAD_NAME( "render" );
+
+	glfwMakeContextCurrent( mWindow );
+	ContextReleaser_ releaser;
+
+	try
+	{
+		// Adaptive V-Sync (negative intervals) needs the swap tear
+		// extension.
+		int swapInterval = mConfig.swapInterval;
+		if( swapInterval < 0 && !glfwExtensionSupported( "GLX_EXT_swap_control_tear" ) && !glfwExtensionSupported( "WGL_EXT_swap_control_tear" ) )
+		{
+			std::fprintf( stderr, "Adaptive V-Sync requires GLX/WGL_EXT_swap_control_tear; using V-Sync\n" );
+			swapInterval = -swapInterval;
+		}
+
+		glfwSwapInterval( swapInterval );
+
+		// Initialize GLAD
+		// This will load the OpenGL API. We mustn't make any OpenGL calls before this!
+		if( !gladLoadGLLoader( (GLADloadproc)&glfwGetProcAddress ) )
+			throw Error( "gladLoaDGLLoader() failed - cannot load GL API!" );
+
+		mGlRenderer = reinterpret_cast<char const*>(glGetString( GL_RENDERER ));
+
+		std::printf( "RENDERER %s\n", mGlRenderer.c_str() );
+		std::printf( "VENDOR %s\n", glGetString( GL_VENDOR ) );
+		std::printf( "VERSION %s\n", glGetString( GL_VERSION ) );
+		std::printf( "SHADING_LANGUAGE_VERSION %s\n", glGetString( GL_SHADING_LANGUAGE_VERSION ) );
+
+		// Debug output
+		setup_gl_debug_output( mConfig.validation );
+		std::printf( "GL validation: %s\n", gl_validation_name( mConfig.validation ) );
+
+		// Global GL state
+		OGL_CHECKPOINT_ALWAYS();
+
+		glEnable( GL_FRAMEBUFFER_SRGB );
+		glEnable( GL_CULL_FACE );
+		glEnable( GL_DEPTH_TEST );
+		glClearColor( 0.2f, 0.2f, 0.2f, 0.0f );
+
+		// Reverse-Z. glClipControl() is core in 4.5; the context may be
+		// older (4.3 is requested).
+		mReverseZ = mConfig.reverseZ && GLAD_GL_VERSION_4_5;
+		if( mReverseZ )
+		{
+			glClipControl( GL_LOWER_LEFT, GL_ZERO_TO_ONE );
+			glClearDepth( 0.0 );
+			glDepthFunc( GL_GREATER );
+		}
+		else if( mConfig.reverseZ )
+		{
+			std::fprintf( stderr, "Reverse-Z requires glClipControl() (OpenGL 4.5); using standard depth\n" );
+		}
+
+		GLenum const depthFormat = mConfig.floatDepth ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24;
+		std::printf( "Depth: %s, %s\n", mReverseZ ? "reverse-Z" : "standard", mConfig.floatDepth ? "32-bit float" : "24-bit" );
+
+		OGL_CHECKPOINT_ALWAYS();
+
+		Resources_ resources( aMaterials, std::move(aMeshes), mConfig );
+		aMaterials.clear();
+		aMaterials.shrink_to_fit();
+
+		{
+			auto const& residency = resources.meshes.stats();
+			std::printf( "Mesh residency: %zu meshes (%.1f MiB CPU), loaded on demand; budget %s",
+				residency.meshes,
+				residency.cpuBytes / (1024.0*1024.0),
+				0 == residency.budgetBytes ? "unlimited" : ""
+			);
+			if( residency.budgetBytes )
+				std::printf( "%.1f MiB", residency.budgetBytes / (1024.0*1024.0) );
+			std::printf( " (textures: %.1f MiB, always resident)\n", residency.pinnedBytes / (1024.0*1024.0) );
+		}
+
+		if( mConfig.terrainHeightfield )
+			std::printf( "Terrain normals: generated on the GPU from a %ux%u heightfield\n", mConfig.terrainHeightfield->columns, mConfig.terrainHeightfield->rows );
+
+		GpuScopeSink_ sink{ &resources, nullptr, nullptr };
+		if( mConfig.recordFrameTimes )
+		{
+			sink.mutex = &mMutex;
+			sink.frameTimes = &mFrameTimes;
+		}
+
+		resources.gpuProfiler.set_scope_callback( &forward_gpu_scope_, &sink );
+
+		resources.depthPrepass = mConfig.depthPrepass;
+		resources.sortFrontToBack = mConfig.sortFrontToBack;
+		resources.depthFunc = mReverseZ ? GL_GREATER : GL_LESS;
+
+		std::printf( "Scene pass: %s\n", mConfig.depthPrepass ? "depth pre-pass, then shading with GL_EQUAL" : (mConfig.sortFrontToBack ? "single pass, front to back" : "single pass, unsorted") );
+		if( !resources.pipelineStats.available() )
+			std::printf( "Fragment shader invocations: not available (requires OpenGL 4.6 or GL_ARB_pipeline_statistics_query)\n" );
+
+		if( mConfig.dynamicResolution )
+		{
+			resources.resolution = std::make_unique<DynamicResolution>( mConfig.minResolutionScale, mConfig.maxResolutionScale, mConfig.gpuBudgetMs );
+			std::printf( "Dynamic resolution: scale %.2f to %.2f, GPU budget %.1f ms\n", double(mConfig.minResolutionScale), double(mConfig.maxResolutionScale), double(mConfig.gpuBudgetMs) );
+		}
+
+		// glClipControl( ..., GL_ZERO_TO_ONE ) is only enabled for reverse-Z.
+		if( mConfig.shadows )
+			resources.shadows = std::make_unique<ShadowCascades>( mConfig.shadowResolution, mConfig.shadowDistance, mReverseZ, mReverseZ );
+
+		// Headless: a fixed size target, bound once. With float depth in a
+		// window: a target matching the window (re-created when its size
+		// changes), blitted to the window after each frame. With dynamic
+		// resolution, the scene target has the float depth buffer and the
+		// scene is upscaled straight to the window.
+		bool const headless = mConfig.offscreenWidth > 0 && mConfig.offscreenHeight > 0;
+		bool const blitToWindow = !headless && mConfig.floatDepth && !mConfig.dynamicResolution;
+
+		std::unique_ptr<Offscreen_> offscreen;
+		std::unique_ptr<Offscreen_> scaled; // dynamic resolution
+		int scaledForWidth = 0, scaledForHeight = 0;
+		if( headless )
+		{
+			offscreen = std::make_unique<Offscreen_>( mConfig.offscreenWidth, mConfig.offscreenHeight, depthFormat );
+			glBindFramebuffer( GL_FRAMEBUFFER, offscreen->fbo );
+		}
+
+		FrameCapture capture;
+		FramePacer pacer( mConfig.maxFramesInFlight );
+
+		std::printf( "Swap interval: %d%s, at most %zu frames in flight\n", swapInterval, swapInterval < 0 ? " (adaptive)" : "", mConfig.maxFramesInFlight );
+
+		OGL_CHECKPOINT_ALWAYS();
+
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			if( mConfig.recordFrameTimes )
+				mFrameTimes.reserve( mConfig.expectedFrames );
+
+			mStarted = true;
+		}
+		mCondition.notify_all();
+
+		// Render loop
+		auto lastSwap = Clock::now();
+		std::uint64_t lastPixels = 0;
+		while( true )
+		{
+			// Wait for the GPU before taking the next packet, so that its
+			// input is as recent as possible.
+			float fenceMs = 0.f;
+			{
+				PROFILE_SCOPE( "wait for GPU" );
+				fenceMs = pacer.begin_frame();
+			}
+
+			auto const waitStart = Clock::now();
+
+			std::size_t index;
+			{
+				PROFILE_SCOPE( "wait for packet" );
+
+				std::unique_lock<std::mutex> lock( mMutex );
+				mCondition.wait( lock, [this] { return mReady > 0 || mStop; } );
+
+				if( mStop )
+					break;
+
+				index = mReadIndex;
+			}
+
+			// The packet is not modified by the main thread until it is
+			// released below.
+			FramePacket const& packet = mPackets[index];
+
+			if( blitToWindow && (!offscreen || offscreen->width != packet.framebufferWidth || offscreen->height != packet.framebufferHeight) )
+			{
+				offscreen.reset();
+				offscreen = std::make_unique<Offscreen_>( packet.framebufferWidth, packet.framebufferHeight, depthFormat );
+				glBindFramebuffer( GL_FRAMEBUFFER, offscreen->fbo );
+			}
+
+			SceneTarget_ target{ nullptr, packet.framebufferWidth, packet.framebufferHeight, offscreen ? offscreen->fbo : 0 };
+			float scale = 1.f;
+
+			if( resources.resolution )
+			{
+				if( !scaled || scaledForWidth != packet.framebufferWidth || scaledForHeight != packet.framebufferHeight )
+				{
+					float const maxScale = resources.resolution->max_scale();
+
+					scaled.reset();
+					scaled = std::make_unique<Offscreen_>(
+						std::max( 1, int(std::ceil( maxScale * float(packet.framebufferWidth) )) ),
+						std::max( 1, int(std::ceil( maxScale * float(packet.framebufferHeight) )) ),
+						depthFormat
+					);
+					scaledForWidth = packet.framebufferWidth;
+					scaledForHeight = packet.framebufferHeight;
+				}
+
+				scale = resources.resolution->begin_frame( packet.frame );
+
+				target.scaled = scaled.get();
+				target.width = std::clamp( int(std::lround( scale * float(packet.framebufferWidth) )), 1, scaled->width );
+				target.height = std::clamp( int(std::lround( scale * float(packet.framebufferHeight) )), 1, scaled->height );
+			}
+
+			lastPixels = std::uint64_t(target.width) * std::uint64_t(target.height);
+
+			auto const renderStart = Clock::now();
+			{
+				PROFILE_SCOPE( "render" );
+				render_( resources, packet, target, to_ms_( renderStart - lastSwap ), mConfig.gpuProfile && !packet.capture );
+			}
+
+			// Read back before swapping; the back buffer is undefined
+			// afterwards.
+			capture.poll();
+			if( packet.capture )
+			{
+				char name[32];
+				std::snprintf( name, sizeof(name), "/frame_%05zu.png", packet.frame );
+				capture.capture( packet.framebufferWidth, packet.framebufferHeight, mConfig.captureDirectory + name );
+			}
+
+			if( blitToWindow )
+			{
+				blit_color_( *offscreen, offscreen->width, offscreen->height, 0, offscreen->width, offscreen->height );
+				glBindFramebuffer( GL_DRAW_FRAMEBUFFER, offscreen->fbo );
+			}
+
+			if( mConfig.gpuProfile && 0 == (packet.frame+1) % kGpuSummaryInterval_ )
+				resources.gpuProfiler.print_summary( stdout );
+
+			auto const swapStart = Clock::now();
+			{
+				PROFILE_SCOPE( "swap" );
+				glfwSwapBuffers( mWindow );
+			}
+
+			auto const swapEnd = Clock::now();
+			lastSwap = swapEnd;
+
+			pacer.end_frame( packet.inputTime );
+
+			GlDebugFrameStats const glStats = GlValidation::off != mConfig.validation
+				? gl_debug_end_frame( stderr )
+				: GlDebugFrameStats{}
+			;
+
+			{
+				std::lock_guard<std::mutex> lock( mMutex );
+				mReadIndex = (mReadIndex+1) % mPackets.size();
+				--mReady;
+
+				mTimings.waitMs = to_ms_( renderStart - waitStart );
+				mTimings.renderMs = to_ms_( swapStart - renderStart );
+				mTimings.swapMs = to_ms_( swapEnd - swapStart );
+				mTimings.fenceMs = fenceMs;
+				mTimings.latencyMs = pacer.latency().lastMs;
+				mTimings.gl = glStats;
+				if( resources.shadows )
+					mTimings.shadows = resources.shadows->stats();
+				mTimings.prepassFragments = resources.pipelineStats.stats( kPrepassStats_ ).last;
+				mTimings.shadingFragments = resources.pipelineStats.stats( kShadingStats_ ).last;
+				mTimings.sceneWidth = target.width;
+				mTimings.sceneHeight = target.height;
+				mTimings.resolutionScale = scale;
+				mTimings.heapAllocations = thread_heap_allocations();
+				mTimings.residency = resources.meshes.stats();
+				if( auto const* vt = resources.materials.virtual_texture() )
+					mTimings.virtualTexture = vt->stats();
+				++mTimings.frames;
+
+				if( mConfig.recordFrameTimes )
+					mFrameTimes.emplace_back( FrameTimes{ packet.frame, mTimings.renderMs, -1.f } );
+			}
+			mCondition.notify_all();
+		}
+
+		if( mConfig.gpuProfile )
+			resources.gpuProfiler.print_summary( stdout );
+
+		if( auto const& shading = resources.pipelineStats.stats( kShadingStats_ ); shading.frames > 0 )
+		{
+			auto const& prepass = resources.pipelineStats.stats( kPrepassStats_ );
+			double const shadingMean = double(shading.total) / double(shading.frames);
+
+			std::printf( "Fragment shader invocations per frame (mean of %zu frames): depth pre-pass %.0f, shading %.0f (%.2f per pixel)\n",
+				shading.frames,
+				prepass.frames ? double(prepass.total) / double(prepass.frames) : 0.0,
+				shadingMean,
+				lastPixels ? shadingMean / double(lastPixels) : 0.0
+			);
+		}
+
+		if( auto const& latency = pacer.latency(); latency.frames > 0 )
+			std::printf( "Input to GPU done (latency estimate): mean %.2f ms, max %.2f ms (%zu frames)\n", double(latency.meanMs), double(latency.maxMs), latency.frames );
+
+		if( resources.resolution )
+		{
+			auto const& res = *resources.resolution;
+			std::printf( "Dynamic resolution: scale %.2f (mean %.2f), %zu changes\n", double(res.scale()), double(res.mean_scale()), res.changes() );
+		}
+
+		if( resources.shadows )
+		{
+			auto const& stats = resources.shadows->stats();
+			for( std::size_t i = 0; i < kShadowCascades; ++i )
+				std::printf( "Shadow cascade %zu: %zu casters, rendered in %zu of %zu frames\n", i, stats.casters[i], stats.renders[i], stats.frames );
+		}
+
+		{
+			auto const& residency = resources.meshes.stats();
+			std::printf( "Mesh residency: %zu of %zu meshes resident (%.1f MiB GPU), %zu loads, %zu evictions\n",
+				residency.resident, residency.meshes,
+				residency.gpuBytes / (1024.0*1024.0),
+				residency.totalLoads, residency.totalEvictions
+			);
+		}
+
+		if( resources.terrainNormals )
+		{
+			auto const& stats = resources.terrainNormals->stats();
+			std::printf( "Terrain normals: generated for %zu mesh uploads (%zu vertices)\n", stats.meshes, stats.vertices );
+		}
+
+		if( auto const* vt = resources.materials.virtual_texture() )
+		{
+			auto const& stats = vt->stats();
+			std::printf( "Virtual texture: %zu of %zu pages resident, %zu uploads, %zu evictions, %zu dropped; %zu feedback reads (%zu skipped)\n",
+				stats.residentPages, stats.pages,
+				stats.totalUploads, stats.totalEvictions, stats.dropped,
+				stats.feedbackReads, stats.feedbackSkipped
+			);
+		}
+
+		{
+			// The main thread is done with the packets (see ~Renderer()).
+			std::size_t highWater = 0, overflows = 0;
+			for( auto const& arena : mArenas )
+			{
+				highWater = std::max( highWater, arena->high_water() );
+				overflows += arena->overflows();
+			}
+
+			std::printf( "Frame arenas: %zu x %.1f MiB, high water %.1f KiB, %zu overflows\n",
+				mArenas.size(), kFrameArenaBytes_ / (1024.0*1024.0),
+				highWater / 1024.0, overflows
+			);
+		}
+
+		capture.finish();
+		if( capture.written() || capture.failed() )
+			std::printf( "Captured %zu frames to '%s' (%zu failed, %zu stalls)\n", capture.written(), mConfig.captureDirectory.c_str(), capture.failed(), capture.stalls() );
+	}
+	catch( ... )
+	{
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			mError = std::current_exception();
+		}
+		mCondition.notify_all();
+	}
+}
+
+namespace
+{
+	Resources_::Resources_( std::vector<MaterialDesc> const& aMaterials, std::vector<MeshAsset> aMeshes, Renderer::Config const& aConfig )
+		: loaders( kLoaderThreads_ )
+		, program( {
+			{ GL_VERTEX_SHADER, "assets/default.vert" },
+			{ GL_FRAGMENT_SHADER, "assets/default.frag" }
+		} )
+		, depthProgram( {
+			{ GL_VERTEX_SHADER, "assets/depth.vert" },
+			{ GL_FRAGMENT_SHADER, "assets/depth.frag" }
+		} )
+		, text( "assets/DroidSansMonoDotted.ttf" )
+		, meshes( std::move(aMeshes), aConfig.meshBudgetBytes, aConfig.maxUploadBytesPerFrame, loaders )
+	{
+		// All materials go into one table, so each model is drawn with a
+		// single draw call regardless of how many materials it uses. The
+		// caller has already offset the meshes' material IDs.
+		[[maybe_unused]] auto const first = materials.add_materials( aMaterials );
+		assert( 0 == first );
+
+		materials.finalize( MaterialSystem::VirtualConfig{ aConfig.virtualTextureMinSize, aConfig.virtualTextureCachePages }, loaders );
+
+		meshes.set_pinned_bytes( materials.stats().textureBytes );
+
+		if( aConfig.terrainHeightfield )
+			terrainNormals = std::make_unique<TerrainNormals>( *aConfig.terrainHeightfield );
+	}
+
+	Resources_::~Resources_() = default;
+
+	Offscreen_::Offscreen_( int aWidth, int aHeight, GLenum aDepthFormat )
+		: width( aWidth )
+		, height( aHeight )
+	{
+		glGenTextures( 1, &color );
+		glBindTexture( GL_TEXTURE_2D, color );
+		glTexStorage2D( GL_TEXTURE_2D, 1, GL_SRGB8_ALPHA8, aWidth, aHeight );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+
+		glGenRenderbuffers( 1, &depth );
+		glBindRenderbuffer( GL_RENDERBUFFER, depth );
+		glRenderbufferStorage( GL_RENDERBUFFER, aDepthFormat, aWidth, aHeight );
+		glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+		glGenFramebuffers( 1, &fbo );
+		glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0 );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth );
+
+		auto const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+		if( GL_FRAMEBUFFER_COMPLETE != status )
+		{
+			glDeleteFramebuffers( 1, &fbo );
+			glDeleteRenderbuffers( 1, &depth );
+			glDeleteTextures( 1, &color );
+			throw Error( "Offscreen framebuffer (%dx%d) incomplete: %#x", aWidth, aHeight, unsigned(status) );
+		}
+	}
+
+	Offscreen_::~Offscreen_()
+	{
+		glDeleteFramebuffers( 1, &fbo );
+		glDeleteRenderbuffers( 1, &depth );
+		glDeleteTextures( 1, &color );
+	}
+
+	void blit_color_( Offscreen_ const& aSource, int aWidth, int aHeight, GLuint aTarget, int aTargetWidth, int aTargetHeight )
+	{
+		// Copy the (already sRGB encoded) color as is. When scaling, this
+		// filters the encoded values, which is close enough for upscaling.
+		glDisable( GL_FRAMEBUFFER_SRGB );
+
+		bool const sameSize = aWidth == aTargetWidth && aHeight == aTargetHeight;
+
+		glBindFramebuffer( GL_READ_FRAMEBUFFER, aSource.fbo );
+		glBindFramebuffer( GL_DRAW_FRAMEBUFFER, aTarget );
+		glBlitFramebuffer(
+			0, 0, aWidth, aHeight,
+			0, 0, aTargetWidth, aTargetHeight,
+			GL_COLOR_BUFFER_BIT, sameSize ? GL_NEAREST : GL_LINEAR
+		);
+
+		glEnable( GL_FRAMEBUFFER_SRGB );
+
+		OGL_CHECKPOINT_DEBUG();
+	}
+
+	void render_scopes_( Resources_& aRes, FramePacket const& aPacket, SceneTarget_ const& aTarget, float aFrameMs, bool aShowProfile )
+	{
+		GpuProfileScope frameScope( aRes.gpuProfiler, "frame" );
+
+		std::pmr::vector<std::uint32_t> drawOrder( aPacket.arena );
+
+		// Normals of meshes that were just uploaded without them; before
+		// anything draws the meshes.
+		generate_normals_( aRes );
+
+		if( aRes.shadows )
+			aRes.shadows->render( aPacket, aRes.meshes.meshes(), aRes.gpuProfiler );
+
+		aRes.lights.update( aPacket, aRes.gpuProfiler );
+
+		if( aTarget.scaled )
+			glBindFramebuffer( GL_FRAMEBUFFER, aTarget.scaled->fbo );
+
+		glViewport( 0, 0, aTarget.width, aTarget.height );
+
+		// Draw scene
+		OGL_CHECKPOINT_DEBUG();
+
+		{
+			GpuProfileScope sceneScope( aRes.gpuProfiler, "scene" );
+			PROFILE_SCOPE( "scene" );
+
+			// The scene target is sized for the maximum scale; only clear the
+			// part in use.
+			if( aTarget.scaled )
+			{
+				glEnable( GL_SCISSOR_TEST );
+				glScissor( 0, 0, aTarget.width, aTarget.height );
+			}
+
+			glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+			if( aTarget.scaled )
+				glDisable( GL_SCISSOR_TEST );
+
+			drawOrder = order_draws_( aRes, aPacket );
+
+			// Both passes must compute the same matrices (see depth.vert).
+			Mat44f const projCamera = aPacket.projection * aPacket.worldToCamera;
+
+			if( aRes.depthPrepass )
+			{
+				GpuProfileScope prepassScope( aRes.gpuProfiler, "depth pre-pass" );
+				aRes.pipelineStats.begin_pass( kPrepassStats_ );
+
+				glUseProgram( aRes.depthProgram.programId() );
+				glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+
+				for( auto const index : drawOrder )
+				{
+					auto const& item = aPacket.draws[index];
+					auto const& mesh = aRes.meshes.meshes()[item.mesh];
+
+					Mat44f const projCameraWorld = projCamera * item.world;
+					glUniformMatrix4fv( 0, 1, GL_TRUE, projCameraWorld.v );
+
+					glBindVertexArray( mesh.positionVao );
+					glDrawArrays( GL_TRIANGLES, 0, mesh.vertexCount );
+				}
+
+				glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+				glDepthMask( GL_FALSE );
+				glDepthFunc( GL_EQUAL );
+
+				aRes.pipelineStats.end_pass( kPrepassStats_ );
+			}
+
+			GpuProfileScope shadingScope( aRes.gpuProfiler, "shading" );
+			aRes.pipelineStats.begin_pass( kShadingStats_ );
+
+			glUseProgram( aRes.program.programId() );
+			aRes.materials.bind();
+
+			glUniform3f( 9, aPacket.cameraPosition.x, aPacket.cameraPosition.y, aPacket.cameraPosition.z );
+			glUniform3f( 10, aPacket.cameraForward.x, aPacket.cameraForward.y, aPacket.cameraForward.z );
+
+			if( aRes.shadows )
+				aRes.shadows->bind();
+			else
+				ShadowCascades::bind_disabled();
+
+			aRes.lights.bind( aPacket, aTarget.width, aTarget.height );
+
+			glUniform3f( 2, aPacket.lightDir.x, aPacket.lightDir.y, aPacket.lightDir.z );
+
+			for( auto const index : drawOrder )
+			{
+				auto const& item = aPacket.draws[index];
+				draw_mesh_( aRes.meshes.meshes()[item.mesh], projCamera * item.world, item.world );
+			}
+
+			glBindVertexArray( 0 );
+			glUseProgram( 0 );
+
+			aRes.pipelineStats.end_pass( kShadingStats_ );
+
+			if( aRes.depthPrepass )
+			{
+				glDepthMask( GL_TRUE );
+				glDepthFunc( aRes.depthFunc );
+			}
+		}
+
+		// Virtual texture feedback: the scene again, at a fraction of the
+		// resolution, recording the tiles it samples
+		if( auto* vt = aRes.materials.virtual_texture() )
+		{
+			GpuProfileScope feedbackScope( aRes.gpuProfiler, "vt feedback" );
+			PROFILE_SCOPE( "vt feedback" );
+
+			Mat44f jitter = kIdentity44f;
+			if( vt->begin_feedback( aTarget.width, aTarget.height, aPacket.frame, jitter ) )
+			{
+				// Materials and the page table are still bound. Only the
+				// texture coordinates are used, so only uProjCameraWorld is
+				// set (the other matrices are inactive).
+				Mat44f const projCamera = jitter * aPacket.projection * aPacket.worldToCamera;
+				for( auto const index : drawOrder )
+				{
+					auto const& item = aPacket.draws[index];
+					auto const& mesh = aRes.meshes.meshes()[item.mesh];
+
+					Mat44f const projCameraWorld = projCamera * item.world;
+					glUniformMatrix4fv( 0, 1, GL_TRUE, projCameraWorld.v );
+
+					glBindVertexArray( mesh.vao );
+					glDrawArrays( GL_TRIANGLES, 0, mesh.vertexCount );
+				}
+
+				glBindVertexArray( 0 );
+				vt->end_feedback();
+
+				glBindFramebuffer( GL_FRAMEBUFFER, aTarget.scaled ? aTarget.scaled->fbo : aTarget.output );
+				glViewport( 0, 0, aTarget.width, aTarget.height );
+			}
+		}
+
+		if( aTarget.scaled )
+		{
+			GpuProfileScope upscaleScope( aRes.gpuProfiler, "upscale" );
+			PROFILE_SCOPE( "upscale" );
+
+			blit_color_( *aTarget.scaled, aTarget.width, aTarget.height, aTarget.output, aPacket.framebufferWidth, aPacket.framebufferHeight );
+			glBindFramebuffer( GL_FRAMEBUFFER, aTarget.output );
+
+			glViewport( 0, 0, aPacket.framebufferWidth, aPacket.framebufferHeight );
+		}
+
+		// Overlay
+		GpuProfileScope overlayScope( aRes.gpuProfiler, "overlay" );
+		PROFILE_SCOPE( "overlay" );
+
+		auto const textStart = Clock::now();
+
+		aRes.text.begin( aPacket.arena );
+
+		float textBottom = 0.f;
+		for( auto const& item : aPacket.text )
+		{
+			aRes.text.draw( item.x, item.y, item.text, item.size, item.color );
+			textBottom = std::max( textBottom, item.y + item.size );
+		}
+
+		if( aShowProfile )
+			draw_gpu_profile_( aRes.text, aRes.gpuProfiler, textBottom + 6.f );
+
+		if( aPacket.textBenchmark )
+			draw_text_benchmark_( aRes.text, aPacket.frame );
+
+		auto const textFlush = Clock::now();
+		aRes.text.flush( aPacket.framebufferWidth, aPacket.framebufferHeight );
+
+		if( aPacket.textBenchmark )
+		{
+			auto const textEnd = Clock::now();
+
+			auto& bench = aRes.textBench;
+			bench.draw += to_ms_( textFlush - textStart );
+			bench.flush += to_ms_( textEnd - textFlush );
+			bench.frame += aFrameMs;
+
+			if( ++bench.frames == 240 )
+			{
+				float const n = float(bench.frames);
+				std::printf( "Text benchmark: %zu glyphs/frame, layout %.3f ms, flush %.3f ms (%zu draw call, %zu atlas bytes), frame %.3f ms\n",
+					aRes.text.stats().glyphs,
+					bench.draw / n,
+					bench.flush / n,
+					aRes.text.stats().drawCalls,
+					aRes.text.stats().atlasBytes,
+					bench.frame / n
+				);
+				bench = Resources_::TextBenchmarkTimes{};
+			}
+		}
+
+		OGL_CHECKPOINT_DEBUG();
+	}
+
+	void generate_normals_( Resources_& aRes )
+	{
+		auto const& meshes = aRes.meshes.meshes();
+		auto const& uploaded = aRes.meshes.uploaded();
+
+		bool const any = std::any_of( uploaded.begin(), uploaded.end(), [&meshes] (std::uint32_t aMesh) {
+			return meshes[aMesh].generatedNormals;
+		} );
+		if( !any )
+			return;
+
+		if( !aRes.terrainNormals )
+			throw Error( "Mesh without normals, but no terrain heightfield to generate them from" );
+
+		GpuProfileScope normalScope( aRes.gpuProfiler, "terrain normals" );
+		PROFILE_SCOPE( "terrain normals" );
+
+		for( auto const index : uploaded )
+		{
+			if( meshes[index].generatedNormals )
+				aRes.terrainNormals->generate( meshes[index] );
+		}
+	}
+
+	void render_( Resources_& aRes, FramePacket const& aPacket, SceneTarget_ const& aTarget, float aFrameMs, bool aShowProfile )
+	{
+		// Map GPU timestamps onto the CPU profiler's timeline. Results arrive
+		// a few frames late, but the clocks drift far more slowly than that.
+		if( profiler_capturing() )
+		{
+			GLint64 gpuNow = 0;
+			glGetInteger64v( GL_TIMESTAMP, &gpuNow );
+			aRes.gpuToCpuNs = profiler_now_ns() - std::int64_t(gpuNow);
+		}
+
+		aRes.gpuProfiler.begin_frame( aPacket.frame );
+		aRes.pipelineStats.begin_frame();
+
+		// Upload meshes that finished loading, and request this frame's.
+		// Cached shadow cascades do not include meshes that just arrived.
+		aRes.meshes.begin_frame( aPacket.frame );
+		for( auto const& item : aPacket.draws )
+			aRes.meshes.request( item.mesh );
+
+		if( aRes.shadows && aRes.meshes.uploaded_this_frame() )
+			aRes.shadows->invalidate_cached();
+
+		// Feedback from a few frames ago; uploads pages for this frame.
+		if( auto* vt = aRes.materials.virtual_texture() )
+			vt->update( aPacket.frame );
+
+		render_scopes_( aRes, aPacket, aTarget, aFrameMs, aShowProfile );
+
+		aRes.meshes.end_frame();
+
+		aRes.pipelineStats.end_frame();
+		aRes.gpuProfiler.end_frame();
+	}
+
+	void forward_gpu_scope_( void* aSink, std::uint64_t aFrame, char const* aName, std::size_t aDepth, GLuint64 aBegin, GLuint64 aEnd )
+	{
+		auto const& sink = *static_cast<GpuScopeSink_*>(aSink);
+
+		auto const offset = sink.resources->gpuToCpuNs;
+		profiler_add_gpu_event( aName, std::int64_t(aBegin) + offset, std::int64_t(aEnd) + offset );
+
+		// The outermost scope covers the whole frame.
+		if( 0 != aDepth )
+			return;
+
+		float const gpuMs = aEnd > aBegin ? float(aEnd - aBegin) * 1e-6f : 0.f;
+
+		if( sink.resources->resolution )
+			sink.resources->resolution->add_sample( std::size_t(aFrame), gpuMs );
+
+		// Its frame was recorded a few frames ago, so search from the back.
+		if( sink.frameTimes )
+		{
+			std::lock_guard<std::mutex> lock( *sink.mutex );
+
+			auto& times = *sink.frameTimes;
+			auto const it = std::find_if( times.rbegin(), times.rend(), [&] (Renderer::FrameTimes const& aTimes) {
+				return aTimes.frame == aFrame;
+			} );
+
+			if( times.rend() != it )
+				it->gpuMs = gpuMs;
+		}
+	}
+
+	void draw_gpu_profile_( TextRenderer& aText, GpuProfiler const& aProfiler, float aY )
+	{
+		constexpr float kSize = 14.f;
+		std::uint32_t const color = text_rgba( 160, 255, 160 );
+
+		char line[128];
+		std::snprintf( line, sizeof(line), "%-14s %6s %6s %6s %6s", "GPU (ms)", "last", "min", "avg", "max" );
+		aText.draw( 10.f, aY, line, kSize, color );
+		aY += kSize + 2.f;
+
+		for( auto const& s : aProfiler.stats() )
+		{
+			std::snprintf( line, sizeof(line), "%*s%-*s %6.2f %6.2f %6.2f %6.2f",
+				int(2*s.depth), "",
+				int(14 - std::min<std::size_t>( 2*s.depth, 14 )), s.name.c_str(),
+				s.lastMs, s.minMs, s.avgMs, s.maxMs
+			);
+			aText.draw( 10.f, aY, line, kSize, color );
+			aY += kSize + 2.f;
+		}
+	}
+
+	void draw_mesh_( GpuMesh const& aMesh, Mat44f const& aProjCameraWorld, Mat44f const& aWorld )
+	{
+		Mat33f const normalMatrix = mat44_to_mat33( transpose(invert(aWorld)) );
+
+		glUniformMatrix4fv( 0, 1, GL_TRUE, aProjCameraWorld.v );
+		glUniformMatrix3fv( 1, 1, GL_TRUE, normalMatrix.v );
+		glUniformMatrix4fv( 3, 1, GL_TRUE, aWorld.v );
+
+		glBindVertexArray( aMesh.vao );
+		glDrawArrays( GL_TRIANGLES, 0, aMesh.vertexCount );
+	}
+
+	std::pmr::vector<std::uint32_t> order_draws_( Resources_& aRes, FramePacket const& aPacket )
+	{
+		std::pmr::vector<std::uint32_t> order( aPacket.arena );
+		order.reserve( aPacket.draws.size() );
+
+		// Keys are indexed by draw, including skipped ones.
+		std::pmr::vector<float> keys( aPacket.draws.size(), aPacket.arena );
+		for( std::size_t i = 0; i < aPacket.draws.size(); ++i )
+		{
+			auto const& item = aPacket.draws[i];
+			assert( item.mesh < aRes.meshes.meshes().size() );
+
+			// Not loaded yet
+			auto const& mesh = aRes.meshes.meshes()[item.mesh];
+			if( 0 == mesh.vertexCount )
+				continue;
+
+			// Distance to the nearest point of the bounding sphere (zero if
+			// the camera is inside)
+			BoundingSphere const bounds = world_bounds( mesh, item.world );
+			keys[i] = std::max( 0.f, length( bounds.center - aPacket.cameraPosition ) - bounds.radius );
+			order.emplace_back( std::uint32_t(i) );
+		}
+
+		if( aRes.sortFrontToBack )
+		{
+			// Ties keep submission order. Not std::stable_sort(), which
+			// allocates a temporary buffer each frame.
+			std::sort( order.begin(), order.end(), [&keys] (std::uint32_t aA, std::uint32_t aB) {
+				return keys[aA] < keys[aB] || (keys[aA] == keys[aB] && aA < aB);
+			} );
+		}
+
+		return order;
+	}
+
+	void draw_text_benchmark_( TextRenderer& aText, std::size_t aFrame )
+	{
+		// 100 lines of 100 characters, different every frame
+		constexpr std::size_t kLines = 100;
+		constexpr std::size_t kColumns = 100;
+
+		char line[kColumns+1];
+		for( std::size_t i = 0; i < kLines; ++i )
+		{
+			for( std::size_t j = 0; j < kColumns; ++j )
+				line[j] = char('!' + (aFrame + i*7 + j*13) % 94);
+			line[kColumns] = '\0';
+
+			aText.draw( 10.f, 40.f + i * 6.5f, line, 7.f, text_rgba( 255, 255, 255, 160 ) );
+		}
+	}
+}
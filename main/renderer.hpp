@@ -0,0 +1,258 @@
+#ifndef RENDERER_HPP_2D2EC794_5212_4E41_BAB5_E8EAAC29F233
+#define RENDERER_HPP_2D2EC794_5212_4E41_BAB5_E8EAAC29F233
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <condition_variable>
+
+#include "../support/debug_output.hpp"
+
+#include "defaults.hpp"
+#include "material.hpp"
+#include "shadow_map.hpp"
+#include "frame_packet.hpp"
+#include "mesh_residency.hpp"
+#include "terrain_normals.hpp"
+#include "virtual_texture.hpp"
+
+struct GLFWwindow;
+
+/* Render thread
+ *
+ * The Renderer owns the window's GL context. Its thread makes the context
+ * current, creates the GL resources (shaders, materials, text) passed to the
+ * constructor, and then draws the FramePackets submitted by the main
+ * thread, calling glfwSwapBuffers() after each. Meshes are loaded when a
+ * packet first draws them, and evicted when over the GPU memory budget (see
+ * MeshResidency); draws of meshes that are not loaded yet are skipped.
+ *
+ * Packets are passed through a small ring of aPipelineDepth+1 slots: with a
+ * depth of 1 (double buffering), the main thread prepares frame N+1 while
+ * the render thread draws frame N; with a depth of 2 (triple buffering) it
+ * may run one more frame ahead. acquire() blocks when the main thread is
+ * further ahead than that.
+ *
+ * The constructor blocks until the render thread has finished initializing,
+ * and rethrows any error it encountered. Errors on the render thread later
+ * on are rethrown by the next acquire().
+ */
+class Renderer final
+{
+	public:
+		static constexpr std::size_t kMaxPipelineDepth = 3;
+
+		// CPU time on the render thread for the most recent frame.
+		struct Timings
+		{
+			float renderMs; // building GL commands
+			float swapMs;   // in glfwSwapBuffers()
+			float waitMs;   // waiting for a packet
+			float fenceMs;  // waiting for the GPU (Config::maxFramesInFlight)
+			std::size_t frames;
+
+			// Most recent estimate of the time from sampling input to the
+			// GPU finishing the frame (see FramePacer)
+			float latencyMs;
+
+			// GL debug messages during the most recent frame
+			GlDebugFrameStats gl;
+
+			// Shadow cascades (all zero without shadows)
+			ShadowStats shadows;
+
+			// Fragment shader invocations in the most recent frame with
+			// results (see PipelineStats; all zero if not available).
+			std::uint64_t prepassFragments;
+			std::uint64_t shadingFragments;
+
+			// Scene resolution of the most recent frame: the framebuffer
+			// size times resolutionScale (1 without dynamic resolution).
+			int sceneWidth, sceneHeight;
+			float resolutionScale;
+
+			// Heap allocations by the render thread so far (operator new;
+			// see thread_heap_allocations())
+			std::uint64_t heapAllocations;
+
+			// Mesh residency after the most recent frame
+			ResidencyStats residency;
+
+			// Virtual texture cache (all zero without a virtual texture)
+			VirtualTextureCacheStats virtualTexture;
+		};
+
+		// Per frame times, with Config::recordFrameTimes.
+		struct FrameTimes
+		{
+			std::size_t frame; // FramePacket::frame
+			float renderMs;    // CPU, building GL commands
+			float gpuMs;       // GPU, outermost scope; < 0 if not available
+		};
+
+		struct Config
+		{
+			std::size_t pipelineDepth = 1;
+
+			// Swap interval: 1 = V-Sync, 0 = off, -1 = adaptive (V-Sync,
+			// but frames that miss the vertical blank are swapped
+			// immediately, with tearing). Adaptive requires
+			// {GLX,WGL}_EXT_swap_control_tear and falls back to V-Sync.
+			int swapInterval = 1;
+
+			// Frames the render thread may run ahead of the GPU (1 to
+			// FramePacer::kMaxInFlight), enforced with fences.
+			std::size_t maxFramesInFlight = 2;
+
+			// Show GPU timings in the overlay and print a summary to the
+			// console periodically and at exit.
+			bool gpuProfile = false;
+
+			// GL debug output and checkpoints. Performance warnings are
+			// reported per frame on the console.
+			GlValidation validation = default_gl_validation();
+
+			// Render into an offscreen framebuffer of this size instead of
+			// the window's default framebuffer (headless benchmarks). The
+			// window is still swapped. 0: draw to the window.
+			int offscreenWidth = 0, offscreenHeight = 0;
+
+			// Reverse-Z: [0,1] clip space depth (glClipControl(), GL 4.5),
+			// depth 1 at the near plane, GL_GREATER. Falls back to the
+			// standard depth mapping if glClipControl() is not available;
+			// check reverse_z().
+			bool reverseZ = true;
+
+			// 32-bit float depth buffer. The default framebuffer only has a
+			// 24-bit fixed point one, so when drawing to the window, frames
+			// are drawn into a framebuffer object and blitted to the window
+			// (with dynamic resolution, the scene target takes that role).
+			bool floatDepth = true;
+
+			// Cascaded shadow maps (see shadow_map.hpp): resolution of each
+			// cascade, and view distance covered.
+			bool shadows = true;
+			int shadowResolution = 2048;
+			float shadowDistance = 150.f;
+
+			// Depth pre-pass: draw all meshes depth only (positions only,
+			// trivial fragment shader), then shade with GL_EQUAL, so that
+			// each pixel is shaded once. Otherwise, meshes are shaded in a
+			// single pass and early depth testing only rejects fragments
+			// behind what has been drawn before.
+			bool depthPrepass = false;
+
+			// Draw meshes front to back (by the nearest point of their
+			// bounding spheres) rather than in packet order.
+			bool sortFrontToBack = true;
+
+			// Dynamic resolution (see dynamic_resolution.hpp): draw the
+			// scene into a separate target at a scale between the two
+			// bounds, chosen to keep the GPU frame time within the budget,
+			// then upscale it (bilinear) to the framebuffer and draw the
+			// overlay at full size.
+			bool dynamicResolution = false;
+			float minResolutionScale = 0.5f;
+			float maxResolutionScale = 1.f;
+			float gpuBudgetMs = 14.f;
+
+			// Frames with FramePacket::capture set are written to
+			// <captureDirectory>/frame_<frame>.png (frame number zero
+			// padded to five digits).
+			std::string captureDirectory = ".";
+
+			// Keep the times of every frame (see frame_times()). Room for
+			// expectedFrames is reserved up front, so that recording does
+			// not allocate in the render loop (0: unknown).
+			bool recordFrameTimes = false;
+			std::size_t expectedFrames = 0;
+
+			// GPU memory budget for meshes and textures (textures are
+			// always resident and count against it); least recently used
+			// meshes are evicted beyond it. 0: unlimited. At most
+			// maxUploadBytesPerFrame of loaded meshes are uploaded per frame
+			// (but at least one mesh).
+			std::uint64_t meshBudgetBytes = 0;
+			std::uint64_t maxUploadBytesPerFrame = 64*1024*1024;
+
+			// Textures at least this large (width or height) are drawn
+			// as a virtual texture, from a cache of virtualTextureCachePages
+			// x virtualTextureCachePages pages (see VirtualTexture). 0: no
+			// virtual textures.
+			std::uint32_t virtualTextureMinSize = 8192;
+			std::size_t virtualTextureCachePages = 16;
+
+			// Heights of the terrain, for meshes without normals (see
+			// create_gpu_mesh()): their normals are generated on the GPU
+			// when they are uploaded (see TerrainNormals). Null: all meshes
+			// carry their normals.
+			std::shared_ptr<Heightfield const> terrainHeightfield;
+		};
+
+	public:
+		// Material IDs in the meshes index aMaterials. DrawItem::mesh
+		// indexes aMeshes.
+		Renderer( GLFWwindow*, std::vector<MaterialDesc> aMaterials, std::vector<MeshAsset> aMeshes, Config const& );
+		~Renderer();
+
+		Renderer( Renderer const& ) = delete;
+		Renderer& operator= (Renderer const&) = delete;
+
+	public:
+		// Main thread: get the next free packet. Blocks until one is
+		// available.
+		FramePacket& acquire();
+
+		// Main thread: hand the packet returned by acquire() to the render
+		// thread.
+		void submit();
+
+		Timings timings() const;
+
+		// Times of all frames drawn so far, in order. GPU times are
+		// collected a few frames late (GpuProfiler::kFrameLatency), so the
+		// most recent frames do not have one yet.
+		std::vector<FrameTimes> frame_times() const;
+
+		// GL_RENDERER of the context
+		std::string const& gl_renderer() const noexcept;
+
+		// Whether reverse-Z is in use. Projection matrices must match:
+		// make_(infinite_)reverse_z_projection() if true, otherwise
+		// make_perspective_projection().
+		bool reverse_z() const noexcept;
+
+	private:
+		void run_( std::vector<MaterialDesc>, std::vector<MeshAsset> );
+
+	private:
+		GLFWwindow* mWindow;
+		Config mConfig;
+
+		std::vector<std::unique_ptr<FrameArena>> mArenas; // one per packet
+		std::vector<FramePacket> mPackets;
+		std::size_t mWriteIndex, mReadIndex;
+		std::size_t mReady;
+		bool mAcquired;
+
+		bool mStarted;
+		bool mStop;
+		std::exception_ptr mError;
+
+		Timings mTimings;
+		std::vector<FrameTimes> mFrameTimes;
+		std::string mGlRenderer; // Set before the constructor returns
+		bool mReverseZ;          // Ditto
+
+		mutable std::mutex mMutex;
+		std::condition_variable mCondition;
+
+		std::thread mThread;
+};
+
+#endif // RENDERER_HPP_2D2EC794_5212_4E41_BAB5_E8EAAC29F233
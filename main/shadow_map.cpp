@@ -0,0 +1,390 @@
+#include "shadow_map.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+#include "../support/gpu_profiler.hpp"
+
+#include "cpu_profiler.hpp"
+
+namespace
+{
+	// Split scheme: 0 = uniform, 1 = logarithmic
+	constexpr float kSplitLambda_ = 0.75f;
+
+	// Cached cascades cover a sphere this much larger than needed, so that
+	// the camera can move a bit before they have to be re-rendered.
+	constexpr float kCachePadding_ = 0.2f;
+
+	// Re-render cached cascades when the light turns by more than this
+	// (cosine of ~0.5 degrees).
+	constexpr float kCacheMinLightCos_ = 0.99996f;
+
+	// Depth bias for rendering (slope scaled, constant) and normal offset
+	// for the lookup (in texels, see default.frag).
+	constexpr float kSlopeBias_ = 2.f;
+	constexpr float kConstantBias_ = 2.f;
+
+	// Uniform locations in the mesh program (default.vert/default.frag)
+	constexpr GLint kShadowMatricesLocation_ = 4; // mat4[4], 4..7
+	constexpr GLint kCascadeEndsLocation_ = 8;
+	constexpr GLint kShadowCascadesLocation_ = 11;
+	constexpr GLint kShadowTexelSizesLocation_ = 12;
+
+	char const* const kCascadeScopeNames_[kShadowCascades] = {
+		"cascade 0", "cascade 1", "cascade 2", "cascade 3"
+	};
+
+	// Camera frame and field of view. The field of view is read from the
+	// projection matrix, which works for all projections in mat44.hpp.
+	struct ViewFrustum_
+	{
+		Vec3f position, forward;
+		float tanX, tanY;
+	};
+
+	ViewFrustum_ view_frustum_( FramePacket const& aPacket ) noexcept
+	{
+		ViewFrustum_ ret;
+		ret.position = aPacket.cameraPosition;
+		ret.forward = aPacket.cameraForward;
+		ret.tanX = 1.f / aPacket.projection(0,0);
+		ret.tanY = 1.f / aPacket.projection(1,1);
+		return ret;
+	}
+
+	// Cascade splits between the near plane and aDistance
+	float split_( std::size_t aIndex, float aNear, float aDistance ) noexcept
+	{
+		float const t = float(aIndex) / float(kShadowCascades);
+		float const logarithmic = aNear * std::pow( aDistance / aNear, t );
+		float const uniform = aNear + (aDistance - aNear) * t;
+		return kSplitLambda_ * logarithmic + (1.f - kSplitLambda_) * uniform;
+	}
+
+	// Smallest sphere around the slice [aStart, aEnd] of the frustum. The
+	// center lies on the view axis; its radius depends only on the slice
+	// and the field of view, not on the camera orientation.
+	BoundingSphere slice_sphere_( ViewFrustum_ const& aView, float aStart, float aEnd ) noexcept
+	{
+		float const k2 = aView.tanX*aView.tanX + aView.tanY*aView.tanY;
+
+		// Equidistant from the near and far corners, unless that is beyond
+		// the far plane.
+		float const t = std::min( aEnd, 0.5f * (aStart + aEnd) * (1.f + k2) );
+
+		float const toNear = std::sqrt( (t-aStart)*(t-aStart) + aStart*aStart*k2 );
+		float const toFar = std::sqrt( (aEnd-t)*(aEnd-t) + aEnd*aEnd*k2 );
+
+		return BoundingSphere{ aView.position + t * aView.forward, std::max( toNear, toFar ) };
+	}
+
+	// Light space: looking along -aLightDir (aLightDir points towards the
+	// light), no translation.
+	Mat44f light_view_( Vec3f aLightDir ) noexcept
+	{
+		Vec3f const up = std::abs( aLightDir.y ) < 0.99f ? Vec3f{ 0.f, 1.f, 0.f } : Vec3f{ 1.f, 0.f, 0.f };
+		Vec3f const x = normalize( cross( up, aLightDir ) );
+		Vec3f const y = cross( aLightDir, x );
+
+		return Mat44f{
+			x.x,         x.y,         x.z,         0.f,
+			y.x,         y.y,         y.z,         0.f,
+			aLightDir.x, aLightDir.y, aLightDir.z, 0.f,
+			0.f,         0.f,         0.f,         1.f
+		};
+	}
+
+	Vec3f transform_point_( Mat44f const& aM, Vec3f aP ) noexcept
+	{
+		Vec4f const r = aM * Vec4f{ aP.x, aP.y, aP.z, 1.f };
+		return Vec3f{ r.x, r.y, r.z };
+	}
+
+	// Sphere (light space) overlaps the cascade's box, or lies between the
+	// box and the light.
+	bool overlaps_( Vec3f aLightCenter, float aRadius, BoundingSphere const& aCaster ) noexcept
+	{
+		float const r = aRadius + aCaster.radius;
+		return std::abs( aCaster.center.x - aLightCenter.x ) <= r
+			&& std::abs( aCaster.center.y - aLightCenter.y ) <= r
+			&& aCaster.center.z + aCaster.radius >= aLightCenter.z - aRadius
+		;
+	}
+}
+
+ShadowCascades::ShadowCascades( int aResolution, float aDistance, bool aZeroToOneDepth, bool aReverseZ )
+	: mResolution( aResolution )
+	, mDistance( aDistance )
+	, mZeroToOneDepth( aZeroToOneDepth )
+	, mReverseZ( aReverseZ )
+	, mTexture( 0 )
+	, mFbo( 0 )
+	, mProgram( {
+		{ GL_VERTEX_SHADER, "assets/shadow.vert" }
+	} )
+	, mCascades{}
+	, mStats{}
+{
+	if( aResolution < 16 || !(aDistance > 0.f) )
+		throw Error( "ShadowCascades: invalid resolution (%d) or distance (%f)", aResolution, double(aDistance) );
+
+	glGenTextures( 1, &mTexture );
+	glBindTexture( GL_TEXTURE_2D_ARRAY, mTexture );
+	glTexStorage3D( GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, aResolution, aResolution, GLsizei(kShadowCascades) );
+
+	// Hardware PCF. Outside of the map: lit.
+	float const border[] = { 1.f, 1.f, 1.f, 1.f };
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
+	glTexParameterfv( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+	glBindTexture( GL_TEXTURE_2D_ARRAY, 0 );
+
+	GLint prevFbo = 0;
+	glGetIntegerv( GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo );
+
+	glGenFramebuffers( 1, &mFbo );
+	glBindFramebuffer( GL_FRAMEBUFFER, mFbo );
+	glFramebufferTextureLayer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mTexture, 0, 0 );
+	glDrawBuffer( GL_NONE );
+	glReadBuffer( GL_NONE );
+
+	auto const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	glBindFramebuffer( GL_FRAMEBUFFER, GLuint(prevFbo) );
+
+	if( GL_FRAMEBUFFER_COMPLETE != status )
+	{
+		glDeleteFramebuffers( 1, &mFbo );
+		glDeleteTextures( 1, &mTexture );
+		throw Error( "Shadow map framebuffer (%d x %d x %zu) incomplete: %#x", aResolution, aResolution, kShadowCascades, unsigned(status) );
+	}
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+ShadowCascades::~ShadowCascades()
+{
+	glDeleteFramebuffers( 1, &mFbo );
+	glDeleteTextures( 1, &mTexture );
+}
+
+void ShadowCascades::render( FramePacket const& aPacket, std::vector<GpuMesh> const& aMeshes, GpuProfiler& aProfiler )
+{
+	GpuProfileScope shadowScope( aProfiler, "shadows" );
+	PROFILE_SCOPE( "shadows" );
+
+	ViewFrustum_ const view = view_frustum_( aPacket );
+	Vec3f const lightDir = normalize( aPacket.lightDir );
+	Mat44f const lightView = light_view_( lightDir );
+
+	GLint prevFbo = 0;
+	glGetIntegerv( GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo );
+
+	bool stateSet = false;
+
+	++mStats.frames;
+
+	// Cascade 0 starts at the near plane.
+	assert( aPacket.nearPlane > 0.f && aPacket.nearPlane < mDistance );
+	float start = aPacket.nearPlane;
+	for( std::size_t i = 0; i < kShadowCascades; ++i )
+	{
+		auto& cascade = mCascades[i];
+		cascade.end = split_( i+1, aPacket.nearPlane, mDistance );
+
+		BoundingSphere const slice = slice_sphere_( view, start, cascade.end );
+		start = cascade.end;
+
+		// Is the cached cascade still good?
+		bool const cached = i >= kFirstCachedCascade;
+		bool needed = !cached
+			|| !cascade.valid
+			|| dot( cascade.lightDir, lightDir ) < kCacheMinLightCos_
+			|| length( slice.center - cascade.center ) + slice.radius > cascade.radius
+		;
+
+		// Dynamic casters, then and now. One that has left the cascade
+		// since still casts its old shadow in the map.
+		for( auto const& bounds : cascade.dynamicCasters )
+		{
+			if( needed )
+				break;
+
+			needed = overlaps_( cascade.lightCenter, cascade.radius, bounds );
+		}
+
+		for( auto const& item : aPacket.draws )
+		{
+			if( needed )
+				break;
+
+			if( item.dynamic )
+			{
+				BoundingSphere bounds = world_bounds( aMeshes[item.mesh], item.world );
+				bounds.center = transform_point_( lightView, bounds.center );
+				needed = overlaps_( cascade.lightCenter, cascade.radius, bounds );
+			}
+		}
+
+		mStats.rendered[i] = needed;
+		if( !needed )
+			continue;
+
+		fit_( cascade, slice.center, cached ? slice.radius * (1.f + kCachePadding_) : slice.radius, lightDir, lightView );
+
+		GpuProfileScope cascadeScope( aProfiler, kCascadeScopeNames_[i] );
+
+		if( !stateSet )
+		{
+			glBindFramebuffer( GL_FRAMEBUFFER, mFbo );
+			glViewport( 0, 0, mResolution, mResolution );
+
+			glUseProgram( mProgram.programId() );
+
+			glDepthFunc( GL_LESS );
+			glEnable( GL_DEPTH_CLAMP );
+			glEnable( GL_POLYGON_OFFSET_FILL );
+			glPolygonOffset( kSlopeBias_, kConstantBias_ );
+
+			stateSet = true;
+		}
+
+		glFramebufferTextureLayer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mTexture, 0, GLint(i) );
+
+		float const clearDepth = 1.f;
+		glClearBufferfv( GL_DEPTH, 0, &clearDepth );
+
+		cascade.dynamicCasters.clear();
+
+		std::size_t casters = 0;
+		for( auto const& item : aPacket.draws )
+		{
+			assert( item.mesh < aMeshes.size() );
+			auto const& mesh = aMeshes[item.mesh];
+			if( 0 == mesh.vertexCount )
+				continue;
+
+			BoundingSphere bounds = world_bounds( mesh, item.world );
+			bounds.center = transform_point_( lightView, bounds.center );
+			if( !overlaps_( cascade.lightCenter, cascade.radius, bounds ) )
+				continue;
+
+			if( item.dynamic )
+				cascade.dynamicCasters.emplace_back( bounds );
+
+			Mat44f const projWorld = cascade.viewProj * item.world;
+			glUniformMatrix4fv( 0, 1, GL_TRUE, projWorld.v );
+
+			glBindVertexArray( mesh.positionVao );
+			glDrawArrays( GL_TRIANGLES, 0, mesh.vertexCount );
+			++casters;
+		}
+
+		mStats.casters[i] = casters;
+		++mStats.renders[i];
+	}
+
+	if( stateSet )
+	{
+		glBindVertexArray( 0 );
+		glUseProgram( 0 );
+
+		glDisable( GL_POLYGON_OFFSET_FILL );
+		glDisable( GL_DEPTH_CLAMP );
+		glDepthFunc( mReverseZ ? GL_GREATER : GL_LESS );
+
+		glBindFramebuffer( GL_FRAMEBUFFER, GLuint(prevFbo) );
+	}
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+void ShadowCascades::invalidate_cached() noexcept
+{
+	for( std::size_t i = kFirstCachedCascade; i < kShadowCascades; ++i )
+		mCascades[i].valid = false;
+}
+
+void ShadowCascades::bind() const
+{
+	Mat44f matrices[kShadowCascades];
+	float ends[kShadowCascades], texels[kShadowCascades];
+	for( std::size_t i = 0; i < kShadowCascades; ++i )
+	{
+		matrices[i] = mCascades[i].shadowMatrix;
+		ends[i] = mCascades[i].end;
+		texels[i] = 2.f * mCascades[i].radius / float(mResolution);
+	}
+
+	static_assert( 4 == kShadowCascades, "Shader uniforms are vec4s" );
+	glUniformMatrix4fv( kShadowMatricesLocation_, GLsizei(kShadowCascades), GL_TRUE, matrices[0].v );
+	glUniform4fv( kCascadeEndsLocation_, 1, ends );
+	glUniform4fv( kShadowTexelSizesLocation_, 1, texels );
+	glUniform1i( kShadowCascadesLocation_, GLint(kShadowCascades) );
+
+	glActiveTexture( GL_TEXTURE0 + kTextureUnit );
+	glBindTexture( GL_TEXTURE_2D_ARRAY, mTexture );
+	glActiveTexture( GL_TEXTURE0 );
+}
+
+void ShadowCascades::bind_disabled()
+{
+	glUniform1i( kShadowCascadesLocation_, 0 );
+}
+
+ShadowStats const& ShadowCascades::stats() const noexcept
+{
+	return mStats;
+}
+
+void ShadowCascades::fit_( Cascade_& aCascade, Vec3f aCenter, float aRadius, Vec3f aLightDir, Mat44f const& aLightView ) const
+{
+	// Snap the center to whole texels (in light space), so that moving the
+	// camera moves the shadow map by whole texels.
+	float const texel = 2.f * aRadius / float(mResolution);
+
+	Vec3f center = transform_point_( aLightView, aCenter );
+	center.x = std::floor( center.x / texel ) * texel;
+	center.y = std::floor( center.y / texel ) * texel;
+
+	// Light space looks down -Z, so the near plane (towards the light) is
+	// at z = center.z + radius.
+	Mat44f const ortho = make_orthographic_projection(
+		center.x - aRadius, center.x + aRadius,
+		center.y - aRadius, center.y + aRadius,
+		-(center.z + aRadius), -(center.z - aRadius)
+	);
+
+	// Rendering: with GL_ZERO_TO_ONE, map [-1,1] to [0,1] ourselves, so that
+	// the stored depth is the same in both cases.
+	Mat44f const zeroToOne{
+		1.f, 0.f, 0.f, 0.f,
+		0.f, 1.f, 0.f, 0.f,
+		0.f, 0.f, 0.5f, 0.5f,
+		0.f, 0.f, 0.f, 1.f
+	};
+
+	// Lookup: [-1,1] to [0,1] on all axes
+	Mat44f const bias{
+		0.5f, 0.f,  0.f,  0.5f,
+		0.f,  0.5f, 0.f,  0.5f,
+		0.f,  0.f,  0.5f, 0.5f,
+		0.f,  0.f,  0.f,  1.f
+	};
+
+	aCascade.center = aCenter;
+	aCascade.radius = aRadius;
+	aCascade.lightDir = aLightDir;
+	aCascade.lightCenter = center;
+	aCascade.viewProj = (mZeroToOneDepth ? zeroToOne * ortho : ortho) * aLightView;
+	aCascade.shadowMatrix = bias * ortho * aLightView;
+	aCascade.valid = true;
+}
@@ -0,0 +1,136 @@
+#ifndef SHADOW_MAP_HPP_1BF77CD8_87FC_42EA_92FE_D2D33F787A5D
+#define SHADOW_MAP_HPP_1BF77CD8_87FC_42EA_92FE_D2D33F787A5D
+
+#include <glad.h>
+
+#include <vector>
+#include <cstddef>
+
+#include "../support/program.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "simple_mesh.hpp"
+#include "frame_packet.hpp"
+
+class GpuProfiler;
+
+constexpr std::size_t kShadowCascades = 4;
+
+// Per cascade statistics, for tuning.
+struct ShadowStats
+{
+	std::size_t casters[kShadowCascades]; // instances after culling, when last rendered
+	bool rendered[kShadowCascades];       // re-rendered in the last frame
+	std::size_t renders[kShadowCascades]; // frames in which it was rendered
+	std::size_t frames;
+};
+
+/* Cascaded shadow maps for the sun
+ *
+ * The view frustum, from the packet's near plane up to aDistance from the
+ * camera, is split into kShadowCascades slices (a blend of logarithmic and
+ * uniform splits). Each cascade covers the bounding sphere of its slice
+ * with an orthographic projection along the light direction. The sphere's
+ * size only depends on the field of view, and its center is snapped to
+ * whole shadow map texels in light space, so the shadows do not shimmer
+ * when the camera moves or turns.
+ * Casters between the cascade and the sun are clamped to the near plane
+ * (GL_DEPTH_CLAMP) rather than extending the depth range.
+ *
+ * All cascades are layers of one GL_DEPTH_COMPONENT32F texture array, read
+ * with hardware depth comparison (sampler2DArrayShadow, 2x2 PCF).
+ *
+ * Cascades from kFirstCachedCascade on are cached: they cover a slightly
+ * larger sphere than needed, and are only re-rendered when the slice leaves
+ * that sphere (camera movement), when the light direction changes by more
+ * than a small angle, when a dynamic DrawItem falls into the cascade or fell
+ * into it when it was last rendered (so that a caster that moved out does
+ * not leave its old shadow behind), or after invalidate_cached().
+ * The near cascades are re-rendered every frame.
+ *
+ * Each rendered cascade has its own GpuProfiler scope ("cascade N", inside
+ * "shadows").
+ *
+ * Mesh programs read the shadow map via the uniforms set by bind(); see
+ * assets/default.frag.
+ */
+class ShadowCascades final
+{
+	public:
+		static constexpr std::size_t kFirstCachedCascade = 2;
+
+		// Texture unit of the shadow map (after the material texture arrays)
+		static constexpr GLuint kTextureUnit = 4;
+
+	public:
+		// aZeroToOneDepth: glClipControl( ..., GL_ZERO_TO_ONE ) is active.
+		// aReverseZ: the main pass uses GL_GREATER (restored after
+		// rendering the cascades).
+		ShadowCascades( int aResolution, float aDistance, bool aZeroToOneDepth, bool aReverseZ );
+		~ShadowCascades();
+
+		ShadowCascades( ShadowCascades const& ) = delete;
+		ShadowCascades& operator= (ShadowCascades const&) = delete;
+
+	public:
+		// Fit the cascades to the packet's camera and render those that need
+		// it. Restores the framebuffer binding and depth function; the
+		// caller sets the viewport afterwards.
+		// Meshes with a vertexCount of zero (not loaded) are skipped.
+		void render( FramePacket const&, std::vector<GpuMesh> const&, GpuProfiler& );
+
+		// Re-render the cached cascades in the next render() (e.g., when
+		// meshes were loaded).
+		void invalidate_cached() noexcept;
+
+		// Bind the shadow map and set the shadow uniforms. The mesh program
+		// must be current.
+		void bind() const;
+
+		// Without shadows: tell the mesh program (must be current).
+		static void bind_disabled();
+
+		ShadowStats const& stats() const noexcept;
+
+	private:
+		struct Cascade_
+		{
+			float end; // view distance at which the cascade ends
+
+			// Covered sphere (world space), light direction and matrices
+			// at the time the cascade was last rendered
+			Vec3f center;
+			float radius;
+			Vec3f lightDir;
+
+			Vec3f lightCenter;  // snapped center, light space
+			Mat44f viewProj;    // world -> clip, for rendering
+			Mat44f shadowMatrix; // world -> shadow map ([0,1]^3)
+
+			// Bounds (light space) of the dynamic casters drawn when the
+			// cascade was last rendered. Their shadows are in the map until
+			// it is rendered again.
+			std::vector<BoundingSphere> dynamicCasters;
+
+			bool valid;
+		};
+
+		void fit_( Cascade_&, Vec3f aCenter, float aRadius, Vec3f aLightDir, Mat44f const& aLightView ) const;
+
+	private:
+		int mResolution;
+		float mDistance;
+		bool mZeroToOneDepth;
+		bool mReverseZ;
+
+		GLuint mTexture;
+		GLuint mFbo;
+		ShaderProgram mProgram;
+
+		Cascade_ mCascades[kShadowCascades];
+		ShadowStats mStats;
+};
+
+#endif // SHADOW_MAP_HPP_1BF77CD8_87FC_42EA_92FE_D2D33F787A5D
@@ -0,0 +1,193 @@
+#include "simple_mesh.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	template< typename tType >
+	GLuint create_vbo_( std::vector<tType> const& aData )
+	{
+		GLuint vbo = 0;
+		glGenBuffers( 1, &vbo );
+		glBindBuffer( GL_ARRAY_BUFFER, vbo );
+		glBufferData( GL_ARRAY_BUFFER, aData.size() * sizeof(tType), aData.data(), GL_STATIC_DRAW );
+		return vbo;
+	}
+
+	// Filled on the GPU, not by the application (hence not STATIC_DRAW)
+	GLuint create_gpu_vbo_( std::size_t aBytes )
+	{
+		GLuint vbo = 0;
+		glGenBuffers( 1, &vbo );
+		glBindBuffer( GL_ARRAY_BUFFER, vbo );
+		glBufferData( GL_ARRAY_BUFFER, GLsizeiptr(aBytes), nullptr, GL_STATIC_COPY );
+		return vbo;
+	}
+}
+
+GpuMesh create_gpu_mesh( SimpleMeshData const& aMeshData )
+{
+	assert( aMeshData.normals.empty() || aMeshData.normals.size() == aMeshData.positions.size() );
+	assert( aMeshData.texcoords.size() == aMeshData.positions.size() );
+	assert( aMeshData.materials.size() == aMeshData.positions.size() );
+
+	GpuMesh mesh;
+	mesh.vertexCount = GLsizei(aMeshData.positions.size());
+
+	auto const bounds = mesh_bounds( aMeshData );
+	mesh.boundsCenter = bounds.center;
+	mesh.boundsRadius = bounds.radius;
+
+	mesh.positionVbo = create_vbo_( aMeshData.positions );
+	if( aMeshData.normals.empty() )
+	{
+		mesh.normalVbo = create_gpu_vbo_( aMeshData.positions.size() * sizeof(Vec3f) );
+		mesh.generatedNormals = true;
+	}
+	else
+	{
+		mesh.normalVbo = create_vbo_( aMeshData.normals );
+	}
+	mesh.texcoordVbo = create_vbo_( aMeshData.texcoords );
+	mesh.materialVbo = create_vbo_( aMeshData.materials );
+
+	glGenVertexArrays( 1, &mesh.vao );
+	glBindVertexArray( mesh.vao );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mesh.positionVbo );
+	glVertexAttribPointer( kMeshPositionLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
+	glEnableVertexAttribArray( kMeshPositionLocation );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mesh.normalVbo );
+	glVertexAttribPointer( kMeshNormalLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
+	glEnableVertexAttribArray( kMeshNormalLocation );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mesh.texcoordVbo );
+	glVertexAttribPointer( kMeshTexCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, nullptr );
+	glEnableVertexAttribArray( kMeshTexCoordLocation );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mesh.materialVbo );
+	glVertexAttribIPointer( kMeshMaterialLocation, 1, GL_UNSIGNED_INT, 0, nullptr );
+	glEnableVertexAttribArray( kMeshMaterialLocation );
+
+	glGenVertexArrays( 1, &mesh.positionVao );
+	glBindVertexArray( mesh.positionVao );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mesh.positionVbo );
+	glVertexAttribPointer( kMeshPositionLocation, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
+	glEnableVertexAttribArray( kMeshPositionLocation );
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	OGL_CHECKPOINT_DEBUG();
+
+	return mesh;
+}
+
+void destroy_gpu_mesh( GpuMesh& aMesh )
+{
+	glDeleteVertexArrays( 1, &aMesh.positionVao );
+	glDeleteVertexArrays( 1, &aMesh.vao );
+
+	GLuint const buffers[] = { aMesh.positionVbo, aMesh.normalVbo, aMesh.texcoordVbo, aMesh.materialVbo };
+	glDeleteBuffers( sizeof(buffers)/sizeof(buffers[0]), buffers );
+
+	aMesh = GpuMesh{};
+}
+
+std::uint64_t vertex_bytes( SimpleMeshData const& aMeshData ) noexcept
+{
+	return aMeshData.positions.size() * sizeof(Vec3f)
+		+ aMeshData.normals.size() * sizeof(Vec3f)
+		+ aMeshData.texcoords.size() * sizeof(Vec2f)
+		+ aMeshData.materials.size() * sizeof(std::uint32_t)
+	;
+}
+
+std::uint64_t vertex_bytes( GpuMesh const& aMesh ) noexcept
+{
+	return std::uint64_t(aMesh.vertexCount) * (2*sizeof(Vec3f) + sizeof(Vec2f) + sizeof(std::uint32_t));
+}
+
+BoundingSphere mesh_bounds( SimpleMeshData const& aMeshData ) noexcept
+{
+	// Sphere around the bounding box. Not the tightest, but good enough.
+	if( aMeshData.positions.empty() )
+		return BoundingSphere{ Vec3f{ 0.f, 0.f, 0.f }, 0.f };
+
+	Vec3f lo = aMeshData.positions.front(), hi = lo;
+	for( auto const& p : aMeshData.positions )
+	{
+		lo = Vec3f{ std::min( lo.x, p.x ), std::min( lo.y, p.y ), std::min( lo.z, p.z ) };
+		hi = Vec3f{ std::max( hi.x, p.x ), std::max( hi.y, p.y ), std::max( hi.z, p.z ) };
+	}
+
+	return BoundingSphere{ 0.5f * (lo + hi), 0.5f * length( hi - lo ) };
+}
+
+std::vector<SimpleMeshData> split_mesh_tiles( SimpleMeshData const& aMeshData, float aTileSize )
+{
+	assert( aTileSize > 0.f );
+	assert( 0 == aMeshData.positions.size() % 3 );
+
+	auto const& pos = aMeshData.positions;
+	if( pos.empty() )
+		return {};
+
+	float minX = pos.front().x, minZ = pos.front().z, maxX = minX, maxZ = minZ;
+	for( auto const& p : pos )
+	{
+		minX = std::min( minX, p.x );
+		minZ = std::min( minZ, p.z );
+		maxX = std::max( maxX, p.x );
+		maxZ = std::max( maxZ, p.z );
+	}
+
+	auto const tilesX = std::max( std::size_t(1), std::size_t(std::ceil( (maxX - minX) / aTileSize )) );
+	auto const tilesZ = std::max( std::size_t(1), std::size_t(std::ceil( (maxZ - minZ) / aTileSize )) );
+
+	bool const hasNormals = !aMeshData.normals.empty();
+
+	std::vector<SimpleMeshData> tiles( tilesX * tilesZ );
+	for( std::size_t i = 0; i < pos.size(); i += 3 )
+	{
+		Vec3f const centroid = (pos[i] + pos[i+1] + pos[i+2]) / 3.f;
+		auto const tx = std::min( tilesX-1, std::size_t(std::max( 0.f, (centroid.x - minX) / aTileSize )) );
+		auto const tz = std::min( tilesZ-1, std::size_t(std::max( 0.f, (centroid.z - minZ) / aTileSize )) );
+
+		auto& tile = tiles[tz*tilesX + tx];
+		for( std::size_t j = i; j < i+3; ++j )
+		{
+			tile.positions.emplace_back( pos[j] );
+			if( hasNormals )
+				tile.normals.emplace_back( aMeshData.normals[j] );
+			tile.texcoords.emplace_back( aMeshData.texcoords[j] );
+			tile.materials.emplace_back( aMeshData.materials[j] );
+		}
+	}
+
+	tiles.erase( std::remove_if( tiles.begin(), tiles.end(), [] (SimpleMeshData const& aTile) {
+		return aTile.positions.empty();
+	} ), tiles.end() );
+
+	return tiles;
+}
+
+BoundingSphere world_bounds( GpuMesh const& aMesh, Mat44f const& aWorld ) noexcept
+{
+	auto const& w = aWorld;
+	Vec4f const center = aWorld * Vec4f{ aMesh.boundsCenter.x, aMesh.boundsCenter.y, aMesh.boundsCenter.z, 1.f };
+
+	// Largest scale of the three axes
+	float const sx = length( Vec3f{ w(0,0), w(1,0), w(2,0) } );
+	float const sy = length( Vec3f{ w(0,1), w(1,1), w(2,1) } );
+	float const sz = length( Vec3f{ w(0,2), w(1,2), w(2,2) } );
+
+	return BoundingSphere{ Vec3f{ center.x, center.y, center.z }, aMesh.boundsRadius * std::max( sx, std::max( sy, sz ) ) };
+}
@@ -0,0 +1,82 @@
+#ifndef SIMPLE_MESH_HPP_1E4C22F7_357E_4AFF_BD07_387F63895196
+#define SIMPLE_MESH_HPP_1E4C22F7_357E_4AFF_BD07_387F63895196
+
+#include <glad.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Non-indexed triangle soup, one entry per vertex in each array.
+//
+// Material IDs are indices into the global material table (see
+// material.hpp), so meshes using different materials can still be drawn with
+// a single draw call.
+struct SimpleMeshData
+{
+	std::vector<Vec3f> positions;
+	std::vector<Vec3f> normals;
+	std::vector<Vec2f> texcoords;
+	std::vector<std::uint32_t> materials;
+};
+
+// Vertex attribute locations, shared by all mesh shaders.
+constexpr GLuint kMeshPositionLocation = 0;
+constexpr GLuint kMeshNormalLocation = 1;
+constexpr GLuint kMeshTexCoordLocation = 2;
+constexpr GLuint kMeshMaterialLocation = 3;
+
+// GPU-side mesh. Each attribute lives in its own buffer, so passes that only
+// need positions touch as little memory as possible: `positionVao` only
+// reads the position buffer (depth pre-pass, shadow maps).
+struct GpuMesh
+{
+	GLuint vao = 0;
+	GLuint positionVao = 0;
+
+	GLuint positionVbo = 0;
+	GLuint normalVbo = 0;
+	GLuint texcoordVbo = 0;
+	GLuint materialVbo = 0;
+
+	GLsizei vertexCount = 0;
+
+	// The normal buffer was allocated, but not filled (mesh without
+	// normals; see TerrainNormals)
+	bool generatedNormals = false;
+
+	// Bounding sphere in model space (for culling)
+	Vec3f boundsCenter{ 0.f, 0.f, 0.f };
+	float boundsRadius = 0.f;
+};
+
+struct BoundingSphere
+{
+	Vec3f center;
+	float radius;
+};
+
+// If the mesh has no normals, the normal buffer is left uninitialized, for
+// the GPU to fill (GpuMesh::generatedNormals).
+GpuMesh create_gpu_mesh( SimpleMeshData const& );
+void destroy_gpu_mesh( GpuMesh& );
+
+// Size of the vertex data (on the CPU, and on the GPU once uploaded)
+std::uint64_t vertex_bytes( SimpleMeshData const& ) noexcept;
+std::uint64_t vertex_bytes( GpuMesh const& ) noexcept;
+
+// Sphere around the mesh's bounding box (as used by GpuMesh)
+BoundingSphere mesh_bounds( SimpleMeshData const& ) noexcept;
+
+// Split a mesh into square tiles of aTileSize on the XZ plane, by triangle
+// centroid (triangles are not cut). Empty tiles are left out. Material IDs
+// are kept, as are missing normals.
+std::vector<SimpleMeshData> split_mesh_tiles( SimpleMeshData const&, float aTileSize );
+
+// Bounding sphere of an instance of the mesh (aWorld: affine transform).
+BoundingSphere world_bounds( GpuMesh const&, Mat44f const& aWorld ) noexcept;
+
+#endif // SIMPLE_MESH_HPP_1E4C22F7_357E_4AFF_BD07_387F63895196
@@ -0,0 +1,70 @@
+#ifndef SPSC_RING_HPP_FE6F41BF_9468_40EE_ABEE_BFF34A86F540
+#define SPSC_RING_HPP_FE6F41BF_9468_40EE_ABEE_BFF34A86F540
+
+#include <atomic>
+#include <cstddef>
+
+/* Bounded single-producer single-consumer ring buffer
+ *
+ * Lock-free and wait-free: exactly one thread may call try_push() and exactly
+ * one (other) thread may call try_pop(). Storage is fixed at compile time, so
+ * neither side ever allocates. try_push() fails if the ring is full; the
+ * caller decides whether to drop the item or retry.
+ *
+ * tCapacity must be a power of two.
+ */
+template< typename tItem, std::size_t tCapacity >
+class SpscRing final
+{
+	static_assert( tCapacity > 0 && 0 == (tCapacity & (tCapacity-1)), "SpscRing: capacity must be a power of two" );
+
+	public:
+		static constexpr std::size_t kCapacity = tCapacity;
+
+	public:
+		SpscRing() = default;
+
+		SpscRing( SpscRing const& ) = delete;
+		SpscRing& operator= (SpscRing const&) = delete;
+
+	public:
+		// Producer side
+		bool try_push( tItem const& aItem ) noexcept
+		{
+			std::size_t const head = mHead.load( std::memory_order_relaxed );
+			if( head - mTail.load( std::memory_order_acquire ) == tCapacity )
+				return false;
+
+			mItems[head & (tCapacity-1)] = aItem;
+			mHead.store( head+1, std::memory_order_release );
+			return true;
+		}
+
+		// Consumer side
+		bool try_pop( tItem& aItem ) noexcept
+		{
+			std::size_t const tail = mTail.load( std::memory_order_relaxed );
+			if( tail == mHead.load( std::memory_order_acquire ) )
+				return false;
+
+			aItem = mItems[tail & (tCapacity-1)];
+			mTail.store( tail+1, std::memory_order_release );
+			return true;
+		}
+
+		// Approximate when called concurrently with push/pop.
+		bool empty() const noexcept
+		{
+			return mHead.load( std::memory_order_acquire ) == mTail.load( std::memory_order_acquire );
+		}
+
+	private:
+		// Head and tail are written by different threads; keep them on
+		// separate cache lines.
+		alignas(64) std::atomic<std::size_t> mHead{ 0 };
+		alignas(64) std::atomic<std::size_t> mTail{ 0 };
+
+		tItem mItems[tCapacity];
+};
+
+#endif // SPSC_RING_HPP_FE6F41BF_9468_40EE_ABEE_BFF34A86F540
@@ -0,0 +1,123 @@
+#include "terrain_normals.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	// Must match the local size in assets/terrain_normals.comp
+	constexpr std::size_t kWorkGroupSize_ = 64;
+
+	// Work groups per dispatch dimension (the minimum GL guarantees);
+	// larger meshes use a second dimension.
+	constexpr std::size_t kMaxWorkGroups_ = 65535;
+
+	// Uniform locations in assets/terrain_normals.comp
+	constexpr GLint kGridLocation_ = 0;
+	constexpr GLint kGridSizeLocation_ = 1;
+	constexpr GLint kVertexCountLocation_ = 2;
+}
+
+// TerrainNormals
+TerrainNormals::TerrainNormals( Heightfield const& aHeights )
+	: mProgram( {
+		{ GL_COMPUTE_SHADER, "assets/terrain_normals.comp" }
+	} )
+	, mHeights( 0 )
+	, mOriginX( 0.f ), mOriginZ( 0.f )
+	, mSpacingX( 1.f ), mSpacingZ( 1.f )
+	, mColumns( 0 ), mRows( 0 )
+	, mStats{}
+{
+	set_heights( aHeights );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+TerrainNormals::~TerrainNormals()
+{
+	glDeleteTextures( 1, &mHeights );
+}
+
+void TerrainNormals::set_heights( Heightfield const& aHeights )
+{
+	assert( aHeights.columns >= 2 && aHeights.rows >= 2 );
+	assert( aHeights.heights.size() == std::size_t(aHeights.columns) * aHeights.rows );
+
+	GLint maxSize = 0;
+	glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxSize );
+	if( aHeights.columns > std::uint32_t(maxSize) || aHeights.rows > std::uint32_t(maxSize) )
+		throw Error( "TerrainNormals: %ux%u heightfield exceeds the maximum texture size (%d)", aHeights.columns, aHeights.rows, maxSize );
+
+	// The texture is immutable; a different grid needs a new one.
+	if( 0 == mHeights || aHeights.columns != mColumns || aHeights.rows != mRows )
+	{
+		glDeleteTextures( 1, &mHeights );
+
+		glGenTextures( 1, &mHeights );
+		glBindTexture( GL_TEXTURE_2D, mHeights );
+		glTexStorage2D( GL_TEXTURE_2D, 1, GL_R32F, GLsizei(aHeights.columns), GLsizei(aHeights.rows) );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	}
+	else
+	{
+		glBindTexture( GL_TEXTURE_2D, mHeights );
+	}
+
+	glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, GLsizei(aHeights.columns), GLsizei(aHeights.rows), GL_RED, GL_FLOAT, aHeights.heights.data() );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	mOriginX = aHeights.originX;
+	mOriginZ = aHeights.originZ;
+	mSpacingX = aHeights.spacingX;
+	mSpacingZ = aHeights.spacingZ;
+	mColumns = aHeights.columns;
+	mRows = aHeights.rows;
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+void TerrainNormals::generate( GpuMesh const& aMesh )
+{
+	if( 0 == aMesh.vertexCount )
+		return;
+
+	glUseProgram( mProgram.programId() );
+
+	glUniform4f( kGridLocation_, mOriginX, mOriginZ, mSpacingX, mSpacingZ );
+	glUniform2f( kGridSizeLocation_, float(mColumns), float(mRows) );
+	glUniform1ui( kVertexCountLocation_, GLuint(aMesh.vertexCount) );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kPositionBufferBinding, aMesh.positionVbo );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kNormalBufferBinding, aMesh.normalVbo );
+
+	glActiveTexture( GL_TEXTURE0 + kHeightTextureUnit );
+	glBindTexture( GL_TEXTURE_2D, mHeights );
+	glActiveTexture( GL_TEXTURE0 );
+
+	auto const groups = (std::size_t(aMesh.vertexCount) + kWorkGroupSize_-1) / kWorkGroupSize_;
+	auto const groupsX = std::min( groups, kMaxWorkGroups_ );
+	glDispatchCompute( GLuint(groupsX), GLuint((groups + groupsX-1) / groupsX), 1 );
+
+	// The normals are read as vertex attributes by later draws.
+	glMemoryBarrier( GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT );
+
+	glUseProgram( 0 );
+
+	++mStats.meshes;
+	mStats.vertices += std::size_t(aMesh.vertexCount);
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+TerrainNormalStats const& TerrainNormals::stats() const noexcept
+{
+	return mStats;
+}
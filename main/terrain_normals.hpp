@@ -0,0 +1,75 @@
+#ifndef TERRAIN_NORMALS_HPP_871334E2_AEFF_42CB_81B4_E6D4124F5CC8
+#define TERRAIN_NORMALS_HPP_871334E2_AEFF_42CB_81B4_E6D4124F5CC8
+
+#include <glad.h>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "../support/program.hpp"
+#include "../support/heightfield.hpp"
+
+#include "simple_mesh.hpp"
+
+struct TerrainNormalStats
+{
+	std::size_t meshes;   // generate() calls so far
+	std::size_t vertices;
+};
+
+/* Terrain normals from a heightfield
+ *
+ * Generates the normals of terrain meshes on the GPU, so that they are
+ * neither loaded nor kept on the CPU (see create_gpu_mesh(), which leaves
+ * the normal buffer of a mesh without normals uninitialized). The heights
+ * are uploaded once, as a GL_R32F texture. generate() runs
+ * assets/terrain_normals.comp with one invocation per vertex: it reads the
+ * vertex's position from the mesh's position buffer and writes the normal,
+ * from central differences of the (bilinearly filtered) heights one grid
+ * spacing away, into the normal buffer. Both are bound as shader storage
+ * buffers, so nothing round-trips through the CPU.
+ *
+ * Meshes must be in the heightfield's space (e.g., tiles of the terrain it
+ * was made from). After editing the terrain, call set_heights() and then
+ * generate() again for its resident meshes.
+ *
+ * Uses its own bindings (compute only), so it does not disturb the mesh
+ * programs' state. Leaves no program bound.
+ */
+class TerrainNormals final
+{
+	public:
+		static constexpr GLuint kPositionBufferBinding = 6;
+		static constexpr GLuint kNormalBufferBinding = 7;
+		static constexpr GLuint kHeightTextureUnit = 6;
+
+	public:
+		explicit TerrainNormals( Heightfield const& );
+		~TerrainNormals();
+
+		TerrainNormals( TerrainNormals const& ) = delete;
+		TerrainNormals& operator= (TerrainNormals const&) = delete;
+
+	public:
+		// Replace the heights. The grid may change.
+		void set_heights( Heightfield const& );
+
+		// Write aMesh's normals. They are visible to vertex fetches of
+		// later draws (the required barrier is issued).
+		void generate( GpuMesh const& aMesh );
+
+		TerrainNormalStats const& stats() const noexcept;
+
+	private:
+		ShaderProgram mProgram;
+
+		GLuint mHeights;
+		float mOriginX, mOriginZ;
+		float mSpacingX, mSpacingZ;
+		std::uint32_t mColumns, mRows;
+
+		TerrainNormalStats mStats;
+};
+
+#endif // TERRAIN_NORMALS_HPP_871334E2_AEFF_42CB_81B4_E6D4124F5CC8
@@ -0,0 +1,272 @@
+#include "text_renderer.hpp"
+
+#include <algorithm>
+
+#include <cstdio>
+#include <cassert>
+
+#include <fontstash.h>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	constexpr std::size_t kInitialVertexCapacity = 6 * 1024;
+}
+
+TextRenderer::TextRenderer( char const* aFontPath, int aAtlasWidth, int aAtlasHeight )
+	: mFontFile( open_asset( aFontPath, FileMapping::Access::willNeed ) )
+	, mContext( nullptr )
+	, mFont( FONS_INVALID )
+	, mProgram( {
+		{ GL_VERTEX_SHADER, "assets/text.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/text.frag" }
+	} )
+	, mAtlas( 0 )
+	, mAtlasWidth( 0 ), mAtlasHeight( 0 )
+	, mDirty{ 0, 0, 0, 0 }
+	, mAtlasFull( false )
+	, mVao( 0 )
+	, mVbo( 0 )
+	, mVboCapacity( kInitialVertexCapacity )
+	, mStats{}
+{
+	// Streaming vertex buffer
+	glGenBuffers( 1, &mVbo );
+	glBindBuffer( GL_ARRAY_BUFFER, mVbo );
+	glBufferData( GL_ARRAY_BUFFER, mVboCapacity * sizeof(Vertex_), nullptr, GL_STREAM_DRAW );
+
+	glGenVertexArrays( 1, &mVao );
+	glBindVertexArray( mVao );
+
+	glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex_), reinterpret_cast<void const*>(offsetof(Vertex_,x)) );
+	glEnableVertexAttribArray( 0 );
+	glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex_), reinterpret_cast<void const*>(offsetof(Vertex_,s)) );
+	glEnableVertexAttribArray( 1 );
+	glVertexAttribPointer( 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex_), reinterpret_cast<void const*>(offsetof(Vertex_,color)) );
+	glEnableVertexAttribArray( 2 );
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	// Fontstash context. This calls create_atlas_().
+	FONSparams params{};
+	params.width = aAtlasWidth;
+	params.height = aAtlasHeight;
+	params.flags = FONS_ZERO_TOPLEFT;
+	params.userPtr = this;
+	params.renderCreate = &TextRenderer::create_atlas_;
+	params.renderResize = &TextRenderer::resize_atlas_;
+	params.renderUpdate = &TextRenderer::update_atlas_;
+	params.renderDraw = &TextRenderer::append_quads_;
+
+	mContext = fonsCreateInternal( &params );
+	if( !mContext )
+		throw Error( "TextRenderer: fonsCreateInternal() failed" );
+
+	fonsSetErrorCallback( mContext, &TextRenderer::on_error_, this );
+
+	// Not copied: stb_truetype only reads the data, which stays mapped for
+	// the lifetime of the context (freeData = 0).
+	mFont = fonsAddFontMem( mContext, "default", const_cast<unsigned char*>(mFontFile.data()), int(mFontFile.size()), 0 );
+	if( FONS_INVALID == mFont )
+	{
+		fonsDeleteInternal( mContext );
+		throw Error( "TextRenderer: unable to load font '%s'", aFontPath );
+	}
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+TextRenderer::~TextRenderer()
+{
+	if( mContext )
+		fonsDeleteInternal( mContext );
+
+	glDeleteTextures( 1, &mAtlas );
+	glDeleteVertexArrays( 1, &mVao );
+	glDeleteBuffers( 1, &mVbo );
+}
+
+void TextRenderer::begin( std::pmr::memory_resource* aScratch )
+{
+	assert( aScratch );
+	assert( !mVertices );
+
+	mVertices.emplace( aScratch );
+	mVertices->reserve( mVboCapacity );
+}
+
+float TextRenderer::draw( float aX, float aY, char const* aText, float aSize, std::uint32_t aColor )
+{
+	assert( mContext );
+	assert( mVertices );
+
+	fonsSetFont( mContext, mFont );
+	fonsSetSize( mContext, aSize );
+	fonsSetColor( mContext, aColor );
+	fonsSetAlign( mContext, FONS_ALIGN_LEFT | FONS_ALIGN_TOP );
+
+	return fonsDrawText( mContext, aX, aY, aText, nullptr );
+}
+
+void TextRenderer::flush( int aFramebufferWidth, int aFramebufferHeight )
+{
+	std::size_t const vertexCount = mVertices ? mVertices->size() : 0;
+
+	mStats = Stats{};
+	mStats.glyphs = vertexCount / 6;
+
+	// Upload the changed part of the atlas
+	if( mDirty[0] < mDirty[2] && mDirty[1] < mDirty[3] )
+	{
+		int w, h;
+		unsigned char const* data = fonsGetTextureData( mContext, &w, &h );
+		assert( w == mAtlasWidth && h == mAtlasHeight );
+
+		glBindTexture( GL_TEXTURE_2D, mAtlas );
+
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, w );
+		glPixelStorei( GL_UNPACK_SKIP_PIXELS, mDirty[0] );
+		glPixelStorei( GL_UNPACK_SKIP_ROWS, mDirty[1] );
+
+		glTexSubImage2D( GL_TEXTURE_2D, 0, mDirty[0], mDirty[1], mDirty[2]-mDirty[0], mDirty[3]-mDirty[1], GL_RED, GL_UNSIGNED_BYTE, data );
+
+		glPixelStorei( GL_UNPACK_SKIP_ROWS, 0 );
+		glPixelStorei( GL_UNPACK_SKIP_PIXELS, 0 );
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+		mStats.atlasUploads = 1;
+		mStats.atlasBytes = std::size_t(mDirty[2]-mDirty[0]) * std::size_t(mDirty[3]-mDirty[1]);
+
+		mDirty[0] = mAtlasWidth;
+		mDirty[1] = mAtlasHeight;
+		mDirty[2] = 0;
+		mDirty[3] = 0;
+	}
+
+	if( vertexCount )
+	{
+		// Stream vertices. Orphan the old storage so that the driver doesn't
+		// have to wait for the previous frame's draw to finish.
+		glBindBuffer( GL_ARRAY_BUFFER, mVbo );
+		if( vertexCount > mVboCapacity )
+			mVboCapacity = std::max( vertexCount, 2*mVboCapacity );
+
+		glBufferData( GL_ARRAY_BUFFER, mVboCapacity * sizeof(Vertex_), nullptr, GL_STREAM_DRAW );
+		glBufferSubData( GL_ARRAY_BUFFER, 0, vertexCount * sizeof(Vertex_), mVertices->data() );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+		// Draw everything at once
+		GLboolean const depthTest = glIsEnabled( GL_DEPTH_TEST );
+		GLboolean const cullFace = glIsEnabled( GL_CULL_FACE );
+
+		glDisable( GL_DEPTH_TEST );
+		glDisable( GL_CULL_FACE );
+		glEnable( GL_BLEND );
+		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+		glUseProgram( mProgram.programId() );
+		glUniform2f( 0, 2.f / float(aFramebufferWidth), 2.f / float(aFramebufferHeight) );
+
+		glActiveTexture( GL_TEXTURE0 );
+		glBindTexture( GL_TEXTURE_2D, mAtlas );
+
+		glBindVertexArray( mVao );
+		glDrawArrays( GL_TRIANGLES, 0, GLsizei(vertexCount) );
+		glBindVertexArray( 0 );
+
+		glUseProgram( 0 );
+
+		glDisable( GL_BLEND );
+		if( depthTest ) glEnable( GL_DEPTH_TEST );
+		if( cullFace ) glEnable( GL_CULL_FACE );
+
+		mStats.drawCalls = 1;
+	}
+
+	// Gives the memory back to the scratch resource
+	mVertices.reset();
+
+	// The atlas ran out of space this frame. Start over; glyphs will be
+	// re-rasterized as needed next frame.
+	if( mAtlasFull )
+	{
+		fonsResetAtlas( mContext, mAtlasWidth, mAtlasHeight );
+		mAtlasFull = false;
+	}
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+TextRenderer::Stats const& TextRenderer::stats() const noexcept
+{
+	return mStats;
+}
+
+int TextRenderer::create_atlas_( void* aSelf, int aWidth, int aHeight )
+{
+	auto* self = static_cast<TextRenderer*>(aSelf);
+
+	if( 0 == self->mAtlas )
+		glGenTextures( 1, &self->mAtlas );
+
+	glBindTexture( GL_TEXTURE_2D, self->mAtlas );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_R8, aWidth, aHeight, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	self->mAtlasWidth = aWidth;
+	self->mAtlasHeight = aHeight;
+
+	// New storage is undefined; upload everything on the next flush.
+	self->mDirty[0] = 0;
+	self->mDirty[1] = 0;
+	self->mDirty[2] = aWidth;
+	self->mDirty[3] = aHeight;
+
+	return 1;
+}
+
+int TextRenderer::resize_atlas_( void* aSelf, int aWidth, int aHeight )
+{
+	return create_atlas_( aSelf, aWidth, aHeight );
+}
+
+void TextRenderer::update_atlas_( void* aSelf, int* aRect, unsigned char const* )
+{
+	// Just record the region. The upload happens once, in flush().
+	auto* self = static_cast<TextRenderer*>(aSelf);
+	self->mDirty[0] = std::min( self->mDirty[0], aRect[0] );
+	self->mDirty[1] = std::min( self->mDirty[1], aRect[1] );
+	self->mDirty[2] = std::max( self->mDirty[2], aRect[2] );
+	self->mDirty[3] = std::max( self->mDirty[3], aRect[3] );
+}
+
+void TextRenderer::append_quads_( void* aSelf, float const* aVerts, float const* aTexCoords, unsigned int const* aColors, int aCount )
+{
+	auto* self = static_cast<TextRenderer*>(aSelf);
+	for( int i = 0; i < aCount; ++i )
+	{
+		self->mVertices->emplace_back( Vertex_{
+			aVerts[i*2+0], aVerts[i*2+1],
+			aTexCoords[i*2+0], aTexCoords[i*2+1],
+			aColors[i]
+		} );
+	}
+}
+
+void TextRenderer::on_error_( void* aSelf, int aError, int aValue )
+{
+	auto* self = static_cast<TextRenderer*>(aSelf);
+	if( FONS_ATLAS_FULL == aError )
+		self->mAtlasFull = true;
+	else
+		std::fprintf( stderr, "TextRenderer: fontstash error %d (%d)\n", aError, aValue );
+}
@@ -0,0 +1,106 @@
+#ifndef TEXT_RENDERER_HPP_071E356A_80C0_4955_9428_F829082B25F9
+#define TEXT_RENDERER_HPP_071E356A_80C0_4955_9428_F829082B25F9
+
+#include <glad.h>
+
+#include <optional>
+#include <memory_resource>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../support/program.hpp"
+#include "../support/asset_store.hpp"
+
+struct FONScontext;
+
+// Pack an RGBA colour in the format expected by TextRenderer::draw().
+constexpr
+std::uint32_t text_rgba( std::uint8_t aR, std::uint8_t aG, std::uint8_t aB, std::uint8_t aA = 255 ) noexcept
+{
+	return std::uint32_t(aR) | (std::uint32_t(aG) << 8) | (std::uint32_t(aB) << 16) | (std::uint32_t(aA) << 24);
+}
+
+/* Fontstash text renderer (GL 4.3 core)
+ *
+ * begin() starts a frame; draw() only records glyph quads on the CPU, in
+ * memory from the resource passed to begin() (e.g., a FrameArena). flush()
+ * then
+ *  - uploads the part of the glyph atlas that changed since the last flush
+ *    (a single glTexSubImage2D() of the union of fontstash's dirty rects),
+ *  - streams all quads of the frame into one vertex buffer (orphaned each
+ *    frame), and
+ *  - draws all text with a single draw call.
+ *
+ * Coordinates are in pixels, with the origin in the top left corner.
+ */
+class TextRenderer final
+{
+	public:
+		struct Stats
+		{
+			std::size_t glyphs;
+			std::size_t drawCalls;
+			std::size_t atlasUploads;
+			std::size_t atlasBytes;
+		};
+
+	public:
+		explicit TextRenderer( char const* aFontPath, int aAtlasWidth = 512, int aAtlasHeight = 512 );
+		~TextRenderer();
+
+		TextRenderer( TextRenderer const& ) = delete;
+		TextRenderer& operator= (TextRenderer const&) = delete;
+
+	public:
+		// Record quads in memory from aScratch until the next flush().
+		// aScratch must outlive that flush().
+		void begin( std::pmr::memory_resource* aScratch );
+
+		// Returns the x position after the text. Only between begin() and
+		// flush().
+		float draw( float aX, float aY, char const* aText, float aSize = 18.f, std::uint32_t aColor = text_rgba( 255, 255, 255 ) );
+
+		void flush( int aFramebufferWidth, int aFramebufferHeight );
+
+		// Statistics for the most recent flush()
+		Stats const& stats() const noexcept;
+
+	private:
+		struct Vertex_
+		{
+			float x, y;
+			float s, t;
+			std::uint32_t color;
+		};
+
+		static int create_atlas_( void*, int, int );
+		static int resize_atlas_( void*, int, int );
+		static void update_atlas_( void*, int*, unsigned char const* );
+		static void append_quads_( void*, float const*, float const*, unsigned int const*, int );
+		static void on_error_( void*, int, int );
+
+	private:
+		AssetData mFontFile; // fontstash reads glyphs straight from it
+		FONScontext* mContext;
+		int mFont;
+
+		ShaderProgram mProgram;
+
+		GLuint mAtlas;
+		int mAtlasWidth, mAtlasHeight;
+		int mDirty[4]; // x0, y0, x1, y1
+		bool mAtlasFull;
+
+		GLuint mVao;
+		GLuint mVbo;
+		std::size_t mVboCapacity; // in vertices
+
+		// Between begin() and flush(). Room for mVboCapacity vertices is
+		// reserved, so it rarely grows.
+		std::optional<std::pmr::vector<Vertex_>> mVertices;
+
+		Stats mStats;
+};
+
+#endif // TEXT_RENDERER_HPP_071E356A_80C0_4955_9428_F829082B25F9
@@ -0,0 +1,46 @@
+#include "texture.hpp"
+
+#include <cassert>
+
+#include <stb_image.h>
+
+#include "../support/error.hpp"
+#include "../support/asset_store.hpp"
+
+GLuint load_texture_2d( char const* aPath )
+{
+	assert( aPath );
+
+	// Load image first
+	// This may fail (e.g., image does not exist), so there's no point in
+	// allocating OpenGL resources ahead of time.
+	stbi_set_flip_vertically_on_load( true );
+
+	// Decoded straight from the mapped file
+	auto const file = open_asset( aPath );
+
+	int w, h, channels;
+	stbi_uc* ptr = stbi_load_from_memory( file.data(), int(file.size()), &w, &h, &channels, 4 );
+	if( !ptr )
+		throw Error( "Unable to load image '%s'", aPath );
+
+	// Generate texture object and initialize texture with image
+	GLuint tex = 0;
+	glGenTextures( 1, &tex );
+	glBindTexture( GL_TEXTURE_2D, tex );
+
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptr );
+
+	stbi_image_free( ptr );
+
+	// Generate mipmap hierarchy
+	glGenerateMipmap( GL_TEXTURE_2D );
+
+	// Configure texture
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	return tex;
+}
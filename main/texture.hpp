@@ -0,0 +1,13 @@
+#ifndef TEXTURE_HPP_A52FCD8A_64D3_4F96_A0F0_E9A997418D8F
+#define TEXTURE_HPP_A52FCD8A_64D3_4F96_A0F0_E9A997418D8F
+
+#include <glad.h>
+
+// Load a 2D texture from an image file (anything that stb_image supports).
+//
+// The image is uploaded as sRGB (GL_SRGB8_ALPHA8) and a full mipmap chain is
+// generated with glGenerateMipmap(). This is the slow path; prefer
+// load_texture_2d_cached() from texture_cache.hpp where possible.
+GLuint load_texture_2d( char const* aPath );
+
+#endif // TEXTURE_HPP_A52FCD8A_64D3_4F96_A0F0_E9A997418D8F
@@ -0,0 +1,459 @@
+#include "texture_cache.hpp"
+
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include <GLFW/glfw3.h>
+
+#include <stb_image.h>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+#include "../support/asset_store.hpp"
+#include "../support/srgb.hpp"
+#include "../support/block_compress.hpp"
+
+#include "texture.hpp"
+#include "defaults.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kCacheMagic = 0x54325743; // "CW2T"
+	constexpr std::uint32_t kCacheVersion = 1;
+
+	constexpr char const* kCacheSuffix = ".texcache";
+
+	// From GL_EXT_texture_sRGB / GL_EXT_texture_compression_s3tc. The GLAD
+	// loader only includes the core profile, so these are not defined there.
+	constexpr GLenum kCompressedSRGB_S3TC_DXT1 = 0x8C4C;
+	constexpr GLenum kCompressedSRGBAlpha_S3TC_DXT5 = 0x8C4F;
+
+	enum class CacheFormat_ : std::uint32_t
+	{
+		bc1 = 1,
+		bc3 = 3
+	};
+
+	struct CacheHeader_
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t format;
+		std::uint32_t levelCount;
+		std::uint32_t width, height;
+		std::uint64_t sourceSize;
+		std::int64_t sourceTime;
+	};
+	struct CacheLevel_
+	{
+		std::uint64_t offset;
+		std::uint64_t size;
+		std::uint32_t width, height;
+	};
+
+	struct SourceStamp_
+	{
+		std::uint64_t size;
+		std::int64_t time;
+	};
+
+	struct CacheStats_
+	{
+		CacheFormat_ format;
+		std::uint32_t width, height, levels;
+		std::uint64_t compressedBytes;
+		std::uint64_t uncompressedBytes;
+	};
+
+	bool source_stamp_( char const*, SourceStamp_& );
+	bool cache_is_current_( char const*, SourceStamp_ const& );
+
+	CacheHeader_ read_header_( AssetData const&, char const* );
+	CacheLevel_ read_level_( AssetData const&, CacheHeader_ const&, std::uint32_t, char const* );
+	GLenum internal_format_( CacheHeader_ const&, char const* );
+
+	GLuint load_cache_( char const*, CacheStats_& );
+}
+
+bool texture_cache_supported()
+{
+	// The cache holds sRGB formats, which plain S3TC does not define.
+	if( GLFW_TRUE == glfwExtensionSupported( "GL_EXT_texture_compression_s3tc_srgb" ) )
+		return true;
+
+	return GLFW_TRUE == glfwExtensionSupported( "GL_EXT_texture_compression_s3tc" )
+		&& GLFW_TRUE == glfwExtensionSupported( "GL_EXT_texture_sRGB" )
+	;
+}
+
+std::string texture_cache_path( char const* aSourcePath )
+{
+	return std::string(aSourcePath) + kCacheSuffix;
+}
+
+std::string ensure_texture_cache( char const* aSourcePath )
+{
+	auto cachePath = texture_cache_path( aSourcePath );
+
+	// A cache in the asset archive is used as-is; it would shadow a freshly
+	// baked loose one anyway (see open_asset()).
+	if( asset_in_archive( cachePath ) )
+		return cachePath;
+
+	// A missing source is OK as long as there is a cache (e.g., if only the
+	// baked files are shipped).
+	SourceStamp_ stamp{};
+	if( source_stamp_( aSourcePath, stamp ) && !cache_is_current_( cachePath.c_str(), stamp ) )
+	{
+		auto const bakeStart = Clock::now();
+		bake_texture_cache( aSourcePath, cachePath.c_str() );
+		auto const bakeTime = std::chrono::duration_cast<Secondsf>(Clock::now() - bakeStart).count();
+
+		std::printf( "Baked texture cache '%s' in %.1f ms\n", cachePath.c_str(), bakeTime * 1000.f );
+	}
+
+	return cachePath;
+}
+
+void bake_texture_cache( char const* aSourcePath, char const* aCachePath )
+{
+	SourceStamp_ stamp{};
+	if( !source_stamp_( aSourcePath, stamp ) )
+		throw Error( "bake_texture_cache(): unable to stat '%s'", aSourcePath );
+
+	// Decode source image. The cache is uploaded with the same orientation as
+	// load_texture_2d(), i.e., flipped so that the first row is at the bottom.
+	stbi_set_flip_vertically_on_load( true );
+
+	auto const source = open_asset( aSourcePath );
+
+	int iw, ih, channels;
+	std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> image( stbi_load_from_memory( source.data(), int(source.size()), &iw, &ih, &channels, 4 ), &stbi_image_free );
+	if( !image )
+		throw Error( "bake_texture_cache(): unable to load image '%s'", aSourcePath );
+
+	auto const width = std::uint32_t(iw), height = std::uint32_t(ih);
+	stbi_uc const* const ptr = image.get();
+
+	bool hasAlpha = false;
+	for( std::size_t i = 0; i < std::size_t(width)*height && !hasAlpha; ++i )
+		hasAlpha = ptr[i*4+3] != 255;
+
+	auto const format = hasAlpha ? CacheFormat_::bc3 : CacheFormat_::bc1;
+	auto const blockBytes = hasAlpha ? kBC3BlockBytes : kBC1BlockBytes;
+
+	// Mips are filtered in linear space, and converted back to sRGB (8 bit)
+	// only for compression.
+	std::vector<float> linear( std::size_t(width)*height*4 );
+	for( std::size_t i = 0; i < std::size_t(width)*height; ++i )
+	{
+		for( std::size_t c = 0; c < 3; ++c )
+			linear[i*4+c] = srgb_to_linear( ptr[i*4+c] );
+		linear[i*4+3] = ptr[i*4+3] / 255.f;
+	}
+
+	std::vector<std::uint8_t> texels( ptr, ptr + std::size_t(width)*height*4 );
+	image.reset();
+
+	std::vector<CacheLevel_> levels;
+	std::vector<std::uint8_t> payload;
+	std::vector<float> next;
+
+	std::uint32_t w = width, h = height;
+	while( true )
+	{
+		// Compress current level
+		std::uint32_t const bw = (w+3)/4, bh = (h+3)/4;
+
+		CacheLevel_ level{};
+		level.width = w;
+		level.height = h;
+		level.offset = payload.size();
+		level.size = std::uint64_t(bw)*bh*blockBytes;
+		payload.resize( payload.size() + level.size );
+
+		std::uint8_t* out = payload.data() + level.offset;
+		for( std::uint32_t by = 0; by < bh; ++by )
+		{
+			for( std::uint32_t bx = 0; bx < bw; ++bx )
+			{
+				std::uint8_t block[16*4];
+				gather_rgba8_block( texels.data(), w, h, bx, by, block );
+
+				if( CacheFormat_::bc3 == format )
+					encode_bc3_block( block, out );
+				else
+					encode_bc1_block( block, out );
+
+				out += blockBytes;
+			}
+		}
+
+		levels.emplace_back( level );
+
+		if( 1 == w && 1 == h )
+			break;
+
+		// Downsample (2×2 box filter) to the next level
+		downsample_linear_rgba( linear.data(), w, h, next );
+		std::swap( linear, next );
+
+		w = std::max( 1u, w/2 );
+		h = std::max( 1u, h/2 );
+
+		texels.resize( std::size_t(w)*h*4 );
+		for( std::size_t i = 0; i < std::size_t(w)*h; ++i )
+		{
+			for( std::size_t c = 0; c < 3; ++c )
+				texels[i*4+c] = linear_to_srgb( linear[i*4+c] );
+			texels[i*4+3] = std::uint8_t(std::clamp( linear[i*4+3], 0.f, 1.f ) * 255.f + 0.5f);
+		}
+	}
+
+	// Write cache file: header, level table, payload
+	CacheHeader_ header{};
+	header.magic = kCacheMagic;
+	header.version = kCacheVersion;
+	header.format = std::uint32_t(format);
+	header.levelCount = std::uint32_t(levels.size());
+	header.width = width;
+	header.height = height;
+	header.sourceSize = stamp.size;
+	header.sourceTime = stamp.time;
+
+	std::uint64_t const payloadOffset = sizeof(CacheHeader_) + levels.size()*sizeof(CacheLevel_);
+	for( auto& level : levels )
+		level.offset += payloadOffset;
+
+	std::FILE* fof = std::fopen( aCachePath, "wb" );
+	if( !fof )
+		throw Error( "bake_texture_cache(): unable to open '%s' for writing", aCachePath );
+
+	bool ok = 1 == std::fwrite( &header, sizeof(header), 1, fof );
+	ok = ok && levels.size() == std::fwrite( levels.data(), sizeof(CacheLevel_), levels.size(), fof );
+	ok = ok && payload.size() == std::fwrite( payload.data(), 1, payload.size(), fof );
+	ok = (0 == std::fclose( fof )) && ok;
+
+	if( !ok )
+	{
+		std::remove( aCachePath );
+		throw Error( "bake_texture_cache(): error while writing '%s'", aCachePath );
+	}
+}
+
+GLuint load_texture_cache( char const* aCachePath )
+{
+	CacheStats_ stats{};
+	return load_cache_( aCachePath, stats );
+}
+
+TextureCacheInfo query_texture_cache( char const* aCachePath )
+{
+	// Only the header is read; no point in reading ahead.
+	auto const file = open_asset( aCachePath, FileMapping::Access::random );
+	auto const header = read_header_( file, aCachePath );
+
+	TextureCacheInfo info{};
+	info.internalFormat = internal_format_( header, aCachePath );
+	info.width = header.width;
+	info.height = header.height;
+	info.levels = header.levelCount;
+	return info;
+}
+
+void upload_texture_cache_layer( char const* aCachePath, GLint aLayer )
+{
+	// All levels are uploaded straight from the mapping.
+	auto const file = open_asset( aCachePath, FileMapping::Access::willNeed );
+	auto const header = read_header_( file, aCachePath );
+	auto const internalFormat = internal_format_( header, aCachePath );
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+	for( std::uint32_t i = 0; i < header.levelCount; ++i )
+	{
+		auto const level = read_level_( file, header, i, aCachePath );
+		glCompressedTexSubImage3D( GL_TEXTURE_2D_ARRAY, GLint(i), 0, 0, aLayer, GLsizei(level.width), GLsizei(level.height), 1, internalFormat, GLsizei(level.size), file.data() + level.offset );
+	}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+}
+
+GLuint load_texture_2d_cached( char const* aSourcePath )
+{
+	if( !texture_cache_supported() )
+	{
+		std::fprintf( stderr, "Note: sRGB S3TC not supported, loading '%s' uncompressed\n", aSourcePath );
+		return load_texture_2d( aSourcePath );
+	}
+
+	auto const cachePath = ensure_texture_cache( aSourcePath );
+
+	auto const loadStart = Clock::now();
+
+	CacheStats_ stats{};
+	GLuint const tex = load_cache_( cachePath.c_str(), stats );
+
+	auto const loadTime = std::chrono::duration_cast<Secondsf>(Clock::now() - loadStart).count();
+
+	std::printf( "Texture '%s': %ux%u %s, %u levels, %.1f MiB (RGBA8: %.1f MiB), loaded in %.1f ms\n",
+		aSourcePath,
+		stats.width, stats.height,
+		CacheFormat_::bc3 == stats.format ? "BC3" : "BC1",
+		stats.levels,
+		stats.compressedBytes / (1024.f*1024.f),
+		stats.uncompressedBytes / (1024.f*1024.f),
+		loadTime * 1000.f
+	);
+
+	return tex;
+}
+
+namespace
+{
+	bool source_stamp_( char const* aPath, SourceStamp_& aStamp )
+	{
+		std::error_code ec;
+		auto const size = std::filesystem::file_size( aPath, ec );
+		if( ec )
+			return false;
+
+		auto const time = std::filesystem::last_write_time( aPath, ec );
+		if( ec )
+			return false;
+
+		aStamp.size = size;
+		aStamp.time = std::int64_t(time.time_since_epoch().count());
+		return true;
+	}
+
+	bool cache_is_current_( char const* aCachePath, SourceStamp_ const& aStamp )
+	{
+		std::FILE* fin = std::fopen( aCachePath, "rb" );
+		if( !fin )
+			return false;
+
+		CacheHeader_ header{};
+		bool const ok = 1 == std::fread( &header, sizeof(header), 1, fin );
+		std::fclose( fin );
+
+		return ok
+			&& kCacheMagic == header.magic
+			&& kCacheVersion == header.version
+			&& aStamp.size == header.sourceSize
+			&& aStamp.time == header.sourceTime
+		;
+	}
+
+	CacheHeader_ read_header_( AssetData const& aFile, char const* aCachePath )
+	{
+		if( aFile.size() < sizeof(CacheHeader_) )
+			throw Error( "Texture cache '%s' is truncated", aCachePath );
+
+		CacheHeader_ header;
+		std::memcpy( &header, aFile.data(), sizeof(header) );
+
+		if( kCacheMagic != header.magic || kCacheVersion != header.version )
+			throw Error( "'%s' is not a texture cache (or has the wrong version)", aCachePath );
+
+		// A full mip chain of 32-bit sizes has at most 32 levels.
+		std::size_t const tableEnd = sizeof(CacheHeader_) + std::size_t(header.levelCount)*sizeof(CacheLevel_);
+		if( 0 == header.levelCount || header.levelCount > 32 || 0 == header.width || 0 == header.height || aFile.size() < tableEnd )
+			throw Error( "Texture cache '%s' has an invalid level table", aCachePath );
+
+		return header;
+	}
+
+	CacheLevel_ read_level_( AssetData const& aFile, CacheHeader_ const& aHeader, std::uint32_t aLevel, char const* aCachePath )
+	{
+		assert( aLevel < aHeader.levelCount );
+
+		CacheLevel_ level;
+		std::memcpy( &level, aFile.data() + sizeof(CacheHeader_) + aLevel*sizeof(CacheLevel_), sizeof(level) );
+
+		// (Written so that corrupt offsets and sizes cannot wrap around.)
+		if( level.offset > aFile.size() || level.size > aFile.size() - level.offset )
+			throw Error( "Texture cache '%s': level %u out of bounds", aCachePath, aLevel );
+
+		// Each level halves the previous one (see bake_texture_cache()),
+		// and holds whole blocks.
+		std::uint64_t const blockBytes = CacheFormat_::bc3 == CacheFormat_(aHeader.format) ? kBC3BlockBytes : kBC1BlockBytes;
+		std::uint64_t const blocks = ((std::uint64_t(level.width)+3)/4) * ((std::uint64_t(level.height)+3)/4);
+
+		bool const valid = level.width == std::max( 1u, aHeader.width >> aLevel )
+			&& level.height == std::max( 1u, aHeader.height >> aLevel )
+			&& level.size == blocks * blockBytes
+		;
+		if( !valid )
+			throw Error( "Texture cache '%s': level %u has an invalid size (%ux%u, %llu bytes)", aCachePath, aLevel, level.width, level.height, (unsigned long long)level.size );
+
+		return level;
+	}
+
+	GLenum internal_format_( CacheHeader_ const& aHeader, char const* aCachePath )
+	{
+		switch( CacheFormat_(aHeader.format) )
+		{
+			case CacheFormat_::bc1: return kCompressedSRGB_S3TC_DXT1;
+			case CacheFormat_::bc3: return kCompressedSRGBAlpha_S3TC_DXT5;
+		}
+
+		throw Error( "Texture cache '%s' has unknown format %u", aCachePath, aHeader.format );
+	}
+
+	GLuint load_cache_( char const* aCachePath, CacheStats_& aStats )
+	{
+		auto const file = open_asset( aCachePath, FileMapping::Access::willNeed );
+
+		auto const header = read_header_( file, aCachePath );
+		auto const internalFormat = internal_format_( header, aCachePath );
+
+		aStats.format = CacheFormat_(header.format);
+		aStats.width = header.width;
+		aStats.height = header.height;
+		aStats.levels = header.levelCount;
+		aStats.compressedBytes = 0;
+		aStats.uncompressedBytes = 0;
+
+		GLuint tex = 0;
+		glGenTextures( 1, &tex );
+		glBindTexture( GL_TEXTURE_2D, tex );
+
+		// Tightly packed blocks
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+		for( std::uint32_t i = 0; i < header.levelCount; ++i )
+		{
+			auto const level = read_level_( file, header, i, aCachePath );
+
+			glCompressedTexImage2D( GL_TEXTURE_2D, GLint(i), internalFormat, GLsizei(level.width), GLsizei(level.height), 0, GLsizei(level.size), file.data() + level.offset );
+
+			aStats.compressedBytes += level.size;
+			aStats.uncompressedBytes += std::uint64_t(level.width)*level.height*4;
+		}
+
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0 );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(header.levelCount-1) );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+
+		glBindTexture( GL_TEXTURE_2D, 0 );
+
+		OGL_CHECKPOINT_DEBUG();
+
+		return tex;
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef TEXTURE_CACHE_HPP_ACCF9033_CFB8_400A_B851_5DA141D0E02F
+#define TEXTURE_CACHE_HPP_ACCF9033_CFB8_400A_B851_5DA141D0E02F
+
+#include <glad.h>
+
+#include <string>
+#include <cstdint>
+
+/* Baked texture cache
+ *
+ * Decoding JPEG/PNG images and running glGenerateMipmap() on every launch is
+ * slow, and the result sits in VRAM as uncompressed RGBA8. Instead, images are
+ * baked once into a cache file (next to the source, with a ".texcache" suffix)
+ * that holds the full mip chain, already block compressed:
+ *
+ *  - mip levels are downsampled in linear space (the textures are sRGB, and
+ *    the framebuffer is sRGB-capable), and
+ *  - each level is compressed to BC1 (opaque) or BC3 (with alpha).
+ *
+ * At runtime, the cache is memory mapped and the levels are passed directly
+ * to glCompressedTexImage2D().
+ *
+ * The cache records the size and modification time of the source image. A
+ * stale cache is re-baked automatically.
+ */
+
+struct TextureCacheInfo
+{
+	GLenum internalFormat; // compressed sRGB format of the levels
+	std::uint32_t width, height;
+	std::uint32_t levels;
+};
+
+// Returns true if the implementation supports the compressed formats used by
+// the cache (sRGB S3TC: GL_EXT_texture_compression_s3tc_srgb, or
+// GL_EXT_texture_compression_s3tc and GL_EXT_texture_sRGB). Requires a
+// current OpenGL context.
+bool texture_cache_supported();
+
+// Returns the cache path used for a given source image.
+std::string texture_cache_path( char const* aSourcePath );
+
+// Bakes the cache for a source image if it is missing or stale, unless the
+// cache is in the mounted asset archive. Returns the path of the cache.
+std::string ensure_texture_cache( char const* aSourcePath );
+
+// Bake source image into a cache file. Throws on errors.
+void bake_texture_cache( char const* aSourcePath, char const* aCachePath );
+
+// Load a previously baked cache file into a new GL_TEXTURE_2D. Throws if the
+// file is missing or invalid.
+GLuint load_texture_cache( char const* aCachePath );
+
+// Read dimensions and format from a cache file without uploading anything.
+TextureCacheInfo query_texture_cache( char const* aCachePath );
+
+// Upload all levels of a cache into one layer of the currently bound
+// GL_TEXTURE_2D_ARRAY. The array's storage must match query_texture_cache().
+void upload_texture_cache_layer( char const* aCachePath, GLint aLayer );
+
+// Load texture through the cache, baking it first if necessary. Falls back to
+// load_texture_2d() if the implementation does not support sRGB S3TC.
+GLuint load_texture_2d_cached( char const* aSourcePath );
+
+#endif // TEXTURE_CACHE_HPP_ACCF9033_CFB8_400A_B851_5DA141D0E02F
@@ -0,0 +1,784 @@
+#include "virtual_texture.hpp"
+
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#include <system_error>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+#include <stb_image.h>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+#include "../support/asset_store.hpp"
+
+#include "defaults.hpp"
+#include "cpu_profiler.hpp"
+
+namespace
+{
+	constexpr char const* kTileSuffix_ = ".vtex";
+
+	constexpr std::uint32_t kNoPage_ = ~std::uint32_t(0);
+	constexpr std::uint32_t kNoTile_ = ~std::uint32_t(0);
+
+	// Feedback clear value (no virtually textured surface)
+	constexpr GLuint kNoRequest_ = ~GLuint(0);
+
+	// std430 layout; must match "buffer PageTable" in the shaders
+	struct PageTableHeader_
+	{
+		float size[4];  // xy: level 0 size (texels), z: tile size, w: border
+		float cache[4]; // xy: 1 / cache size (texels), z: page size, w: level count
+		std::uint32_t levels[VirtualTextureFile::kMaxLevels][4]; // x: first entry, yz: tiles
+	};
+
+	static_assert( sizeof(PageTableHeader_) == 288, "Unexpected padding in PageTableHeader_" );
+
+	// Page table entries (page x, y and the level of the tile it holds) and
+	// feedback requests (tile x, y and level) use the same packing.
+	std::uint32_t pack_( std::uint32_t aX, std::uint32_t aY, std::uint32_t aLevel ) noexcept
+	{
+		assert( aX < 4096 && aY < 4096 && aLevel < 256 );
+		return aX | (aY << 12) | (aLevel << 24);
+	}
+
+	struct SourceStamp_
+	{
+		std::uint64_t size;
+		std::int64_t time;
+	};
+
+	bool source_stamp_( char const*, SourceStamp_& );
+	bool tiles_are_current_( char const*, SourceStamp_ const& );
+
+	VirtualTextureStats bake_( char const* aSourcePath, char const* aTilePath, JobSystem& );
+}
+
+// VirtualTexture
+VirtualTexture::VirtualTexture( char const* aTilePath, std::size_t aCachePages, JobSystem& aLoaders )
+	: mFile( aTilePath )
+	, mJobs( aLoaders )
+	, mFeedbackProgram( {
+		{ GL_VERTEX_SHADER, "assets/default.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/vt_feedback.frag" }
+	} )
+	, mCachePages( aCachePages )
+	, mCacheTexture( 0 )
+	, mPageTable( 0 )
+	, mFeedbackFbo( 0 )
+	, mFeedbackColor( 0 ), mFeedbackDepth( 0 )
+	, mFeedbackWidth( 0 ), mFeedbackHeight( 0 )
+	, mFeedbackUsedWidth( 0 ), mFeedbackUsedHeight( 0 )
+	, mFeedbackTarget( nullptr )
+	, mReadbackSequence( 0 )
+	, mVisit( 0 )
+	, mWantedNext( 0 )
+	, mFrame( 0 )
+	, mFeedbackFrame( 0 )
+	, mStats{}
+{
+	auto const pageSize = mFile.page_size();
+
+	GLint maxTextureSize = 0;
+	glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTextureSize );
+
+	if( mCachePages < 2 || mCachePages > kMaxCachePages || mCachePages * pageSize > std::size_t(maxTextureSize) )
+		throw Error( "VirtualTexture: cache of %zu x %zu pages of %u texels not supported (2 to %zu pages, at most %d texels)", mCachePages, mCachePages, pageSize, kMaxCachePages, maxTextureSize );
+
+	auto const pageCount = mCachePages * mCachePages;
+	auto const tileCount = mFile.tile_count();
+
+	mPages.assign( pageCount, Page_{ kNoTile_, 0, false } );
+
+	// Handed out from the back, i.e., page 0 first
+	mFreePages.reserve( pageCount );
+	for( std::size_t i = pageCount; i-- > 0; )
+		mFreePages.emplace_back( std::uint32_t(i) );
+
+	mTileState.assign( tileCount, TileState_::absent );
+	mTilePage.assign( tileCount, kNoPage_ );
+	mEntries.assign( tileCount, 0 );
+	mDirtyBegin.fill( 0 );
+	mDirtyEnd.fill( 0 );
+
+	// Sized for the worst case, so that frames do not allocate.
+	mVisited.assign( tileCount, 0 );
+	mWanted.reserve( tileCount );
+
+	for( std::size_t i = 0; i < kLoadSlots; ++i )
+	{
+		auto& slot = mSlots.emplace_back();
+		slot.texels.resize( mFile.page_bytes() );
+		slot.job = LoadJob_{ &slot, &mFile };
+	}
+
+	// The last level (a single tile) is read before creating any GL
+	// objects, so that a corrupt file does not leak them.
+	auto& first = mSlots.front();
+	first.tile = mFile.level( mFile.level_count()-1 ).firstTile;
+	first.busy = true;
+	mTileState[first.tile] = TileState_::loading;
+	mFile.read_tile( first.tile, first.texels.data() );
+
+	// Physical cache
+	auto const cacheSize = GLsizei(mCachePages * pageSize);
+
+	glGenTextures( 1, &mCacheTexture );
+	glBindTexture( GL_TEXTURE_2D, mCacheTexture );
+	glTexStorage2D( GL_TEXTURE_2D, 1, GL_SRGB8_ALPHA8, cacheSize, cacheSize );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	// Page table
+	PageTableHeader_ header{};
+	header.size[0] = float(mFile.width());
+	header.size[1] = float(mFile.height());
+	header.size[2] = float(mFile.tile_size());
+	header.size[3] = float(mFile.border());
+	header.cache[0] = header.cache[1] = 1.f / float(cacheSize);
+	header.cache[2] = float(pageSize);
+	header.cache[3] = float(mFile.level_count());
+
+	for( std::uint32_t i = 0; i < mFile.level_count(); ++i )
+	{
+		auto const& level = mFile.level( i );
+		header.levels[i][0] = level.firstTile;
+		header.levels[i][1] = level.tilesX;
+		header.levels[i][2] = level.tilesY;
+	}
+
+	glGenBuffers( 1, &mPageTable );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mPageTable );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, GLsizeiptr(sizeof(header) + tileCount*sizeof(std::uint32_t)), nullptr, GL_DYNAMIC_DRAW );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	for( auto& readback : mReadbacks )
+		glGenBuffers( 1, &readback.pbo );
+
+	// Upload and pin the last level. Every page table entry now points to
+	// it.
+	[[maybe_unused]] bool const uploaded = upload_( first );
+	assert( uploaded );
+
+	mPages[mTilePage[first.tile]].pinned = true;
+	flush_entries_();
+
+	mStats.pages = pageCount;
+	mStats.pinnedPages = 1;
+	mStats.tiles = tileCount;
+	mStats.cacheBytes = std::uint64_t(cacheSize) * cacheSize * 4;
+	mStats.residentPages = 1;
+	mStats.uploaded = 0;
+	mStats.totalUploads = 0;
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	for( auto& slot : mSlots )
+		mJobs.wait( slot.done );
+
+	for( auto& readback : mReadbacks )
+	{
+		if( readback.fence )
+			glDeleteSync( readback.fence );
+		glDeleteBuffers( 1, &readback.pbo );
+	}
+
+	if( 0 != mFeedbackFbo )
+	{
+		glDeleteFramebuffers( 1, &mFeedbackFbo );
+		glDeleteRenderbuffers( 1, &mFeedbackColor );
+		glDeleteRenderbuffers( 1, &mFeedbackDepth );
+	}
+
+	glDeleteBuffers( 1, &mPageTable );
+	glDeleteTextures( 1, &mCacheTexture );
+}
+
+void VirtualTexture::update( std::size_t aFrame )
+{
+	PROFILE_SCOPE( "virtual texture" );
+
+	mFrame = aFrame;
+	mStats.uploaded = 0;
+
+	// Feedback that has arrived, oldest first
+	while( true )
+	{
+		Readback_* oldest = nullptr;
+		for( auto& readback : mReadbacks )
+		{
+			if( readback.fence && (!oldest || readback.sequence < oldest->sequence) )
+				oldest = &readback;
+		}
+
+		if( !oldest )
+			break;
+
+		auto const status = glClientWaitSync( oldest->fence, 0, 0 );
+		if( GL_ALREADY_SIGNALED != status && GL_CONDITION_SATISFIED != status )
+			break;
+
+		glDeleteSync( oldest->fence );
+		oldest->fence = nullptr;
+
+		auto const count = std::size_t(oldest->width) * std::size_t(oldest->height);
+
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, oldest->pbo );
+		if( auto const* data = static_cast<std::uint32_t const*>(glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(count*sizeof(std::uint32_t)), GL_MAP_READ_BIT )) )
+		{
+			process_feedback_( data, count );
+			glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+		}
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+	}
+
+	// Upload finished loads
+	std::size_t uploads = 0;
+	for( auto& slot : mSlots )
+	{
+		if( uploads == kMaxUploadsPerFrame )
+			break;
+
+		if( !slot.busy || !slot.done.done() )
+			continue;
+
+		if( slot.error )
+			std::rethrow_exception( slot.error );
+
+		if( upload_( slot ) )
+			++uploads;
+	}
+
+	flush_entries_();
+
+	// Slots freed above take the next missing tiles.
+	start_loads_();
+
+	mStats.residentPages = mPages.size() - mFreePages.size();
+	mStats.loading = std::size_t(std::count_if( mSlots.begin(), mSlots.end(), [] (LoadSlot_ const& aSlot) {
+		return aSlot.busy;
+	} ));
+}
+
+void VirtualTexture::bind() const
+{
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kPageTableBinding, mPageTable );
+
+	glActiveTexture( GL_TEXTURE0 + kCacheTextureUnit );
+	glBindTexture( GL_TEXTURE_2D, mCacheTexture );
+	glActiveTexture( GL_TEXTURE0 );
+}
+
+bool VirtualTexture::begin_feedback( int aSceneWidth, int aSceneHeight, std::size_t aFrame, Mat44f& aJitter )
+{
+	assert( !mFeedbackTarget );
+
+	for( auto& readback : mReadbacks )
+	{
+		if( !readback.fence )
+		{
+			mFeedbackTarget = &readback;
+			break;
+		}
+	}
+
+	if( !mFeedbackTarget )
+	{
+		++mStats.feedbackSkipped;
+		return false;
+	}
+
+	int const width = std::max( 1, (aSceneWidth + int(kFeedbackDivisor)-1) / int(kFeedbackDivisor) );
+	int const height = std::max( 1, (aSceneHeight + int(kFeedbackDivisor)-1) / int(kFeedbackDivisor) );
+
+	// The target only grows, so that dynamic resolution does not
+	// re-create it all the time.
+	if( width > mFeedbackWidth || height > mFeedbackHeight )
+	{
+		if( 0 != mFeedbackFbo )
+		{
+			glDeleteFramebuffers( 1, &mFeedbackFbo );
+			glDeleteRenderbuffers( 1, &mFeedbackColor );
+			glDeleteRenderbuffers( 1, &mFeedbackDepth );
+		}
+
+		mFeedbackWidth = std::max( width, mFeedbackWidth );
+		mFeedbackHeight = std::max( height, mFeedbackHeight );
+
+		glGenRenderbuffers( 1, &mFeedbackColor );
+		glBindRenderbuffer( GL_RENDERBUFFER, mFeedbackColor );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_R32UI, mFeedbackWidth, mFeedbackHeight );
+
+		glGenRenderbuffers( 1, &mFeedbackDepth );
+		glBindRenderbuffer( GL_RENDERBUFFER, mFeedbackDepth );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, mFeedbackWidth, mFeedbackHeight );
+		glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+		glGenFramebuffers( 1, &mFeedbackFbo );
+		glBindFramebuffer( GL_FRAMEBUFFER, mFeedbackFbo );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mFeedbackColor );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mFeedbackDepth );
+
+		if( auto const status = glCheckFramebufferStatus( GL_FRAMEBUFFER ); GL_FRAMEBUFFER_COMPLETE != status )
+			throw Error( "VirtualTexture: feedback framebuffer (%dx%d) incomplete: %#x", mFeedbackWidth, mFeedbackHeight, unsigned(status) );
+	}
+
+	mFeedbackUsedWidth = width;
+	mFeedbackUsedHeight = height;
+
+	glBindFramebuffer( GL_FRAMEBUFFER, mFeedbackFbo );
+	glViewport( 0, 0, width, height );
+
+	GLuint const clear[4] = { kNoRequest_, 0, 0, 0 };
+	glClearBufferuiv( GL_COLOR, 0, clear );
+	glClear( GL_DEPTH_BUFFER_BIT );
+
+	// Derivatives are kFeedbackDivisor times larger than in the scene.
+	glUseProgram( mFeedbackProgram.programId() );
+	glUniform1f( kLodBiasLocation, -std::log2( float(kFeedbackDivisor) ) );
+
+	// Subpixel offset, visiting all kFeedbackDivisor² positions of a
+	// scene pixel block in turn (both strides are coprime with the
+	// divisor).
+	float const jx = (float( (aFrame * 5) % kFeedbackDivisor ) + 0.5f) / float(kFeedbackDivisor) - 0.5f;
+	float const jy = (float( (aFrame / kFeedbackDivisor * 3) % kFeedbackDivisor ) + 0.5f) / float(kFeedbackDivisor) - 0.5f;
+	aJitter = make_translation( { 2.f * jx / float(width), 2.f * jy / float(height), 0.f } );
+
+	return true;
+}
+
+void VirtualTexture::end_feedback()
+{
+	assert( mFeedbackTarget );
+	auto& readback = *mFeedbackTarget;
+	mFeedbackTarget = nullptr;
+
+	auto const bytes = std::size_t(mFeedbackUsedWidth) * std::size_t(mFeedbackUsedHeight) * sizeof(std::uint32_t);
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.pbo );
+	if( bytes > readback.capacity )
+	{
+		glBufferData( GL_PIXEL_PACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_READ );
+		readback.capacity = bytes;
+	}
+
+	glReadPixels( 0, 0, mFeedbackUsedWidth, mFeedbackUsedHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	readback.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	readback.width = mFeedbackUsedWidth;
+	readback.height = mFeedbackUsedHeight;
+	readback.sequence = mReadbackSequence++;
+
+	glUseProgram( 0 );
+
+	OGL_CHECKPOINT_DEBUG();
+}
+
+VirtualTextureFile const& VirtualTexture::file() const noexcept
+{
+	return mFile;
+}
+
+std::size_t VirtualTexture::cache_pages() const noexcept
+{
+	return mCachePages;
+}
+
+VirtualTextureCacheStats const& VirtualTexture::stats() const noexcept
+{
+	return mStats;
+}
+
+void VirtualTexture::process_feedback_( std::uint32_t const* aRequests, std::size_t aCount )
+{
+	if( 0 == ++mVisit )
+	{
+		std::fill( mVisited.begin(), mVisited.end(), 0 );
+		mVisit = 1;
+	}
+
+	mFeedbackFrame = mFrame;
+	mWanted.clear();
+	mWantedNext = 0;
+
+	std::size_t requested = 0, missing = 0;
+
+	auto const levels = mFile.level_count();
+
+	std::uint32_t previous = kNoRequest_;
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		auto const request = aRequests[i];
+		if( kNoRequest_ == request || previous == request )
+			continue;
+
+		previous = request;
+
+		std::uint32_t level = request >> 24;
+		std::uint32_t x = request & 0xfff, y = (request >> 12) & 0xfff;
+		if( level >= levels || x >= mFile.level( level ).tilesX || y >= mFile.level( level ).tilesY )
+			continue;
+
+		auto tile = std::uint32_t(mFile.tile_index( level, x, y ));
+		if( mVisit == mVisited[tile] )
+			continue;
+
+		++requested;
+		if( TileState_::resident != mTileState[tile] )
+			++missing;
+
+		// The tile and its ancestors (until one that was seen already):
+		// keep the resident ones, load the missing ones.
+		while( true )
+		{
+			mVisited[tile] = mVisit;
+
+			if( TileState_::resident == mTileState[tile] )
+				mPages[mTilePage[tile]].lastUsed = mFrame;
+			else if( TileState_::absent == mTileState[tile] )
+				mWanted.emplace_back( tile );
+
+			if( ++level == levels )
+				break;
+
+			x /= 2;
+			y /= 2;
+			tile = std::uint32_t(mFile.tile_index( level, x, y ));
+
+			if( mVisit == mVisited[tile] )
+				break;
+		}
+	}
+
+	// Coarser levels first: their tiles come after the finer levels' in
+	// the file, so that is descending tile order.
+	std::sort( mWanted.begin(), mWanted.end(), std::greater<std::uint32_t>() );
+
+	mStats.requested = requested;
+	mStats.missing = missing;
+	++mStats.feedbackReads;
+}
+
+void VirtualTexture::start_loads_()
+{
+	// Only load as many tiles as there are pages to put them in (free, or
+	// not requested by the most recent feedback); see upload_().
+	std::size_t available = mFreePages.size();
+	for( auto const& page : mPages )
+	{
+		if( !page.pinned && kNoTile_ != page.tile && page.lastUsed < mFeedbackFrame )
+			++available;
+	}
+
+	for( auto const& slot : mSlots )
+	{
+		if( slot.busy )
+			available -= std::min<std::size_t>( available, 1 );
+	}
+
+	for( auto& slot : mSlots )
+	{
+		if( 0 == available )
+			break;
+
+		if( slot.busy )
+			continue;
+
+		while( mWantedNext < mWanted.size() && TileState_::absent != mTileState[mWanted[mWantedNext]] )
+			++mWantedNext;
+
+		if( mWantedNext == mWanted.size() )
+			break;
+
+		slot.tile = mWanted[mWantedNext++];
+		slot.busy = true;
+		slot.error = nullptr;
+		mTileState[slot.tile] = TileState_::loading;
+		--available;
+
+		mJobs.parallel_for( 1, 1, slot.job, slot.done );
+	}
+}
+
+bool VirtualTexture::upload_( LoadSlot_& aSlot )
+{
+	assert( aSlot.busy && TileState_::loading == mTileState[aSlot.tile] );
+	aSlot.busy = false;
+
+	std::uint32_t page = kNoPage_;
+	if( !mFreePages.empty() )
+	{
+		page = mFreePages.back();
+		mFreePages.pop_back();
+	}
+	else
+	{
+		// Least recently requested page. Pages requested by the most
+		// recent feedback (or uploaded since) are never evicted; the tile
+		// is dropped instead, and requested again by later feedback.
+		std::size_t oldest = ~std::size_t(0);
+		for( std::size_t i = 0; i < mPages.size(); ++i )
+		{
+			if( !mPages[i].pinned && mPages[i].lastUsed < oldest )
+			{
+				oldest = mPages[i].lastUsed;
+				page = std::uint32_t(i);
+			}
+		}
+
+		if( kNoPage_ == page || oldest >= mFeedbackFrame )
+		{
+			mTileState[aSlot.tile] = TileState_::absent;
+			++mStats.dropped;
+			return false;
+		}
+
+		evict_( page );
+	}
+
+	auto const pageSize = GLint(mFile.page_size());
+	auto const px = GLint(page % mCachePages), py = GLint(page / mCachePages);
+
+	glBindTexture( GL_TEXTURE_2D, mCacheTexture );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, px * pageSize, py * pageSize, pageSize, pageSize, GL_RGBA, GL_UNSIGNED_BYTE, aSlot.texels.data() );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	mPages[page] = Page_{ aSlot.tile, mFrame, false };
+	mTileState[aSlot.tile] = TileState_::resident;
+	mTilePage[aSlot.tile] = page;
+
+	update_entries_( aSlot.tile );
+
+	++mStats.uploaded;
+	++mStats.totalUploads;
+	return true;
+}
+
+void VirtualTexture::evict_( std::uint32_t aPage )
+{
+	auto& page = mPages[aPage];
+	assert( !page.pinned && kNoTile_ != page.tile );
+
+	auto const tile = page.tile;
+	mTileState[tile] = TileState_::absent;
+	mTilePage[tile] = kNoPage_;
+	page.tile = kNoTile_;
+
+	update_entries_( tile );
+
+	++mStats.totalEvictions;
+}
+
+void VirtualTexture::tile_coords_( std::uint32_t aTile, std::uint32_t& aLevel, std::uint32_t& aX, std::uint32_t& aY ) const noexcept
+{
+	for( auto level = mFile.level_count(); level-- > 0; )
+	{
+		auto const& info = mFile.level( level );
+		if( aTile >= info.firstTile )
+		{
+			auto const local = aTile - info.firstTile;
+			aLevel = level;
+			aX = local % info.tilesX;
+			aY = local / info.tilesX;
+			return;
+		}
+	}
+
+	assert( false );
+}
+
+void VirtualTexture::update_entries_( std::uint32_t aTile )
+{
+	std::uint32_t tileLevel = 0, tileX = 0, tileY = 0;
+	tile_coords_( aTile, tileLevel, tileX, tileY );
+
+	// The tile covers 2^k x 2^k tiles k levels below. Each entry is the
+	// tile's own page if resident, else its parent's entry; so go from the
+	// tile's level down.
+	for( auto level = tileLevel+1; level-- > 0; )
+	{
+		auto const& info = mFile.level( level );
+		auto const shift = tileLevel - level;
+
+		auto const x0 = tileX << shift, y0 = tileY << shift;
+		auto const x1 = std::min( (tileX+1) << shift, info.tilesX );
+		auto const y1 = std::min( (tileY+1) << shift, info.tilesY );
+
+		for( auto y = y0; y < y1; ++y )
+		{
+			for( auto x = x0; x < x1; ++x )
+			{
+				auto const index = info.firstTile + y*info.tilesX + x;
+				if( TileState_::resident == mTileState[index] )
+				{
+					auto const page = mTilePage[index];
+					mEntries[index] = pack_( std::uint32_t(page % mCachePages), std::uint32_t(page / mCachePages), level );
+				}
+				else
+				{
+					// The last level is pinned, so there always is a parent.
+					assert( level+1 < mFile.level_count() );
+					mEntries[index] = mEntries[mFile.tile_index( level+1, x/2, y/2 )];
+				}
+			}
+		}
+
+		std::size_t const begin = info.firstTile + std::size_t(y0)*info.tilesX + x0;
+		std::size_t const end = info.firstTile + std::size_t(y1-1)*info.tilesX + x1;
+
+		if( mDirtyBegin[level] >= mDirtyEnd[level] )
+		{
+			mDirtyBegin[level] = begin;
+			mDirtyEnd[level] = end;
+		}
+		else
+		{
+			mDirtyBegin[level] = std::min( mDirtyBegin[level], begin );
+			mDirtyEnd[level] = std::max( mDirtyEnd[level], end );
+		}
+	}
+}
+
+void VirtualTexture::flush_entries_()
+{
+	bool bound = false;
+	for( std::uint32_t level = 0; level < mFile.level_count(); ++level )
+	{
+		auto& begin = mDirtyBegin[level];
+		auto& end = mDirtyEnd[level];
+		if( begin >= end )
+			continue;
+
+		if( !bound )
+		{
+			glBindBuffer( GL_SHADER_STORAGE_BUFFER, mPageTable );
+			bound = true;
+		}
+
+		glBufferSubData( GL_SHADER_STORAGE_BUFFER,
+			GLintptr(sizeof(PageTableHeader_) + begin*sizeof(std::uint32_t)),
+			GLsizeiptr((end - begin)*sizeof(std::uint32_t)),
+			mEntries.data() + begin
+		);
+
+		begin = end = 0;
+	}
+
+	if( bound )
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+void VirtualTexture::LoadJob_::operator() ( std::size_t, std::size_t )
+{
+	try
+	{
+		file->read_tile( slot->tile, slot->texels.data() );
+	}
+	catch( ... )
+	{
+		slot->error = std::current_exception();
+	}
+}
+
+// Free functions
+std::string virtual_texture_path( char const* aSourcePath )
+{
+	return std::string(aSourcePath) + kTileSuffix_;
+}
+
+std::string ensure_virtual_texture( char const* aSourcePath, JobSystem& aJobs )
+{
+	auto tilePath = virtual_texture_path( aSourcePath );
+
+	// As ensure_texture_cache(): archived tiles are used as-is, and a
+	// missing source is OK if the tiles exist.
+	if( asset_in_archive( tilePath ) )
+		return tilePath;
+
+	SourceStamp_ stamp{};
+	if( source_stamp_( aSourcePath, stamp ) && !tiles_are_current_( tilePath.c_str(), stamp ) )
+	{
+		auto const bakeStart = Clock::now();
+		auto const stats = bake_( aSourcePath, tilePath.c_str(), aJobs );
+		auto const bakeTime = std::chrono::duration_cast<Secondsf>(Clock::now() - bakeStart).count();
+
+		std::printf( "Tiled virtual texture '%s': %u levels, %zu tiles (%zu compressed), %.1f MiB in %.1f ms\n",
+			tilePath.c_str(),
+			stats.levels, stats.tiles, stats.compressed,
+			stats.fileBytes / (1024.0*1024.0),
+			bakeTime * 1000.f
+		);
+	}
+
+	return tilePath;
+}
+
+namespace
+{
+	bool source_stamp_( char const* aPath, SourceStamp_& aStamp )
+	{
+		std::error_code ec;
+		auto const size = std::filesystem::file_size( aPath, ec );
+		if( ec )
+			return false;
+
+		auto const time = std::filesystem::last_write_time( aPath, ec );
+		if( ec )
+			return false;
+
+		aStamp.size = size;
+		aStamp.time = std::int64_t(time.time_since_epoch().count());
+		return true;
+	}
+
+	bool tiles_are_current_( char const* aTilePath, SourceStamp_ const& aStamp )
+	{
+		std::error_code ec;
+		if( !std::filesystem::exists( aTilePath, ec ) )
+			return false;
+
+		// Invalid (e.g., truncated or old version) tiles are re-baked.
+		try
+		{
+			VirtualTextureFile const file( aTilePath );
+			return aStamp.size == file.source_size() && aStamp.time == file.source_time();
+		}
+		catch( Error const& )
+		{
+			return false;
+		}
+	}
+
+	VirtualTextureStats bake_( char const* aSourcePath, char const* aTilePath, JobSystem& aJobs )
+	{
+		SourceStamp_ stamp{};
+		if( !source_stamp_( aSourcePath, stamp ) )
+			throw Error( "ensure_virtual_texture(): unable to stat '%s'", aSourcePath );
+
+		// Same orientation as load_texture_2d() and the texture cache
+		stbi_set_flip_vertically_on_load( true );
+
+		auto const source = open_asset( aSourcePath );
+
+		int w, h, channels;
+		std::unique_ptr<stbi_uc, void (*)(void*)> texels( stbi_load_from_memory( source.data(), int(source.size()), &w, &h, &channels, 4 ), &stbi_image_free );
+		if( !texels )
+			throw Error( "ensure_virtual_texture(): unable to load image '%s'", aSourcePath );
+
+		return write_virtual_texture( aTilePath, VirtualTextureSource{ texels.get(), std::uint32_t(w), std::uint32_t(h), stamp.size, stamp.time }, VirtualTexture::kTileSize, VirtualTexture::kBorder, aJobs );
+	}
+}
@@ -0,0 +1,228 @@
+#ifndef VIRTUAL_TEXTURE_HPP_8E4D2B61_0C57_4A9F_B3E8_2F61D7A90C35
+#define VIRTUAL_TEXTURE_HPP_8E4D2B61_0C57_4A9F_B3E8_2F61D7A90C35
+
+#include <glad.h>
+
+#include <array>
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+#include "../support/program.hpp"
+#include "../support/virtual_texture_file.hpp"
+
+#include "../jobs/job_system.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+struct VirtualTextureCacheStats
+{
+	std::size_t pages;           // physical pages in the cache
+	std::size_t residentPages;   // including pinned ones
+	std::size_t pinnedPages;     // the last level (always resident)
+	std::size_t tiles;           // all levels
+	std::uint64_t cacheBytes;
+
+	// Most recent feedback
+	std::size_t requested;       // distinct tiles
+	std::size_t missing;         // requested, but not resident (drawn from a coarser level)
+
+	std::size_t loading;
+	std::size_t uploaded;        // most recent frame
+
+	// Since the start
+	std::size_t totalUploads;
+	std::size_t totalEvictions;
+	std::size_t dropped;         // loaded tiles discarded because all pages were in use
+	std::size_t feedbackReads;
+	std::size_t feedbackSkipped; // no free readback buffer
+};
+
+/* Sparse virtual texture
+ *
+ * Draws a texture that is too large to upload (see VirtualTextureFile) from
+ * a fixed-size cache of pages, without requiring sparse texture extensions:
+ *
+ *  - the physical cache is a single GL_TEXTURE_2D of cachePages x
+ *    cachePages pages (bilinear, no mips; the pages' borders make filtering
+ *    across tile edges seamless),
+ *  - the page table is a shader storage buffer with one entry per tile of
+ *    every level: the page of the finest resident level covering the tile.
+ *    The last level is always resident, so every lookup hits a page, and
+ *    missing tiles are drawn from the nearest coarser level,
+ *  - a feedback pass draws the scene at 1/kFeedbackDivisor resolution into
+ *    an integer target, writing the tile that each pixel would sample.
+ *    The target is read back asynchronously (PBO and fence, as in
+ *    FrameCapture), a few frames late. The projection is jittered by a
+ *    subpixel offset each frame, so that small features are eventually
+ *    seen, and
+ *  - update() turns the feedback into requests (missing coarser ancestors
+ *    first), reads requested tiles on loader jobs, and uploads at most
+ *    kMaxUploadsPerFrame finished ones per frame, evicting the least
+ *    recently requested pages.
+ *
+ * Shader interface (see assets/default.frag and assets/vt_feedback.frag):
+ *   layout( std430, binding = kPageTableBinding ) buffer PageTable
+ *   layout( binding = kCacheTextureUnit ) uniform sampler2D ...
+ *
+ * Render thread only (GL context, and the owner of aLoaders, which may be
+ * shared with other loaders).
+ */
+class VirtualTexture final
+{
+	public:
+		static constexpr GLuint kPageTableBinding = 5;
+		static constexpr GLuint kCacheTextureUnit = 5;
+		static constexpr GLint kLodBiasLocation = 16; // vt_feedback.frag
+
+		// Tiles baked by ensure_virtual_texture(): 128x128 texel pages
+		static constexpr std::uint32_t kTileSize = 120;
+		static constexpr std::uint32_t kBorder = 4;
+
+		static constexpr std::size_t kMaxCachePages = 64; // per side
+		static constexpr std::uint32_t kFeedbackDivisor = 8;
+		static constexpr std::size_t kReadbackSlots = 3;
+
+		static constexpr std::size_t kLoadSlots = 16;
+		static constexpr std::size_t kMaxUploadsPerFrame = 8;
+
+	public:
+		// aCachePages: pages per side of the physical cache. Tiles are read
+		// on aLoaders. The last level is loaded and uploaded before
+		// returning.
+		VirtualTexture( char const* aTilePath, std::size_t aCachePages, JobSystem& aLoaders );
+		~VirtualTexture(); // Waits for running loaders
+
+		VirtualTexture( VirtualTexture const& ) = delete;
+		VirtualTexture& operator= (VirtualTexture const&) = delete;
+
+	public:
+		// Processes feedback that has arrived, starts loads, and uploads
+		// loaded tiles. Rethrows errors from loaders.
+		void update( std::size_t aFrame );
+
+		void bind() const;
+
+		// Feedback pass. If begin_feedback() returns true, draw the scene
+		// with aJitter applied after the projection (the feedback program
+		// is bound, and uses the default.vert interface), then call
+		// end_feedback(). Binds the feedback framebuffer and sets the
+		// viewport; the caller restores both. Returns false (and binds
+		// nothing) while all readback buffers are busy.
+		bool begin_feedback( int aSceneWidth, int aSceneHeight, std::size_t aFrame, Mat44f& aJitter );
+		void end_feedback();
+
+		VirtualTextureFile const& file() const noexcept;
+		std::size_t cache_pages() const noexcept;
+
+		VirtualTextureCacheStats const& stats() const noexcept;
+
+	private:
+		enum class TileState_ : std::uint8_t
+		{
+			absent,
+			loading,
+			resident
+		};
+
+		struct Page_
+		{
+			std::uint32_t tile;
+			std::size_t lastUsed;
+			bool pinned;
+		};
+
+		struct LoadSlot_;
+
+		// Job functor (see JobSystem::parallel_for()); lives in its slot
+		struct LoadJob_
+		{
+			LoadSlot_* slot;
+			VirtualTextureFile const* file;
+			void operator() ( std::size_t, std::size_t );
+		};
+
+		struct LoadSlot_
+		{
+			bool busy = false;
+			std::uint32_t tile = 0;
+			std::vector<std::uint8_t> texels; // one page
+			std::exception_ptr error;
+
+			LoadJob_ job;
+			JobCounter done;
+		};
+
+		struct Readback_
+		{
+			GLuint pbo = 0;
+			GLsync fence = nullptr;
+			std::size_t capacity = 0; // bytes
+			int width = 0, height = 0;
+			std::size_t sequence = 0;
+		};
+
+		void process_feedback_( std::uint32_t const*, std::size_t aCount );
+		void start_loads_();
+
+		bool upload_( LoadSlot_& );
+		void evict_( std::uint32_t aPage );
+
+		void tile_coords_( std::uint32_t aTile, std::uint32_t& aLevel, std::uint32_t& aX, std::uint32_t& aY ) const noexcept;
+		void update_entries_( std::uint32_t aTile );
+		void flush_entries_();
+
+	private:
+		VirtualTextureFile mFile;
+		JobSystem& mJobs;
+		ShaderProgram mFeedbackProgram;
+
+		std::size_t mCachePages;
+		GLuint mCacheTexture;
+		GLuint mPageTable;
+
+		GLuint mFeedbackFbo;
+		GLuint mFeedbackColor, mFeedbackDepth;
+		int mFeedbackWidth, mFeedbackHeight;     // allocated
+		int mFeedbackUsedWidth, mFeedbackUsedHeight; // current pass
+
+		std::array<Readback_, kReadbackSlots> mReadbacks;
+		Readback_* mFeedbackTarget; // between begin_ and end_feedback()
+		std::size_t mReadbackSequence;
+
+		std::vector<Page_> mPages;
+		std::vector<std::uint32_t> mFreePages;
+
+		std::vector<TileState_> mTileState;
+		std::vector<std::uint32_t> mTilePage;
+		std::vector<std::uint32_t> mEntries; // CPU copy of the page table
+
+		// Dirty entries of each level, [begin,end) (empty if begin >= end)
+		std::array<std::size_t, VirtualTextureFile::kMaxLevels> mDirtyBegin, mDirtyEnd;
+
+		// Scratch for process_feedback_(): tiles seen in the current
+		// feedback (mVisited[tile] == mVisit), and missing ones to load
+		std::vector<std::uint32_t> mVisited;
+		std::uint32_t mVisit;
+		std::vector<std::uint32_t> mWanted;
+		std::size_t mWantedNext; // next one for start_loads_()
+
+		std::deque<LoadSlot_> mSlots; // stable addresses (LoadJob_, JobCounter)
+
+		std::size_t mFrame;
+		std::size_t mFeedbackFrame; // frame of the most recent feedback
+		VirtualTextureCacheStats mStats;
+};
+
+// Returns the tile file path used for a given source image.
+std::string virtual_texture_path( char const* aSourcePath );
+
+// Tiles a source image if its tile file is missing or stale (with kTileSize
+// and kBorder, on aJobs), unless the tile file is in the mounted asset
+// archive. Returns the path of the tile file. Like ensure_texture_cache().
+std::string ensure_virtual_texture( char const* aSourcePath, JobSystem& aJobs );
+
+#endif // VIRTUAL_TEXTURE_HPP_8E4D2B61_0C57_4A9F_B3E8_2F61D7A90C35
@@ -1,3 +1,36 @@
+newoption {
+	trigger = "cpu-profiler",
+	description = "Keep the CPU profiler's PROFILE_SCOPE() macros in release builds"
+}
+
+-- Headless runs of the release build that fail if the frame loop allocates
+-- after the warm-up. Build first (e.g. `make config=release_x64`), then run
+-- `premake5 check-allocations`.
+newaction {
+	trigger = "check-allocations",
+	description = "Run the headless benchmarks (release build) with --check-allocations",
+	execute = function()
+		os.chdir( _MAIN_SCRIPT_DIR )
+
+		local exes = os.matchfiles( "bin/main-release-*.exe" )
+		if #exes == 0 then
+			error( "bin/main-release-*.exe not found; build the release configuration first", 0 )
+		end
+
+		local runs = {
+			"--headless --frames=300 --check-allocations",
+			"--headless --light-benchmark --check-allocations"
+		}
+		for _, args in ipairs( runs ) do
+			local command = path.translate( exes[1] ) .. " " .. args
+			print( command )
+			if not os.execute( command ) then
+				error( "check-allocations failed: " .. command, 0 )
+			end
+		end
+	end
+}
+
 workspace "COMP3811-cw2"
 	language "C++"
 	cppdialect "C++17"
@@ -64,6 +97,9 @@ workspace "COMP3811-cw2"
 		optimize "On"
 		defines { "NDEBUG=1" }
 
+	filter "options:cpu-profiler"
+		defines { "CPU_PROFILER_ENABLED=1" }
+
 	filter "*"
 
 
@@ -86,10 +122,12 @@ project "main"
 
 	links "vmlib"
 	links "support"
+	links "jobs"
 
 	links "x-stb"
 	links "x-glad"
 	links "x-glfw"
+	links "x-fontstash"
 
 	files( sources )
 
@@ -134,6 +172,67 @@ project "vmlib"
 
 	files( sources )
 
+project "jobs"
+	local sources = { 
+		"jobs/**.cpp",
+		"jobs/**.hpp",
+		"jobs/**.hxx",
+		"jobs/**.inl"
+	}
+
+	kind "StaticLib"
+	location "jobs"
+
+	files( sources )
+
+project "imgdiff"
+	local sources = { 
+		"imgdiff/**.cpp",
+		"imgdiff/**.hpp",
+		"imgdiff/**.hxx",
+		"imgdiff/**.inl"
+	}
+
+	kind "ConsoleApp"
+	location "imgdiff"
+
+	files( sources )
+
+	links "x-stb"
+
+project "asset-packer"
+	local sources = { 
+		"asset-packer/**.cpp",
+		"asset-packer/**.hpp",
+		"asset-packer/**.hxx",
+		"asset-packer/**.inl"
+	}
+
+	kind "ConsoleApp"
+	location "asset-packer"
+
+	files( sources )
+
+	links "support"
+	links "jobs"
+
+project "vt-tiler"
+	local sources = { 
+		"vt-tiler/**.cpp",
+		"vt-tiler/**.hpp",
+		"vt-tiler/**.hxx",
+		"vt-tiler/**.inl"
+	}
+
+	kind "ConsoleApp"
+	location "vt-tiler"
+
+	files( sources )
+
+	links "support"
+	links "jobs"
+	links "x-stb"
+
 project "vmlib-test"
 	local sources = { 
 		"vmlib-test/**.cpp",
@@ -148,6 +247,8 @@ project "vmlib-test"
 	files( sources )
 
 	links "vmlib"
+	links "support"
+	links "jobs"
 	links "x-catch2"
 
 	files( sources )
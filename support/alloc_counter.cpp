@@ -0,0 +1,181 @@
+#include "alloc_counter.hpp"
+
+#include <new>
+
+#include <cstddef>
+#include <cstdlib>
+
+#if defined(_MSC_VER)
+#	include <malloc.h>
+#endif
+
+namespace
+{
+	// Thread local, so that counting does not contend between threads.
+	// Trivial types only: these may be touched before any constructors run.
+	thread_local std::uint64_t tAllocations_ = 0;
+	thread_local std::uint64_t tBytes_ = 0;
+
+	void* allocate_( std::size_t aSize ) noexcept
+	{
+		++tAllocations_;
+		tBytes_ += aSize;
+
+		if( 0 == aSize )
+			aSize = 1;
+
+		while( true )
+		{
+			if( void* ptr = std::malloc( aSize ) )
+				return ptr;
+
+			auto const handler = std::get_new_handler();
+			if( !handler )
+				return nullptr;
+
+			handler(); // may throw std::bad_alloc
+		}
+	}
+
+	void* allocate_aligned_( std::size_t aSize, std::size_t aAlign ) noexcept
+	{
+		++tAllocations_;
+		tBytes_ += aSize;
+
+		// std::aligned_alloc() requires a multiple of the alignment. MSVC
+		// does not have it; _aligned_malloc() needs _aligned_free().
+		aSize = (aSize + aAlign-1) / aAlign * aAlign;
+		if( 0 == aSize )
+			aSize = aAlign;
+
+		while( true )
+		{
+#			if defined(_MSC_VER)
+			if( void* ptr = _aligned_malloc( aSize, aAlign ) )
+				return ptr;
+#			else
+			if( void* ptr = std::aligned_alloc( aAlign, aSize ) )
+				return ptr;
+#			endif
+
+			auto const handler = std::get_new_handler();
+			if( !handler )
+				return nullptr;
+
+			handler();
+		}
+	}
+
+	void free_aligned_( void* aPtr ) noexcept
+	{
+#		if defined(_MSC_VER)
+		_aligned_free( aPtr );
+#		else
+		std::free( aPtr );
+#		endif
+	}
+}
+
+std::uint64_t thread_heap_allocations() noexcept
+{
+	return tAllocations_;
+}
+
+std::uint64_t thread_heap_allocated_bytes() noexcept
+{
+	return tBytes_;
+}
+
+// Replacement allocation functions. Throwing versions throw std::bad_alloc
+// when allocate_*() fails (and there is no new handler to free memory).
+void* operator new( std::size_t aSize )
+{
+	if( void* ptr = allocate_( aSize ) )
+		return ptr;
+	throw std::bad_alloc();
+}
+void* operator new[]( std::size_t aSize )
+{
+	if( void* ptr = allocate_( aSize ) )
+		return ptr;
+	throw std::bad_alloc();
+}
+void* operator new( std::size_t aSize, std::nothrow_t const& ) noexcept
+{
+	return allocate_( aSize );
+}
+void* operator new[]( std::size_t aSize, std::nothrow_t const& ) noexcept
+{
+	return allocate_( aSize );
+}
+
+void* operator new( std::size_t aSize, std::align_val_t aAlign )
+{
+	if( void* ptr = allocate_aligned_( aSize, std::size_t(aAlign) ) )
+		return ptr;
+	throw std::bad_alloc();
+}
+void* operator new[]( std::size_t aSize, std::align_val_t aAlign )
+{
+	if( void* ptr = allocate_aligned_( aSize, std::size_t(aAlign) ) )
+		return ptr;
+	throw std::bad_alloc();
+}
+void* operator new( std::size_t aSize, std::align_val_t aAlign, std::nothrow_t const& ) noexcept
+{
+	return allocate_aligned_( aSize, std::size_t(aAlign) );
+}
+void* operator new[]( std::size_t aSize, std::align_val_t aAlign, std::nothrow_t const& ) noexcept
+{
+	return allocate_aligned_( aSize, std::size_t(aAlign) );
+}
+
+void operator delete( void* aPtr ) noexcept
+{
+	std::free( aPtr );
+}
+void operator delete[]( void* aPtr ) noexcept
+{
+	std::free( aPtr );
+}
+void operator delete( void* aPtr, std::size_t ) noexcept
+{
+	std::free( aPtr );
+}
+void operator delete[]( void* aPtr, std::size_t ) noexcept
+{
+	std::free( aPtr );
+}
+void operator delete( void* aPtr, std::nothrow_t const& ) noexcept
+{
+	std::free( aPtr );
+}
+void operator delete[]( void* aPtr, std::nothrow_t const& ) noexcept
+{
+	std::free( aPtr );
+}
+
+void operator delete( void* aPtr, std::align_val_t ) noexcept
+{
+	free_aligned_( aPtr );
+}
+void operator delete[]( void* aPtr, std::align_val_t ) noexcept
+{
+	free_aligned_( aPtr );
+}
+void operator delete( void* aPtr, std::size_t, std::align_val_t ) noexcept
+{
+	free_aligned_( aPtr );
+}
+void operator delete[]( void* aPtr, std::size_t, std::align_val_t ) noexcept
+{
+	free_aligned_( aPtr );
+}
+void operator delete( void* aPtr, std::align_val_t, std::nothrow_t const& ) noexcept
+{
+	free_aligned_( aPtr );
+}
+void operator delete[]( void* aPtr, std::align_val_t, std::nothrow_t const& ) noexcept
+{
+	free_aligned_( aPtr );
+}
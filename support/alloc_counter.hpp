@@ -0,0 +1,30 @@
+#ifndef ALLOC_COUNTER_HPP_2B8F0F60_4FC3_4969_A044_4B5B3D40568E
+#define ALLOC_COUNTER_HPP_2B8F0F60_4FC3_4969_A044_4B5B3D40568E
+
+#include <cstdint>
+
+/* Heap allocation counter
+ *
+ * alloc_counter.cpp replaces the global operator new/delete (all variants,
+ * including the aligned and nothrow ones) with versions that forward to
+ * std::malloc()/std::free() and count allocations per thread. The
+ * replacement is linked into any program that calls one of the functions
+ * below.
+ *
+ * Only operator new is counted; memory obtained with malloc() directly (C
+ * libraries such as GLFW, stb or the GL driver) is not.
+ *
+ * Usage, e.g., to check that a loop does not allocate once warmed up:
+ *
+ *   auto const before = thread_heap_allocations();
+ *   ...
+ *   assert( thread_heap_allocations() == before );
+ */
+
+// Number of allocations by the calling thread so far
+std::uint64_t thread_heap_allocations() noexcept;
+
+// Number of bytes requested by the calling thread so far
+std::uint64_t thread_heap_allocated_bytes() noexcept;
+
+#endif // ALLOC_COUNTER_HPP_2B8F0F60_4FC3_4969_A044_4B5B3D40568E
@@ -0,0 +1,300 @@
+#include "asset_archive.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+#include <cstdio>
+#include <cstring>
+
+#include "error.hpp"
+#include "lz_block.hpp"
+
+#include "../jobs/job_system.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kArchiveMagic_ = 0x50325743; // "CW2P"
+	constexpr std::uint32_t kArchiveVersion_ = 1;
+
+	struct Header_
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint64_t entryCount;
+		std::uint64_t pathBytes;
+	};
+
+	static_assert( sizeof(Header_) == 24 );
+	static_assert( sizeof(AssetArchive::Entry) == 48 );
+	static_assert( alignof(AssetArchive::Entry) <= 8 && 0 == sizeof(Header_) % 8 );
+
+	std::uint64_t align_up_( std::uint64_t aValue, std::uint64_t aAlign ) noexcept
+	{
+		return (aValue + aAlign-1) / aAlign * aAlign;
+	}
+
+	// Input file, with its compressed data (if compression pays off)
+	struct Pending_
+	{
+		std::string path;
+		std::uint64_t hash;
+		FileMapping file;
+		std::vector<std::uint8_t> compressed;
+	};
+
+	bool write_zeros_( std::FILE* aOut, std::size_t aCount )
+	{
+		static constexpr std::uint8_t kZeros[AssetArchive::kDataAlign] = {};
+		return aCount <= sizeof(kZeros) && aCount == std::fwrite( kZeros, 1, aCount, aOut );
+	}
+}
+
+// AssetArchive
+AssetArchive::AssetArchive( char const* aPath )
+	: mFile( aPath, FileMapping::Access::random )
+	, mPath( aPath )
+	, mEntries( nullptr )
+	, mEntryCount( 0 )
+	, mPaths( nullptr )
+	, mPathBytes( 0 )
+{
+	if( mFile.size() < sizeof(Header_) )
+		throw Error( "Asset archive '%s' is truncated", aPath );
+
+	Header_ header;
+	std::memcpy( &header, mFile.data(), sizeof(header) );
+
+	if( kArchiveMagic_ != header.magic || kArchiveVersion_ != header.version )
+		throw Error( "'%s' is not an asset archive (or has the wrong version)", aPath );
+
+	std::uint64_t const indexBytes = header.entryCount * sizeof(Entry);
+	if( header.entryCount > mFile.size() / sizeof(Entry) || header.pathBytes > mFile.size() || sizeof(Header_) + indexBytes + header.pathBytes > mFile.size() )
+		throw Error( "Asset archive '%s': index out of bounds", aPath );
+
+	// The mapping is page aligned, and the index follows the 24-byte header.
+	mEntries = reinterpret_cast<Entry const*>(mFile.data() + sizeof(Header_));
+	mEntryCount = std::size_t(header.entryCount);
+	mPaths = reinterpret_cast<char const*>(mFile.data() + sizeof(Header_) + indexBytes);
+	mPathBytes = std::size_t(header.pathBytes);
+
+	for( std::size_t i = 0; i < mEntryCount; ++i )
+	{
+		auto const& entry = mEntries[i];
+
+		bool const valid = std::uint64_t(entry.pathOffset) + entry.pathLength <= mPathBytes
+			&& entry.offset <= mFile.size() && entry.storedSize <= mFile.size() - entry.offset
+			&& (Compression::lz == entry.compression || (Compression::none == entry.compression && entry.storedSize == entry.size))
+			&& (0 == i || mEntries[i-1].hash <= entry.hash)
+		;
+
+		if( !valid )
+			throw Error( "Asset archive '%s': entry %zu is invalid", aPath, i );
+	}
+}
+
+std::size_t AssetArchive::entry_count() const noexcept
+{
+	return mEntryCount;
+}
+
+AssetArchive::Entry const& AssetArchive::entry( std::size_t aIndex ) const noexcept
+{
+	return mEntries[aIndex];
+}
+
+std::string_view AssetArchive::path( std::size_t aIndex ) const noexcept
+{
+	auto const& entry = mEntries[aIndex];
+	return std::string_view( mPaths + entry.pathOffset, entry.pathLength );
+}
+
+std::optional<std::size_t> AssetArchive::find( std::string_view aPath ) const
+{
+	auto const normalized = normalize_asset_path( aPath );
+	auto const hash = asset_path_hash( normalized );
+
+	auto it = std::lower_bound( mEntries, mEntries + mEntryCount, hash, [] (Entry const& aEntry, std::uint64_t aHash) {
+		return aEntry.hash < aHash;
+	} );
+
+	for( ; mEntries + mEntryCount != it && hash == it->hash; ++it )
+	{
+		auto const index = std::size_t(it - mEntries);
+		if( path( index ) == normalized )
+			return index;
+	}
+
+	return {};
+}
+
+std::uint8_t const* AssetArchive::stored_data( std::size_t aIndex ) const noexcept
+{
+	return mFile.data() + mEntries[aIndex].offset;
+}
+
+void AssetArchive::extract( std::size_t aIndex, std::uint8_t* aOut ) const
+{
+	auto const& entry = mEntries[aIndex];
+
+	if( Compression::none == entry.compression )
+	{
+		std::memcpy( aOut, stored_data( aIndex ), std::size_t(entry.size) );
+		return;
+	}
+
+	if( !lz_decompress( stored_data( aIndex ), std::size_t(entry.storedSize), aOut, std::size_t(entry.size) ) )
+	{
+		auto const name = path( aIndex );
+		throw Error( "Asset archive '%s': entry '%.*s' is corrupt", mPath.c_str(), int(name.size()), name.data() );
+	}
+}
+
+std::size_t AssetArchive::file_size() const noexcept
+{
+	return mFile.size();
+}
+
+// Free functions
+std::string normalize_asset_path( std::string_view aPath )
+{
+	return std::filesystem::path( aPath ).lexically_normal().generic_string();
+}
+
+std::uint64_t asset_path_hash( std::string_view aNormalizedPath ) noexcept
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	for( char const c : aNormalizedPath )
+	{
+		hash ^= std::uint8_t(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+AssetArchiveStats write_asset_archive( char const* aArchivePath, std::vector<std::string> const& aFiles, JobSystem& aJobs )
+{
+	// Map all inputs first, so that missing files are reported before
+	// spending time on compression.
+	std::vector<Pending_> pending;
+	pending.reserve( aFiles.size() );
+	for( auto const& file : aFiles )
+	{
+		auto path = normalize_asset_path( file );
+		auto const hash = asset_path_hash( path );
+		pending.emplace_back( Pending_{ std::move(path), hash, FileMapping( file.c_str() ), {} } );
+
+		if( pending.back().file.size() > 0xffffffffu )
+			throw Error( "write_asset_archive(): '%s' is too large (4 GB max.)", file.c_str() );
+	}
+
+	std::sort( pending.begin(), pending.end(), [] (Pending_ const& aA, Pending_ const& aB) {
+		return aA.hash < aB.hash || (aA.hash == aB.hash && aA.path < aB.path);
+	} );
+
+	for( std::size_t i = 1; i < pending.size(); ++i )
+	{
+		if( pending[i-1].path == pending[i].path )
+			throw Error( "write_asset_archive(): '%s' is listed twice", pending[i].path.c_str() );
+	}
+
+	// Compress in parallel. Keep the result only if it saves enough.
+	aJobs.parallel_for( pending.size(), 1, [&pending] (std::size_t aBegin, std::size_t aEnd) {
+		for( std::size_t i = aBegin; i < aEnd; ++i )
+		{
+			auto& item = pending[i];
+			auto const size = item.file.size();
+			if( 0 == size )
+				continue;
+
+			item.compressed.resize( lz_compress_bound( size ) );
+			auto const bytes = lz_compress( item.file.data(), size, item.compressed.data(), item.compressed.size() );
+
+			if( 0 != bytes && double(bytes) <= (1.0 - AssetArchive::kMinSaving) * double(size) )
+			{
+				item.compressed.resize( bytes );
+				item.compressed.shrink_to_fit();
+			}
+			else
+			{
+				item.compressed = std::vector<std::uint8_t>();
+			}
+		}
+	} );
+
+	// Layout
+	std::vector<AssetArchive::Entry> entries( pending.size() );
+	std::string paths;
+
+	std::uint64_t const pathStart = sizeof(Header_) + entries.size() * sizeof(AssetArchive::Entry);
+	for( std::size_t i = 0; i < pending.size(); ++i )
+	{
+		auto& entry = entries[i];
+		entry.hash = pending[i].hash;
+		entry.pathOffset = std::uint32_t(paths.size());
+		entry.pathLength = std::uint32_t(pending[i].path.size());
+		paths += pending[i].path;
+	}
+
+	AssetArchiveStats stats{};
+	stats.entries = pending.size();
+
+	std::uint64_t offset = align_up_( pathStart + paths.size(), AssetArchive::kDataAlign );
+	for( std::size_t i = 0; i < pending.size(); ++i )
+	{
+		auto const& item = pending[i];
+		auto& entry = entries[i];
+
+		bool const compressed = !item.compressed.empty();
+		entry.offset = offset;
+		entry.size = item.file.size();
+		entry.storedSize = compressed ? item.compressed.size() : item.file.size();
+		entry.compression = compressed ? AssetArchive::Compression::lz : AssetArchive::Compression::none;
+		entry.reserved = 0;
+
+		offset = align_up_( offset + entry.storedSize, AssetArchive::kDataAlign );
+
+		stats.compressed += compressed ? 1 : 0;
+		stats.originalBytes += entry.size;
+		stats.storedBytes += entry.storedSize;
+	}
+	stats.fileBytes = offset;
+
+	// Write
+	std::FILE* out = std::fopen( aArchivePath, "wb" );
+	if( !out )
+		throw Error( "write_asset_archive(): unable to open '%s' for writing", aArchivePath );
+
+	Header_ const header{ kArchiveMagic_, kArchiveVersion_, entries.size(), paths.size() };
+
+	bool ok = 1 == std::fwrite( &header, sizeof(header), 1, out )
+		&& entries.size() == std::fwrite( entries.data(), sizeof(AssetArchive::Entry), entries.size(), out )
+		&& paths.size() == std::fwrite( paths.data(), 1, paths.size(), out )
+	;
+
+	std::uint64_t written = pathStart + paths.size();
+	for( std::size_t i = 0; i < pending.size() && ok; ++i )
+	{
+		auto const& item = pending[i];
+		auto const& entry = entries[i];
+
+		ok = write_zeros_( out, std::size_t(entry.offset - written) );
+
+		std::uint8_t const* data = item.compressed.empty() ? item.file.data() : item.compressed.data();
+		ok = ok && entry.storedSize == std::fwrite( data, 1, std::size_t(entry.storedSize), out );
+
+		written = entry.offset + entry.storedSize;
+	}
+
+	ok = ok && write_zeros_( out, std::size_t(stats.fileBytes - written) );
+
+	if( 0 != std::fclose( out ) )
+		ok = false;
+
+	if( !ok )
+	{
+		std::remove( aArchivePath );
+		throw Error( "write_asset_archive(): error while writing '%s'", aArchivePath );
+	}
+
+	return stats;
+}
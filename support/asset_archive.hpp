@@ -0,0 +1,117 @@
+#ifndef ASSET_ARCHIVE_HPP_E4EBA3E4_1490_47A9_A201_D2912F9D4EAC
+#define ASSET_ARCHIVE_HPP_E4EBA3E4_1490_47A9_A201_D2912F9D4EAC
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <string_view>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "file_mapping.hpp"
+
+class JobSystem;
+
+/* Packed asset archive
+ *
+ * A single file holding many assets, accessed through a FileMapping:
+ *
+ *   header | index (sorted by path hash) | paths | data
+ *
+ * Each index entry gives the entry's path hash (FNV-1a, 64 bit, of the
+ * normalized path, see asset_path_hash()), the offset and size of its data,
+ * its original size and its compression. Entries are compressed with
+ * lz_block.hpp where that saves at least kMinSaving of the size, and stored
+ * as-is otherwise (e.g., JPEGs); stored entries are read straight from the
+ * mapping. Data is aligned to kDataAlign bytes.
+ *
+ * Paths are stored as given to write_asset_archive(), normalized with
+ * normalize_asset_path(); lookups normalize the same way and compare the
+ * full path after matching the hash.
+ *
+ * All integers are little-endian (the archive is not portable to big-endian
+ * machines).
+ */
+class AssetArchive final
+{
+	public:
+		enum class Compression : std::uint32_t
+		{
+			none = 0,
+			lz = 1
+		};
+
+		struct Entry
+		{
+			std::uint64_t hash;
+			std::uint64_t offset;     // of the data, from the start of the file
+			std::uint64_t storedSize; // in the archive
+			std::uint64_t size;       // original
+			std::uint32_t pathOffset; // into the path table
+			std::uint32_t pathLength;
+			Compression compression;
+			std::uint32_t reserved;
+		};
+
+		static constexpr std::size_t kDataAlign = 16;
+		static constexpr double kMinSaving = 0.1;
+
+	public:
+		// Throws Error if the file cannot be mapped or is not a valid
+		// archive (the index and paths are checked, the data is not).
+		explicit AssetArchive( char const* aPath );
+
+		AssetArchive( AssetArchive const& ) = delete;
+		AssetArchive& operator= (AssetArchive const&) = delete;
+
+	public:
+		std::size_t entry_count() const noexcept;
+		Entry const& entry( std::size_t ) const noexcept;
+		std::string_view path( std::size_t ) const noexcept;
+
+		// Index of the entry for aPath (normalized first)
+		std::optional<std::size_t> find( std::string_view aPath ) const;
+
+		// Stored bytes of an entry, in the mapping. For Compression::none,
+		// this is the content.
+		std::uint8_t const* stored_data( std::size_t ) const noexcept;
+
+		// Decompress (or copy) an entry into aOut, which must hold
+		// entry().size bytes. Thread safe. Throws Error for corrupt data.
+		void extract( std::size_t, std::uint8_t* aOut ) const;
+
+		std::size_t file_size() const noexcept;
+
+	private:
+		FileMapping mFile;
+		std::string mPath;
+
+		Entry const* mEntries;
+		std::size_t mEntryCount;
+
+		char const* mPaths;
+		std::size_t mPathBytes;
+};
+
+// Lexically normalized, with forward slashes ("./a\\b/../c" -> "a/c")
+std::string normalize_asset_path( std::string_view );
+
+// FNV-1a (64 bit) of the normalized path
+std::uint64_t asset_path_hash( std::string_view aNormalizedPath ) noexcept;
+
+struct AssetArchiveStats
+{
+	std::size_t entries;
+	std::size_t compressed; // entries stored with Compression::lz
+	std::uint64_t originalBytes;
+	std::uint64_t storedBytes;
+	std::uint64_t fileBytes;
+};
+
+// Pack the files aFiles (paths relative to the working directory; stored
+// normalized) into aArchivePath. Entries are compressed in parallel on
+// aJobs. Throws Error on I/O errors or duplicate paths.
+AssetArchiveStats write_asset_archive( char const* aArchivePath, std::vector<std::string> const& aFiles, JobSystem& aJobs );
+
+#endif // ASSET_ARCHIVE_HPP_E4EBA3E4_1490_47A9_A201_D2912F9D4EAC
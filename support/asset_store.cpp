@@ -0,0 +1,179 @@
+#include "asset_store.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "error.hpp"
+#include "asset_archive.hpp"
+
+#include "../jobs/job_system.hpp"
+
+namespace
+{
+	constexpr std::uint64_t kNotUnpacked_ = ~std::uint64_t(0);
+
+	struct Mounted_
+	{
+		std::unique_ptr<AssetArchive> archive;
+
+		// Decompressed entries, each at unpackedOffset[entry] (kNotUnpacked_
+		// for entries that are stored as-is)
+		std::unique_ptr<std::uint8_t[]> unpacked;
+		std::vector<std::uint64_t> unpackedOffset;
+	};
+
+	std::unique_ptr<Mounted_> gMounted_;
+}
+
+// AssetData
+AssetData::AssetData() noexcept
+	: mData( nullptr )
+	, mSize( 0 )
+{}
+
+AssetData::AssetData( FileMapping aFile ) noexcept
+	: mFile( std::move(aFile) )
+	, mData( mFile.data() )
+	, mSize( mFile.size() )
+{}
+
+AssetData::AssetData( std::uint8_t const* aData, std::size_t aSize ) noexcept
+	: mData( aData )
+	, mSize( aSize )
+{}
+
+AssetData::AssetData( AssetData&& aOther ) noexcept
+	: mFile( std::move(aOther.mFile) )
+	, mData( std::exchange( aOther.mData, nullptr ) )
+	, mSize( std::exchange( aOther.mSize, 0 ) )
+{}
+AssetData& AssetData::operator= (AssetData&& aOther) noexcept
+{
+	std::swap( mFile, aOther.mFile );
+	std::swap( mData, aOther.mData );
+	std::swap( mSize, aOther.mSize );
+	return *this;
+}
+
+std::uint8_t const* AssetData::data() const noexcept
+{
+	return mData;
+}
+
+std::size_t AssetData::size() const noexcept
+{
+	return mSize;
+}
+
+bool AssetData::empty() const noexcept
+{
+	return 0 == mSize;
+}
+
+std::string_view AssetData::text() const noexcept
+{
+	return std::string_view( reinterpret_cast<char const*>(mData), mSize );
+}
+
+// Free functions
+AssetMountStats mount_asset_archive( char const* aPath, JobSystem& aJobs )
+{
+	auto const start = std::chrono::steady_clock::now();
+
+	auto mounted = std::make_unique<Mounted_>();
+	mounted->archive = std::make_unique<AssetArchive>( aPath );
+
+	auto const& archive = *mounted->archive;
+	auto const count = archive.entry_count();
+
+	AssetMountStats stats{};
+	stats.entries = count;
+	stats.archiveBytes = archive.file_size();
+	stats.threads = aJobs.thread_count();
+
+	// One buffer for all compressed entries; 16-byte aligned each
+	std::vector<std::size_t> compressed;
+	mounted->unpackedOffset.assign( count, kNotUnpacked_ );
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		auto const& entry = archive.entry( i );
+		if( AssetArchive::Compression::none == entry.compression )
+			continue;
+
+		mounted->unpackedOffset[i] = stats.unpackedBytes;
+		stats.unpackedBytes += (entry.size + 15) / 16 * 16;
+		compressed.emplace_back( i );
+	}
+
+	stats.unpacked = compressed.size();
+	mounted->unpacked.reset( new std::uint8_t[std::size_t(stats.unpackedBytes)] );
+
+	// Errors are collected, since jobs must not throw.
+	std::atomic<std::size_t> failed{ count };
+
+	auto const& offsets = mounted->unpackedOffset;
+	std::uint8_t* const buffer = mounted->unpacked.get();
+	aJobs.parallel_for( compressed.size(), 1, [&] (std::size_t aBegin, std::size_t aEnd) {
+		for( std::size_t i = aBegin; i < aEnd; ++i )
+		{
+			auto const entry = compressed[i];
+			try
+			{
+				archive.extract( entry, buffer + offsets[entry] );
+			}
+			catch( ... )
+			{
+				failed.store( entry );
+			}
+		}
+	} );
+
+	if( auto const entry = failed.load(); count != entry )
+	{
+		auto const name = archive.path( entry );
+		throw Error( "mount_asset_archive(): entry '%.*s' of '%s' is corrupt", int(name.size()), name.data(), aPath );
+	}
+
+	gMounted_ = std::move(mounted);
+
+	stats.unpackMs = std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - start ).count();
+	return stats;
+}
+
+void unmount_asset_archive() noexcept
+{
+	gMounted_.reset();
+}
+
+bool asset_archive_mounted() noexcept
+{
+	return !!gMounted_;
+}
+
+bool asset_in_archive( std::string_view aPath )
+{
+	return gMounted_ && gMounted_->archive->find( aPath );
+}
+
+AssetData open_asset( char const* aPath, FileMapping::Access aAccess )
+{
+	if( gMounted_ )
+	{
+		if( auto const index = gMounted_->archive->find( aPath ) )
+		{
+			auto const& archive = *gMounted_->archive;
+			auto const size = std::size_t(archive.entry( *index ).size);
+
+			if( auto const offset = gMounted_->unpackedOffset[*index]; kNotUnpacked_ != offset )
+				return AssetData( gMounted_->unpacked.get() + offset, size );
+
+			return AssetData( archive.stored_data( *index ), size );
+		}
+	}
+
+	return AssetData( FileMapping( aPath, aAccess ) );
+}
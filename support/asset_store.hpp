@@ -0,0 +1,78 @@
+#ifndef ASSET_STORE_HPP_239003E0_8A96_4176_BCFB_F9D3E7FE24C4
+#define ASSET_STORE_HPP_239003E0_8A96_4176_BCFB_F9D3E7FE24C4
+
+#include <string_view>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "file_mapping.hpp"
+
+class JobSystem;
+
+/* Asset lookup: packed archive first, loose files second
+ *
+ * mount_asset_archive() maps a packed archive (see asset_archive.hpp) and
+ * decompresses all compressed entries up front, in parallel on a JobSystem,
+ * into one buffer. open_asset() then returns entries without further copies:
+ * decompressed ones from that buffer, stored ones straight from the archive
+ * mapping.
+ *
+ * Paths that are not in the mounted archive (or all paths, if no archive is
+ * mounted) are read from loose files with FileMapping. Development thus
+ * works without an archive; note that with an archive mounted, its entries
+ * take precedence over edited loose files (e.g., on shader reload).
+ *
+ * Mounting and unmounting are not thread safe. open_asset() may be called
+ * from any thread while the mount does not change. Data from the archive
+ * stays valid until unmount_asset_archive().
+ */
+class AssetData final
+{
+	public:
+		AssetData() noexcept;
+		explicit AssetData( FileMapping ) noexcept;
+		AssetData( std::uint8_t const* aData, std::size_t aSize ) noexcept; // not owned
+
+		AssetData( AssetData const& ) = delete;
+		AssetData& operator= (AssetData const&) = delete;
+
+		AssetData( AssetData&& ) noexcept;
+		AssetData& operator= (AssetData&&) noexcept;
+
+	public:
+		std::uint8_t const* data() const noexcept;
+		std::size_t size() const noexcept;
+		bool empty() const noexcept;
+
+		std::string_view text() const noexcept;
+
+	private:
+		FileMapping mFile; // loose files only
+		std::uint8_t const* mData;
+		std::size_t mSize;
+};
+
+struct AssetMountStats
+{
+	std::size_t entries;
+	std::size_t unpacked;        // compressed entries
+	std::uint64_t unpackedBytes; // their size after decompression
+	std::uint64_t archiveBytes;
+	std::size_t threads;         // JobSystem::thread_count()
+	float unpackMs;
+};
+
+// Replaces any mounted archive. Throws Error if the archive is invalid or an
+// entry fails to decompress; nothing is mounted then.
+AssetMountStats mount_asset_archive( char const* aPath, JobSystem& aJobs );
+void unmount_asset_archive() noexcept;
+
+bool asset_archive_mounted() noexcept;
+bool asset_in_archive( std::string_view aPath );
+
+// Throws Error if aPath is neither in the archive nor a readable file. The
+// access hint applies to loose files only.
+AssetData open_asset( char const* aPath, FileMapping::Access = FileMapping::Access::sequential );
+
+#endif // ASSET_STORE_HPP_239003E0_8A96_4176_BCFB_F9D3E7FE24C4
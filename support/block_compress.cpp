@@ -0,0 +1,181 @@
+#include "block_compress.hpp"
+
+#include <cmath>
+#include <limits>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	std::uint16_t pack_565_( float aR, float aG, float aB ) noexcept
+	{
+		auto const r = unsigned(std::clamp( aR, 0.f, 255.f ) * 31.f / 255.f + 0.5f);
+		auto const g = unsigned(std::clamp( aG, 0.f, 255.f ) * 63.f / 255.f + 0.5f);
+		auto const b = unsigned(std::clamp( aB, 0.f, 255.f ) * 31.f / 255.f + 0.5f);
+		return std::uint16_t( (r << 11) | (g << 5) | b );
+	}
+
+	void unpack_565_( std::uint16_t aC, int aOut[3] ) noexcept
+	{
+		int const r = (aC >> 11) & 31;
+		int const g = (aC >> 5) & 63;
+		int const b = aC & 31;
+		aOut[0] = (r << 3) | (r >> 2);
+		aOut[1] = (g << 2) | (g >> 4);
+		aOut[2] = (b << 3) | (b >> 2);
+	}
+
+	// Writes the 8-byte colour part of a BC1/BC3 block. Always produces the
+	// four-colour mode (c0 > c1), which is also the only mode BC3 supports.
+	void encode_color_( std::uint8_t const* aRGBA, std::uint8_t* aOut ) noexcept
+	{
+		// Mean and covariance of the block's colours
+		float mean[3] = { 0.f, 0.f, 0.f };
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			for( std::size_t c = 0; c < 3; ++c )
+				mean[c] += aRGBA[i*4+c];
+		}
+		for( auto& m : mean )
+			m /= 16.f;
+
+		float cov[6] = {}; // rr, rg, rb, gg, gb, bb
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			float const r = aRGBA[i*4+0] - mean[0];
+			float const g = aRGBA[i*4+1] - mean[1];
+			float const b = aRGBA[i*4+2] - mean[2];
+			cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+			cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+		}
+
+		// Principal axis by power iteration
+		float axis[3] = { 1.f, 1.f, 1.f };
+		for( int iter = 0; iter < 8; ++iter )
+		{
+			float const x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+			float const y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+			float const z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+			float const m = std::max( { std::abs(x), std::abs(y), std::abs(z) } );
+			if( m <= 0.f )
+				break;
+			axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+		}
+
+		// Endpoints are the extreme projections onto the axis
+		float minProj = std::numeric_limits<float>::max();
+		float maxProj = -std::numeric_limits<float>::max();
+		std::size_t minIdx = 0, maxIdx = 0;
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			float const p = aRGBA[i*4+0]*axis[0] + aRGBA[i*4+1]*axis[1] + aRGBA[i*4+2]*axis[2];
+			if( p < minProj ) { minProj = p; minIdx = i; }
+			if( p > maxProj ) { maxProj = p; maxIdx = i; }
+		}
+
+		std::uint16_t c0 = pack_565_( aRGBA[maxIdx*4+0], aRGBA[maxIdx*4+1], aRGBA[maxIdx*4+2] );
+		std::uint16_t c1 = pack_565_( aRGBA[minIdx*4+0], aRGBA[minIdx*4+1], aRGBA[minIdx*4+2] );
+		if( c0 < c1 )
+			std::swap( c0, c1 );
+
+		std::uint32_t indices = 0;
+		if( c0 != c1 )
+		{
+			int palette[4][3];
+			unpack_565_( c0, palette[0] );
+			unpack_565_( c1, palette[1] );
+			for( std::size_t c = 0; c < 3; ++c )
+			{
+				palette[2][c] = (2*palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2*palette[1][c]) / 3;
+			}
+
+			for( std::size_t i = 0; i < 16; ++i )
+			{
+				int best = std::numeric_limits<int>::max();
+				std::uint32_t bestIdx = 0;
+				for( std::uint32_t j = 0; j < 4; ++j )
+				{
+					int const dr = aRGBA[i*4+0] - palette[j][0];
+					int const dg = aRGBA[i*4+1] - palette[j][1];
+					int const db = aRGBA[i*4+2] - palette[j][2];
+					int const d = dr*dr + dg*dg + db*db;
+					if( d < best ) { best = d; bestIdx = j; }
+				}
+				indices |= bestIdx << (2*i);
+			}
+		}
+
+		aOut[0] = std::uint8_t(c0 & 0xff);
+		aOut[1] = std::uint8_t(c0 >> 8);
+		aOut[2] = std::uint8_t(c1 & 0xff);
+		aOut[3] = std::uint8_t(c1 >> 8);
+		for( std::size_t i = 0; i < 4; ++i )
+			aOut[4+i] = std::uint8_t(indices >> (8*i));
+	}
+
+	// Writes the 8-byte alpha part of a BC3 block (eight-value mode).
+	void encode_alpha_( std::uint8_t const* aRGBA, std::uint8_t* aOut ) noexcept
+	{
+		int a0 = 0, a1 = 255;
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			a0 = std::max<int>( a0, aRGBA[i*4+3] );
+			a1 = std::min<int>( a1, aRGBA[i*4+3] );
+		}
+
+		std::uint64_t indices = 0;
+		if( a0 != a1 )
+		{
+			int palette[8];
+			palette[0] = a0;
+			palette[1] = a1;
+			for( int j = 1; j < 7; ++j )
+				palette[1+j] = ((7-j)*a0 + j*a1) / 7;
+
+			for( std::size_t i = 0; i < 16; ++i )
+			{
+				int best = std::numeric_limits<int>::max();
+				std::uint64_t bestIdx = 0;
+				for( std::uint64_t j = 0; j < 8; ++j )
+				{
+					int const d = std::abs( aRGBA[i*4+3] - palette[j] );
+					if( d < best ) { best = d; bestIdx = j; }
+				}
+				indices |= bestIdx << (3*i);
+			}
+		}
+
+		aOut[0] = std::uint8_t(a0);
+		aOut[1] = std::uint8_t(a1);
+		for( std::size_t i = 0; i < 6; ++i )
+			aOut[2+i] = std::uint8_t(indices >> (8*i));
+	}
+}
+
+void encode_bc1_block( std::uint8_t const* aRGBA, std::uint8_t* aOut ) noexcept
+{
+	encode_color_( aRGBA, aOut );
+}
+
+void encode_bc3_block( std::uint8_t const* aRGBA, std::uint8_t* aOut ) noexcept
+{
+	encode_alpha_( aRGBA, aOut );
+	encode_color_( aRGBA, aOut+8 );
+}
+
+void gather_rgba8_block( std::uint8_t const* aImage, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aBlockX, std::uint32_t aBlockY, std::uint8_t* aRGBA ) noexcept
+{
+	assert( aWidth > 0 && aHeight > 0 );
+
+	for( std::uint32_t y = 0; y < 4; ++y )
+	{
+		auto const sy = std::min( aBlockY*4+y, aHeight-1 );
+		for( std::uint32_t x = 0; x < 4; ++x )
+		{
+			auto const sx = std::min( aBlockX*4+x, aWidth-1 );
+			std::memcpy( aRGBA + (y*4+x)*4, aImage + (std::size_t(sy)*aWidth+sx)*4, 4 );
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef BLOCK_COMPRESS_HPP_13D8FC7F_F81D_49B1_B3F7_9A7313D41773
+#define BLOCK_COMPRESS_HPP_13D8FC7F_F81D_49B1_B3F7_9A7313D41773
+
+#include <cstdint>
+#include <cstddef>
+
+/* CPU block compression encoders (S3TC/DXT)
+ *
+ * Inputs are always a single 4×4 block of RGBA8 texels, stored row by row
+ * (16 texels, 64 bytes). The encoders fit the block endpoints along the
+ * principal axis of the block's colours ("range fit"). This is not as good as
+ * an exhaustive cluster fit, but it is fast enough to run on first launch.
+ *
+ * Colour values are compressed as-is. For sRGB textures, the GPU interpolates
+ * the palette in sRGB space as well, so no conversion is needed here.
+ */
+
+constexpr std::size_t kBC1BlockBytes = 8;
+constexpr std::size_t kBC3BlockBytes = 16;
+
+// BC1 (DXT1): 4 bits per texel. Opaque colour only; alpha is ignored.
+void encode_bc1_block( std::uint8_t const* aRGBA, std::uint8_t* aOut ) noexcept;
+
+// BC3 (DXT5): 8 bits per texel. BC1-style colour plus interpolated alpha.
+void encode_bc3_block( std::uint8_t const* aRGBA, std::uint8_t* aOut ) noexcept;
+
+// Copy block (aBlockX, aBlockY) of an aWidth×aHeight RGBA8 image into aRGBA
+// (64 bytes). Texels past the right and bottom edges repeat the last column
+// and row, so sizes that are not a multiple of four (including levels
+// smaller than a block) need no special casing.
+void gather_rgba8_block( std::uint8_t const* aImage, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aBlockX, std::uint32_t aBlockY, std::uint8_t* aRGBA ) noexcept;
+
+#endif // BLOCK_COMPRESS_HPP_13D8FC7F_F81D_49B1_B3F7_9A7313D41773
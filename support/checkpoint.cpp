@@ -27,6 +27,8 @@ namespace
 
 namespace detail
 {
+	bool gCheckpointsEnabled = true;
+
 	void check_gl_error( char const* aSourceFile, int aSourceLine )
 	{
 		auto const res = glGetError();
@@ -6,15 +6,25 @@
 	} while(0)                                                      \
 	/*ENDM*/
 
+// Only checks if the GL validation level is "sync" (see debug_output.hpp);
+// glGetError() may force the driver to synchronize.
 #if defined(NDEBUG)
 #	define OGL_CHECKPOINT_DEBUG()   do {} while(0)
 #else
-#	define OGL_CHECKPOINT_DEBUG()   OGL_CHECKPOINT_ALWAYS()
+#	define OGL_CHECKPOINT_DEBUG() do {                                 \
+		if( ::detail::gCheckpointsEnabled )                         \
+			::detail::check_gl_error( __FILE__, __LINE__ );         \
+	} while(0)                                                      \
+	/*ENDM*/
 #endif
 
 namespace detail
 {
 	void check_gl_error( char const*, int );
+
+	// Set by setup_gl_debug_output(). Only read by the thread that owns the
+	// GL context.
+	extern bool gCheckpointsEnabled;
 }
 
 #endif // CHECKPOINT_HPP_3DFDA796_469C_4D37_B904_1C8D8FAE207B
@@ -1,7 +1,15 @@
 #include "debug_output.hpp"
 
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
 #include <cstdio>
 #include <cassert>
+#include <cstdint>
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
@@ -11,36 +19,175 @@
 
 namespace
 {
-	// Debug callback
-#	if !defined(NDEBUG)
+	using Clock_ = std::chrono::steady_clock;
+
+	// Longest message text kept for the performance report.
+	constexpr std::size_t kMaxReportText_ = 160;
+
+	struct PerfGroup_
+	{
+		std::uint64_t key;
+		std::size_t count;
+		std::string text;
+	};
+
+	// Shared between the callback (any thread with async output) and
+	// gl_debug_end_frame().
+	struct DebugState_
+	{
+		std::mutex mutex;
+
+		// Number of times each (source, type, id) has been seen
+		std::unordered_map<std::uint64_t, std::size_t> seen;
+
+		// Rate limit for printed messages
+		Clock_::time_point windowStart = Clock_::now();
+		std::size_t printedInWindow = 0;
+
+		// Current frame
+		GlDebugFrameStats frame{};
+		std::vector<PerfGroup_> perf;
+
+		Clock_::time_point lastPerfSummary{};
+	};
+
+	DebugState_& state_()
+	{
+		static DebugState_ state;
+		return state;
+	}
+
+	std::atomic<GlValidation> gValidation_{ GlValidation::off };
+
+#	if !defined(__APPLE__)
 	void GLAPIENTRY callback_gldebug_( GLenum, GLenum, GLuint, GLenum, GLsizei, GLchar const*, void const* );
-#	endif // ~ !NDEBUG
+#	endif // ~ __APPLE__
+
+	bool may_print_( DebugState_&, Clock_::time_point ) noexcept;
+}
+
+GlValidation default_gl_validation() noexcept
+{
+#	if defined(NDEBUG)
+	return GlValidation::off;
+#	else
+	return GlValidation::sync;
+#	endif
 }
 
-void setup_gl_debug_output()
+void setup_gl_debug_output( GlValidation aLevel )
 {
-#	if !defined(NDEBUG)
 	OGL_CHECKPOINT_ALWAYS();
 
+	gValidation_.store( aLevel, std::memory_order_relaxed );
+	detail::gCheckpointsEnabled = (GlValidation::sync == aLevel);
+
 	// glDebugMessageCallback() was standardized in 4.3, so it's not available
 	// Apple. The extension (ARB_debug_output), which predates standardization
 	// doesn't seem to exist on Apple either.
 #	if !defined(__APPLE__)
-	glDebugMessageCallback( &callback_gldebug_, nullptr );
-	glEnable( GL_DEBUG_OUTPUT );
+	if( GlValidation::off == aLevel )
+	{
+		glDisable( GL_DEBUG_OUTPUT );
+		glDebugMessageCallback( nullptr, nullptr );
+	}
+	else
+	{
+		glDebugMessageCallback( &callback_gldebug_, nullptr );
+		glEnable( GL_DEBUG_OUTPUT );
+
+		// Low severity messages are disabled by default, but many drivers
+		// report performance issues with low severity.
+		glDebugMessageControl( GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DEBUG_SEVERITY_LOW, 0, nullptr, GL_TRUE );
 
-	// Make sure the callback is called synchronously and from the same thread.
-	// This makes the debugger more useful.
-	glEnable( GL_DEBUG_OUTPUT_SYNCHRONOUS );
+		// In sync mode, make sure the callback is called synchronously and
+		// from the same thread. This makes the debugger more useful, but
+		// costs performance.
+		if( GlValidation::sync == aLevel )
+			glEnable( GL_DEBUG_OUTPUT_SYNCHRONOUS );
+		else
+			glDisable( GL_DEBUG_OUTPUT_SYNCHRONOUS );
+	}
 #	endif // ~ __APPLE__
 
 	OGL_CHECKPOINT_ALWAYS();
-#	endif // ~ !NDEBUG
+}
+
+GlValidation gl_validation() noexcept
+{
+	return gValidation_.load( std::memory_order_relaxed );
+}
+
+char const* gl_validation_name( GlValidation aLevel ) noexcept
+{
+	switch( aLevel )
+	{
+		case GlValidation::off: return "off";
+		case GlValidation::async: return "async";
+		case GlValidation::sync: return "sync";
+	}
+
+	return "<unknown>";
+}
+
+GlDebugFrameStats gl_debug_end_frame( std::FILE* aOut )
+{
+	auto& state = state_();
+	std::lock_guard<std::mutex> lock( state.mutex );
+
+	GlDebugFrameStats const ret = state.frame;
+	state.frame = GlDebugFrameStats{};
+
+	if( !state.perf.empty() && aOut )
+	{
+		auto const now = Clock_::now();
+
+		// New messages are printed in full. The key was counted in `seen`
+		// when the message arrived, so a count equal to the frame's count
+		// means that it was first seen during this frame.
+		bool any = false;
+		for( auto const& group : state.perf )
+		{
+			if( state.seen[group.key] == group.count )
+			{
+				std::fprintf( aOut, "OpenGL Debug: Performance: %zux %s\n", group.count, group.text.c_str() );
+				any = true;
+			}
+		}
+
+		if( !any && now - state.lastPerfSummary >= std::chrono::seconds(1) )
+		{
+			std::fprintf( aOut, "OpenGL Debug: Performance: %zu warning(s) this frame (%zu distinct, all seen before)\n", ret.performance, state.perf.size() );
+			any = true;
+		}
+
+		if( any )
+			state.lastPerfSummary = now;
+
+		state.perf.clear();
+	}
+
+	return ret;
 }
 
 namespace
 {
-#	if !defined(NDEBUG)
+	bool may_print_( DebugState_& aState, Clock_::time_point aNow ) noexcept
+	{
+		if( aNow - aState.windowStart >= std::chrono::seconds(1) )
+		{
+			aState.windowStart = aNow;
+			aState.printedInWindow = 0;
+		}
+
+		if( aState.printedInWindow >= kMaxPrintedPerSecond )
+			return false;
+
+		++aState.printedInWindow;
+		return true;
+	}
+
+#	if !defined(__APPLE__)
 	char const* type_str_( GLenum aType ) noexcept
 	{
 		switch( aType )
@@ -71,7 +218,7 @@ namespace
 		return "<unknown severity>";
 	}
 
-	void GLAPIENTRY callback_gldebug_( GLenum, GLenum aType, GLuint, GLenum aSeverity, GLsizei, GLchar const* aMessage, void const* /*aUser*/ )
+	void GLAPIENTRY callback_gldebug_( GLenum aSource, GLenum aType, GLuint aId, GLenum aSeverity, GLsizei, GLchar const* aMessage, void const* /*aUser*/ )
 	{
 		// "Other" can be a bit spammy at times. However, it can include fairly
 		// interesting information on e.g. NVIDIA (such as in what memory VBOs
@@ -80,12 +227,47 @@ namespace
 		if( GL_DEBUG_TYPE_OTHER == aType )
 			return;
 
+		// Source and type enums are all below 0x10000.
+		std::uint64_t const key = (std::uint64_t(aSource & 0xffff) << 48) | (std::uint64_t(aType & 0xffff) << 32) | aId;
+
+		auto& state = state_();
+		std::unique_lock<std::mutex> lock( state.mutex );
+
+		++state.frame.messages;
+		std::size_t const count = ++state.seen[key];
+
+		if( GL_DEBUG_TYPE_PERFORMANCE == aType )
+		{
+			++state.frame.performance;
+
+			for( auto& group : state.perf )
+			{
+				if( key == group.key )
+				{
+					++group.count;
+					return;
+				}
+			}
+
+			state.perf.emplace_back( PerfGroup_{ key, 1, std::string( aMessage ).substr( 0, kMaxReportText_ ) } );
+			return;
+		}
+
+		if( count > 1 || !may_print_( state, Clock_::now() ) )
+		{
+			++state.frame.suppressed;
+			return;
+		}
+
+		lock.unlock();
+
 		std::fprintf( stderr, "OpenGL Debug: %s [%s]: %s\n", severity_str_(aSeverity), type_str_(aType), aMessage );
 
-		// For high severity errors, break into the debugger now.
-		if( GL_DEBUG_SEVERITY_HIGH == aSeverity )
+		// For high severity errors, break into the debugger now. This is only
+		// useful with synchronous output (the call stack includes the GL call
+		// that caused the error).
+		if( GL_DEBUG_SEVERITY_HIGH == aSeverity && GlValidation::sync == gl_validation() )
 			assert( false );
 	}
-#	endif // ~ !NDEBUG
+#	endif // ~ __APPLE__
 }
-
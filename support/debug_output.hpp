@@ -1,6 +1,62 @@
 #ifndef DEBUG_OUTPUT_HPP_91C7C3DF_B7F1_4025_B682_2456DFD7C05D
 #define DEBUG_OUTPUT_HPP_91C7C3DF_B7F1_4025_B682_2456DFD7C05D
 
-void setup_gl_debug_output();
+#include <cstdio>
+#include <cstddef>
+
+/* GL validation level
+ *
+ *  - off:   no debug output, OGL_CHECKPOINT_DEBUG() does nothing.
+ *  - async: debug messages are delivered asynchronously (the driver may call
+ *           the callback from its own threads, at some later point). No
+ *           checkpoints. Cheap enough to leave on while measuring.
+ *  - sync:  GL_DEBUG_OUTPUT_SYNCHRONOUS, i.e., the callback is called from
+ *           within the offending GL call, plus glGetError() at each
+ *           OGL_CHECKPOINT_DEBUG(). Both can stall the pipeline.
+ *
+ * OGL_CHECKPOINT_DEBUG() compiles to nothing in release builds, regardless of
+ * the level. OGL_CHECKPOINT_ALWAYS() is not affected by the level.
+ */
+enum class GlValidation
+{
+	off,
+	async,
+	sync
+};
+
+// Default: sync in debug builds, off in release builds.
+GlValidation default_gl_validation() noexcept;
+
+// Requires a current GL context. Messages are only guaranteed to be
+// generated by a debug context (GLFW_OPENGL_DEBUG_CONTEXT).
+void setup_gl_debug_output( GlValidation = default_gl_validation() );
+
+GlValidation gl_validation() noexcept;
+
+char const* gl_validation_name( GlValidation ) noexcept;
+
+/* Debug messages per frame
+ *
+ * Each distinct message (source, type, id) is printed the first time it
+ * occurs; repeats are only counted. At most kMaxPrintedPerSecond messages
+ * are printed per second; the rest are counted as suppressed.
+ *
+ * GL_DEBUG_TYPE_PERFORMANCE messages are not printed by the callback.
+ * Instead, gl_debug_end_frame() reports them per frame, grouped by message.
+ * Messages that have not been seen before are printed in full; otherwise a
+ * one-line summary is printed at most once per second.
+ */
+struct GlDebugFrameStats
+{
+	std::size_t messages;    // all messages received during the frame
+	std::size_t suppressed;  // not printed (repeats or rate limit), excluding performance
+	std::size_t performance; // GL_DEBUG_TYPE_PERFORMANCE messages
+};
+
+constexpr std::size_t kMaxPrintedPerSecond = 20;
+
+// Close the current frame: return its statistics and report its performance
+// warnings (if any) to aOut. Thread safe.
+GlDebugFrameStats gl_debug_end_frame( std::FILE* aOut = stderr );
 
 #endif // DEBUG_OUTPUT_HPP_91C7C3DF_B7F1_4025_B682_2456DFD7C05D
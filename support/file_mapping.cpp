@@ -0,0 +1,175 @@
+#include "file_mapping.hpp"
+
+#include <utility>
+#include <algorithm>
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN 1
+#	define NOMINMAX 1
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include "error.hpp"
+
+FileMapping::FileMapping() noexcept
+	: mData( nullptr )
+	, mSize( 0 )
+#	if defined(_WIN32)
+	, mFile( INVALID_HANDLE_VALUE )
+	, mMapping( nullptr )
+#	endif
+{}
+
+// Delegates to the default constructor, so the destructor cleans up if any
+// of the steps below throws.
+FileMapping::FileMapping( char const* aPath, Access aAccess )
+	: FileMapping()
+{
+#	if defined(_WIN32)
+	DWORD const flags = Access::random == aAccess ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+
+	mFile = CreateFileA( aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr );
+	if( INVALID_HANDLE_VALUE == mFile )
+		throw Error( "FileMapping: unable to open '%s'", aPath );
+
+	LARGE_INTEGER size;
+	if( !GetFileSizeEx( mFile, &size ) )
+		throw Error( "FileMapping: unable to query size of '%s'", aPath );
+
+	mSize = std::size_t(size.QuadPart);
+	if( 0 == mSize )
+	{
+		CloseHandle( mFile );
+		mFile = INVALID_HANDLE_VALUE;
+		return;
+	}
+
+	mMapping = CreateFileMappingA( mFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( !mMapping )
+		throw Error( "FileMapping: unable to map '%s'", aPath );
+
+	mData = static_cast<std::uint8_t const*>(MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 ));
+	if( !mData )
+		throw Error( "FileMapping: unable to map view of '%s'", aPath );
+
+	if( Access::willNeed == aAccess )
+		prefetch( 0, mSize );
+#	else
+	int const fd = open( aPath, O_RDONLY );
+	if( -1 == fd )
+		throw Error( "FileMapping: unable to open '%s'", aPath );
+
+	struct stat st;
+	if( -1 == fstat( fd, &st ) )
+	{
+		close( fd );
+		throw Error( "FileMapping: unable to stat '%s'", aPath );
+	}
+
+	mSize = std::size_t(st.st_size);
+	if( 0 == mSize )
+	{
+		close( fd );
+		return;
+	}
+
+	void* ptr = mmap( nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd ); // mapping stays valid
+
+	if( MAP_FAILED == ptr )
+	{
+		mSize = 0;
+		throw Error( "FileMapping: unable to map '%s'", aPath );
+	}
+
+	mData = static_cast<std::uint8_t const*>(ptr);
+
+	// Hints only; failures are harmless.
+	switch( aAccess )
+	{
+		case Access::normal: break;
+		case Access::sequential: madvise( ptr, mSize, MADV_SEQUENTIAL ); break;
+		case Access::random: madvise( ptr, mSize, MADV_RANDOM ); break;
+		case Access::willNeed: madvise( ptr, mSize, MADV_WILLNEED ); break;
+	}
+#	endif
+}
+
+FileMapping::~FileMapping()
+{
+#	if defined(_WIN32)
+	if( mData )
+		UnmapViewOfFile( mData );
+	if( mMapping )
+		CloseHandle( mMapping );
+	if( INVALID_HANDLE_VALUE != mFile )
+		CloseHandle( mFile );
+#	else
+	if( mData )
+		munmap( const_cast<std::uint8_t*>(mData), mSize );
+#	endif
+}
+
+FileMapping::FileMapping( FileMapping&& aOther ) noexcept
+	: mData( std::exchange( aOther.mData, nullptr ) )
+	, mSize( std::exchange( aOther.mSize, 0 ) )
+#	if defined(_WIN32)
+	, mFile( std::exchange( aOther.mFile, INVALID_HANDLE_VALUE ) )
+	, mMapping( std::exchange( aOther.mMapping, nullptr ) )
+#	endif
+{}
+FileMapping& FileMapping::operator= (FileMapping&& aOther) noexcept
+{
+	std::swap( mData, aOther.mData );
+	std::swap( mSize, aOther.mSize );
+#	if defined(_WIN32)
+	std::swap( mFile, aOther.mFile );
+	std::swap( mMapping, aOther.mMapping );
+#	endif
+	return *this;
+}
+
+std::uint8_t const* FileMapping::data() const noexcept
+{
+	return mData;
+}
+
+std::size_t FileMapping::size() const noexcept
+{
+	return mSize;
+}
+
+bool FileMapping::empty() const noexcept
+{
+	return 0 == mSize;
+}
+
+std::string_view FileMapping::text() const noexcept
+{
+	return std::string_view( reinterpret_cast<char const*>(mData), mSize );
+}
+
+void FileMapping::prefetch( std::size_t aOffset, std::size_t aBytes ) const noexcept
+{
+	if( !mData || aOffset >= mSize )
+		return;
+
+	aBytes = std::min( aBytes, mSize - aOffset );
+
+#	if defined(_WIN32)
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<std::uint8_t*>(mData + aOffset);
+	range.NumberOfBytes = aBytes;
+	PrefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 );
+#	else
+	// madvise() wants a page aligned address.
+	auto const page = std::size_t(sysconf( _SC_PAGESIZE ));
+	std::size_t const start = aOffset / page * page;
+	madvise( const_cast<std::uint8_t*>(mData + start), aBytes + (aOffset - start), MADV_WILLNEED );
+#	endif
+}
@@ -0,0 +1,69 @@
+#ifndef FILE_MAPPING_HPP_69094589_A819_41B4_908D_E49F0E518D2A
+#define FILE_MAPPING_HPP_69094589_A819_41B4_908D_E49F0E518D2A
+
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+
+/* Read-only memory mapping of a whole file
+ *
+ * The contents are accessed in place (mmap() or MapViewOfFile()): no buffer
+ * is allocated and nothing is copied. Parsers, decoders and GL take the
+ * mapped bytes directly; the OS reads pages in as they are touched.
+ *
+ * The access hint is passed on to the OS (madvise() on Linux, see Access).
+ * prefetch() asks for part of the file to be read ahead, e.g., a texture's
+ * mip levels just before they are uploaded.
+ *
+ * Empty files map to data() == nullptr and size() == 0. The mapping stays
+ * valid until the object is destroyed; it does not keep the file open.
+ */
+class FileMapping final
+{
+	public:
+		enum class Access
+		{
+			normal,
+			sequential, // read front to back once (aggressive read-ahead)
+			random,     // few scattered reads (no read-ahead)
+			willNeed    // read the whole file soon (start reading now)
+		};
+
+	public:
+		FileMapping() noexcept;
+
+		// Throws Error if the file cannot be opened or mapped.
+		explicit FileMapping( char const* aPath, Access = Access::sequential );
+
+		~FileMapping();
+
+		FileMapping( FileMapping const& ) = delete;
+		FileMapping& operator= (FileMapping const&) = delete;
+
+		FileMapping( FileMapping&& ) noexcept;
+		FileMapping& operator= (FileMapping&&) noexcept;
+
+	public:
+		std::uint8_t const* data() const noexcept;
+		std::size_t size() const noexcept;
+		bool empty() const noexcept;
+
+		// Contents as characters (e.g., for text parsers)
+		std::string_view text() const noexcept;
+
+		// Hint that [aOffset, aOffset+aBytes) is needed soon. Clamped to the
+		// file; does nothing where not supported.
+		void prefetch( std::size_t aOffset, std::size_t aBytes ) const noexcept;
+
+	private:
+		std::uint8_t const* mData;
+		std::size_t mSize;
+
+#		if defined(_WIN32)
+		void* mFile;    // HANDLE
+		void* mMapping; // HANDLE
+#		endif
+};
+
+#endif // FILE_MAPPING_HPP_69094589_A819_41B4_908D_E49F0E518D2A
@@ -0,0 +1,145 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstdint>
+
+namespace
+{
+	constexpr std::size_t kNoAllocation_ = ~std::size_t(0);
+	constexpr std::size_t kMaxAlign_ = alignof(std::max_align_t);
+
+	std::size_t align_up_( std::size_t aValue, std::size_t aAlign ) noexcept
+	{
+		assert( 0 == (aAlign & (aAlign-1)) );
+		return (aValue + aAlign-1) & ~(aAlign-1);
+	}
+}
+
+// FrameArena
+FrameArena::FrameArena( std::size_t aCapacity, std::pmr::memory_resource* aUpstream )
+	: mUpstream( aUpstream )
+	, mBuffer( nullptr )
+	, mCapacity( aCapacity )
+	, mOwnsBuffer( aCapacity > 0 )
+	, mOffset( 0 )
+	, mLastOffset( kNoAllocation_ )
+	, mOverflow( nullptr )
+	, mOverflowBytes( 0 )
+	, mHighWater( 0 )
+	, mOverflows( 0 )
+{
+	assert( aUpstream );
+
+	if( mOwnsBuffer )
+		mBuffer = static_cast<std::byte*>(mUpstream->allocate( aCapacity, kMaxAlign_ ));
+}
+
+FrameArena::FrameArena( void* aBuffer, std::size_t aCapacity, std::pmr::memory_resource* aUpstream )
+	: mUpstream( aUpstream )
+	, mBuffer( static_cast<std::byte*>(aBuffer) )
+	, mCapacity( aCapacity )
+	, mOwnsBuffer( false )
+	, mOffset( 0 )
+	, mLastOffset( kNoAllocation_ )
+	, mOverflow( nullptr )
+	, mOverflowBytes( 0 )
+	, mHighWater( 0 )
+	, mOverflows( 0 )
+{
+	assert( aUpstream );
+	assert( aBuffer || 0 == aCapacity );
+}
+
+FrameArena::~FrameArena()
+{
+	reset();
+
+	if( mOwnsBuffer )
+		mUpstream->deallocate( mBuffer, mCapacity, kMaxAlign_ );
+}
+
+void FrameArena::reset() noexcept
+{
+	while( mOverflow )
+	{
+		Overflow_* const next = mOverflow->next;
+		mUpstream->deallocate( mOverflow, mOverflow->bytes, mOverflow->align );
+		mOverflow = next;
+	}
+
+	mOffset = 0;
+	mLastOffset = kNoAllocation_;
+	mOverflowBytes = 0;
+}
+
+std::size_t FrameArena::capacity() const noexcept
+{
+	return mCapacity;
+}
+
+std::size_t FrameArena::used() const noexcept
+{
+	return mOffset + mOverflowBytes;
+}
+
+std::size_t FrameArena::high_water() const noexcept
+{
+	return mHighWater;
+}
+
+std::size_t FrameArena::overflows() const noexcept
+{
+	return mOverflows;
+}
+
+void* FrameArena::do_allocate( std::size_t aBytes, std::size_t aAlign )
+{
+	// Align the address, not just the offset: the buffer itself is only
+	// guaranteed to be aligned to alignof(std::max_align_t) (or less, if
+	// provided by the caller).
+	auto const base = reinterpret_cast<std::uintptr_t>(mBuffer);
+	std::size_t const start = align_up_( base + mOffset, aAlign ) - base;
+
+	if( mBuffer && start <= mCapacity && aBytes <= mCapacity - start )
+	{
+		mLastOffset = start;
+		mOffset = start + aBytes;
+		mHighWater = std::max( mHighWater, used() );
+		return mBuffer + start;
+	}
+
+	// Does not fit. Allocate from upstream, with a header in front.
+	std::size_t const align = std::max( aAlign, alignof(Overflow_) );
+	std::size_t const header = align_up_( sizeof(Overflow_), align );
+	std::size_t const bytes = header + aBytes;
+
+	auto* const overflow = static_cast<Overflow_*>(mUpstream->allocate( bytes, align ));
+	overflow->next = mOverflow;
+	overflow->bytes = bytes;
+	overflow->align = align;
+	mOverflow = overflow;
+
+	mOverflowBytes += bytes;
+	++mOverflows;
+	mHighWater = std::max( mHighWater, used() );
+
+	return reinterpret_cast<std::byte*>(overflow) + header;
+}
+
+void FrameArena::do_deallocate( void* aPtr, std::size_t aBytes, std::size_t )
+{
+	// Give back the most recent allocation, if this is it. Everything else
+	// is released by reset().
+	if( kNoAllocation_ != mLastOffset && aPtr == mBuffer + mLastOffset && mLastOffset + aBytes == mOffset )
+	{
+		mOffset = mLastOffset;
+		mLastOffset = kNoAllocation_;
+	}
+}
+
+bool FrameArena::do_is_equal( std::pmr::memory_resource const& aOther ) const noexcept
+{
+	return this == &aOther;
+}
@@ -0,0 +1,86 @@
+#ifndef FRAME_ARENA_HPP_95D212BE_8B66_4488_BB69_B15C610B7B7C
+#define FRAME_ARENA_HPP_95D212BE_8B66_4488_BB69_B15C610B7B7C
+
+#include <memory_resource>
+
+#include <cstddef>
+
+/* Linear allocator for transient data (std::pmr::memory_resource)
+ *
+ * Allocations are carved from one buffer by bumping an offset; deallocation
+ * does nothing, except for the most recent allocation, which is given back
+ * (so scratch buffers freed in reverse order can reuse the space). A growing
+ * std::pmr::vector gains nothing from this: it allocates its new storage
+ * before freeing the old one, which then stays in use until reset(). Reserve
+ * containers up front where the size is known. reset() releases everything
+ * at once, e.g., at the start of each frame:
+ *
+ *   FrameArena arena( 1 << 20 );
+ *   while( ... )
+ *   {
+ *     arena.reset();
+ *     std::pmr::vector<DrawKey> keys( &arena );
+ *     ...
+ *   }
+ *
+ * The buffer is either allocated once by the constructor or provided by the
+ * caller (e.g., on the stack). When it is full, further allocations go to
+ * the upstream resource and are freed by the next reset(); overflows()
+ * counts them, and high_water() shows how much would have been needed.
+ *
+ * Not thread safe. Objects allocated from the arena must not be used after
+ * reset(); their destructors are not run by it.
+ */
+class FrameArena final : public std::pmr::memory_resource
+{
+	public:
+		explicit FrameArena( std::size_t aCapacity, std::pmr::memory_resource* aUpstream = std::pmr::new_delete_resource() );
+		FrameArena( void* aBuffer, std::size_t aCapacity, std::pmr::memory_resource* aUpstream = std::pmr::new_delete_resource() );
+		~FrameArena() override;
+
+		FrameArena( FrameArena const& ) = delete;
+		FrameArena& operator= (FrameArena const&) = delete;
+
+	public:
+		void reset() noexcept;
+
+		std::size_t capacity() const noexcept;
+		std::size_t used() const noexcept;
+
+		// Most bytes in use (including overflow) at any point since
+		// construction
+		std::size_t high_water() const noexcept;
+
+		// Allocations that did not fit, since construction
+		std::size_t overflows() const noexcept;
+
+	private:
+		void* do_allocate( std::size_t, std::size_t ) override;
+		void do_deallocate( void*, std::size_t, std::size_t ) override;
+		bool do_is_equal( std::pmr::memory_resource const& ) const noexcept override;
+
+	private:
+		// Header of an overflow allocation (singly linked list)
+		struct Overflow_
+		{
+			Overflow_* next;
+			std::size_t bytes, align;
+		};
+
+		std::pmr::memory_resource* mUpstream;
+
+		std::byte* mBuffer;
+		std::size_t mCapacity;
+		bool mOwnsBuffer;
+
+		std::size_t mOffset;
+		std::size_t mLastOffset; // start of the most recent allocation
+
+		Overflow_* mOverflow;
+		std::size_t mOverflowBytes;
+
+		std::size_t mHighWater;
+		std::size_t mOverflows;
+};
+
+#endif // FRAME_ARENA_HPP_95D212BE_8B66_4488_BB69_B15C610B7B7C
@@ -0,0 +1,197 @@
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+namespace
+{
+	constexpr std::size_t kInvalidScope_ = ~std::size_t(0);
+}
+
+GpuProfiler::GpuProfiler()
+	: mFrames( kFrameLatency )
+	, mCurrent( 0 )
+	, mDepth( 0 )
+	, mInFrame( false )
+	, mDroppedFrames( 0 )
+	, mCallback( nullptr )
+	, mCallbackUser( nullptr )
+{
+	for( auto& frame : mFrames )
+	{
+		glGenQueries( GLsizei(2*kMaxScopesPerFrame), frame.queries );
+		frame.scopeCount = 0;
+		frame.tag = 0;
+		frame.pending = false;
+	}
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for( auto& frame : mFrames )
+		glDeleteQueries( GLsizei(2*kMaxScopesPerFrame), frame.queries );
+}
+
+void GpuProfiler::begin_frame( std::uint64_t aFrameTag )
+{
+	assert( !mInFrame );
+
+	// Reuse the oldest slot. Collect its results first, if they are ready.
+	mCurrent = (mCurrent+1) % mFrames.size();
+
+	auto& frame = mFrames[mCurrent];
+	if( frame.pending )
+		collect_( frame );
+
+	frame.scopeCount = 0;
+	frame.tag = aFrameTag;
+	frame.pending = false;
+
+	mDepth = 0;
+	mInFrame = true;
+}
+
+void GpuProfiler::end_frame()
+{
+	assert( mInFrame );
+	assert( 0 == mDepth );
+
+	auto& frame = mFrames[mCurrent];
+	frame.pending = frame.scopeCount > 0;
+
+	mInFrame = false;
+}
+
+std::size_t GpuProfiler::begin_scope( char const* aName )
+{
+	assert( mInFrame );
+
+	auto& frame = mFrames[mCurrent];
+	if( frame.scopeCount >= kMaxScopesPerFrame )
+	{
+		++mDepth;
+		return kInvalidScope_;
+	}
+
+	std::size_t const index = frame.scopeCount++;
+	frame.scopes[index] = Scope_{ aName, mDepth, false };
+	++mDepth;
+
+	glQueryCounter( frame.queries[2*index+0], GL_TIMESTAMP );
+	return index;
+}
+
+void GpuProfiler::end_scope( std::size_t aScope )
+{
+	assert( mDepth > 0 );
+	--mDepth;
+
+	if( kInvalidScope_ == aScope )
+		return;
+
+	auto& frame = mFrames[mCurrent];
+	assert( aScope < frame.scopeCount );
+
+	glQueryCounter( frame.queries[2*aScope+1], GL_TIMESTAMP );
+	frame.scopes[aScope].closed = true;
+}
+
+std::vector<GpuProfiler::ScopeStats> const& GpuProfiler::stats() const noexcept
+{
+	return mStats;
+}
+
+std::size_t GpuProfiler::dropped_frames() const noexcept
+{
+	return mDroppedFrames;
+}
+
+void GpuProfiler::print_summary( std::FILE* aOut ) const
+{
+	std::fprintf( aOut, "GPU profile (last %zu frames, ms):\n", kHistory );
+	std::fprintf( aOut, "  %-28s %8s %8s %8s\n", "scope", "min", "avg", "max" );
+	for( auto const& s : mStats )
+	{
+		int const indent = int(2*s.depth);
+		int const width = std::max( 0, 28 - indent );
+		std::fprintf( aOut, "  %*s%-*s %8.3f %8.3f %8.3f\n", indent, "", width, s.name.c_str(), s.minMs, s.avgMs, s.maxMs );
+	}
+
+	if( mDroppedFrames )
+		std::fprintf( aOut, "  (%zu frames dropped: results not ready in time)\n", mDroppedFrames );
+}
+
+void GpuProfiler::set_scope_callback( ScopeCallback aCallback, void* aUser ) noexcept
+{
+	mCallback = aCallback;
+	mCallbackUser = aUser;
+}
+
+void GpuProfiler::collect_( Frame_& aFrame )
+{
+	// Results of all queries in a frame become available in order; checking
+	// the last one is enough. The outermost scope ends last.
+	GLint available = 0;
+	glGetQueryObjectiv( aFrame.queries[1], GL_QUERY_RESULT_AVAILABLE, &available );
+	for( std::size_t i = 0; available && i < aFrame.scopeCount; ++i )
+	{
+		if( aFrame.scopes[i].closed )
+			glGetQueryObjectiv( aFrame.queries[2*i+1], GL_QUERY_RESULT_AVAILABLE, &available );
+	}
+
+	if( !available )
+	{
+		++mDroppedFrames;
+		return;
+	}
+
+	for( std::size_t i = 0; i < aFrame.scopeCount; ++i )
+	{
+		auto const& scope = aFrame.scopes[i];
+		if( !scope.closed )
+			continue;
+
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v( aFrame.queries[2*i+0], GL_QUERY_RESULT, &start );
+		glGetQueryObjectui64v( aFrame.queries[2*i+1], GL_QUERY_RESULT, &end );
+
+		float const ms = end > start ? float(end - start) * 1e-6f : 0.f;
+		record_( scope.name, scope.depth, ms );
+
+		if( mCallback )
+			mCallback( mCallbackUser, aFrame.tag, scope.name, scope.depth, start, end );
+	}
+}
+
+void GpuProfiler::record_( char const* aName, std::size_t aDepth, float aMs )
+{
+	auto it = std::find_if( mStats.begin(), mStats.end(), [&] (ScopeStats const& aStats) {
+		return aStats.depth == aDepth && aStats.name == aName;
+	} );
+
+	if( mStats.end() == it )
+	{
+		mStats.emplace_back( ScopeStats{ aName, aDepth, 0.f, 0.f, 0.f, 0.f } );
+		mHistory.emplace_back( History_{ {}, 0, 0 } );
+		it = mStats.end() - 1;
+	}
+
+	auto& hist = mHistory[std::size_t(it - mStats.begin())];
+	hist.samples[hist.next] = aMs;
+	hist.next = (hist.next+1) % kHistory;
+	hist.count = std::min( hist.count+1, kHistory );
+
+	float minMs = hist.samples[0], maxMs = hist.samples[0], sum = 0.f;
+	for( std::size_t i = 0; i < hist.count; ++i )
+	{
+		minMs = std::min( minMs, hist.samples[i] );
+		maxMs = std::max( maxMs, hist.samples[i] );
+		sum += hist.samples[i];
+	}
+
+	it->lastMs = aMs;
+	it->minMs = minMs;
+	it->maxMs = maxMs;
+	it->avgMs = sum / float(hist.count);
+}
@@ -0,0 +1,146 @@
+#ifndef GPU_PROFILER_HPP_07183DE4_B847_4E6B_A8C3_3862061B48DD
+#define GPU_PROFILER_HPP_07183DE4_B847_4E6B_A8C3_3862061B48DD
+
+#include <glad.h>
+
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+
+/* GPU profiler based on timer queries
+ *
+ * Each scope records a GL_TIMESTAMP query at its start and at its end.
+ * Timestamps (rather than GL_TIME_ELAPSED, which cannot be nested) allow
+ * scopes to be nested arbitrarily.
+ *
+ * Queries are kept in a ring of kFrameLatency frames. begin_frame() collects
+ * the results of the oldest frame in the ring, i.e., results lag a few frames
+ * behind but reading them never stalls the pipeline. If a frame's results
+ * are still not available when its slot comes round again, that frame is
+ * skipped (and counted in dropped_frames()).
+ *
+ * Per scope, a rolling window of the last kHistory samples gives min/avg/max.
+ * Scopes are identified by name and nesting depth, and reported in the order
+ * in which they were first seen.
+ *
+ * Usage:
+ *   profiler.begin_frame();
+ *   {
+ *     GpuProfileScope scope( profiler, "scene" );
+ *     ...
+ *   }
+ *   profiler.end_frame();
+ */
+class GpuProfiler final
+{
+	public:
+		static constexpr std::size_t kFrameLatency = 4;
+		static constexpr std::size_t kMaxScopesPerFrame = 64;
+		static constexpr std::size_t kHistory = 120;
+
+		struct ScopeStats
+		{
+			std::string name;
+			std::size_t depth;
+
+			float lastMs;
+			float minMs, avgMs, maxMs;
+		};
+
+		// Called for each scope when a frame's results are collected, with
+		// the tag passed to that frame's begin_frame() and the raw
+		// GL_TIMESTAMP values (nanoseconds, GPU clock).
+		using ScopeCallback = void (*)( void* aUser, std::uint64_t aFrameTag, char const* aName, std::size_t aDepth, GLuint64 aBegin, GLuint64 aEnd );
+
+	public:
+		GpuProfiler();
+		~GpuProfiler();
+
+		GpuProfiler( GpuProfiler const& ) = delete;
+		GpuProfiler& operator= (GpuProfiler const&) = delete;
+
+	public:
+		// aFrameTag identifies the frame in the scope callback (e.g., the
+		// frame number).
+		void begin_frame( std::uint64_t aFrameTag = 0 );
+		void end_frame();
+
+		// aName must stay valid until the frame's results have been collected
+		// (string literals are the intended use).
+		std::size_t begin_scope( char const* aName );
+		void end_scope( std::size_t aScope );
+
+		std::vector<ScopeStats> const& stats() const noexcept;
+		std::size_t dropped_frames() const noexcept;
+
+		void print_summary( std::FILE* ) const;
+
+		void set_scope_callback( ScopeCallback, void* aUser ) noexcept;
+
+	private:
+		struct Scope_
+		{
+			char const* name;
+			std::size_t depth;
+			bool closed;
+		};
+
+		struct Frame_
+		{
+			GLuint queries[2*kMaxScopesPerFrame];
+			Scope_ scopes[kMaxScopesPerFrame];
+			std::size_t scopeCount;
+			std::uint64_t tag;
+			bool pending;
+		};
+
+		struct History_
+		{
+			float samples[kHistory];
+			std::size_t count, next;
+		};
+
+		void collect_( Frame_& );
+		void record_( char const* aName, std::size_t aDepth, float aMs );
+
+	private:
+		std::vector<Frame_> mFrames;
+		std::size_t mCurrent;
+		std::size_t mDepth;
+		bool mInFrame;
+
+		std::vector<ScopeStats> mStats;
+		std::vector<History_> mHistory;
+
+		std::size_t mDroppedFrames;
+
+		ScopeCallback mCallback;
+		void* mCallbackUser;
+};
+
+// RAII helper for GpuProfiler::begin_scope()/end_scope()
+class GpuProfileScope final
+{
+	public:
+		GpuProfileScope( GpuProfiler& aProfiler, char const* aName )
+			: mProfiler( aProfiler )
+			, mScope( aProfiler.begin_scope( aName ) )
+		{}
+
+		~GpuProfileScope()
+		{
+			mProfiler.end_scope( mScope );
+		}
+
+		GpuProfileScope( GpuProfileScope const& ) = delete;
+		GpuProfileScope& operator= (GpuProfileScope const&) = delete;
+
+	private:
+		GpuProfiler& mProfiler;
+		std::size_t mScope;
+};
+
+#endif // GPU_PROFILER_HPP_07183DE4_B847_4E6B_A8C3_3862061B48DD
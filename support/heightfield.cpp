@@ -0,0 +1,174 @@
+#include "heightfield.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+#include <cstddef>
+
+#include "error.hpp"
+
+namespace
+{
+	// Barycentric tolerance, so that grid points on shared edges are not
+	// missed due to rounding
+	constexpr double kEdgeEpsilon_ = 1e-5;
+
+	// Fill distance of grid points that no triangle covers yet
+	constexpr std::uint32_t kUnreached_ = std::numeric_limits<std::uint32_t>::max();
+
+	double cross_( double aX0, double aY0, double aX1, double aY1 ) noexcept
+	{
+		return aX0 * aY1 - aY0 * aX1;
+	}
+}
+
+Heightfield make_heightfield( std::vector<Vec3f> const& aPositions, std::uint32_t aMaxSize )
+{
+	assert( aMaxSize >= 2 );
+	assert( 0 == aPositions.size() % 3 );
+
+	auto const& pos = aPositions;
+	if( pos.empty() )
+		throw Error( "make_heightfield(): empty mesh" );
+
+	float minX = pos.front().x, minZ = pos.front().z, maxX = minX, maxZ = minZ;
+	for( auto const& p : pos )
+	{
+		minX = std::min( minX, p.x );
+		minZ = std::min( minZ, p.z );
+		maxX = std::max( maxX, p.x );
+		maxZ = std::max( maxZ, p.z );
+	}
+
+	float const width = maxX - minX, depth = maxZ - minZ;
+	if( !(width > 0.f && depth > 0.f) )
+		throw Error( "make_heightfield(): mesh covers no area (%g x %g)", double(width), double(depth) );
+
+	// A regular grid of V vertices has about 2V triangles, i.e., six
+	// triangle corners per vertex.
+	double const vertices = std::max( 4.0, double(pos.size()) / 6.0 );
+	double const aspect = double(width) / double(depth);
+
+	auto const grid_points_ = [aMaxSize] (double aCells) {
+		return std::uint32_t(std::clamp<long>( std::lround( aCells ) + 1, 2, long(aMaxSize) ));
+	};
+
+	Heightfield field{};
+	field.originX = minX;
+	field.originZ = minZ;
+	field.columns = grid_points_( std::sqrt( vertices * aspect ) );
+	field.rows = grid_points_( std::sqrt( vertices / aspect ) );
+	field.spacingX = width / float(field.columns-1);
+	field.spacingZ = depth / float(field.rows-1);
+	field.heights.assign( std::size_t(field.columns) * field.rows, 0.f );
+
+	// Rings from the covered area; 0 for grid points that a triangle covers
+	std::vector<std::uint32_t> ring( field.heights.size(), kUnreached_ );
+
+	// Rasterize the triangles onto the grid points, in grid coordinates
+	for( std::size_t i = 0; i < pos.size(); i += 3 )
+	{
+		double gx[3], gz[3];
+		for( std::size_t k = 0; k < 3; ++k )
+		{
+			gx[k] = double(pos[i+k].x - minX) / double(field.spacingX);
+			gz[k] = double(pos[i+k].z - minZ) / double(field.spacingZ);
+		}
+
+		// Vertical triangles cover no grid points.
+		double const area = cross_( gx[1]-gx[0], gz[1]-gz[0], gx[2]-gx[0], gz[2]-gz[0] );
+		if( std::abs( area ) < 1e-12 )
+			continue;
+
+		auto const lo_ = [] (double aA, double aB, double aC) {
+			return long(std::ceil( std::min( { aA, aB, aC } ) - kEdgeEpsilon_ ));
+		};
+		auto const hi_ = [] (double aA, double aB, double aC) {
+			return long(std::floor( std::max( { aA, aB, aC } ) + kEdgeEpsilon_ ));
+		};
+
+		long const x0 = std::max( 0L, lo_( gx[0], gx[1], gx[2] ) );
+		long const x1 = std::min( long(field.columns)-1, hi_( gx[0], gx[1], gx[2] ) );
+		long const z0 = std::max( 0L, lo_( gz[0], gz[1], gz[2] ) );
+		long const z1 = std::min( long(field.rows)-1, hi_( gz[0], gz[1], gz[2] ) );
+
+		for( long z = z0; z <= z1; ++z )
+		{
+			for( long x = x0; x <= x1; ++x )
+			{
+				double const u = cross_( double(x)-gx[0], double(z)-gz[0], gx[2]-gx[0], gz[2]-gz[0] ) / area;
+				double const v = cross_( gx[1]-gx[0], gz[1]-gz[0], double(x)-gx[0], double(z)-gz[0] ) / area;
+				double const w = 1.0 - u - v;
+				if( u < -kEdgeEpsilon_ || v < -kEdgeEpsilon_ || w < -kEdgeEpsilon_ )
+					continue;
+
+				auto const h = float(w * pos[i].y + u * pos[i+1].y + v * pos[i+2].y);
+
+				auto const index = std::size_t(z) * field.columns + std::size_t(x);
+				if( 0 != ring[index] || h > field.heights[index] )
+				{
+					field.heights[index] = h;
+					ring[index] = 0;
+				}
+			}
+		}
+	}
+
+	// Grow the covered area into holes and the corners outside of the mesh,
+	// breadth-first. A grid point in ring k takes the mean height of its
+	// neighbours in ring k-1 (all of which precede it in the queue), so every
+	// grid point is visited once.
+	std::vector<std::size_t> queue;
+	queue.reserve( field.heights.size() );
+	for( std::size_t i = 0; i < ring.size(); ++i )
+	{
+		if( 0 == ring[i] )
+			queue.emplace_back( i );
+	}
+
+	if( queue.empty() )
+		throw Error( "make_heightfield(): no grid point covered (%ux%u grid)", field.columns, field.rows );
+
+	for( std::size_t head = 0; head < queue.size(); ++head )
+	{
+		auto const index = queue[head];
+		auto const x = index % field.columns, z = index / field.columns;
+
+		std::size_t neighbours[4];
+		std::size_t count = 0;
+		if( x > 0 ) neighbours[count++] = index-1;
+		if( x+1 < field.columns ) neighbours[count++] = index+1;
+		if( z > 0 ) neighbours[count++] = index-field.columns;
+		if( z+1 < field.rows ) neighbours[count++] = index+field.columns;
+
+		if( 0 != ring[index] )
+		{
+			float sum = 0.f;
+			std::size_t inner = 0;
+			for( std::size_t k = 0; k < count; ++k )
+			{
+				if( ring[neighbours[k]] < ring[index] )
+				{
+					sum += field.heights[neighbours[k]];
+					++inner;
+				}
+			}
+
+			assert( inner > 0 );
+			field.heights[index] = sum / float(inner);
+		}
+
+		for( std::size_t k = 0; k < count; ++k )
+		{
+			if( kUnreached_ == ring[neighbours[k]] )
+			{
+				ring[neighbours[k]] = ring[index] + 1;
+				queue.emplace_back( neighbours[k] );
+			}
+		}
+	}
+
+	return field;
+}
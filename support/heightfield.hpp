@@ -0,0 +1,28 @@
+#ifndef HEIGHTFIELD_HPP_AADC2678_34D1_4DC0_9A3C_39D33C22E6ED
+#define HEIGHTFIELD_HPP_AADC2678_34D1_4DC0_9A3C_39D33C22E6ED
+
+#include <vector>
+#include <cstdint>
+
+#include "../vmlib/vec3.hpp"
+
+// Terrain heights on a regular grid in the XZ plane. Grid point (i,j) is at
+// x = originX + i*spacingX, z = originZ + j*spacingZ.
+struct Heightfield
+{
+	float originX, originZ;
+	float spacingX, spacingZ;
+	std::uint32_t columns, rows;  // grid points (at least 2 each)
+	std::vector<float> heights;   // columns*rows, row by row (along X)
+};
+
+// Sample a terrain mesh (a triangle soup, three positions per triangle,
+// single-valued in Y) onto a grid covering its XZ bounds, with about one
+// grid point per mesh vertex, but at most aMaxSize points per side. Where
+// triangles overlap in XZ, the highest one wins. Grid points that no
+// triangle covers take the mean height of their neighbours nearer to the
+// covered area (one breadth-first pass over the grid). Throws Error if the
+// mesh covers no area.
+Heightfield make_heightfield( std::vector<Vec3f> const& aPositions, std::uint32_t aMaxSize );
+
+#endif // HEIGHTFIELD_HPP_AADC2678_34D1_4DC0_9A3C_39D33C22E6ED
@@ -0,0 +1,219 @@
+#include "lz_block.hpp"
+
+#include <vector>
+
+#include <cstring>
+
+namespace
+{
+	constexpr std::size_t kMinMatch_ = 4;
+	constexpr std::size_t kMaxOffset_ = 65535;
+
+	// LZ4 block rules: the last 5 bytes are always literals, and the last
+	// match starts at least 12 bytes before the end.
+	constexpr std::size_t kLastLiterals_ = 5;
+	constexpr std::size_t kMatchLimit_ = 12;
+
+	constexpr unsigned kHashBits_ = 16;
+
+	std::uint32_t read32_( std::uint8_t const* aPtr ) noexcept
+	{
+		std::uint32_t ret;
+		std::memcpy( &ret, aPtr, sizeof(ret) );
+		return ret;
+	}
+
+	std::uint32_t hash_( std::uint32_t aValue ) noexcept
+	{
+		return (aValue * 2654435761u) >> (32 - kHashBits_);
+	}
+
+	// Output with bounds checks. All writes fail (and keep failing) once the
+	// capacity is exceeded.
+	struct Writer_
+	{
+		std::uint8_t* out;
+		std::size_t capacity;
+		std::size_t size = 0;
+		bool overflow = false;
+
+		void byte( std::uint8_t aByte ) noexcept
+		{
+			if( size < capacity )
+				out[size++] = aByte;
+			else
+				overflow = true;
+		}
+
+		void bytes( std::uint8_t const* aData, std::size_t aCount ) noexcept
+		{
+			if( aCount <= capacity - size )
+			{
+				std::memcpy( out + size, aData, aCount );
+				size += aCount;
+			}
+			else
+			{
+				overflow = true;
+			}
+		}
+
+		// Length beyond the 4 bits in the token: 255s, then the remainder
+		void length( std::size_t aExtra ) noexcept
+		{
+			for( ; aExtra >= 255; aExtra -= 255 )
+				byte( 255 );
+			byte( std::uint8_t(aExtra) );
+		}
+	};
+
+	void write_sequence_( Writer_& aOut, std::uint8_t const* aLiterals, std::size_t aLiteralCount, std::size_t aOffset, std::size_t aMatchLength ) noexcept
+	{
+		std::size_t const matchCode = aMatchLength - kMinMatch_;
+
+		std::uint8_t token = std::uint8_t((aLiteralCount < 15 ? aLiteralCount : 15) << 4);
+		if( aMatchLength )
+			token |= std::uint8_t(matchCode < 15 ? matchCode : 15);
+		aOut.byte( token );
+
+		if( aLiteralCount >= 15 )
+			aOut.length( aLiteralCount - 15 );
+		aOut.bytes( aLiterals, aLiteralCount );
+
+		if( !aMatchLength )
+			return;
+
+		aOut.byte( std::uint8_t(aOffset & 0xff) );
+		aOut.byte( std::uint8_t(aOffset >> 8) );
+
+		if( matchCode >= 15 )
+			aOut.length( matchCode - 15 );
+	}
+
+	// Length continuation bytes; false if the input ends first
+	bool read_length_( std::uint8_t const* aIn, std::size_t aSize, std::size_t& aPos, std::size_t& aLength ) noexcept
+	{
+		std::uint8_t extra;
+		do
+		{
+			if( aPos >= aSize )
+				return false;
+
+			extra = aIn[aPos++];
+			aLength += extra;
+		} while( 255 == extra );
+
+		return true;
+	}
+}
+
+std::size_t lz_compress_bound( std::size_t aSize ) noexcept
+{
+	// Incompressible input: one token, the length bytes and the literals
+	return aSize + aSize/255 + 16;
+}
+
+std::size_t lz_compress( std::uint8_t const* aIn, std::size_t aSize, std::uint8_t* aOut, std::size_t aCapacity )
+{
+	Writer_ out{ aOut, aCapacity };
+
+	std::size_t anchor = 0; // first literal not yet written
+	if( aSize > kMatchLimit_ )
+	{
+		// Positions + 1 (0: empty)
+		std::vector<std::uint32_t> table( std::size_t(1) << kHashBits_, 0 );
+
+		std::size_t const matchEnd = aSize - kLastLiterals_;
+		std::size_t pos = 0;
+		while( pos + kMatchLimit_ <= aSize )
+		{
+			auto const value = read32_( aIn + pos );
+			auto& slot = table[hash_( value )];
+			std::size_t const candidate = slot;
+			slot = std::uint32_t(pos + 1);
+
+			if( 0 == candidate || pos - (candidate-1) > kMaxOffset_ || read32_( aIn + candidate-1 ) != value )
+			{
+				++pos;
+				continue;
+			}
+
+			std::size_t const ref = candidate - 1;
+			std::size_t length = kMinMatch_;
+			while( pos + length < matchEnd && aIn[ref + length] == aIn[pos + length] )
+				++length;
+
+			write_sequence_( out, aIn + anchor, pos - anchor, pos - ref, length );
+			if( out.overflow )
+				return 0;
+
+			// Index a position near the end of the match, so that the next
+			// one can refer back to it. (Ends before matchEnd, so the read
+			// is in bounds.)
+			table[hash_( read32_( aIn + pos + length - 2 ) )] = std::uint32_t(pos + length - 2 + 1);
+
+			pos += length;
+			anchor = pos;
+		}
+	}
+
+	write_sequence_( out, aIn + anchor, aSize - anchor, 0, 0 );
+	return out.overflow ? 0 : out.size;
+}
+
+bool lz_decompress( std::uint8_t const* aIn, std::size_t aSize, std::uint8_t* aOut, std::size_t aOutSize ) noexcept
+{
+	std::size_t in = 0, out = 0;
+	while( true )
+	{
+		if( in >= aSize )
+			return false;
+
+		std::uint8_t const token = aIn[in++];
+
+		std::size_t literals = token >> 4;
+		if( 15 == literals && !read_length_( aIn, aSize, in, literals ) )
+			return false;
+
+		if( literals > aSize - in || literals > aOutSize - out )
+			return false;
+
+		std::memcpy( aOut + out, aIn + in, literals );
+		in += literals;
+		out += literals;
+
+		// The last sequence has literals only.
+		if( in == aSize )
+			return out == aOutSize;
+
+		if( aSize - in < 2 )
+			return false;
+
+		std::size_t const offset = std::size_t(aIn[in]) | (std::size_t(aIn[in+1]) << 8);
+		in += 2;
+
+		if( 0 == offset || offset > out )
+			return false;
+
+		std::size_t length = token & 15;
+		if( 15 == length && !read_length_( aIn, aSize, in, length ) )
+			return false;
+		length += kMinMatch_;
+
+		if( length > aOutSize - out )
+			return false;
+
+		// Matches may overlap their own output (offset < length), e.g., runs.
+		std::uint8_t const* src = aOut + out - offset;
+		if( offset >= length )
+		{
+			std::memcpy( aOut + out, src, length );
+		}
+		else
+		{
+			for( std::size_t i = 0; i < length; ++i )
+				aOut[out + i] = src[i];
+		}
+		out += length;
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef LZ_BLOCK_HPP_7772E7C5_3948_4A5B_9EDD_4F42571E502B
+#define LZ_BLOCK_HPP_7772E7C5_3948_4A5B_9EDD_4F42571E502B
+
+#include <cstdint>
+#include <cstddef>
+
+/* LZ77 block compression (LZ4 block format)
+ *
+ * Output is a single LZ4 block: sequences of (token, literals, 16-bit
+ * offset, match length), ending in literals. The encoder is a greedy
+ * single-pass matcher with a 64k-entry hash table; it aims for fast
+ * decompression rather than ratio. Blocks carry no sizes or checksums; the
+ * caller stores the original size (e.g., in the archive index).
+ *
+ * The decoder checks all reads and writes against the buffer bounds, so
+ * corrupt input fails cleanly instead of overrunning.
+ */
+
+// Largest possible output of lz_compress() for aSize input bytes
+std::size_t lz_compress_bound( std::size_t aSize ) noexcept;
+
+// Returns the number of bytes written to aOut, or 0 if the output does not
+// fit into aCapacity bytes (never with aCapacity >= lz_compress_bound()).
+// Allocates the hash table (256 kB) on the heap.
+std::size_t lz_compress( std::uint8_t const* aIn, std::size_t aSize, std::uint8_t* aOut, std::size_t aCapacity );
+
+// Decompress aSize bytes into exactly aOutSize bytes. Returns false if the
+// input is corrupt or does not decode to exactly aOutSize bytes.
+bool lz_decompress( std::uint8_t const* aIn, std::size_t aSize, std::uint8_t* aOut, std::size_t aOutSize ) noexcept;
+
+#endif // LZ_BLOCK_HPP_7772E7C5_3948_4A5B_9EDD_4F42571E502B
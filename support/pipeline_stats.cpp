@@ -0,0 +1,139 @@
+#include "pipeline_stats.hpp"
+
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	bool has_extension_( char const* aName )
+	{
+		GLint count = 0;
+		glGetIntegerv( GL_NUM_EXTENSIONS, &count );
+
+		for( GLint i = 0; i < count; ++i )
+		{
+			auto const* ext = reinterpret_cast<char const*>(glGetStringi( GL_EXTENSIONS, GLuint(i) ));
+			if( ext && 0 == std::strcmp( ext, aName ) )
+				return true;
+		}
+
+		return false;
+	}
+}
+
+PipelineStats::PipelineStats()
+	: mAvailable( GLAD_GL_VERSION_4_6 || has_extension_( "GL_ARB_pipeline_statistics_query" ) )
+	, mFrames{}
+	, mCurrent( 0 )
+	, mStats{}
+	, mDroppedFrames( 0 )
+{
+	if( !mAvailable )
+		return;
+
+	for( auto& frame : mFrames )
+		glGenQueries( GLsizei(kMaxPasses), frame.queries );
+}
+
+PipelineStats::~PipelineStats()
+{
+	if( !mAvailable )
+		return;
+
+	for( auto& frame : mFrames )
+		glDeleteQueries( GLsizei(kMaxPasses), frame.queries );
+}
+
+bool PipelineStats::available() const noexcept
+{
+	return mAvailable;
+}
+
+void PipelineStats::begin_frame()
+{
+	if( !mAvailable )
+		return;
+
+	mCurrent = (mCurrent+1) % kFrameLatency;
+
+	auto& frame = mFrames[mCurrent];
+	if( frame.pending )
+		collect_( frame );
+
+	for( auto& used : frame.used )
+		used = false;
+	frame.pending = false;
+}
+
+void PipelineStats::end_frame()
+{
+	if( !mAvailable )
+		return;
+
+	auto& frame = mFrames[mCurrent];
+	for( auto const used : frame.used )
+		frame.pending = frame.pending || used;
+}
+
+void PipelineStats::begin_pass( std::size_t aPass )
+{
+	assert( aPass < kMaxPasses );
+	if( !mAvailable )
+		return;
+
+	auto& frame = mFrames[mCurrent];
+	assert( !frame.used[aPass] );
+
+	glBeginQuery( GL_FRAGMENT_SHADER_INVOCATIONS, frame.queries[aPass] );
+	frame.used[aPass] = true;
+}
+
+void PipelineStats::end_pass( std::size_t aPass )
+{
+	assert( aPass < kMaxPasses );
+	if( !mAvailable )
+		return;
+
+	glEndQuery( GL_FRAGMENT_SHADER_INVOCATIONS );
+}
+
+PipelineStats::PassStats const& PipelineStats::stats( std::size_t aPass ) const noexcept
+{
+	assert( aPass < kMaxPasses );
+	return mStats[aPass];
+}
+
+std::size_t PipelineStats::dropped_frames() const noexcept
+{
+	return mDroppedFrames;
+}
+
+void PipelineStats::collect_( Frame_& aFrame )
+{
+	for( std::size_t i = 0; i < kMaxPasses; ++i )
+	{
+		if( !aFrame.used[i] )
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv( aFrame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available );
+		if( !available )
+		{
+			++mDroppedFrames;
+			return;
+		}
+	}
+
+	for( std::size_t i = 0; i < kMaxPasses; ++i )
+	{
+		if( !aFrame.used[i] )
+			continue;
+
+		GLuint64 count = 0;
+		glGetQueryObjectui64v( aFrame.queries[i], GL_QUERY_RESULT, &count );
+
+		mStats[i].last = count;
+		mStats[i].total += count;
+		++mStats[i].frames;
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef PIPELINE_STATS_HPP_5C2E8A41_7D93_4B0F_A6E1_93F4B27C8D05
+#define PIPELINE_STATS_HPP_5C2E8A41_7D93_4B0F_A6E1_93F4B27C8D05
+
+#include <glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/* Fragment shader invocation counts per pass
+ *
+ * One GL_FRAGMENT_SHADER_INVOCATIONS query per pass and frame, for up to
+ * kMaxPasses passes (identified by index). The query is core in OpenGL 4.6
+ * and needs GL_ARB_pipeline_statistics_query before that; without either,
+ * available() is false and all other calls do nothing.
+ *
+ * As in GpuProfiler, queries are kept in a ring of kFrameLatency frames and
+ * begin_frame() collects the oldest frame's results, so reading them never
+ * stalls the pipeline. Frames whose results are still not available by then
+ * are skipped (and counted in dropped_frames()).
+ *
+ * Queries of the same type cannot be active at the same time, so passes
+ * must not overlap.
+ */
+class PipelineStats final
+{
+	public:
+		static constexpr std::size_t kFrameLatency = 4;
+		static constexpr std::size_t kMaxPasses = 4;
+
+		struct PassStats
+		{
+			std::uint64_t last;  // most recent frame with results
+			std::uint64_t total; // sum over all frames with results
+			std::size_t frames;  // frames with results
+		};
+
+	public:
+		PipelineStats();
+		~PipelineStats();
+
+		PipelineStats( PipelineStats const& ) = delete;
+		PipelineStats& operator= (PipelineStats const&) = delete;
+
+	public:
+		bool available() const noexcept;
+
+		void begin_frame();
+		void end_frame();
+
+		void begin_pass( std::size_t aPass );
+		void end_pass( std::size_t aPass );
+
+		PassStats const& stats( std::size_t aPass ) const noexcept;
+		std::size_t dropped_frames() const noexcept;
+
+	private:
+		struct Frame_
+		{
+			GLuint queries[kMaxPasses];
+			bool used[kMaxPasses];
+			bool pending;
+		};
+
+		void collect_( Frame_& );
+
+	private:
+		bool mAvailable;
+
+		Frame_ mFrames[kFrameLatency];
+		std::size_t mCurrent;
+
+		PassStats mStats[kMaxPasses];
+		std::size_t mDroppedFrames;
+};
+
+#endif // PIPELINE_STATS_HPP_5C2E8A41_7D93_4B0F_A6E1_93F4B27C8D05
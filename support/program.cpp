@@ -2,17 +2,25 @@
 
 #include <vector>
 #include <utility>
+#include <memory_resource>
 
 #include <cstdio>
+#include <cstddef>
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
 
 #include "error.hpp"
 #include "checkpoint.hpp"
+#include "frame_arena.hpp"
+#include "asset_store.hpp"
 
 namespace
 {
+	// Scratch space for info logs. Longer ones spill to the heap (see
+	// FrameArena).
+	constexpr std::size_t kScratchBytes_ = 16*1024;
+
 	GLuint load_shader_( 
 		GLenum aShaderType, 
 		char const* aSourcePath
@@ -110,11 +118,14 @@ void ShaderProgram::reload()
 	glLinkProgram( prog );
 
 	{
+		alignas(std::max_align_t) std::byte scratchBuffer[kScratchBytes_];
+		FrameArena scratch( scratchBuffer, sizeof(scratchBuffer) );
+
 		// Get info log
 		GLint logLength = 0;
 		glGetProgramiv( prog, GL_INFO_LOG_LENGTH, &logLength );
 
-		std::vector<GLchar> log;
+		std::pmr::vector<GLchar> log( &scratch );
 		if( logLength )
 		{
 			log.resize( logLength );
@@ -142,39 +153,8 @@ namespace
 {
 	GLuint load_shader_( GLenum aShaderType, char const* aSourcePath )
 	{
-		// Load the shader source code from file
-		std::vector<GLchar> source;
-
-		if( std::FILE* fin = std::fopen( aSourcePath, "rb" ) )
-		{
-			auto const scopeFile_ = scope_exit_( [&fin] {
-				std::fclose( fin );
-			} );
-
-			std::fseek( fin, 0, SEEK_END );
-			auto const length = std::size_t(std::ftell( fin ));
-			std::fseek( fin, 0, SEEK_SET );
-
-			source.resize( length );
-			for( std::size_t read = 0; read != length; )
-			{
-				auto const ret = std::fread( source.data()+read, 1, length-read, fin );
-
-				if( 0 == ret )
-				{
-					if( auto const err = std::ferror( fin ) )
-						throw Error( "load_shader_(): error while reading from '%s': %d (%zu bytes read, %zu total)", aSourcePath, err, read, length );
-					if( std::feof( fin ) )
-						throw Error( "load_shader_(): unexpected EOF in '%s' (%zu bytes read, %zu total)", aSourcePath, read, length );
-				}
-			
-				read += ret;
-			}
-		}
-		else
-		{
-			throw Error( "load_shader_(): unable to open input file '%s'", aSourcePath );
-		}
+		// The source is passed to GL straight from the mapped file (or archive).
+		auto const source = open_asset( aSourcePath );
 
 		// Create shader object
 		OGL_CHECKPOINT_ALWAYS();
@@ -183,7 +163,7 @@ namespace
 
 		// Compile shader
 		GLchar const* sources[] = {
-			source.data()
+			source.empty() ? "" : reinterpret_cast<GLchar const*>(source.data())
 		};
 		GLsizei lengths[] = {
 			GLsizei(source.size())
@@ -203,7 +183,10 @@ namespace
 		GLint logLength = 0;
 		glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logLength );
 
-		std::vector<GLchar> log;
+		alignas(std::max_align_t) std::byte scratchBuffer[kScratchBytes_];
+		FrameArena scratch( scratchBuffer, sizeof(scratchBuffer) );
+
+		std::pmr::vector<GLchar> log( &scratch );
 		if( logLength )
 		{
 			log.resize( logLength );
@@ -0,0 +1,56 @@
+#include "srgb.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+#include <cstddef>
+
+float srgb_to_linear( std::uint8_t aValue ) noexcept
+{
+	static float const* const lut = [] {
+		static float table[256];
+		for( std::size_t i = 0; i < 256; ++i )
+		{
+			float const c = i / 255.f;
+			table[i] = c <= 0.04045f ? c / 12.92f : std::pow( (c + 0.055f) / 1.055f, 2.4f );
+		}
+		return table;
+	}();
+
+	return lut[aValue];
+}
+
+std::uint8_t linear_to_srgb( float aValue ) noexcept
+{
+	float const c = std::clamp( aValue, 0.f, 1.f );
+	float const s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow( c, 1.f/2.4f ) - 0.055f;
+	return std::uint8_t(s * 255.f + 0.5f);
+}
+
+void downsample_linear_rgba( float const* aImage, std::uint32_t aWidth, std::uint32_t aHeight, std::vector<float>& aOut )
+{
+	assert( aWidth > 0 && aHeight > 0 );
+
+	std::uint32_t const nw = std::max( 1u, aWidth/2 ), nh = std::max( 1u, aHeight/2 );
+
+	aOut.resize( std::size_t(nw)*nh*4 );
+	for( std::uint32_t y = 0; y < nh; ++y )
+	{
+		for( std::uint32_t x = 0; x < nw; ++x )
+		{
+			auto const x0 = std::min( 2*x, aWidth-1 ), x1 = std::min( 2*x+1, aWidth-1 );
+			auto const y0 = std::min( 2*y, aHeight-1 ), y1 = std::min( 2*y+1, aHeight-1 );
+
+			for( std::size_t c = 0; c < 4; ++c )
+			{
+				aOut[(std::size_t(y)*nw+x)*4+c] = 0.25f * (
+					aImage[(std::size_t(y0)*aWidth+x0)*4+c] +
+					aImage[(std::size_t(y0)*aWidth+x1)*4+c] +
+					aImage[(std::size_t(y1)*aWidth+x0)*4+c] +
+					aImage[(std::size_t(y1)*aWidth+x1)*4+c]
+				);
+			}
+		}
+	}
+}
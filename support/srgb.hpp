@@ -0,0 +1,27 @@
+#ifndef SRGB_HPP_5B0E61D2_8C3A_4F07_A2D9_3E71C4B86F15
+#define SRGB_HPP_5B0E61D2_8C3A_4F07_A2D9_3E71C4B86F15
+
+#include <vector>
+
+#include <cstdint>
+
+/* sRGB conversions and mip filtering
+ *
+ * Mip levels of sRGB textures are filtered in linear space; averaging the
+ * encoded values would darken them. Images are RGBA, with alpha stored
+ * linearly in both representations.
+ */
+
+// Exact (table lookup)
+float srgb_to_linear( std::uint8_t aValue ) noexcept;
+
+// Clamps to [0,1] and rounds to nearest
+std::uint8_t linear_to_srgb( float aValue ) noexcept;
+
+// Next mip level of an aWidth×aHeight linear RGBA image: max(1,aWidth/2) ×
+// max(1,aHeight/2) texels, each the mean of a 2×2 box. Where the image is a
+// single texel wide or high, the box repeats that column or row. Odd sizes
+// drop the last column/row.
+void downsample_linear_rgba( float const* aImage, std::uint32_t aWidth, std::uint32_t aHeight, std::vector<float>& aOut );
+
+#endif // SRGB_HPP_5B0E61D2_8C3A_4F07_A2D9_3E71C4B86F15
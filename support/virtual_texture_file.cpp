@@ -0,0 +1,382 @@
+#include "virtual_texture_file.hpp"
+
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#include "srgb.hpp"
+#include "error.hpp"
+#include "lz_block.hpp"
+
+#include "../jobs/job_system.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kTextureMagic_ = 0x56325743; // "CW2V"
+	constexpr std::uint32_t kTextureVersion_ = 1;
+
+	struct Header_
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t width, height;
+		std::uint32_t tileSize, border;
+		std::uint32_t levelCount;
+		std::uint32_t reserved;
+		std::uint64_t tileCount;
+		std::uint64_t sourceSize;
+		std::int64_t sourceTime;
+	};
+
+	static_assert( sizeof(Header_) == 56 );
+	static_assert( sizeof(VirtualTextureFile::Level) == 24 );
+	static_assert( sizeof(VirtualTextureFile::Tile) == 16 );
+
+	using Compression_ = VirtualTextureFile::Compression;
+
+	// Level geometry for a given size (see VirtualTextureFile)
+	std::vector<VirtualTextureFile::Level> levels_( std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aTileSize )
+	{
+		std::vector<VirtualTextureFile::Level> levels;
+
+		std::uint32_t w = aWidth, h = aHeight, first = 0;
+		while( true )
+		{
+			VirtualTextureFile::Level level{};
+			level.width = w;
+			level.height = h;
+			level.tilesX = (w + aTileSize-1) / aTileSize;
+			level.tilesY = (h + aTileSize-1) / aTileSize;
+			level.firstTile = first;
+			levels.emplace_back( level );
+
+			if( 1 == level.tilesX && 1 == level.tilesY )
+				break;
+
+			first += level.tilesX * level.tilesY;
+			w = (w+1) / 2;
+			h = (h+1) / 2;
+		}
+
+		return levels;
+	}
+
+	// 2×2 box filter; odd sizes repeat the last row/column.
+	void downsample_( std::uint8_t const* aIn, std::uint32_t aWidth, std::uint32_t aHeight, std::uint8_t* aOut, JobSystem& aJobs )
+	{
+		std::uint32_t const nw = (aWidth+1) / 2, nh = (aHeight+1) / 2;
+
+		aJobs.parallel_for( nh, 16, [&] (std::size_t aBegin, std::size_t aEnd) {
+			for( auto y = std::uint32_t(aBegin); y < aEnd; ++y )
+			{
+				auto const y0 = 2*y, y1 = std::min( 2*y+1, aHeight-1 );
+				for( std::uint32_t x = 0; x < nw; ++x )
+				{
+					auto const x0 = 2*x, x1 = std::min( 2*x+1, aWidth-1 );
+
+					std::uint8_t const* texels[4] = {
+						aIn + (std::size_t(y0)*aWidth + x0)*4,
+						aIn + (std::size_t(y0)*aWidth + x1)*4,
+						aIn + (std::size_t(y1)*aWidth + x0)*4,
+						aIn + (std::size_t(y1)*aWidth + x1)*4
+					};
+
+					std::uint8_t* out = aOut + (std::size_t(y)*nw + x)*4;
+					for( std::size_t c = 0; c < 3; ++c )
+					{
+						float const sum = srgb_to_linear( texels[0][c] ) + srgb_to_linear( texels[1][c] ) + srgb_to_linear( texels[2][c] ) + srgb_to_linear( texels[3][c] );
+						out[c] = linear_to_srgb( 0.25f * sum );
+					}
+
+					unsigned const alpha = unsigned(texels[0][3]) + texels[1][3] + texels[2][3] + texels[3][3];
+					out[3] = std::uint8_t((alpha + 2) / 4);
+				}
+			}
+		} );
+	}
+
+	// Page of tile (aTileX, aTileY), including its border
+	void extract_page_( std::uint8_t const* aLevel, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aTileX, std::uint32_t aTileY, std::uint32_t aTileSize, std::uint32_t aBorder, std::uint8_t* aOut ) noexcept
+	{
+		std::uint32_t const page = aTileSize + 2*aBorder;
+
+		auto const wrap = [] (std::int64_t aValue, std::uint32_t aSize) {
+			auto const r = aValue % std::int64_t(aSize);
+			return std::uint32_t(r < 0 ? r + aSize : r);
+		};
+
+		for( std::uint32_t y = 0; y < page; ++y )
+		{
+			auto const sy = wrap( std::int64_t(aTileY)*aTileSize + y - aBorder, aHeight );
+			for( std::uint32_t x = 0; x < page; ++x )
+			{
+				auto const sx = wrap( std::int64_t(aTileX)*aTileSize + x - aBorder, aWidth );
+				std::memcpy( aOut + (std::size_t(y)*page + x)*4, aLevel + (std::size_t(sy)*aWidth + sx)*4, 4 );
+			}
+		}
+	}
+}
+
+// VirtualTextureFile
+VirtualTextureFile::VirtualTextureFile( char const* aPath )
+	: mFile( open_asset( aPath, FileMapping::Access::random ) )
+	, mPath( aPath )
+	, mLevels( nullptr )
+	, mLevelCount( 0 )
+	, mTiles( nullptr )
+	, mTileCount( 0 )
+{
+	if( mFile.size() < sizeof(Header_) )
+		throw Error( "Virtual texture '%s' is truncated", aPath );
+
+	Header_ header;
+	std::memcpy( &header, mFile.data(), sizeof(header) );
+
+	if( kTextureMagic_ != header.magic || kTextureVersion_ != header.version )
+		throw Error( "'%s' is not a virtual texture (or has the wrong version)", aPath );
+
+	if( 0 == header.width || 0 == header.height || 0 == header.tileSize || header.border > header.tileSize || 0 == header.levelCount || header.levelCount > kMaxLevels )
+		throw Error( "Virtual texture '%s' has an invalid header", aPath );
+
+	// The level table must match the geometry implied by the header.
+	auto const expected = levels_( header.width, header.height, header.tileSize );
+	auto const tableEnd = sizeof(Header_) + expected.size()*sizeof(Level) + header.tileCount*sizeof(Tile);
+	if( expected.size() != header.levelCount || header.tileCount > mFile.size() / sizeof(Tile) || tableEnd > mFile.size() )
+		throw Error( "Virtual texture '%s': tables out of bounds", aPath );
+
+	mLevels = reinterpret_cast<Level const*>(mFile.data() + sizeof(Header_));
+	mLevelCount = header.levelCount;
+
+	for( std::uint32_t i = 0; i < mLevelCount; ++i )
+	{
+		if( 0 != std::memcmp( &expected[i], &mLevels[i], offsetof( Level, reserved ) ) )
+			throw Error( "Virtual texture '%s': level %u is invalid", aPath, i );
+	}
+
+	auto const& last = expected.back();
+	if( std::uint64_t(last.firstTile) + 1 != header.tileCount )
+		throw Error( "Virtual texture '%s': wrong tile count", aPath );
+
+	mTiles = reinterpret_cast<Tile const*>(mFile.data() + sizeof(Header_) + mLevelCount*sizeof(Level));
+	mTileCount = std::size_t(header.tileCount);
+
+	mWidth = header.width;
+	mHeight = header.height;
+	mTileSize = header.tileSize;
+	mBorder = header.border;
+	mSourceSize = header.sourceSize;
+	mSourceTime = header.sourceTime;
+
+	for( std::size_t i = 0; i < mTileCount; ++i )
+	{
+		auto const& tile = mTiles[i];
+
+		bool const valid = tile.offset <= mFile.size() && tile.storedSize <= mFile.size() - tile.offset
+			&& (Compression_::lz == tile.compression || (Compression_::none == tile.compression && tile.storedSize == page_bytes()))
+		;
+
+		if( !valid )
+			throw Error( "Virtual texture '%s': tile %zu is invalid", aPath, i );
+	}
+}
+
+std::uint32_t VirtualTextureFile::width() const noexcept
+{
+	return mWidth;
+}
+std::uint32_t VirtualTextureFile::height() const noexcept
+{
+	return mHeight;
+}
+
+std::uint32_t VirtualTextureFile::tile_size() const noexcept
+{
+	return mTileSize;
+}
+std::uint32_t VirtualTextureFile::border() const noexcept
+{
+	return mBorder;
+}
+std::uint32_t VirtualTextureFile::page_size() const noexcept
+{
+	return mTileSize + 2*mBorder;
+}
+std::size_t VirtualTextureFile::page_bytes() const noexcept
+{
+	return std::size_t(page_size()) * page_size() * 4;
+}
+
+std::uint32_t VirtualTextureFile::level_count() const noexcept
+{
+	return mLevelCount;
+}
+VirtualTextureFile::Level const& VirtualTextureFile::level( std::uint32_t aLevel ) const noexcept
+{
+	assert( aLevel < mLevelCount );
+	return mLevels[aLevel];
+}
+
+std::size_t VirtualTextureFile::tile_count() const noexcept
+{
+	return mTileCount;
+}
+std::size_t VirtualTextureFile::tile_index( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY ) const noexcept
+{
+	auto const& level = this->level( aLevel );
+	assert( aX < level.tilesX && aY < level.tilesY );
+	return level.firstTile + std::size_t(aY)*level.tilesX + aX;
+}
+
+std::uint64_t VirtualTextureFile::source_size() const noexcept
+{
+	return mSourceSize;
+}
+std::int64_t VirtualTextureFile::source_time() const noexcept
+{
+	return mSourceTime;
+}
+
+void VirtualTextureFile::read_tile( std::size_t aTile, std::uint8_t* aOut ) const
+{
+	assert( aTile < mTileCount );
+	auto const& tile = mTiles[aTile];
+
+	std::uint8_t const* stored = mFile.data() + tile.offset;
+	if( Compression_::none == tile.compression )
+	{
+		std::memcpy( aOut, stored, page_bytes() );
+		return;
+	}
+
+	if( !lz_decompress( stored, tile.storedSize, aOut, page_bytes() ) )
+		throw Error( "Virtual texture '%s': tile %zu is corrupt", mPath.c_str(), aTile );
+}
+
+// Free functions
+VirtualTextureStats write_virtual_texture( char const* aPath, VirtualTextureSource const& aSource, std::uint32_t aTileSize, std::uint32_t aBorder, JobSystem& aJobs )
+{
+	assert( aSource.rgba );
+
+	if( 0 == aSource.width || 0 == aSource.height )
+		throw Error( "write_virtual_texture(): empty source" );
+	if( 0 == aTileSize || aBorder > aTileSize )
+		throw Error( "write_virtual_texture(): invalid tile size %u (border %u)", aTileSize, aBorder );
+
+	auto levels = levels_( aSource.width, aSource.height, aTileSize );
+	if( levels.size() > VirtualTextureFile::kMaxLevels )
+		throw Error( "write_virtual_texture(): %ux%u needs %zu levels with %u texel tiles (%u max.)", aSource.width, aSource.height, levels.size(), aTileSize, VirtualTextureFile::kMaxLevels );
+
+	std::size_t const tileCount = levels.back().firstTile + 1;
+	std::uint32_t const page = aTileSize + 2*aBorder;
+	std::size_t const pageBytes = std::size_t(page) * page * 4;
+
+	Header_ header{};
+	header.magic = kTextureMagic_;
+	header.version = kTextureVersion_;
+	header.width = aSource.width;
+	header.height = aSource.height;
+	header.tileSize = aTileSize;
+	header.border = aBorder;
+	header.levelCount = std::uint32_t(levels.size());
+	header.tileCount = tileCount;
+	header.sourceSize = aSource.sourceSize;
+	header.sourceTime = aSource.sourceTime;
+
+	std::FILE* out = std::fopen( aPath, "wb" );
+	if( !out )
+		throw Error( "write_virtual_texture(): unable to open '%s' for writing", aPath );
+
+	// The tile table is written last, once the offsets are known.
+	std::vector<VirtualTextureFile::Tile> tiles( tileCount );
+	std::uint64_t const tableOffset = sizeof(Header_) + levels.size()*sizeof(VirtualTextureFile::Level);
+
+	bool ok = 1 == std::fwrite( &header, sizeof(header), 1, out )
+		&& levels.size() == std::fwrite( levels.data(), sizeof(VirtualTextureFile::Level), levels.size(), out )
+		&& tiles.size() == std::fwrite( tiles.data(), sizeof(VirtualTextureFile::Tile), tiles.size(), out )
+	;
+
+	VirtualTextureStats stats{};
+	stats.levels = header.levelCount;
+	stats.tiles = tileCount;
+
+	// One row of tiles at a time: pages, then their compressed form
+	std::size_t const maxTilesX = levels.front().tilesX;
+	std::vector<std::uint8_t> pages( maxTilesX * pageBytes );
+	std::vector<std::uint8_t> compressed( maxTilesX * lz_compress_bound( pageBytes ) );
+	std::vector<std::size_t> compressedBytes( maxTilesX );
+
+	std::uint8_t const* texels = aSource.rgba;
+	std::vector<std::uint8_t> current, next;
+
+	std::uint64_t written = tableOffset + tiles.size()*sizeof(VirtualTextureFile::Tile);
+	for( std::size_t l = 0; l < levels.size() && ok; ++l )
+	{
+		auto const& level = levels[l];
+
+		for( std::uint32_t ty = 0; ty < level.tilesY && ok; ++ty )
+		{
+			aJobs.parallel_for( level.tilesX, 1, [&] (std::size_t aBegin, std::size_t aEnd) {
+				for( std::size_t tx = aBegin; tx < aEnd; ++tx )
+				{
+					std::uint8_t* pageData = pages.data() + tx*pageBytes;
+					extract_page_( texels, level.width, level.height, std::uint32_t(tx), ty, aTileSize, aBorder, pageData );
+
+					std::size_t const bound = lz_compress_bound( pageBytes );
+					auto const bytes = lz_compress( pageData, pageBytes, compressed.data() + tx*bound, bound );
+					compressedBytes[tx] = (0 != bytes && double(bytes) <= (1.0 - VirtualTextureFile::kMinSaving) * double(pageBytes)) ? bytes : 0;
+				}
+			} );
+
+			for( std::uint32_t tx = 0; tx < level.tilesX && ok; ++tx )
+			{
+				auto& tile = tiles[level.firstTile + std::size_t(ty)*level.tilesX + tx];
+				tile.offset = written;
+
+				std::uint8_t const* data;
+				if( 0 != compressedBytes[tx] )
+				{
+					tile.storedSize = std::uint32_t(compressedBytes[tx]);
+					tile.compression = Compression_::lz;
+					data = compressed.data() + tx*lz_compress_bound( pageBytes );
+					++stats.compressed;
+				}
+				else
+				{
+					tile.storedSize = std::uint32_t(pageBytes);
+					tile.compression = Compression_::none;
+					data = pages.data() + tx*pageBytes;
+				}
+
+				ok = tile.storedSize == std::fwrite( data, 1, tile.storedSize, out );
+				written += tile.storedSize;
+			}
+		}
+
+		if( l+1 < levels.size() )
+		{
+			auto const& coarser = levels[l+1];
+			next.resize( std::size_t(coarser.width) * coarser.height * 4 );
+			downsample_( texels, level.width, level.height, next.data(), aJobs );
+
+			std::swap( current, next );
+			texels = current.data();
+		}
+	}
+
+	ok = ok && 0 == std::fseek( out, long(tableOffset), SEEK_SET );
+	ok = ok && tiles.size() == std::fwrite( tiles.data(), sizeof(VirtualTextureFile::Tile), tiles.size(), out );
+	ok = (0 == std::fclose( out )) && ok;
+
+	if( !ok )
+	{
+		std::remove( aPath );
+		throw Error( "write_virtual_texture(): error while writing '%s'", aPath );
+	}
+
+	stats.fileBytes = written;
+	return stats;
+}
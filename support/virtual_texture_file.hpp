@@ -0,0 +1,138 @@
+#ifndef VIRTUAL_TEXTURE_FILE_HPP_3F0B8C52_7D1A_4E86_9A27_C51B2E9D60F4
+#define VIRTUAL_TEXTURE_FILE_HPP_3F0B8C52_7D1A_4E86_9A27_C51B2E9D60F4
+
+#include <string>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "asset_store.hpp"
+
+class JobSystem;
+
+/* Tiled virtual texture file
+ *
+ * A texture that is too large to upload as a whole, split into square tiles
+ * for each level of its mip chain:
+ *
+ *   header | level table | tile table | tile data
+ *
+ * Level L has ceil(width / 2^L) x ceil(height / 2^L) texels; texel j of
+ * level L+1 is the average (in linear space, the texels are sRGB) of texels
+ * 2j and 2j+1 of level L. Unlike a GL mip chain, odd sizes round up, so
+ * that tile (x,y) of level L+1 always covers tiles (2x..2x+1, 2y..2y+1) of
+ * level L. The last level is the first one that fits into a single tile.
+ *
+ * Each tile is stored as a page of page_size() x page_size() RGBA8 texels:
+ * the tile_size() x tile_size() texels of the tile, plus a border() texel
+ * wide frame copied from the neighbouring tiles (wrapping around at the
+ * edges of the level, like GL_REPEAT), so that pages can be bilinearly
+ * filtered independently of each other. Tiles are compressed with
+ * lz_block.hpp where that saves at least kMinSaving, and stored as-is
+ * otherwise.
+ *
+ * Rows are stored in the order given to write_virtual_texture(); callers
+ * pass images flipped to GL's orientation (first row at the bottom).
+ *
+ * The file is read through open_asset(), i.e., from the mounted asset
+ * archive or a memory mapping. All integers are little-endian.
+ */
+class VirtualTextureFile final
+{
+	public:
+		static constexpr std::uint32_t kMaxLevels = 16;
+		static constexpr double kMinSaving = 0.1;
+
+		enum class Compression : std::uint32_t
+		{
+			none = 0,
+			lz = 1
+		};
+
+		struct Level
+		{
+			std::uint32_t width, height;   // texels
+			std::uint32_t tilesX, tilesY;
+			std::uint32_t firstTile;       // index of tile (0,0)
+			std::uint32_t reserved;
+		};
+
+		struct Tile
+		{
+			std::uint64_t offset;      // of the stored page, from the start of the file
+			std::uint32_t storedSize;
+			Compression compression;
+		};
+
+	public:
+		// Throws Error if the file cannot be opened or its tables are
+		// invalid (tile data is checked by read_tile()).
+		explicit VirtualTextureFile( char const* aPath );
+
+		VirtualTextureFile( VirtualTextureFile const& ) = delete;
+		VirtualTextureFile& operator= (VirtualTextureFile const&) = delete;
+
+	public:
+		std::uint32_t width() const noexcept;
+		std::uint32_t height() const noexcept;
+
+		std::uint32_t tile_size() const noexcept;
+		std::uint32_t border() const noexcept;
+		std::uint32_t page_size() const noexcept; // tile_size() + 2*border()
+		std::size_t page_bytes() const noexcept;
+
+		std::uint32_t level_count() const noexcept;
+		Level const& level( std::uint32_t ) const noexcept;
+
+		std::size_t tile_count() const noexcept; // all levels
+		std::size_t tile_index( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY ) const noexcept;
+
+		// Source size and modification time, as passed to the writer
+		std::uint64_t source_size() const noexcept;
+		std::int64_t source_time() const noexcept;
+
+		// Decompress the page of a tile into aOut (page_bytes()). Thread
+		// safe. Throws Error for corrupt data.
+		void read_tile( std::size_t aTile, std::uint8_t* aOut ) const;
+
+	private:
+		AssetData mFile;
+		std::string mPath;
+
+		std::uint32_t mWidth, mHeight;
+		std::uint32_t mTileSize, mBorder;
+		std::uint64_t mSourceSize;
+		std::int64_t mSourceTime;
+
+		Level const* mLevels;
+		std::uint32_t mLevelCount;
+
+		Tile const* mTiles;
+		std::size_t mTileCount;
+};
+
+struct VirtualTextureSource
+{
+	std::uint8_t const* rgba; // width*height texels
+	std::uint32_t width, height;
+
+	// Recorded in the file, for staleness checks
+	std::uint64_t sourceSize;
+	std::int64_t sourceTime;
+};
+
+struct VirtualTextureStats
+{
+	std::uint32_t levels;
+	std::size_t tiles;
+	std::size_t compressed; // tiles stored compressed
+	std::uint64_t fileBytes;
+};
+
+// Tile aSource into aPath. Levels are downsampled and tiles compressed in
+// parallel on aJobs. Besides the source, only the next level and one row of
+// tiles are held in memory. Throws Error on I/O errors or invalid
+// parameters.
+VirtualTextureStats write_virtual_texture( char const* aPath, VirtualTextureSource const& aSource, std::uint32_t aTileSize, std::uint32_t aBorder, JobSystem& aJobs );
+
+#endif // VIRTUAL_TEXTURE_FILE_HPP_3F0B8C52_7D1A_4E86_9A27_C51B2E9D60F4
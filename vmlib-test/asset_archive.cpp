@@ -0,0 +1,193 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+
+#include "../support/lz_block.hpp"
+#include "../support/asset_store.hpp"
+#include "../support/asset_archive.hpp"
+
+#include "../jobs/job_system.hpp"
+
+namespace
+{
+    std::vector<std::uint8_t> round_trip(std::vector<std::uint8_t> const& input)
+    {
+        std::vector<std::uint8_t> packed(lz_compress_bound(input.size()));
+        std::size_t const bytes = lz_compress(input.data(), input.size(), packed.data(), packed.size());
+        REQUIRE(0 != bytes);
+
+        std::vector<std::uint8_t> output(input.size());
+        REQUIRE(lz_decompress(packed.data(), bytes, output.data(), output.size()));
+        return output;
+    }
+
+    void write_file(std::filesystem::path const& path, std::string const& contents)
+    {
+        std::FILE* fof = std::fopen(path.string().c_str(), "wb");
+        REQUIRE(fof);
+        REQUIRE(contents.size() == std::fwrite(contents.data(), 1, contents.size(), fof));
+        std::fclose(fof);
+    }
+}
+
+TEST_CASE("LZ blocks round-trip", "[asset_archive]")
+{
+    SECTION("empty and tiny inputs")
+    {
+        for (std::size_t size : { 0, 1, 5, 12, 13 })
+        {
+            std::vector<std::uint8_t> input(size, 'x');
+            REQUIRE(round_trip(input) == input);
+        }
+    }
+
+    SECTION("repetitive input shrinks")
+    {
+        std::string text;
+        while (text.size() < 100000)
+            text += "vec3 n = normalize( v2fNormal ); // repeated line\n";
+
+        std::vector<std::uint8_t> const input(text.begin(), text.end());
+        std::vector<std::uint8_t> packed(lz_compress_bound(input.size()));
+        std::size_t const bytes = lz_compress(input.data(), input.size(), packed.data(), packed.size());
+        REQUIRE(0 != bytes);
+        REQUIRE(bytes < input.size() / 10);
+
+        REQUIRE(round_trip(input) == input);
+    }
+
+    SECTION("random input stays within the bound")
+    {
+        std::mt19937 rng(1234);
+        std::vector<std::uint8_t> input(70000);
+        for (auto& byte : input)
+            byte = std::uint8_t(rng());
+
+        REQUIRE(round_trip(input) == input);
+    }
+
+    SECTION("too small output buffer")
+    {
+        std::vector<std::uint8_t> input(1000, 7);
+        input[500] = 1;
+        std::uint8_t packed[4];
+        REQUIRE(0 == lz_compress(input.data(), input.size(), packed, sizeof(packed)));
+    }
+}
+
+TEST_CASE("LZ decompression rejects corrupt input", "[asset_archive]")
+{
+    std::string text;
+    while (text.size() < 4000)
+        text += "abcdefgh" + std::to_string(text.size() % 97);
+
+    std::vector<std::uint8_t> const input(text.begin(), text.end());
+    std::vector<std::uint8_t> packed(lz_compress_bound(input.size()));
+    std::size_t const bytes = lz_compress(input.data(), input.size(), packed.data(), packed.size());
+    REQUIRE(0 != bytes);
+
+    std::vector<std::uint8_t> output(input.size());
+
+    // Wrong sizes
+    REQUIRE_FALSE(lz_decompress(packed.data(), bytes - 1, output.data(), output.size()));
+    REQUIRE_FALSE(lz_decompress(packed.data(), bytes, output.data(), output.size() - 1));
+
+    // Match offset before the start of the output
+    std::uint8_t const badOffset[] = { 0x10, 'a', 0xff, 0x00, 0x00 };
+    REQUIRE_FALSE(lz_decompress(badOffset, sizeof(badOffset), output.data(), output.size()));
+
+    // Flipped bytes must never write out of bounds (and usually fail).
+    for (std::size_t i = 0; i < bytes; i += 7)
+    {
+        auto corrupt = packed;
+        corrupt[i] ^= 0x5a;
+        lz_decompress(corrupt.data(), bytes, output.data(), output.size());
+    }
+}
+
+TEST_CASE("Asset archives round-trip through the asset store", "[asset_archive]")
+{
+    namespace fs = std::filesystem;
+    fs::path const dir = fs::temp_directory_path() / "vmlib-test-asset-archive";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "sub");
+
+    std::string compressible;
+    while (compressible.size() < 20000)
+        compressible += "uniform mat4 uProjCameraWorld;\n";
+
+    std::string incompressible(3000, '\0');
+    std::mt19937 rng(42);
+    for (auto& c : incompressible)
+        c = char(rng());
+
+    write_file(dir / "a.txt", compressible);
+    write_file(dir / "sub" / "b.bin", incompressible);
+    write_file(dir / "empty", "");
+
+    auto const path = [&dir](char const* name) { return (dir / name).generic_string(); };
+    auto const archivePath = dir / "test.pak";
+
+    JobSystem jobs(2);
+    auto const stats = write_asset_archive(archivePath.string().c_str(), { path("a.txt"), path("sub/b.bin"), path("empty") }, jobs);
+    REQUIRE(3 == stats.entries);
+    REQUIRE(1 == stats.compressed);
+    REQUIRE(stats.fileBytes == fs::file_size(archivePath));
+
+    SECTION("lookup and extraction")
+    {
+        AssetArchive const archive(archivePath.string().c_str());
+        REQUIRE(3 == archive.entry_count());
+
+        auto const a = archive.find(path("a.txt"));
+        REQUIRE(a);
+        REQUIRE(AssetArchive::Compression::lz == archive.entry(*a).compression);
+
+        // Lookups normalize the path.
+        auto const b = archive.find((dir / "sub" / ".." / "sub" / "b.bin").string());
+        REQUIRE(b);
+        REQUIRE(AssetArchive::Compression::none == archive.entry(*b).compression);
+
+        REQUIRE_FALSE(archive.find(path("missing")));
+
+        std::string out(compressible.size(), '\0');
+        archive.extract(*a, reinterpret_cast<std::uint8_t*>(out.data()));
+        REQUIRE(out == compressible);
+    }
+
+    SECTION("mounted archives take precedence over loose files")
+    {
+        auto const mount = mount_asset_archive(archivePath.string().c_str(), jobs);
+        REQUIRE(3 == mount.entries);
+        REQUIRE(1 == mount.unpacked);
+
+        write_file(dir / "a.txt", "changed");
+        write_file(dir / "loose.txt", "loose");
+
+        REQUIRE(asset_in_archive(path("a.txt")));
+        REQUIRE(open_asset(path("a.txt").c_str()).text() == compressible);
+        REQUIRE(open_asset(path("sub/b.bin").c_str()).text() == incompressible);
+        REQUIRE(open_asset(path("empty").c_str()).empty());
+
+        REQUIRE_FALSE(asset_in_archive(path("loose.txt")));
+        REQUIRE(open_asset(path("loose.txt").c_str()).text() == "loose");
+
+        unmount_asset_archive();
+        REQUIRE_FALSE(asset_archive_mounted());
+        REQUIRE(open_asset(path("a.txt").c_str()).text() == "changed");
+    }
+
+    SECTION("corrupt archives are rejected")
+    {
+        write_file(dir / "bad.pak", "not an archive, but long enough for a header");
+        REQUIRE_THROWS(AssetArchive((dir / "bad.pak").string().c_str()));
+        REQUIRE_THROWS(write_asset_archive(archivePath.string().c_str(), { path("a.txt"), path("a.txt") }, jobs));
+    }
+
+    fs::remove_all(dir);
+}
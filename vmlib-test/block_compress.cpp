@@ -0,0 +1,372 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+
+#include "../support/srgb.hpp"
+#include "../support/block_compress.hpp"
+
+namespace
+{
+    using Block = std::array<std::uint8_t, 16 * 4>;
+
+    void unpack_565(std::uint16_t c, int out[3])
+    {
+        int const r = (c >> 11) & 31;
+        int const g = (c >> 5) & 63;
+        int const b = c & 31;
+        out[0] = (r << 3) | (r >> 2);
+        out[1] = (g << 2) | (g >> 4);
+        out[2] = (b << 3) | (b >> 2);
+    }
+
+    // Reference decoder for the 8-byte colour part; BC3 always uses the
+    // four-colour mode.
+    void decode_color(std::uint8_t const* in, bool fourColor, Block& out)
+    {
+        auto const c0 = std::uint16_t(in[0] | (in[1] << 8));
+        auto const c1 = std::uint16_t(in[2] | (in[3] << 8));
+
+        int palette[4][3];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            if (fourColor || c0 > c1)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+
+        std::uint32_t const indices = in[4] | (in[5] << 8) | (in[6] << 16) | (std::uint32_t(in[7]) << 24);
+        for (std::size_t i = 0; i < 16; ++i)
+        {
+            auto const index = (indices >> (2 * i)) & 3;
+            for (int c = 0; c < 3; ++c)
+                out[i * 4 + c] = std::uint8_t(palette[index][c]);
+        }
+    }
+
+    void decode_alpha(std::uint8_t const* in, Block& out)
+    {
+        int const a0 = in[0], a1 = in[1];
+
+        int palette[8] = { a0, a1 };
+        if (a0 > a1)
+        {
+            for (int j = 1; j < 7; ++j)
+                palette[1 + j] = ((7 - j) * a0 + j * a1) / 7;
+        }
+        else
+        {
+            for (int j = 1; j < 5; ++j)
+                palette[1 + j] = ((5 - j) * a0 + j * a1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        std::uint64_t indices = 0;
+        for (std::size_t i = 0; i < 6; ++i)
+            indices |= std::uint64_t(in[2 + i]) << (8 * i);
+        for (std::size_t i = 0; i < 16; ++i)
+            out[i * 4 + 3] = std::uint8_t(palette[(indices >> (3 * i)) & 7]);
+    }
+
+    Block decode_bc1(std::uint8_t const* in)
+    {
+        Block out{};
+        decode_color(in, false, out);
+        for (std::size_t i = 0; i < 16; ++i)
+            out[i * 4 + 3] = 255;
+        return out;
+    }
+
+    Block decode_bc3(std::uint8_t const* in)
+    {
+        Block out{};
+        decode_alpha(in, out);
+        decode_color(in + 8, true, out);
+        return out;
+    }
+
+    Block solid_block(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a)
+    {
+        Block block{};
+        for (std::size_t i = 0; i < 16; ++i)
+        {
+            block[i * 4 + 0] = r;
+            block[i * 4 + 1] = g;
+            block[i * 4 + 2] = b;
+            block[i * 4 + 3] = a;
+        }
+        return block;
+    }
+}
+
+TEST_CASE("BC1/BC3 encode solid colour blocks exactly", "[block_compress]")
+{
+    // Colours that are exactly representable in RGB565
+    std::uint8_t const colors[][3] = {
+        { 0, 0, 0 },
+        { 255, 255, 255 },
+        { 255, 0, 0 },
+        { 0, 255, 0 },
+        { 0, 0, 255 },
+        { 156, 182, 57 },
+    };
+
+    for (auto const& color : colors)
+    {
+        auto const block = solid_block(color[0], color[1], color[2], 255);
+
+        std::uint8_t bc1[kBC1BlockBytes];
+        encode_bc1_block(block.data(), bc1);
+        REQUIRE(decode_bc1(bc1) == block);
+
+        auto const translucent = solid_block(color[0], color[1], color[2], 77);
+
+        std::uint8_t bc3[kBC3BlockBytes];
+        encode_bc3_block(translucent.data(), bc3);
+        REQUIRE(decode_bc3(bc3) == translucent);
+    }
+}
+
+TEST_CASE("BC1 keeps two-colour blocks within one step of their endpoints", "[block_compress]")
+{
+    // One RGB565 step: 255/31 for red and blue, 255/63 for green
+    int const step[3] = { 8, 4, 8 };
+
+    std::uint8_t const pairs[][2][3] = {
+        { { 200, 30, 90 }, { 20, 180, 240 } },
+        { { 255, 255, 255 }, { 0, 0, 0 } },
+        { { 101, 100, 99 }, { 97, 102, 100 } },
+        { { 13, 250, 7 }, { 13, 249, 7 } },
+    };
+
+    for (auto const& pair : pairs)
+    {
+        // Checkerboard of the two colours
+        Block block{};
+        for (std::size_t i = 0; i < 16; ++i)
+        {
+            auto const& color = pair[((i & 3) + (i >> 2)) & 1];
+            for (int c = 0; c < 3; ++c)
+                block[i * 4 + c] = color[c];
+            block[i * 4 + 3] = 255;
+        }
+
+        std::uint8_t bc1[kBC1BlockBytes];
+        encode_bc1_block(block.data(), bc1);
+        auto const decoded = decode_bc1(bc1);
+
+        for (std::size_t i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                REQUIRE(std::abs(int(decoded[i * 4 + c]) - int(block[i * 4 + c])) <= step[c]);
+        }
+    }
+}
+
+TEST_CASE("BC3 preserves alpha endpoints of 0 and 255", "[block_compress]")
+{
+    auto block = solid_block(128, 64, 32, 0);
+    for (std::size_t i = 0; i < 16; ++i)
+        block[i * 4 + 3] = std::uint8_t(i % 3 == 0 ? 255 : (i % 3 == 1 ? 0 : 100));
+
+    std::uint8_t bc3[kBC3BlockBytes];
+    encode_bc3_block(block.data(), bc3);
+    auto const decoded = decode_bc3(bc3);
+
+    REQUIRE(255 == bc3[0]);
+    REQUIRE(0 == bc3[1]);
+    for (std::size_t i = 0; i < 16; ++i)
+    {
+        if (i % 3 == 2)
+            REQUIRE(std::abs(int(decoded[i * 4 + 3]) - 100) <= 255 / 14 + 1);
+        else
+            REQUIRE(decoded[i * 4 + 3] == block[i * 4 + 3]);
+    }
+
+    // Fully transparent and fully opaque blocks
+    for (int alpha : { 0, 255 })
+    {
+        auto const solid = solid_block(10, 20, 30, std::uint8_t(alpha));
+        encode_bc3_block(solid.data(), bc3);
+        auto const out = decode_bc3(bc3);
+        for (std::size_t i = 0; i < 16; ++i)
+            REQUIRE(alpha == out[i * 4 + 3]);
+    }
+}
+
+TEST_CASE("Blocks past non-multiple-of-4 edges repeat the last texel", "[block_compress]")
+{
+    // 5×3 image, distinct value for every texel
+    std::uint32_t const width = 5, height = 3;
+    std::vector<std::uint8_t> image(width * height * 4);
+    for (std::uint32_t y = 0; y < height; ++y)
+    {
+        for (std::uint32_t x = 0; x < width; ++x)
+        {
+            auto* texel = image.data() + (y * width + x) * 4;
+            texel[0] = std::uint8_t(x);
+            texel[1] = std::uint8_t(y);
+            texel[2] = 7;
+            texel[3] = 255;
+        }
+    }
+
+    auto const check = [&](std::uint32_t bx, std::uint32_t by) {
+        Block block{};
+        gather_rgba8_block(image.data(), width, height, bx, by, block.data());
+        for (std::uint32_t y = 0; y < 4; ++y)
+        {
+            for (std::uint32_t x = 0; x < 4; ++x)
+            {
+                REQUIRE(block[(y * 4 + x) * 4 + 0] == std::min(bx * 4 + x, width - 1));
+                REQUIRE(block[(y * 4 + x) * 4 + 1] == std::min(by * 4 + y, height - 1));
+                REQUIRE(block[(y * 4 + x) * 4 + 2] == 7);
+            }
+        }
+    };
+
+    check(0, 0);
+    check(1, 0);
+
+    // A 1×1 level fills the whole block
+    std::uint8_t const texel[4] = { 1, 2, 3, 4 };
+    Block block{};
+    gather_rgba8_block(texel, 1, 1, 0, 0, block.data());
+    REQUIRE(block == solid_block(1, 2, 3, 4));
+
+    // Edge blocks of a 6×6 image whose last two columns are solid encode
+    // exactly, i.e., the repeated texels do not disturb the endpoints.
+    std::vector<std::uint8_t> split(6 * 6 * 4);
+    for (std::size_t i = 0; i < 6 * 6; ++i)
+    {
+        bool const right = i % 6 >= 4;
+        split[i * 4 + 0] = right ? 255 : 0;
+        split[i * 4 + 1] = right ? 0 : 255;
+        split[i * 4 + 2] = 0;
+        split[i * 4 + 3] = 255;
+    }
+
+    for (std::uint32_t by = 0; by < 2; ++by)
+    {
+        gather_rgba8_block(split.data(), 6, 6, 1, by, block.data());
+
+        std::uint8_t bc1[kBC1BlockBytes];
+        encode_bc1_block(block.data(), bc1);
+        REQUIRE(decode_bc1(bc1) == solid_block(255, 0, 0, 255));
+    }
+}
+
+TEST_CASE("sRGB conversions round trip", "[srgb]")
+{
+    REQUIRE(0.f == srgb_to_linear(0));
+    REQUIRE(1.f == srgb_to_linear(255));
+
+    for (int i = 0; i < 256; ++i)
+        REQUIRE(i == linear_to_srgb(srgb_to_linear(std::uint8_t(i))));
+
+    // Out of range values clamp
+    REQUIRE(0 == linear_to_srgb(-1.f));
+    REQUIRE(255 == linear_to_srgb(2.f));
+}
+
+TEST_CASE("sRGB mip chains of 1×1 and non-square images", "[srgb]")
+{
+    // Linear RGBA: red is x/(w-1), green is y/(h-1), blue and alpha constant
+    auto const make_ramp = [](std::uint32_t w, std::uint32_t h) {
+        std::vector<float> image(std::size_t(w) * h * 4);
+        for (std::uint32_t y = 0; y < h; ++y)
+        {
+            for (std::uint32_t x = 0; x < w; ++x)
+            {
+                auto* texel = image.data() + (std::size_t(y) * w + x) * 4;
+                texel[0] = w > 1 ? float(x) / float(w - 1) : 0.f;
+                texel[1] = h > 1 ? float(y) / float(h - 1) : 0.f;
+                texel[2] = 0.25f;
+                texel[3] = 0.75f;
+            }
+        }
+        return image;
+    };
+
+    SECTION("1×1 stays 1×1")
+    {
+        std::vector<float> const image = { 0.1f, 0.2f, 0.3f, 0.4f };
+        std::vector<float> out;
+        downsample_linear_rgba(image.data(), 1, 1, out);
+        REQUIRE(out == image);
+    }
+
+    SECTION("non-square chains end at 1×1 with the image mean")
+    {
+        struct Chain { std::uint32_t w, h; std::vector<std::pair<std::uint32_t, std::uint32_t>> levels; };
+        Chain const chains[] = {
+            { 8, 2, { { 4, 1 }, { 2, 1 }, { 1, 1 } } },
+            { 2, 8, { { 1, 4 }, { 1, 2 }, { 1, 1 } } },
+            { 16, 1, { { 8, 1 }, { 4, 1 }, { 2, 1 }, { 1, 1 } } },
+        };
+
+        for (auto const& chain : chains)
+        {
+            auto image = make_ramp(chain.w, chain.h);
+            std::vector<float> next;
+
+            std::uint32_t w = chain.w, h = chain.h;
+            for (auto const& level : chain.levels)
+            {
+                downsample_linear_rgba(image.data(), w, h, next);
+                w = std::max(1u, w / 2);
+                h = std::max(1u, h / 2);
+                REQUIRE(level.first == w);
+                REQUIRE(level.second == h);
+                REQUIRE(next.size() == std::size_t(w) * h * 4);
+                image.swap(next);
+            }
+
+            REQUIRE(image[0] == Catch::Approx(chain.w > 1 ? 0.5f : 0.f));
+            REQUIRE(image[1] == Catch::Approx(chain.h > 1 ? 0.5f : 0.f));
+            REQUIRE(image[2] == Catch::Approx(0.25f));
+            REQUIRE(image[3] == Catch::Approx(0.75f));
+        }
+    }
+
+    SECTION("odd sizes average the 2×2 boxes they cover")
+    {
+        auto const image = make_ramp(5, 3);
+        std::vector<float> out;
+        downsample_linear_rgba(image.data(), 5, 3, out);
+
+        REQUIRE(out.size() == 2 * 1 * 4);
+        REQUIRE(out[0] == Catch::Approx(0.125f));  // x 0,1 of 0..4
+        REQUIRE(out[4] == Catch::Approx(0.625f));  // x 2,3
+        REQUIRE(out[1] == Catch::Approx(0.25f));   // y 0,1 of 0..2
+        REQUIRE(out[5] == Catch::Approx(0.25f));
+    }
+
+    SECTION("filtering happens in linear space")
+    {
+        // Black and white average to linear 0.5, i.e., sRGB 188 (not 128)
+        std::vector<float> const image = {
+            srgb_to_linear(0), srgb_to_linear(0), srgb_to_linear(0), 1.f,
+            srgb_to_linear(255), srgb_to_linear(255), srgb_to_linear(255), 1.f,
+        };
+        std::vector<float> out;
+        downsample_linear_rgba(image.data(), 2, 1, out);
+
+        REQUIRE(out.size() == 4);
+        REQUIRE(188 == linear_to_srgb(out[0]));
+    }
+}
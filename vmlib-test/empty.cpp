@@ -94,6 +94,25 @@ TEST_CASE("Mat22f special cases", "[mat22]")
     }
 }
 
+// ======== test Vec3 ============
+
+TEST_CASE("Vec3f cross product", "[vec3]")
+{
+    Vec3f x = { 1.f, 0.f, 0.f };
+    Vec3f y = { 0.f, 1.f, 0.f };
+    Vec3f z = cross(x, y);
+
+    REQUIRE(z.x == 0.f);
+    REQUIRE(z.y == 0.f);
+    REQUIRE(z.z == 1.f);
+
+    Vec3f a = { 1.f, 2.f, 3.f };
+    Vec3f b = { -2.f, 0.5f, 4.f };
+    Vec3f c = cross(a, b);
+    REQUIRE(dot(c, a) == Catch::Approx(0.f).margin(0.00001));
+    REQUIRE(dot(c, b) == Catch::Approx(0.f).margin(0.00001));
+}
+
 // ======== test Mat33 ============
 
 TEST_CASE("Mat33f operations", "[Mat33f]") {
@@ -270,6 +289,88 @@ TEST_CASE("Perspective projection matrix tests", "[mat44]")
     }
 }
 
+TEST_CASE("Orthographic projection matrix tests", "[mat44]")
+{
+    SECTION("Box corners map to the unit cube")
+    {
+        Mat44f proj = make_orthographic_projection(-2.f, 6.f, -1.f, 3.f, 1.f, 11.f);
+
+        Vec4f lo = proj * Vec4f{ -2.f, -1.f, -1.f, 1.f };
+        Vec4f hi = proj * Vec4f{ 6.f, 3.f, -11.f, 1.f };
+
+        REQUIRE(lo.x == Catch::Approx(-1.f));
+        REQUIRE(lo.y == Catch::Approx(-1.f));
+        REQUIRE(lo.z == Catch::Approx(-1.f));
+        REQUIRE(lo.w == 1.f);
+        REQUIRE(hi.x == Catch::Approx(1.f));
+        REQUIRE(hi.y == Catch::Approx(1.f));
+        REQUIRE(hi.z == Catch::Approx(1.f));
+        REQUIRE(hi.w == 1.f);
+    }
+}
+
+TEST_CASE("Reverse-Z projection matrix tests", "[mat44]")
+{
+    float const pi = 3.14159265359f;
+    float const fov = pi / 3.f;
+    float const aspect = 16.f / 9.f;
+    float const near = 0.1f;
+    float const far = 100.f;
+
+    auto const depth = [](Mat44f const& proj, float dist) {
+        Vec4f const projected = proj * Vec4f{ 0.f, 0.f, -dist, 1.f };
+        return projected.z / projected.w;
+    };
+
+    SECTION("Near maps to one, far maps to zero")
+    {
+        Mat44f proj = make_reverse_z_projection(fov, aspect, near, far);
+
+        REQUIRE(depth(proj, near) == Catch::Approx(1.f).margin(0.00001));
+        REQUIRE(depth(proj, far) == Catch::Approx(0.f).margin(0.00001));
+        REQUIRE(depth(proj, 10.f) > depth(proj, 20.f));
+    }
+
+    SECTION("Same x and y as the standard projection")
+    {
+        Mat44f standard = make_perspective_projection(fov, aspect, near, far);
+        Mat44f reversed = make_reverse_z_projection(fov, aspect, near, far);
+        Vec4f point = { 3.f, -2.f, -7.f, 1.f };
+
+        Vec4f a = standard * point;
+        Vec4f b = reversed * point;
+
+        REQUIRE(a.x / a.w == Catch::Approx(b.x / b.w));
+        REQUIRE(a.y / a.w == Catch::Approx(b.y / b.w));
+        REQUIRE(a.w == Catch::Approx(b.w));
+    }
+
+    SECTION("Infinite far plane")
+    {
+        Mat44f proj = make_infinite_reverse_z_projection(fov, aspect, near);
+
+        REQUIRE(depth(proj, near) == Catch::Approx(1.f).margin(0.00001));
+        REQUIRE(depth(proj, 1e6f) > 0.f);
+        REQUIRE(depth(proj, 1e6f) < 1e-6f);
+
+        // Points far beyond any practical far plane are still in front of
+        // the camera and ordered correctly.
+        REQUIRE(depth(proj, 1e4f) > depth(proj, 2e4f));
+    }
+
+    SECTION("Depth resolution with 32-bit float depth")
+    {
+        // Two points 1 cm apart at 1 km still get different depth values.
+        // The standard projection cannot separate them (even before the
+        // [-1,1] -> [0,1] depth range mapping).
+        Mat44f reversed = make_infinite_reverse_z_projection(fov, aspect, near);
+        REQUIRE(depth(reversed, 1000.f) != depth(reversed, 1000.01f));
+
+        Mat44f standard = make_perspective_projection(fov, aspect, near, 2000.f);
+        REQUIRE(depth(standard, 1000.f) == depth(standard, 1000.01f));
+    }
+}
+
 TEST_CASE("Matrix transpose test", "[mat44]")
 {
     SECTION("Transpose identity matrix")
@@ -0,0 +1,100 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+
+#include "../support/frame_arena.hpp"
+#include "../support/alloc_counter.hpp"
+
+namespace
+{
+    bool is_aligned(void const* ptr, std::size_t align)
+    {
+        return 0 == reinterpret_cast<std::uintptr_t>(ptr) % align;
+    }
+}
+
+TEST_CASE("FrameArena hands out aligned memory from its buffer", "[frame_arena]")
+{
+    alignas(std::max_align_t) std::byte buffer[1024];
+    FrameArena arena(buffer, sizeof(buffer));
+
+    void* const a = arena.allocate(3, 1);
+    void* const b = arena.allocate(16, 16);
+    void* const c = arena.allocate(8, 8);
+
+    REQUIRE(static_cast<std::byte*>(a) >= buffer);
+    REQUIRE(static_cast<std::byte*>(c) + 8 <= buffer + sizeof(buffer));
+    REQUIRE(is_aligned(b, 16));
+    REQUIRE(is_aligned(c, 8));
+    REQUIRE(static_cast<std::byte*>(b) >= static_cast<std::byte*>(a) + 3);
+    REQUIRE(static_cast<std::byte*>(c) >= static_cast<std::byte*>(b) + 16);
+    REQUIRE(0 == arena.overflows());
+
+    // The most recent allocation is given back.
+    std::size_t const used = arena.used();
+    arena.deallocate(c, 8, 8);
+    REQUIRE(arena.used() < used);
+
+    // reset() starts over from the beginning of the buffer.
+    arena.reset();
+    REQUIRE(0 == arena.used());
+    REQUIRE(arena.allocate(3, 1) == a);
+    REQUIRE(arena.high_water() >= used);
+}
+
+TEST_CASE("FrameArena falls back to upstream when full", "[frame_arena]")
+{
+    alignas(std::max_align_t) std::byte buffer[64];
+    FrameArena arena(buffer, sizeof(buffer));
+
+    void* const inside = arena.allocate(48, 8);
+    void* const outside = arena.allocate(48, 32);
+
+    REQUIRE(static_cast<std::byte*>(inside) >= buffer);
+    REQUIRE(static_cast<std::byte*>(inside) < buffer + sizeof(buffer));
+    REQUIRE((static_cast<std::byte*>(outside) < buffer || static_cast<std::byte*>(outside) >= buffer + sizeof(buffer)));
+    REQUIRE(is_aligned(outside, 32));
+    REQUIRE(1 == arena.overflows());
+    REQUIRE(arena.used() >= 96);
+
+    arena.reset();
+    REQUIRE(0 == arena.used());
+    REQUIRE(arena.high_water() >= 96);
+}
+
+TEST_CASE("FrameArena backs pmr containers without heap allocations", "[frame_arena][alloc_counter]")
+{
+    FrameArena arena(64 * 1024);
+
+    for (int frame = 0; frame < 4; ++frame)
+    {
+        auto const before = thread_heap_allocations();
+
+        arena.reset();
+        std::pmr::vector<std::uint32_t> keys(&arena);
+        for (std::uint32_t i = 0; i < 1000; ++i)
+            keys.push_back(1000 - i);
+
+        REQUIRE(thread_heap_allocations() == before);
+        REQUIRE(1000 == keys.size());
+        REQUIRE(1 == keys.back());
+    }
+
+    REQUIRE(0 == arena.overflows());
+}
+
+TEST_CASE("Heap allocations are counted per thread", "[alloc_counter]")
+{
+    auto const before = thread_heap_allocations();
+    auto const beforeBytes = thread_heap_allocated_bytes();
+
+    std::vector<double> values(100, 1.0);
+    std::vector<int> indices(10, 2);
+
+    REQUIRE(thread_heap_allocations() - before == 2);
+    REQUIRE(thread_heap_allocated_bytes() - beforeBytes >= 100 * sizeof(double) + 10 * sizeof(int));
+    REQUIRE(values[99] + indices[9] == 3.0);
+}
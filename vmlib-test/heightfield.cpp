@@ -0,0 +1,167 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "../support/error.hpp"
+#include "../support/heightfield.hpp"
+
+namespace
+{
+    float height_at(Heightfield const& field, std::uint32_t x, std::uint32_t z)
+    {
+        return field.heights[std::size_t(z) * field.columns + x];
+    }
+
+    // Two triangles covering the grid cell with corner (x,z), heights from
+    // height(x,z) at the corners
+    template <typename F>
+    void add_cell(std::vector<Vec3f>& positions, float x, float z, F const& height)
+    {
+        auto const corner = [&](float cx, float cz) {
+            return Vec3f{ cx, height(cx, cz), cz };
+        };
+
+        positions.emplace_back(corner(x, z));
+        positions.emplace_back(corner(x + 1.f, z));
+        positions.emplace_back(corner(x + 1.f, z + 1.f));
+
+        positions.emplace_back(corner(x, z));
+        positions.emplace_back(corner(x + 1.f, z + 1.f));
+        positions.emplace_back(corner(x, z + 1.f));
+    }
+}
+
+TEST_CASE("make_heightfield samples a sloped quad exactly", "[heightfield]")
+{
+    // Two triangles over [1,3]×[-2,0], y = x + 2z + 1
+    auto const height = [](float x, float z) { return x + 2.f * z + 1.f; };
+
+    std::vector<Vec3f> const positions = {
+        { 1.f, height(1.f, -2.f), -2.f }, { 3.f, height(3.f, -2.f), -2.f }, { 3.f, height(3.f, 0.f), 0.f },
+        { 1.f, height(1.f, -2.f), -2.f }, { 3.f, height(3.f, 0.f), 0.f }, { 1.f, height(1.f, 0.f), 0.f },
+    };
+
+    // Six corners are less than one grid vertex; the minimum of four
+    // vertices gives a 3×3 grid.
+    auto const field = make_heightfield(positions, 2048);
+
+    REQUIRE(3 == field.columns);
+    REQUIRE(3 == field.rows);
+    REQUIRE(1.f == field.originX);
+    REQUIRE(-2.f == field.originZ);
+    REQUIRE(1.f == field.spacingX);
+    REQUIRE(1.f == field.spacingZ);
+    REQUIRE(9 == field.heights.size());
+
+    for (std::uint32_t z = 0; z < 3; ++z)
+    {
+        for (std::uint32_t x = 0; x < 3; ++x)
+            REQUIRE(height_at(field, x, z) == height(1.f + float(x), -2.f + float(z)));
+    }
+
+    SECTION("aMaxSize limits the grid")
+    {
+        auto const coarse = make_heightfield(positions, 2);
+
+        REQUIRE(2 == coarse.columns);
+        REQUIRE(2 == coarse.rows);
+        REQUIRE(2.f == coarse.spacingX);
+        REQUIRE(height_at(coarse, 0, 0) == height(1.f, -2.f));
+        REQUIRE(height_at(coarse, 1, 0) == height(3.f, -2.f));
+        REQUIRE(height_at(coarse, 0, 1) == height(1.f, 0.f));
+        REQUIRE(height_at(coarse, 1, 1) == height(3.f, 0.f));
+    }
+}
+
+TEST_CASE("make_heightfield fills holes from their neighbours", "[heightfield]")
+{
+    SECTION("hole inside the mesh")
+    {
+        // 4×4 cells without the four around (2,2), which no triangle then
+        // covers. Non-planar, so the filled height differs from the surface.
+        auto const height = [](float x, float z) { return x * x + z; };
+
+        std::vector<Vec3f> positions;
+        for (int z = 0; z < 4; ++z)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                if ((1 == x || 2 == x) && (1 == z || 2 == z))
+                    continue;
+                add_cell(positions, float(x), float(z), height);
+            }
+        }
+
+        // 24 triangles; repeat eight of them (same heights, so the result is
+        // unchanged) to get 16 vertices' worth, i.e., a 5×5 grid on the cell
+        // corners.
+        for (std::size_t i = 0; i < 8 * 3; ++i)
+            positions.emplace_back(positions[i]);
+
+        auto const field = make_heightfield(positions, 2048);
+        REQUIRE(5 == field.columns);
+        REQUIRE(5 == field.rows);
+
+        for (std::uint32_t z = 0; z < 5; ++z)
+        {
+            for (std::uint32_t x = 0; x < 5; ++x)
+            {
+                if (2 == x && 2 == z)
+                    continue;
+                REQUIRE(height_at(field, x, z) == height(float(x), float(z)));
+            }
+        }
+
+        float const expected = (height(1.f, 2.f) + height(3.f, 2.f) + height(2.f, 1.f) + height(2.f, 3.f)) / 4.f;
+        REQUIRE(height_at(field, 2, 2) == Catch::Approx(expected));
+        REQUIRE(height_at(field, 2, 2) != Catch::Approx(height(2.f, 2.f)));
+    }
+
+    SECTION("uncovered corner, two rings deep")
+    {
+        // A single triangle over half of [0,2]² (y = x) leaves (2,1), (1,2)
+        // and (2,2) uncovered. The latter is only reached via the others.
+        std::vector<Vec3f> const positions = {
+            { 0.f, 0.f, 0.f }, { 2.f, 2.f, 0.f }, { 0.f, 0.f, 2.f },
+        };
+
+        auto const field = make_heightfield(positions, 2048);
+        REQUIRE(3 == field.columns);
+        REQUIRE(3 == field.rows);
+
+        REQUIRE(height_at(field, 1, 1) == 1.f);
+        REQUIRE(height_at(field, 2, 1) == Catch::Approx(1.5f)); // (1,1) and (2,0)
+        REQUIRE(height_at(field, 1, 2) == Catch::Approx(0.5f)); // (0,2) and (1,1)
+        REQUIRE(height_at(field, 2, 2) == Catch::Approx(1.f));  // (1,2) and (2,1)
+    }
+}
+
+TEST_CASE("make_heightfield rejects meshes without area", "[heightfield]")
+{
+    SECTION("empty mesh")
+    {
+        REQUIRE_THROWS_AS(make_heightfield({}, 2048), Error);
+    }
+
+    SECTION("zero-area bounds")
+    {
+        // All triangles on the line z = 1
+        std::vector<Vec3f> const positions = {
+            { 0.f, 0.f, 1.f }, { 1.f, 1.f, 1.f }, { 2.f, 0.f, 1.f },
+            { 2.f, 0.f, 1.f }, { 3.f, 5.f, 1.f }, { 4.f, 0.f, 1.f },
+        };
+        REQUIRE_THROWS_AS(make_heightfield(positions, 2048), Error);
+    }
+
+    SECTION("vertical triangles only")
+    {
+        // The bounds cover [0,1]², but neither triangle covers any of it.
+        std::vector<Vec3f> const positions = {
+            { 0.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, { 1.f, 1.f, 0.f },
+            { 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 1.f },
+        };
+        REQUIRE_THROWS_AS(make_heightfield(positions, 2048), Error);
+    }
+}
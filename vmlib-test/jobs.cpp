@@ -0,0 +1,272 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+#include "../jobs/job_system.hpp"
+
+namespace
+{
+    // Frustum culling of bounding spheres. Planes are (n, d) with n pointing
+    // inwards; a sphere is visible unless it is fully outside one plane.
+    bool sphere_visible(Vec4f const (&planes)[6], Vec4f const& sphere)
+    {
+        for (auto const& p : planes)
+        {
+            float const dist = p.x * sphere.x + p.y * sphere.y + p.z * sphere.z + p.w;
+            if (dist < -sphere.w)
+                return false;
+        }
+        return true;
+    }
+
+    struct Instance
+    {
+        Vec3f position;
+        float angle;
+    };
+
+    std::vector<Instance> make_instances(std::size_t count)
+    {
+        std::vector<Instance> ret(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            float const f = float(i);
+            ret[i] = Instance{ Vec3f{ f * 0.37f - 500.f, 0.f, f * 0.11f - 200.f }, f * 0.01f };
+        }
+        return ret;
+    }
+
+    Mat44f instance_matrix(Mat44f const& projCamera, Instance const& instance)
+    {
+        return projCamera * make_translation(instance.position) * make_rotation_y(instance.angle);
+    }
+}
+
+TEST_CASE("Job system parallel_for", "[jobs]")
+{
+    JobSystem jobs(3);
+    REQUIRE(jobs.thread_count() == 4);
+
+    SECTION("Each index is visited exactly once")
+    {
+        constexpr std::size_t kCount = 100000;
+        std::vector<std::atomic<int>> visits(kCount);
+
+        jobs.parallel_for(kCount, 64, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                visits[i].fetch_add(1, std::memory_order_relaxed);
+        });
+
+        std::size_t wrong = 0;
+        for (auto const& v : visits)
+            wrong += (1 != v.load()) ? 1 : 0;
+        REQUIRE(wrong == 0);
+    }
+
+    SECTION("Ranges respect the grain size")
+    {
+        std::atomic<std::size_t> largest{ 0 };
+        jobs.parallel_for(10000, 100, [&](std::size_t begin, std::size_t end) {
+            std::size_t size = end - begin;
+            std::size_t prev = largest.load();
+            while (size > prev && !largest.compare_exchange_weak(prev, size))
+                ;
+        });
+        REQUIRE(largest.load() <= 100);
+    }
+
+    SECTION("More jobs than preallocated slots")
+    {
+        // Grain 1 results in far more jobs than kJobsPerThread; the job ring
+        // has to wrap around safely.
+        std::atomic<std::size_t> sum{ 0 };
+        constexpr std::size_t kCount = 4 * JobSystem::kJobsPerThread;
+        jobs.parallel_for(kCount, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                sum.fetch_add(i, std::memory_order_relaxed);
+        });
+        REQUIRE(sum.load() == kCount * (kCount - 1) / 2);
+    }
+
+    SECTION("Dependencies")
+    {
+        constexpr std::size_t kCount = 4096;
+        std::vector<int> a(kCount, 0), b(kCount, 0);
+
+        auto first = [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                a[i] = int(i);
+        };
+        auto second = [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                b[i] = a[kCount - 1 - i] + 1;
+        };
+
+        JobCounter firstDone, secondDone;
+        jobs.parallel_for(kCount, 128, first, firstDone);
+        jobs.parallel_for(kCount, 128, second, secondDone, &firstDone);
+        jobs.wait(secondDone);
+
+        REQUIRE(firstDone.done());
+
+        bool ok = true;
+        for (std::size_t i = 0; i < kCount; ++i)
+            ok = ok && (b[i] == int(kCount - i));
+        REQUIRE(ok);
+    }
+}
+
+TEST_CASE("Job system dependencies without stealing", "[jobs]")
+{
+    // The only worker is kept busy, so the waiting thread has to run both
+    // parallel_for()s itself. The dependent one is popped first (it was
+    // pushed last) and must not keep coming back while its dependency waits
+    // in the same deque.
+    JobSystem jobs(1);
+
+    std::atomic<bool> started{ false }, release{ false };
+    auto blocker = [&](std::size_t, std::size_t) {
+        started.store(true);
+        while (!release.load())
+            std::this_thread::yield();
+    };
+
+    JobCounter blockerDone;
+    jobs.parallel_for(1, 1, blocker, blockerDone);
+    while (!started.load())
+        std::this_thread::yield();
+
+    constexpr std::size_t kCount = 1024;
+    std::vector<int> a(kCount, 0), b(kCount, 0);
+
+    auto first = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            a[i] = int(i);
+    };
+    auto second = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            b[i] = a[i] * 2;
+    };
+
+    JobCounter firstDone, secondDone;
+    jobs.parallel_for(kCount, 64, first, firstDone);
+    jobs.parallel_for(kCount, 64, second, secondDone, &firstDone);
+    jobs.wait(secondDone);
+
+    REQUIRE(firstDone.done());
+    REQUIRE(!blockerDone.done());
+
+    bool ok = true;
+    for (std::size_t i = 0; i < kCount; ++i)
+        ok = ok && (b[i] == int(2 * i));
+    REQUIRE(ok);
+
+    // A dependency that is already done does not park the job.
+    JobCounter thirdDone;
+    jobs.parallel_for(kCount, 64, second, thirdDone, &firstDone);
+    jobs.wait(thirdDone);
+    REQUIRE(thirdDone.done());
+
+    release.store(true);
+    jobs.wait(blockerDone);
+}
+
+TEST_CASE("Job system wakes sleeping workers", "[jobs]")
+{
+    // Idle workers block without a timeout, so a lost wake-up would leave
+    // the job unrun. The owning thread only watches; it never helps.
+    JobSystem jobs(2);
+
+    std::atomic<std::size_t> runs{ 0 };
+    auto job = [&](std::size_t, std::size_t) {
+        runs.fetch_add(1);
+    };
+
+    constexpr std::size_t kRounds = 200;
+    for (std::size_t round = 0; round < kRounds; ++round)
+    {
+        // Give the workers time to go to sleep (every few rounds) or to be
+        // on their way there.
+        std::this_thread::sleep_for(std::chrono::microseconds(round % 4 ? 50 : 2000));
+
+        JobCounter done;
+        jobs.parallel_for(1, 1, job, done);
+
+        auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!done.done() && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+
+        REQUIRE(done.done());
+    }
+
+    REQUIRE(kRounds == runs.load());
+}
+
+// Benchmarks. Hidden by default; run with
+//   vmlib-test "[jobs-benchmark]"
+TEST_CASE("Job system benchmarks", "[.][jobs-benchmark]")
+{
+    JobSystem jobs;
+
+    constexpr std::size_t kInstances = 200000;
+    auto const instances = make_instances(kInstances);
+
+    Mat44f const projCamera = make_perspective_projection(1.f, 16.f / 9.f, 0.1f, 100.f)
+        * make_rotation_x(0.3f) * make_translation({ 0.f, -5.f, -10.f });
+
+    std::vector<Mat44f> matrices(kInstances);
+
+    BENCHMARK("Matrices, serial")
+    {
+        for (std::size_t i = 0; i < kInstances; ++i)
+            matrices[i] = instance_matrix(projCamera, instances[i]);
+        return matrices[kInstances / 2].v[0];
+    };
+
+    BENCHMARK("Matrices, parallel_for (grain 1024)")
+    {
+        jobs.parallel_for(kInstances, 1024, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                matrices[i] = instance_matrix(projCamera, instances[i]);
+        });
+        return matrices[kInstances / 2].v[0];
+    };
+
+    Vec4f const planes[6] = {
+        { 1.f, 0.f, 0.f, 100.f }, { -1.f, 0.f, 0.f, 100.f },
+        { 0.f, 1.f, 0.f, 100.f }, { 0.f, -1.f, 0.f, 100.f },
+        { 0.f, 0.f, 1.f, 100.f }, { 0.f, 0.f, -1.f, 100.f }
+    };
+
+    std::vector<Vec4f> spheres(kInstances);
+    for (std::size_t i = 0; i < kInstances; ++i)
+        spheres[i] = Vec4f{ instances[i].position.x, instances[i].position.y, instances[i].position.z, 2.f };
+
+    std::vector<std::uint8_t> visible(kInstances);
+
+    BENCHMARK("Culling, serial")
+    {
+        for (std::size_t i = 0; i < kInstances; ++i)
+            visible[i] = sphere_visible(planes, spheres[i]);
+        return visible[kInstances / 2];
+    };
+
+    BENCHMARK("Culling, parallel_for (grain 4096)")
+    {
+        jobs.parallel_for(kInstances, 4096, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                visible[i] = sphere_visible(planes, spheres[i]);
+        });
+        return visible[kInstances / 2];
+    };
+
+    std::printf("Job system: %zu threads, %zu jobs executed, %zu stolen\n",
+        jobs.thread_count(), jobs.stats().executed, jobs.stats().stolen);
+}
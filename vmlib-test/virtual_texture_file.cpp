@@ -0,0 +1,126 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+
+#include "../support/virtual_texture_file.hpp"
+
+#include "../jobs/job_system.hpp"
+
+namespace
+{
+    // Distinct value for every texel (opaque)
+    std::vector<std::uint8_t> make_image(std::uint32_t width, std::uint32_t height)
+    {
+        std::vector<std::uint8_t> rgba(std::size_t(width) * height * 4);
+        for (std::uint32_t y = 0; y < height; ++y)
+        {
+            for (std::uint32_t x = 0; x < width; ++x)
+            {
+                auto* texel = rgba.data() + (std::size_t(y) * width + x) * 4;
+                texel[0] = std::uint8_t(x);
+                texel[1] = std::uint8_t(y);
+                texel[2] = std::uint8_t(x / 256 + y / 256 * 16);
+                texel[3] = 255;
+            }
+        }
+        return rgba;
+    }
+
+    std::uint8_t const* page_texel(std::vector<std::uint8_t> const& page, std::uint32_t pageSize, std::uint32_t x, std::uint32_t y)
+    {
+        return page.data() + (std::size_t(y) * pageSize + x) * 4;
+    }
+}
+
+TEST_CASE("Virtual texture tiles round-trip", "[virtual_texture]")
+{
+    namespace fs = std::filesystem;
+    auto const path = (fs::temp_directory_path() / "vmlib-test-virtual-texture.vtex").string();
+
+    // Odd sizes: levels round up (300x200, 150x100, 75x50, 38x25, 19x13)
+    constexpr std::uint32_t kWidth = 300, kHeight = 200;
+    constexpr std::uint32_t kTile = 32, kBorder = 2, kPage = kTile + 2 * kBorder;
+
+    auto const image = make_image(kWidth, kHeight);
+
+    JobSystem jobs(2);
+    auto const stats = write_virtual_texture(path.c_str(), VirtualTextureSource{ image.data(), kWidth, kHeight, 1234, 5678 }, kTile, kBorder, jobs);
+
+    REQUIRE(5 == stats.levels);
+    REQUIRE(stats.fileBytes == fs::file_size(path));
+
+    VirtualTextureFile const file(path.c_str());
+    REQUIRE(kWidth == file.width());
+    REQUIRE(kTile == file.tile_size());
+    REQUIRE(kPage == file.page_size());
+    REQUIRE(1234 == file.source_size());
+    REQUIRE(5678 == file.source_time());
+    REQUIRE(stats.tiles == file.tile_count());
+
+    SECTION("level geometry")
+    {
+        REQUIRE(5 == file.level_count());
+        REQUIRE(10 == file.level(0).tilesX);
+        REQUIRE(7 == file.level(0).tilesY);
+        REQUIRE(38 == file.level(3).width);
+        REQUIRE(25 == file.level(3).height);
+
+        // The last level fits into a single tile.
+        auto const& last = file.level(4);
+        REQUIRE((1 == last.tilesX && 1 == last.tilesY));
+        REQUIRE(file.tile_count() == last.firstTile + 1);
+
+        REQUIRE(file.level(1).firstTile == file.tile_index(0, 9, 6) + 1);
+    }
+
+    SECTION("pages hold the tile and a wrapped border")
+    {
+        std::vector<std::uint8_t> page(file.page_bytes());
+
+        // Tile (1,2): texels (32..63, 64..95)
+        file.read_tile(file.tile_index(0, 1, 2), page.data());
+        auto const* inner = page_texel(page, kPage, kBorder + 5, kBorder + 7);
+        REQUIRE(32 + 5 == inner[0]);
+        REQUIRE(64 + 7 == inner[1]);
+
+        // Tile (0,0): the border wraps to the other edge
+        file.read_tile(file.tile_index(0, 0, 0), page.data());
+        auto const* corner = page_texel(page, kPage, 0, 0);
+        REQUIRE(std::uint8_t(kWidth - kBorder) == corner[0]);
+        REQUIRE(std::uint8_t(kHeight - kBorder) == corner[1]);
+    }
+
+    SECTION("coarser levels are averaged")
+    {
+        std::vector<std::uint8_t> page(file.page_bytes());
+        file.read_tile(file.tile_index(1, 0, 0), page.data());
+
+        // Texel (3,4) of level 1 covers texels (6..7, 8..9) of level 0.
+        auto const* texel = page_texel(page, kPage, kBorder + 3, kBorder + 4);
+        REQUIRE(texel[0] >= 6);
+        REQUIRE(texel[0] <= 7);
+        REQUIRE(texel[1] >= 8);
+        REQUIRE(texel[1] <= 9);
+        REQUIRE(255 == texel[3]);
+    }
+
+    SECTION("invalid files are rejected")
+    {
+        auto const bad = (fs::temp_directory_path() / "vmlib-test-virtual-texture-bad.vtex").string();
+
+        std::FILE* fof = std::fopen(bad.c_str(), "wb");
+        REQUIRE(fof);
+        std::string const junk(200, 'x');
+        std::fwrite(junk.data(), 1, junk.size(), fof);
+        std::fclose(fof);
+
+        REQUIRE_THROWS(VirtualTextureFile(bad.c_str()));
+        REQUIRE_THROWS(write_virtual_texture(bad.c_str(), VirtualTextureSource{ image.data(), kWidth, kHeight, 0, 0 }, 0, 0, jobs));
+
+        fs::remove(bad);
+    }
+}
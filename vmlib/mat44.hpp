@@ -185,6 +185,61 @@ Mat44f make_perspective_projection(float aFovInRadians, float aAspect, float aNe
 	};
 }
 
+// Orthographic projection, same conventions as glOrtho(): the box from
+// (aLeft, aBottom, -aNear) to (aRight, aTop, -aFar) in view space maps to
+// [-1,1] on all axes.
+inline
+Mat44f make_orthographic_projection(float aLeft, float aRight, float aBottom, float aTop, float aNear, float aFar) noexcept
+{
+	float const w = aRight - aLeft;
+	float const h = aTop - aBottom;
+	float const d = aFar - aNear;
+
+	return Mat44f{
+		2.f / w,   0.f,      0.f,       -(aRight + aLeft) / w,
+		0.f,       2.f / h,  0.f,       -(aTop + aBottom) / h,
+		0.f,       0.f,      -2.f / d,  -(aFar + aNear) / d,
+		0.f,       0.f,      0.f,       1.f
+	};
+}
+
+// Reverse-Z projections, for a [0,1] clip space depth range (i.e., with
+// glClipControl( GL_LOWER_LEFT, GL_ZERO_TO_ONE )). The near plane maps to
+// depth 1 and the far plane to 0; use GL_GREATER and clear depth to 0.
+//
+// With a floating point depth buffer, reverse-Z spreads the precision about
+// evenly over the view distance: the float's exponent compensates for the
+// 1/z distribution. The infinite variant has no far plane at all (depth
+// approaches 0 as the distance goes to infinity).
+inline
+Mat44f make_reverse_z_projection(float aFovInRadians, float aAspect, float aNear, float aFar) noexcept
+{
+	float const tanHalfFov = std::tan(aFovInRadians * 0.5f);
+	float const f = 1.f / tanHalfFov; // focal length
+	float const d = aFar - aNear;     // distance between near and far planes
+
+	return Mat44f{
+		f / aAspect, 0.f,  0.f,                   0.f,
+		0.f,       f,    0.f,                   0.f,
+		0.f,       0.f,  aNear / d,             aFar * aNear / d,
+		0.f,       0.f,  -1.f,                  0.f
+	};
+}
+
+inline
+Mat44f make_infinite_reverse_z_projection(float aFovInRadians, float aAspect, float aNear) noexcept
+{
+	float const tanHalfFov = std::tan(aFovInRadians * 0.5f);
+	float const f = 1.f / tanHalfFov; // focal length
+
+	return Mat44f{
+		f / aAspect, 0.f,  0.f,                   0.f,
+		0.f,       f,    0.f,                   0.f,
+		0.f,       0.f,  0.f,                   aNear,
+		0.f,       0.f,  -1.f,                  0.f
+	};
+}
+
 
 
 
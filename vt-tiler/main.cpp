@@ -0,0 +1,228 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <system_error>
+
+#include <stb_image.h>
+
+#include "../support/error.hpp"
+#include "../support/virtual_texture_file.hpp"
+
+#include "../jobs/job_system.hpp"
+
+/* Virtual texture tiler
+ *
+ * Tiles an image into a virtual texture file (see
+ * support/virtual_texture_file.hpp) ahead of time. The program tiles large
+ * textures on first use as well (ensure_virtual_texture()), but can only
+ * decode images of up to 2 GiB (stb_image's limit, e.g. 16k x 16k RGBA).
+ * Larger textures are assembled from a grid of equally sized images with
+ * --grid=CxR: C columns and R rows, listed row by row starting at the top.
+ *
+ * For a single source, the output records the source's size and
+ * modification time, so the program considers it current. Assembled
+ * outputs record none; name them after a texture path that does not exist
+ * (e.g. "assets/terrain.png.vtex" without "assets/terrain.png"), and the
+ * program uses them as-is.
+ *
+ * Exit code: 0 on success, 1 on errors, 2 on usage errors.
+ */
+
+namespace
+{
+	struct Options_
+	{
+		std::uint32_t tileSize = 120;
+		std::uint32_t border = 4;
+		std::size_t threads = 0;
+		std::uint32_t columns = 1, rows = 1;
+		std::vector<char const*> inputs;
+		std::string output;
+	};
+
+	void print_help_( char const* aProgram )
+	{
+		std::printf( "Usage: %s [options] IMAGE... [OUTPUT]\n", aProgram );
+		std::printf( "Writes IMAGE.vtex unless OUTPUT (ending in .vtex) is given.\n" );
+		std::printf( "Options:\n" );
+		std::printf( "  --tile=N            Tile size in texels (default: 120, as the program bakes)\n" );
+		std::printf( "  --border=N          Border around each tile in texels (default: 4)\n" );
+		std::printf( "  --grid=CxR          Assemble C x R images, row by row from the top (default: 1x1)\n" );
+		std::printf( "  --threads=N         Downsample and compress on N worker threads (default: all cores)\n" );
+	}
+
+	char const* match_value_( char const* aArg, char const* aName )
+	{
+		std::size_t const len = std::strlen( aName );
+		if( 0 != std::strncmp( aArg, aName, len ) || '=' != aArg[len] )
+			return nullptr;
+
+		return aArg + len + 1;
+	}
+
+	bool ends_with_( char const* aString, char const* aSuffix )
+	{
+		std::size_t const len = std::strlen( aString ), suffix = std::strlen( aSuffix );
+		return len >= suffix && 0 == std::strcmp( aString + len - suffix, aSuffix );
+	}
+
+	using Image_ = std::unique_ptr<stbi_uc, void (*)(void*)>;
+
+	Image_ load_( char const* aPath, int& aWidth, int& aHeight )
+	{
+		// GL orientation (first row at the bottom), as the program expects
+		stbi_set_flip_vertically_on_load( true );
+
+		int channels;
+		Image_ image( stbi_load( aPath, &aWidth, &aHeight, &channels, 4 ), &stbi_image_free );
+		if( !image )
+			throw Error( "Unable to load image '%s': %s", aPath, stbi_failure_reason() );
+
+		return image;
+	}
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+	Options_ options;
+	std::vector<char const*> positional;
+	for( int i = 1; i < aArgc; ++i )
+	{
+		char const* arg = aArgv[i];
+
+		if( 0 == std::strcmp( arg, "--help" ) )
+		{
+			print_help_( aArgv[0] );
+			return 0;
+		}
+		else if( char const* value = match_value_( arg, "--tile" ) )
+		{
+			options.tileSize = std::uint32_t(std::max( 0, std::atoi( value ) ));
+		}
+		else if( char const* value = match_value_( arg, "--border" ) )
+		{
+			options.border = std::uint32_t(std::max( 0, std::atoi( value ) ));
+		}
+		else if( char const* value = match_value_( arg, "--grid" ) )
+		{
+			unsigned columns = 0, rows = 0;
+			if( 2 != std::sscanf( value, "%ux%u", &columns, &rows ) || 0 == columns || 0 == rows )
+			{
+				std::fprintf( stderr, "vt-tiler: invalid grid '%s' (expected CxR)\n", value );
+				return 2;
+			}
+
+			options.columns = columns;
+			options.rows = rows;
+		}
+		else if( char const* value = match_value_( arg, "--threads" ) )
+		{
+			options.threads = std::size_t(std::max( 0, std::atoi( value ) ));
+		}
+		else if( '-' == arg[0] && '-' == arg[1] )
+		{
+			std::fprintf( stderr, "vt-tiler: unknown option '%s' (try --help)\n", arg );
+			return 2;
+		}
+		else
+		{
+			positional.emplace_back( arg );
+		}
+	}
+
+	if( !positional.empty() && ends_with_( positional.back(), ".vtex" ) )
+	{
+		options.output = positional.back();
+		positional.pop_back();
+	}
+
+	std::size_t const count = std::size_t(options.columns) * options.rows;
+	if( positional.size() != count )
+	{
+		print_help_( aArgv[0] );
+		return 2;
+	}
+
+	options.inputs = positional;
+	if( options.output.empty() )
+		options.output = std::string(options.inputs.front()) + ".vtex";
+
+	auto const start = std::chrono::steady_clock::now();
+
+	// Single image: tiled in place
+	VirtualTextureSource source{};
+	std::vector<std::uint8_t> assembled;
+
+	int w = 0, h = 0;
+	Image_ first = load_( options.inputs.front(), w, h );
+
+	if( 1 == count )
+	{
+		std::error_code ec;
+		auto const path = options.inputs.front();
+		auto const size = std::filesystem::file_size( path, ec );
+		auto const time = std::filesystem::last_write_time( path, ec );
+		if( ec )
+			throw Error( "Unable to stat '%s': %s", path, ec.message().c_str() );
+
+		// As recorded by ensure_virtual_texture()
+		source = VirtualTextureSource{ first.get(), std::uint32_t(w), std::uint32_t(h), size, std::int64_t(time.time_since_epoch().count()) };
+	}
+	else
+	{
+		std::size_t const width = std::size_t(w) * options.columns, height = std::size_t(h) * options.rows;
+		if( width > 0xffffffffu || height > 0xffffffffu )
+			throw Error( "Assembled image too large (%zux%zu)", width, height );
+
+		assembled.resize( width * height * 4 );
+
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			int iw = w, ih = h;
+			Image_ image = i ? load_( options.inputs[i], iw, ih ) : std::move(first);
+			if( iw != w || ih != h )
+				throw Error( "'%s' is %dx%d, expected %dx%d like '%s'", options.inputs[i], iw, ih, w, h, options.inputs.front() );
+
+			// Images are flipped, so the top row of the grid goes last.
+			std::size_t const column = i % options.columns, row = options.rows-1 - i / options.columns;
+			for( std::size_t y = 0; y < std::size_t(h); ++y )
+			{
+				auto const* src = image.get() + y * std::size_t(w) * 4;
+				auto* dst = assembled.data() + ((row * h + y) * width + column * w) * 4;
+				std::memcpy( dst, src, std::size_t(w) * 4 );
+			}
+
+			std::printf( "vt-tiler: '%s' (%zu/%zu)\n", options.inputs[i], i+1, count );
+		}
+
+		source = VirtualTextureSource{ assembled.data(), std::uint32_t(width), std::uint32_t(height), 0, 0 };
+	}
+
+	JobSystem jobs( options.threads );
+	auto const stats = write_virtual_texture( options.output.c_str(), source, options.tileSize, options.border, jobs );
+
+	auto const ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+	std::printf( "vt-tiler: %ux%u, %u levels, %zu tiles (%zu compressed), %.1f MiB in '%s' (%.1f ms, %zu threads)\n",
+		source.width, source.height,
+		stats.levels, stats.tiles, stats.compressed,
+		stats.fileBytes / (1024.0*1024.0),
+		options.output.c_str(),
+		ms, jobs.thread_count()
+	);
+
+	return 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "vt-tiler: %s\n", eErr.what() );
+	return 1;
+}